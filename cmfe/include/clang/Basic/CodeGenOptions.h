@@ -264,6 +264,10 @@ public:
   /// OpenCL builtin functions
   std::string GenXBiFName;
 
+  /// for MDF CM compilations, the CM library modules (bitcode or SPIR-V) to
+  /// link with the kernels before optimization
+  std::vector<std::string> CMLinkLibraries;
+
   /// Set of files defining the rules for the symbol rewriting.
   std::vector<std::string> RewriteMapFiles;
 
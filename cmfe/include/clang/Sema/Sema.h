@@ -67,6 +67,7 @@ namespace llvm {
   template <typename ValueT> struct DenseMapInfo;
   template <typename ValueT, typename ValueInfoT> class DenseSet;
   class SmallBitVector;
+  class Timer;
   struct InlineAsmIdentifierInfo;
 }
 
@@ -1440,6 +1441,55 @@ public:
   /// \brief Check whether vector/matrix initializer is valid.
   void DiagnoseCMVectorMatrixInitializer(QualType VarType, Expr *E);
 
+  /// \brief A CM region check (select, replicate or vector format)
+  /// that passed without any diagnostic. It is keyed by the check kind, the
+  /// canonical types involved and the constant region parameters, so that
+  /// the same region over the same type is only checked once.
+  class CMRegionCheck : public llvm::FoldingSetNode {
+    ArrayRef<uint64_t> Key;
+    QualType Result;
+
+  public:
+    CMRegionCheck(ArrayRef<uint64_t> Key, QualType Result)
+        : Key(Key), Result(Result) {}
+
+    QualType getResult() const { return Result; }
+
+    void Profile(llvm::FoldingSetNodeID &ID) const { Profile(ID, Key); }
+    static void Profile(llvm::FoldingSetNodeID &ID, ArrayRef<uint64_t> Key) {
+      for (uint64_t V : Key)
+        ID.AddInteger(V);
+    }
+  };
+
+  /// \brief The memoised CM region checks.
+  llvm::FoldingSet<CMRegionCheck> CMRegionChecks;
+
+  /// \brief Times the CM region checks, only set with -ftime-report.
+  std::unique_ptr<llvm::Timer> CMRegionCheckTimer;
+
+  /// \brief Nesting depth of CM region checks being timed.
+  unsigned CMRegionCheckDepth = 0;
+
+  /// \brief Number of CM region checks performed and answered from
+  /// CMRegionChecks.
+  unsigned NumCMRegionChecks = 0;
+  unsigned NumCMRegionCheckHits = 0;
+
+  /// \brief Number of CM region parameters evaluated as constants.
+  unsigned NumCMRegionParamEvals = 0;
+
+  /// \brief Returns the result type of a memoised CM region check, or a null
+  /// type if this region has not been checked cleanly before.
+  QualType LookupCMRegionCheck(ArrayRef<uint64_t> Key);
+
+  /// \brief Memoises a CM region check that found nothing to diagnose.
+  void RecordCMRegionCheck(ArrayRef<uint64_t> Key, QualType Result);
+
+  /// \brief Prints the CM region check counters, used with -ftime-report and
+  /// -print-stats. Prints nothing if no CM region was checked.
+  void PrintCMRegionCheckStats() const;
+
   bool CheckFunctionReturnType(QualType T, SourceLocation Loc);
 
   /// Build a function type.
@@ -31,6 +31,7 @@
 #include "llvm/GenXIntrinsics/GenXSPIRVWriterAdaptor.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/IRPrintingPasses.h"
+#include "llvm/IR/Instructions.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/ModuleSummaryIndex.h"
@@ -379,6 +380,26 @@ static void addCMSimdCFLoweringPass(const PassManagerBuilder &Builder,
   PM.add(createCMSimdCFLoweringPass());
 }
 
+// A kernel compiled straight to vISA cannot be specialized when it is loaded,
+// so each specialization constant takes its default value.
+static void foldCMSpecConstants(Module &M) {
+  for (auto FI = M.begin(), FE = M.end(); FI != FE;) {
+    Function &F = *FI++;
+    if (!F.isDeclaration() ||
+        !F.getName().startswith("_Z20__spirv_SpecConstant"))
+      continue;
+    for (auto UI = F.user_begin(), UE = F.user_end(); UI != UE;) {
+      auto CI = dyn_cast<CallInst>(*UI++);
+      if (!CI || CI->getCalledFunction() != &F)
+        continue;
+      CI->replaceAllUsesWith(CI->getArgOperand(1));
+      CI->eraseFromParent();
+    }
+    if (F.use_empty())
+      F.eraseFromParent();
+  }
+}
+
 static CodeGenOpt::Level getCGOptLevel(const CodeGenOptions &CodeGenOpts) {
   switch (CodeGenOpts.OptimizationLevel) {
   default:
@@ -824,6 +845,8 @@ void EmitAssemblyHelper::EmitAssembly(BackendAction Action,
     return;
   if (TM)
     TheModule->setDataLayout(TM->createDataLayout());
+  if (UsesCodeGen && LangOpts.MdfCM)
+    foldCMSpecConstants(*TheModule);
 
   legacy::PassManager PerModulePasses;
   PerModulePasses.add(
@@ -49,6 +49,7 @@
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <sstream>
 
 using namespace clang;
 using namespace llvm;
@@ -211,6 +212,13 @@ namespace clang {
           for (Function &F : *LM.Module)
             Gen->CGM().AddDefaultFnAttrs(F);
 
+        // CM library modules may come from SPIR-V, which does not carry the
+        // GenX target.
+        if (LangOpts.MdfCM) {
+          LM.Module->setDataLayout(getModule()->getDataLayout());
+          LM.Module->setTargetTriple(getModule()->getTargetTriple());
+        }
+
         CurLinkModule = LM.Module.get();
 
         bool Err;
@@ -889,6 +897,49 @@ GetOutputStream(CompilerInstance &CI, StringRef InFile, BackendAction Action) {
   llvm_unreachable("Invalid action!");
 }
 
+// Load a CM library module to link with the kernels. The library is LLVM
+// bitcode or SPIR-V, as emitted by -emit-llvm or -emit-spirv.
+static std::unique_ptr<llvm::Module>
+loadCMLibraryModule(CompilerInstance &CI, StringRef Filename,
+                    LLVMContext &Ctx) {
+  auto BufOrErr = CI.getFileManager().getBufferForFile(Filename);
+  if (!BufOrErr) {
+    CI.getDiagnostics().Report(diag::err_cannot_open_file)
+        << Filename << BufOrErr.getError().message();
+    return nullptr;
+  }
+
+  // SPIR-V starts with its magic number, 0x07230203.
+  StringRef Data = (*BufOrErr)->getBuffer();
+  if (Data.startswith(StringRef("\x03\x02\x23\x07", 4))) {
+    std::istringstream IS(Data.str());
+    llvm::Module *M = nullptr;
+    std::string Err;
+    SPIRV::TranslatorOpts Opts;
+    Opts.setDesiredBIsRepresentation(SPIRV::BIsRepresentation::SPIRVFriendlyIR);
+    if (!readSpirv(Ctx, Opts, IS, M, Err)) {
+      CI.getDiagnostics().Report(diag::err_cannot_open_file) << Filename << Err;
+      return nullptr;
+    }
+    legacy::PassManager PerModulePasses;
+    PerModulePasses.add(createGenXSPIRVReaderAdaptorPass());
+    PerModulePasses.add(createGenXRestoreIntrAttrPass());
+    PerModulePasses.run(*M);
+    return std::unique_ptr<llvm::Module>(M);
+  }
+
+  Expected<std::unique_ptr<llvm::Module>> ModuleOrErr =
+      getOwningLazyBitcodeModule(std::move(*BufOrErr), Ctx);
+  if (!ModuleOrErr) {
+    handleAllErrors(ModuleOrErr.takeError(), [&](ErrorInfoBase &EIB) {
+      CI.getDiagnostics().Report(diag::err_cannot_open_file)
+          << Filename << EIB.message();
+    });
+    return nullptr;
+  }
+  return std::move(*ModuleOrErr);
+}
+
 std::unique_ptr<ASTConsumer>
 CodeGenAction::CreateASTConsumer(CompilerInstance &CI, StringRef InFile) {
   BackendAction BA = static_cast<BackendAction>(Act);
@@ -900,7 +951,7 @@ CodeGenAction::CreateASTConsumer(CompilerInstance &CI, StringRef InFile) {
     return nullptr;
 
   // Load bitcode modules to link with, if we need to.
-  if (LinkModules.empty())
+  if (LinkModules.empty()) {
     for (const CodeGenOptions::BitcodeFileToLink &F :
          CI.getCodeGenOpts().LinkBitcodeFiles) {
       auto BCBuf = CI.getFileManager().getBufferForFile(F.Filename);
@@ -925,6 +976,22 @@ CodeGenAction::CreateASTConsumer(CompilerInstance &CI, StringRef InFile) {
                              F.Internalize, F.LinkFlags});
     }
 
+    // CM libraries are linked like builtin bitcode: only what the kernels use
+    // is pulled in, and it is internalized so that inlining, CMABI and dead
+    // function removal see the whole program.
+    for (const std::string &Lib : CI.getCodeGenOpts().CMLinkLibraries) {
+      std::unique_ptr<llvm::Module> M =
+          loadCMLibraryModule(CI, Lib, *VMContext);
+      if (!M) {
+        LinkModules.clear();
+        return nullptr;
+      }
+      LinkModules.push_back({std::move(M), /*PropagateAttrs=*/false,
+                             /*Internalize=*/true,
+                             llvm::Linker::Flags::LinkOnlyNeeded});
+    }
+  }
+
   CoverageSourceInfo *CoverageInfo = nullptr;
   // Add the preprocessor callback only when the coverage mapping is generated.
   if (CI.getCodeGenOpts().CoverageMapping) {
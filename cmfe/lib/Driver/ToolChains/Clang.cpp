@@ -4107,6 +4107,16 @@ void Clang::ConstructJob(Compilation &C, const JobAction &JA,
         CmdArgs.push_back(BiFName);
       }
     }
+    for (Arg *A : Args.filtered(options::OPT_mCM_link_library)) {
+      A->claim();
+      const char *LibName = A->getValue();
+      if ((LibName[0] == '=') || (LibName[0] == ':'))
+        LibName = &LibName[1];
+      if (strlen(LibName)) {
+        CmdArgs.push_back("-mCM_link_library");
+        CmdArgs.push_back(LibName);
+      }
+    }
     if (Args.getLastArg(options::OPT_mCM_init_global))
       CmdArgs.push_back("-mCM_init_global");
     if (Args.getLastArg(options::OPT_fvolatile_global))
@@ -627,6 +627,9 @@ void CompilerInstance::createSema(TranslationUnitKind TUKind,
                                   CodeCompleteConsumer *CompletionConsumer) {
   TheSema.reset(new Sema(getPreprocessor(), getASTContext(), getASTConsumer(),
                          TUKind, CompletionConsumer));
+  if (FrontendTimerGroup)
+    TheSema->CMRegionCheckTimer = llvm::make_unique<llvm::Timer>(
+        "cm_region_checks", "CM region checks", *FrontendTimerGroup);
   // Attach the external sema source if there is any.
   if (ExternalSemaSrc) {
     TheSema->addExternalSource(ExternalSemaSrc.get());
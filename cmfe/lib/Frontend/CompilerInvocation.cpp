@@ -793,6 +793,7 @@ static bool ParseCodeGenArgs(CodeGenOptions &Opts, ArgList &Args, InputKind IK,
   Opts.ForceNoInline = !Args.hasArg(OPT_fno_force_noinline);
   if (Args.hasArg(OPT_mCM_import_bif))
     Opts.GenXBiFName = Args.getLastArgValue(OPT_mCM_import_bif);
+  Opts.CMLinkLibraries = Args.getAllArgValues(OPT_mCM_link_library);
   // By default, CM global variables are not default initialized, this option
   // forces initialization when initalizer is absent.
   Opts.InitializeCMGlobals = Args.hasArg(OPT_mCM_init_global);
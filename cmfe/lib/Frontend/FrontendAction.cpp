@@ -23,6 +23,7 @@
 #include "clang/Lex/Preprocessor.h"
 #include "clang/Lex/PreprocessorOptions.h"
 #include "clang/Parse/ParseAST.h"
+#include "clang/Sema/Sema.h"
 #include "clang/Serialization/ASTDeserializationListener.h"
 #include "clang/Serialization/ASTReader.h"
 #include "clang/Serialization/GlobalModuleIndex.h"
@@ -1036,6 +1037,9 @@ void ASTFrontendAction::ExecuteAction() {
 
   ParseAST(CI.getSema(), CI.getFrontendOpts().ShowStats,
            CI.getFrontendOpts().SkipFunctionBodies);
+
+  if (CI.getFrontendOpts().ShowTimers)
+    CI.getSema().PrintCMRegionCheckStats();
 }
 
 void PluginASTAction::anchor() { }
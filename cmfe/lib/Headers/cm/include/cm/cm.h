@@ -2014,6 +2014,18 @@ cm_dp4a(vector<T2, N> src0, vector<T3, N> src1, vector<T4, N> src2,
   return _Result;
 }
 
+// cm_spec_constant
+// Returns the value of the specialization constant \p Id. A kernel compiled to
+// SPIR-V leaves the value open until it is loaded, when the runtime may supply
+// one; otherwise, and when compiling straight to vISA, the result is \p def,
+// which must be a compile time constant.
+template <unsigned Id, typename T>
+CM_NODEBUG CM_INLINE T cm_spec_constant(T def) {
+  CM_STATIC_ERROR(details::is_cm_scalar<T>::value,
+                  "specialization constant must be a scalar of CM type");
+  return __spirv_SpecConstant<T>(Id, def);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // SIMD control follow related macros.
 ////////////////////////////////////////////////////////////////////////////////
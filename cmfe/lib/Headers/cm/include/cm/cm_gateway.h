@@ -88,6 +88,26 @@ CM_INLINE void cm_signal() {
   CM_STATIC_ERROR(N <= 8, "the maximal number dependencies cannot exceed 8");
 }
 
+/// \brief Wait for the first NumDeps thread dependencies of a wavefront
+///
+/// The dependency pattern itself is set up by the host. The hardware
+/// scoreboard ignores the dependencies whose mask bit is set.
+template <int NumDeps>
+CM_INLINE void cm_wavefront_wait() {
+  CM_STATIC_ERROR(NumDeps >= 0 && NumDeps <= 8,
+                  "the maximal number dependencies cannot exceed 8");
+  cm_wait((unsigned char)(0xff << NumDeps));
+}
+
+/// \brief Release the dependants of this thread in a wavefront
+///
+/// The hardware scoreboard releases the dependants when the thread ends, so
+/// this is a no-op and signalling early does not shorten the wavefront.
+template <int NumDeps>
+CM_INLINE void cm_wavefront_signal() {
+  cm_signal<NumDeps>();
+}
+
 #else
 
 /// \brief Hardware Thread Monitor signal event
@@ -266,7 +286,156 @@ CM_INLINE void cm_signal() {
     signal_event(EventID);
   }
 }
+
+/// \brief Wait for the first NumDeps thread dependencies of a wavefront
+///
+/// The dependency pattern itself is set up by the host. The software
+/// scoreboard waits for the dependencies whose mask bit is set, the opposite
+/// of the hardware scoreboard, so the mask is built here.
+template <int NumDeps>
+CM_INLINE void cm_wavefront_wait() {
+  CM_STATIC_ERROR(NumDeps >= 0 && NumDeps <= 8,
+                  "the maximal number dependencies cannot exceed 8");
+  cm_wait((unsigned char)((1u << NumDeps) - 1));
+}
+
+/// \brief Release the dependants of this thread in a wavefront
+///
+/// This may be called as soon as the data read by the dependants is written,
+/// which lets them start before this thread ends. The writes are fenced
+/// first so that they are visible to the released threads.
+template <int NumDeps>
+CM_INLINE void cm_wavefront_signal() {
+  cm_fence();
+  cm_signal<NumDeps>();
+}
+#endif
+
+/// \brief Arrive at the thread group barrier without waiting for it
+///
+/// Split barriers let a thread overlap independent work with the wait for the
+/// rest of the group:
+///
+///   cm_barrier_arrive();
+///   ... work that does not touch the data guarded by the barrier ...
+///   cm_barrier_wait();
+///
+/// SLM writes issued before the arrival are visible to the group after the
+/// wait. Every arrival must be followed by a wait before the next arrival or
+/// cm_barrier. Targets without split barriers perform the whole barrier here.
+CM_INLINE void cm_barrier_arrive() {
+#if CM_GENX > 900
+  cm_slm_fence(CM_GLOBAL_COHERENT_FENCE);
+#endif
+#if CM_GENX >= 900
+  cm_sbarrier(1);
+#else
+  cm_barrier();
+#endif
+}
+
+/// \brief Wait for the thread group barrier joined by cm_barrier_arrive
+///
+CM_INLINE void cm_barrier_wait() {
+#if CM_GENX >= 900
+  cm_sbarrier(0);
+#endif
+}
+
+namespace details {
+
+static const ushort __cm_stage_ring_lanes[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+
+// Dword offsets of the counters in the stage ring header.
+constexpr unsigned __cm_stage_ring_pushed = 0;
+constexpr unsigned __cm_stage_ring_popped = 1;
+
+template <int Slots, typename T, int N>
+CM_INLINE void __cm_stage_ring_check() {
+  constexpr unsigned Sz = N * sizeof(T);
+  CM_STATIC_ERROR(isPowerOf2(Slots), "number of slots must be a power of 2");
+  CM_STATIC_ERROR(isPowerOf2(Sz) && Sz >= OWORD &&
+                      Sz <= getMaxNumOfOWordSLM() * OWORD,
+                  "slot must be 1, 2, 4 or 8 owords");
+}
+
+// Adds the given values to the counters in a single SLM atomic message and
+// returns their previous values. The other lanes add 0 to the rest of the
+// header.
+CM_INLINE vector<uint, 8> __cm_stage_ring_bump(uint slm, uint pushed,
+                                               uint popped) {
+  vector<ushort, 8> addr(__cm_stage_ring_lanes);
+  vector<uint, 8> add = 0;
+  add(__cm_stage_ring_pushed) = pushed;
+  add(__cm_stage_ring_popped) = popped;
+  vector<uint, 8> old;
+  cm_slm_atomic(slm, ATOMIC_ADD, addr, old, add);
+  return old;
+}
+
+} // namespace details
+
+/// \brief Size in bytes of the SLM buffer backing a stage ring
+///
+/// A stage ring hands data from a producer thread to a consumer thread of the
+/// same thread group through Slots slots of vector<T, N> kept in SLM. The
+/// buffer starts with a 32 byte header holding the counters.
+template <int Slots, typename T, int N>
+constexpr unsigned cm_stage_ring_size() {
+  return 8 * details::DWORD + Slots * N * sizeof(T);
+}
+
+/// \brief Empty a stage ring on behalf of the whole thread group
+///
+/// Every thread of the group must call it, it ends with a barrier.
+CM_INLINE void cm_stage_ring_init(uint slm) {
+  if (cm_linear_local_id() == 0) {
+    vector<uint, 8> header = 0;
+    cm_slm_block_write(slm, 0, header);
+  }
+#if CM_GENX > 900
+  cm_slm_fence(CM_GLOBAL_COHERENT_FENCE);
+#endif
+  cm_barrier();
+}
+
+/// \brief Hand the next slot of a stage ring to the consumer
+///
+/// Waits while all slots are still in use by the consumer. A ring has a single
+/// producer thread and a single consumer thread, both in the same thread
+/// group; chain rings to build a pipeline of more stages.
+template <int Slots, typename T, int N>
+CM_INLINE void cm_stage_ring_push(uint slm, vector<T, N> data) {
+  details::__cm_stage_ring_check<Slots, T, N>();
+  vector<uint, 8> count = details::__cm_stage_ring_bump(slm, 0, 0);
+  while (count(details::__cm_stage_ring_pushed) -
+             count(details::__cm_stage_ring_popped) >= Slots)
+    count = details::__cm_stage_ring_bump(slm, 0, 0);
+  uint slot = count(details::__cm_stage_ring_pushed) % Slots;
+  cm_slm_block_write(slm, 8 * details::DWORD + slot * N * sizeof(T), data);
+#if CM_GENX > 900
+  cm_slm_fence(CM_GLOBAL_COHERENT_FENCE);
+#endif
+  details::__cm_stage_ring_bump(slm, 1, 0);
+}
+
+/// \brief Take the next slot of a stage ring from the producer
+///
+/// Waits while the ring is empty.
+template <int Slots, typename T, int N>
+CM_INLINE void cm_stage_ring_pop(uint slm, vector_ref<T, N> data) {
+  details::__cm_stage_ring_check<Slots, T, N>();
+  vector<uint, 8> count = details::__cm_stage_ring_bump(slm, 0, 0);
+  while (count(details::__cm_stage_ring_pushed) ==
+         count(details::__cm_stage_ring_popped))
+    count = details::__cm_stage_ring_bump(slm, 0, 0);
+  uint slot = count(details::__cm_stage_ring_popped) % Slots;
+  cm_slm_block_read(slm, 8 * details::DWORD + slot * N * sizeof(T), data);
+#if CM_GENX > 900
+  cm_slm_fence(CM_GLOBAL_COHERENT_FENCE);
 #endif
+  details::__cm_stage_ring_bump(slm, 0, 1);
+}
 
 
 #endif /* _CLANG_CM_GATEWAY_H */
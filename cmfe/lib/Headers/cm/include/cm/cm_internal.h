@@ -422,5 +422,9 @@ void __cm_intrinsic_impl_svm_write(typename simd_type<uint64_t, n>::type addrs,
 
 } // namespace details
 
+// Specialization constant with SpecId \p id and default value \p def. The
+// name follows the SPIR-V translator, which emits each call as OpSpecConstant.
+// It is kept global so that it mangles as the translator expects.
+template <typename T> T __spirv_SpecConstant(int id, T def);
 
 #endif
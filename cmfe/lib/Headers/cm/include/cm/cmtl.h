@@ -27,6 +27,11 @@
 #define _CMTL_H_
 
 #include <cm/cm.h>
+#include <cm/cmtl/fft.h>
+#include <cm/cmtl/filter.h>
+#include <cm/cmtl/sparse.h>
+#include <cm/cmtl/thread_map.h>
+#include <cm/cmtl/work_queue.h>
 
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wcm-bounds-check"
@@ -283,17 +288,40 @@ template <typename T, int W, uint CACHESIZE>
 void CachedStackInit(matrix_ref<short, 3, W> context,
                      matrix_ref<int, 2, W> context_ii, uint MaxSize);
 
+/* CachedStackSLMInit - initializes a CachedStack Object that spills to Shared
+   Local Memory instead of a linear surface, so deep stacks stay on chip.
+   Top/Pop/Push are then called with the SLM buffer in place of surf.
+   template params and context, context_ii, MaxSize as for CachedStackInit.
+   The top CACHESIZE elements of a channel always stay in the register cache,
+   so a channel only owns room in SLM for the whole cache lines it can spill,
+   and every thread of the group owns W such channels, indexed by
+   cm_linear_local_id(). The caller must allocate the SLM buffer with
+   CachedStackSLMSize<T, W, CACHESIZE, MaxSize, Threads>() bytes, where
+   Threads >= cm_linear_local_size(); SLM is at most 64KB per group.
+*/
+template <typename T, int W, uint CACHESIZE>
+void CachedStackSLMInit(matrix_ref<short, 2, W> context,
+                        matrix_ref<int, 2, W> context_ii, uint MaxSize);
+
+/* CachedStackSLMSize - bytes of SLM needed by Threads threads with a
+   CachedStack each, initialized by CachedStackSLMInit with MaxSize.
+*/
+template <typename T, int W, uint CACHESIZE, uint MaxSize, uint Threads,
+          uint STACKCOUNT = 1>
+constexpr uint CachedStackSLMSize();
+
 /* CachedStackTop - Returns the element from top of Stack, w/o removing from
    stack:
    function params:
-   surf - pointer to linear sruface used for stack
+   surf - linear surface (or SLM buffer, see CachedStackSLMInit) used for
+   stack
    context, context_ii - internaly used by CachedStack to maintain cache
    pointers, caller must not modify this params.
    stack - user allocated stack cache
    element - returned top element
 */
-template <typename T, int W, uint CACHESIZE>
-void CachedStackTop(SurfaceIndex surf, matrix_ref<short, 2, W> context,
+template <typename T, int W, uint CACHESIZE, typename S>
+void CachedStackTop(S surf, matrix_ref<short, 2, W> context,
                     matrix_ref<int, 2, W> context_ii,
                     matrix_ref<T, W, CACHESIZE> stack,
                     vector_ref<T, W> element);
@@ -302,7 +330,8 @@ void CachedStackTop(SurfaceIndex surf, matrix_ref<short, 2, W> context,
    mask, for channels with a 0 mask
    pixel element is returned to caller but not Poped (see CacheStackTop)
    function params:
-   surf - pointer to linear sruface used for stack
+   surf - linear surface (or SLM buffer, see CachedStackSLMInit) used for
+   stack
    context, context_ii - internaly used by CachedStack to maintain cache
    pointers, caller must not modify this params.
    stack - user allocated stack cache
@@ -318,15 +347,16 @@ void CachedStackTop(SurfaceIndex surf, matrix_ref<short, 2, W> context,
    mask *= (1-isEmpty);
    CachedStackPop<..>(..., mask);
 */
-template <typename T, int W, uint CACHESIZE>
-void CachedStackPop(SurfaceIndex surf, matrix_ref<short, 2, W> context,
+template <typename T, int W, uint CACHESIZE, typename S>
+void CachedStackPop(S surf, matrix_ref<short, 2, W> context,
                     matrix_ref<int, 2, W> context_ii,
                     matrix_ref<T, W, CACHESIZE> stack, vector_ref<T, W> element,
                     vector_ref<short, W> mask);
 
 /* CachedStackPush - Push an element to top of Stack
    function params:
-   surf - pointer to linear sruface used for stack
+   surf - linear surface (or SLM buffer, see CachedStackSLMInit) used for
+   stack
    context, context_ii - internaly used by CachedStack to maintain cache
    pointers, caller must not modify this params.
    stack - user allocated stack cache
@@ -334,8 +364,8 @@ void CachedStackPop(SurfaceIndex surf, matrix_ref<short, 2, W> context,
 
    Note: Caller must not  Push() over a full stack (top element at MaxSize -1)
 */
-template <typename T, int W, uint CACHESIZE>
-void CachedStackPush(SurfaceIndex surf, matrix_ref<short, 2, W> context,
+template <typename T, int W, uint CACHESIZE, typename S>
+void CachedStackPush(S surf, matrix_ref<short, 2, W> context,
                      matrix_ref<int, 2, W> context_ii,
                      matrix_ref<T, W, CACHESIZE> stack,
                      vector_ref<T, W> element);
@@ -368,38 +398,44 @@ template <typename T, int W, uint CACHESIZE, uint STACKCOUNT>
 void CachedStackInit(matrix_ref<short, 2, W *STACKCOUNT> context,
                      matrix_ref<int, 2, W> context_ii, uint MaxSize);
 
+/* SLM variant, the buffer size is
+   CachedStackSLMSize<T, W, CACHESIZE, MaxSize, Threads, STACKCOUNT>() */
 template <typename T, int W, uint CACHESIZE, uint STACKCOUNT>
-void CachedStackTop(SurfaceIndex surf,
+void CachedStackSLMInit(matrix_ref<short, 2, W *STACKCOUNT> context,
+                        matrix_ref<int, 2, W> context_ii, uint MaxSize);
+
+template <typename T, int W, uint CACHESIZE, uint STACKCOUNT, typename S>
+void CachedStackTop(S surf,
                     matrix_ref<short, 2, W *STACKCOUNT> context,
                     matrix_ref<int, 2, W> context_ii,
                     matrix_ref<T, W, CACHESIZE *STACKCOUNT> stack,
                     matrix_ref<T, STACKCOUNT, W> element);
 
 /* retrieve element only from the specified stack index */
-template <typename T, int W, uint CACHESIZE, uint STACKCOUNT>
-void CachedStackTop(SurfaceIndex surf,
+template <typename T, int W, uint CACHESIZE, uint STACKCOUNT, typename S>
+void CachedStackTop(S surf,
                     matrix_ref<short, 2, W *STACKCOUNT> context,
                     matrix_ref<int, 2, W> context_ii,
                     matrix_ref<T, W, CACHESIZE *STACKCOUNT> stack,
                     vector_ref<T, W> element, int index);
 
-template <typename T, int W, uint CACHESIZE, uint STACKCOUNT>
+template <typename T, int W, uint CACHESIZE, uint STACKCOUNT, typename S>
 void
-CachedStackPop(SurfaceIndex surf, matrix_ref<short, 2, W *STACKCOUNT> context,
+CachedStackPop(S surf, matrix_ref<short, 2, W *STACKCOUNT> context,
                matrix_ref<int, 2, W> context_ii,
                matrix_ref<T, W, CACHESIZE *STACKCOUNT> stack,
                matrix_ref<T, STACKCOUNT, W> element, vector_ref<short, W> mask);
 
 /* pop but don't return top elements */
-template <typename T, int W, uint CACHESIZE, uint STACKCOUNT>
-void CachedStackPop(SurfaceIndex surf,
+template <typename T, int W, uint CACHESIZE, uint STACKCOUNT, typename S>
+void CachedStackPop(S surf,
                     matrix_ref<short, 2, W *STACKCOUNT> context,
                     matrix_ref<int, 2, W> context_ii,
                     matrix_ref<T, W, CACHESIZE *STACKCOUNT> stack,
                     vector_ref<short, W> mask);
 
-template <typename T, int W, uint CACHESIZE, uint STACKCOUNT>
-void CachedStackPush(SurfaceIndex surf,
+template <typename T, int W, uint CACHESIZE, uint STACKCOUNT, typename S>
+void CachedStackPush(S surf,
                      matrix_ref<short, 2, W *STACKCOUNT> context,
                      matrix_ref<int, 2, W> context_ii,
                      matrix_ref<T, W, CACHESIZE *STACKCOUNT> stack,
@@ -1307,9 +1343,32 @@ CM_INLINE void _CSTKAssert(matrix_ref<short, _CMTL_CNTXT_SIZE> context,
   // TODO add check for full stack
 }
 
-template <typename T, int W, uint CACHESIZE, uint STACKCOUNT>
+/* spill/refill of a single IO chunk, to a linear surface or to SLM */
+template <typename T, int N>
+CM_INLINE void _CSTKStore(SurfaceIndex surf, int offset,
+                          vector_ref<T, N> data) {
+  write(surf, offset, data);
+}
+
+template <typename T, int N>
+CM_INLINE void _CSTKStore(uint slm, int offset, vector_ref<T, N> data) {
+  cm_slm_block_write<T, N>(slm, offset, data);
+}
+
+template <typename T, int N>
+CM_INLINE void _CSTKLoad(SurfaceIndex surf, int offset,
+                         vector_ref<T, N> data) {
+  read(MODIFIED(surf), offset, data);
+}
+
+template <typename T, int N>
+CM_INLINE void _CSTKLoad(uint slm, int offset, vector_ref<T, N> data) {
+  cm_slm_block_read(slm, offset, data);
+}
+
+template <typename T, int W, uint CACHESIZE, uint STACKCOUNT, typename S>
 CM_INLINE void
-_CSTKWriteBuffers(SurfaceIndex surf,
+_CSTKWriteBuffers(S surf,
                   matrix_ref<short, _CMTL_CNTXT_SIZE> context,
                   matrix_ref<int, 2, W> context_ii,
                   matrix_ref<T, _CMTL_STACK_SIZE> stack) {
@@ -1331,7 +1390,7 @@ _CSTKWriteBuffers(SurfaceIndex surf,
         vector_ref<T, _CMTL_MAXIOLINEAR(T)> temp =
             stack.row(chnl).template select<_CMTL_MAXIOLINEAR(T), 1>(
                 s * _CMTL_MAXIOLINEAR(T));
-        write(surf, surf_offset(s, chnl), temp);
+        _CSTKStore(surf, surf_offset(s, chnl), temp);
       }
     }
   }
@@ -1341,8 +1400,8 @@ _CSTKWriteBuffers(SurfaceIndex surf,
   k.merge(0, k == CACHESIZE);
 }
 
-template <typename T, int W, uint CACHESIZE, uint STACKCOUNT>
-CM_INLINE void _CSTKReadBuffers(SurfaceIndex surf,
+template <typename T, int W, uint CACHESIZE, uint STACKCOUNT, typename S>
+CM_INLINE void _CSTKReadBuffers(S surf,
                                 matrix_ref<short, _CMTL_CNTXT_SIZE> context,
                                 matrix_ref<int, 2, W> context_ii,
                                 matrix_ref<T, _CMTL_STACK_SIZE> stack) {
@@ -1366,7 +1425,7 @@ CM_INLINE void _CSTKReadBuffers(SurfaceIndex surf,
         vector_ref<T, _CMTL_MAXIOLINEAR(T)> temp =
             stack.row(chnl).template select<_CMTL_MAXIOLINEAR(T), 1>(
                 s * _CMTL_MAXIOLINEAR(T));
-        read(MODIFIED(surf), surf_offset(s, chnl), temp);
+        _CSTKLoad(surf, surf_offset(s, chnl), temp);
       }
     }
   }
@@ -1377,9 +1436,11 @@ CM_INLINE void _CSTKReadBuffers(SurfaceIndex surf,
 const static int _CSTK_c_channels[16] = { 0, 1, 2,  3,  4,  5,  6,  7,
                                           8, 9, 10, 11, 12, 13, 14, 15 };
 
+/* channel_stride: bytes of the spill buffer owned by each channel */
 template <typename T, int W, uint CACHESIZE, uint STACKCOUNT>
-CM_INLINE void CachedStackInit(matrix_ref<short, _CMTL_CNTXT_SIZE> context,
-                               matrix_ref<int, 2, W> context_ii, uint MaxSize) {
+CM_INLINE void _CSTKInit(matrix_ref<short, _CMTL_CNTXT_SIZE> context,
+                         matrix_ref<int, 2, W> context_ii,
+                         uint channel_stride, ushort thread) {
   _CMTL_CSTK_DECIPHER_CONTEXT(context);
 
   cm_assert(STACKCOUNT > 0);
@@ -1395,18 +1456,52 @@ CM_INLINE void CachedStackInit(matrix_ref<short, _CMTL_CNTXT_SIZE> context,
 
   k = -1;
 
-  ushort x_pos = get_thread_origin_x() * W;
+  ushort x_pos = thread * W;
 
   context_ii.row(_CMTL_CNTX_II_OFFSET_DYNAMIC) =
-      (x_pos + _chnls.template select<W, 1>(0)) * MaxSize * STACKCOUNT *
-      sizeof(T);
+      (x_pos + _chnls.template select<W, 1>(0)) * channel_stride;
 
   context_ii.row(_CMTL_CNTX_II_OFFSET_INITIAL) =
       context_ii.row(_CMTL_CNTX_II_OFFSET_DYNAMIC);
 }
 
 template <typename T, int W, uint CACHESIZE, uint STACKCOUNT>
-CM_INLINE void CachedStackTop(SurfaceIndex surf,
+CM_INLINE void CachedStackInit(matrix_ref<short, _CMTL_CNTXT_SIZE> context,
+                               matrix_ref<int, 2, W> context_ii, uint MaxSize) {
+  _CSTKInit<T, W, CACHESIZE, STACKCOUNT>(
+      context, context_ii, MaxSize * STACKCOUNT * sizeof(T),
+      get_thread_origin_x());
+}
+
+/* A push only spills once the cache is full and another element arrives,
+   so at most MaxSize - 1 elements, rounded down to whole cache lines, are
+   ever in SLM. */
+template <typename T, uint CACHESIZE, uint STACKCOUNT>
+constexpr uint _CSTKSLMChannelStride(uint MaxSize) {
+  return MaxSize ? (MaxSize - 1) / CACHESIZE * CACHESIZE * STACKCOUNT *
+                       sizeof(T)
+                 : 0;
+}
+
+template <typename T, int W, uint CACHESIZE, uint MaxSize, uint Threads,
+          uint STACKCOUNT>
+constexpr uint CachedStackSLMSize() {
+  return _CSTKSLMChannelStride<T, CACHESIZE, STACKCOUNT>(MaxSize) * W *
+         Threads;
+}
+
+template <typename T, int W, uint CACHESIZE, uint STACKCOUNT>
+CM_INLINE void CachedStackSLMInit(matrix_ref<short, _CMTL_CNTXT_SIZE> context,
+                                  matrix_ref<int, 2, W> context_ii,
+                                  uint MaxSize) {
+  _CSTKInit<T, W, CACHESIZE, STACKCOUNT>(
+      context, context_ii,
+      _CSTKSLMChannelStride<T, CACHESIZE, STACKCOUNT>(MaxSize),
+      cm_linear_local_id());
+}
+
+template <typename T, int W, uint CACHESIZE, uint STACKCOUNT, typename S>
+CM_INLINE void CachedStackTop(S surf,
                               matrix_ref<short, _CMTL_CNTXT_SIZE> context,
                               matrix_ref<int, 2, W> context_ii,
                               matrix_ref<T, _CMTL_STACK_SIZE> stack,
@@ -1425,8 +1520,8 @@ CM_INLINE void CachedStackTop(SurfaceIndex surf,
   element = stack.iselect(chnls_, k_dup);
 }
 
-template <typename T, int W, uint CACHESIZE, uint STACKCOUNT>
-CM_INLINE void CachedStackTop(SurfaceIndex surf,
+template <typename T, int W, uint CACHESIZE, uint STACKCOUNT, typename S>
+CM_INLINE void CachedStackTop(S surf,
                               matrix_ref<short, _CMTL_CNTXT_SIZE> context,
                               matrix_ref<int, 2, W> context_ii,
                               matrix_ref<T, _CMTL_STACK_SIZE> stack,
@@ -1441,8 +1536,8 @@ CM_INLINE void CachedStackTop(SurfaceIndex surf,
                           k_dup.template select<W, 1>(s));
 }
 
-template <typename T, int W, uint CACHESIZE, uint STACKCOUNT>
-CM_INLINE void CachedStackPop(SurfaceIndex surf,
+template <typename T, int W, uint CACHESIZE, uint STACKCOUNT, typename S>
+CM_INLINE void CachedStackPop(S surf,
                               matrix_ref<short, _CMTL_CNTXT_SIZE> context,
                               matrix_ref<int, 2, W> context_ii,
                               matrix_ref<T, _CMTL_STACK_SIZE> stack,
@@ -1462,8 +1557,8 @@ CM_INLINE void CachedStackPop(SurfaceIndex surf,
   }
 }
 
-template <typename T, int W, uint CACHESIZE, uint STACKCOUNT>
-CM_INLINE void CachedStackPop(SurfaceIndex surf,
+template <typename T, int W, uint CACHESIZE, uint STACKCOUNT, typename S>
+CM_INLINE void CachedStackPop(S surf,
                               matrix_ref<short, _CMTL_CNTXT_SIZE> context,
                               matrix_ref<int, 2, W> context_ii,
                               matrix_ref<T, _CMTL_STACK_SIZE> stack,
@@ -1475,8 +1570,8 @@ CM_INLINE void CachedStackPop(SurfaceIndex surf,
                                               mask);
 }
 
-template <typename T, int W, uint CACHESIZE, uint STACKCOUNT>
-CM_INLINE void CachedStackPush(SurfaceIndex surf,
+template <typename T, int W, uint CACHESIZE, uint STACKCOUNT, typename S>
+CM_INLINE void CachedStackPush(S surf,
                                matrix_ref<short, _CMTL_CNTXT_SIZE> context,
                                matrix_ref<int, 2, W> context_ii,
                                matrix_ref<T, _CMTL_STACK_SIZE> stack,
@@ -1523,25 +1618,32 @@ CM_INLINE void CachedStackInit(matrix_ref<short, 2, W> context,
 }
 
 template <typename T, int W, uint CACHESIZE>
+CM_INLINE void CachedStackSLMInit(matrix_ref<short, 2, W> context,
+                                  matrix_ref<int, 2, W> context_ii,
+                                  uint MaxSize) {
+  CachedStackSLMInit<T, W, CACHESIZE, 1>(context, context_ii, MaxSize);
+}
+
+template <typename T, int W, uint CACHESIZE, typename S>
 CM_INLINE void
-CachedStackTop(SurfaceIndex surf, matrix_ref<short, 2, W> context,
+CachedStackTop(S surf, matrix_ref<short, 2, W> context,
                matrix_ref<int, 2, W> context_ii,
                matrix_ref<T, W, CACHESIZE> stack, vector_ref<T, W> element) {
   CachedStackTop<T, W, CACHESIZE, 1>(surf, context, context_ii, stack, element);
 }
 
-template <typename T, int W, uint CACHESIZE>
+template <typename T, int W, uint CACHESIZE, typename S>
 CM_INLINE void
-CachedStackPush(SurfaceIndex surf, matrix_ref<short, 2, W> context,
+CachedStackPush(S surf, matrix_ref<short, 2, W> context,
                 matrix_ref<int, 2, W> context_ii,
                 matrix_ref<T, W, CACHESIZE> stack, vector_ref<T, W> element) {
   CachedStackPush<T, W, CACHESIZE, 1>(surf, context, context_ii, stack,
                                       element);
 }
 
-template <typename T, int W, uint CACHESIZE>
+template <typename T, int W, uint CACHESIZE, typename S>
 CM_INLINE void
-CachedStackPop(SurfaceIndex surf, matrix_ref<short, 2, W> context,
+CachedStackPop(S surf, matrix_ref<short, 2, W> context,
                matrix_ref<int, 2, W> context_ii,
                matrix_ref<T, W, CACHESIZE> stack, vector_ref<T, W> element,
                vector_ref<short, W> mask) {
@@ -0,0 +1,438 @@
+/*===================== begin_copyright_notice ==================================
+
+ Copyright (c) 2021, Intel Corporation
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+======================= end_copyright_notice ==================================*/
+
+#ifndef CM_CMTL_FFT_H
+#define CM_CMTL_FFT_H
+
+#include "../cm.h"
+#include "global.h"
+#include "numbers.h"
+
+/* cm/cmtl/fft.h provides building blocks for complex fast Fourier transforms
+ * of power of 2 sizes over float or half data.
+ *
+ * Complex data is kept split: a transform of n points is a pair of n x simd
+ * matrices (re, im) where row i holds point i and every column (SIMD lane) is
+ * an independent transform, so simd transforms are computed at once with full
+ * width instructions.
+ *
+ * The transforms are Stockham autosort FFTs: every pass applies twiddle
+ * factors and a radix-8, radix-4 or radix-2 butterfly and writes its output
+ * already reordered, so both input and output are in natural order and no bit
+ * reversal is needed. Radix-8 passes are used as long as possible.
+ *
+ * The forward transform computes X[k] = sum x[i] * exp(-2 * pi * j * i * k / n).
+ * The inverse transform uses the opposite sign and is not normalized: a
+ * forward followed by an inverse transform scales the data by n.
+ *
+ * Twiddle factors come from a quarter wave sine table computed at compile time
+ * (in double precision and rounded once to float). Register resident
+ * transforms index it with compile time constants so all twiddles become
+ * immediates; SLM resident transforms read a table of n complex twiddles that
+ * init_twiddles stores into SLM.
+ */
+
+namespace cmtl {
+namespace fft {
+
+namespace fft_detail {
+
+const uint lane_init[32] = {0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  10,
+                            11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21,
+                            22, 23, 24, 25, 26, 27, 28, 29, 30, 31};
+
+template<typename T>
+CM_INLINE constexpr void type_check() {
+  CM_STATIC_ERROR((std::is_same<T, float>::value ||
+                   std::is_same<T, half>::value),
+                  "fft supports float and half data only");
+}
+
+// sin(x) for x in [0, pi/2], accurate to double precision.
+CM_INLINE constexpr double sin_poly(double x) {
+  double term = x;
+  double sum = x;
+  for (int i = 1; i < 12; ++i) {
+    term *= -x * x / ((2 * i) * (2 * i + 1));
+    sum += term;
+  }
+  return sum;
+}
+
+// v[m] = sin(2 * pi * m / n) for m in [0, n / 4].
+template<int n>
+struct quarter_wave {
+  float v[n / 4 + 1];
+  constexpr quarter_wave() : v() {
+    for (int m = 0; m <= n / 4; ++m)
+      v[m] = static_cast<float>(sin_poly(2 * numbers::pi * m / n));
+  }
+};
+
+template<int n>
+CM_INLINE constexpr quarter_wave<n> quarter_wave_v{};
+
+// Twiddle factor W_n^k = exp(-2 * pi * j * k / n) = c - j * s, 0 <= k < n.
+// Meant to be called with compile time k so the table loads fold away.
+template<int n>
+CM_INLINE float twiddle_cos(int k) {
+  if constexpr (n < 4) {
+    return k == 0 ? 1.0f : -1.0f;
+  } else {
+    constexpr int quarter = n / 4;
+    int m = k % quarter;
+    int qd = k / quarter;
+    float c = (qd & 1) ? -quarter_wave_v<n>.v[m]
+                       : quarter_wave_v<n>.v[quarter - m];
+    return qd >= 2 ? -c : c;
+  }
+}
+
+template<int n>
+CM_INLINE float twiddle_sin(int k) {
+  if constexpr (n < 4) {
+    return 0.0f;
+  } else {
+    constexpr int quarter = n / 4;
+    int m = k % quarter;
+    int qd = k / quarter;
+    float s = (qd & 1) ? quarter_wave_v<n>.v[quarter - m]
+                       : quarter_wave_v<n>.v[m];
+    return qd >= 2 ? -s : s;
+  }
+}
+
+// Vector form of the above for run time k.
+template<int n, int width>
+CM_INLINE void twiddle(vector<uint, width> k, vector_ref<float, width> c,
+                       vector_ref<float, width> s) {
+  constexpr int quarter = n / 4;
+  vector<int, width> m = k & (quarter - 1);
+  vector<uint, width> qd = k / quarter;
+  vector<float, width> lo = global::load(quarter_wave_v<n>.v, m);
+  vector<float, width> hi = global::load(quarter_wave_v<n>.v, quarter - m);
+  c.merge(-lo, hi, (qd & 1) != 0);
+  s.merge(hi, lo, (qd & 1) != 0);
+  c.merge(-c, qd >= 2);
+  s.merge(-s, qd >= 2);
+}
+
+// Radix of the next Stockham pass when m points are left to combine.
+CM_INLINE constexpr int pass_radix(int m) {
+  return m % 8 == 0 ? 8 : m % 4 == 0 ? 4 : 2;
+}
+
+} // namespace fft_detail
+
+/* cmul: (re, im) *= (wr, wi), element wise complex multiplication. */
+template<typename T, int simd>
+CM_INLINE void cmul(vector_ref<T, simd> re, vector_ref<T, simd> im,
+                    vector<T, simd> wr, vector<T, simd> wi) {
+  vector<T, simd> t = re * wr - im * wi;
+  im = re * wi + im * wr;
+  re = t;
+}
+
+template<typename T, int simd>
+CM_INLINE void cmul(vector_ref<T, simd> re, vector_ref<T, simd> im, T wr,
+                    T wi) {
+  vector<T, simd> vwr = wr;
+  vector<T, simd> vwi = wi;
+  cmul(re, im, vwr, vwi);
+}
+
+/* mul_j: multiplies (re, im) by -j, or by +j for an inverse transform. This
+ * is the W_4^1 twiddle and costs no multiplication.
+ */
+template<bool inverse, typename T, int simd>
+CM_INLINE void mul_j(vector_ref<T, simd> re, vector_ref<T, simd> im) {
+  vector<T, simd> t = re;
+  if constexpr (inverse) {
+    re = -im;
+    im = t;
+  } else {
+    re = im;
+    im = -t;
+  }
+}
+
+/* butterfly2: in place 2 point DFT of rows 0 and 1. */
+template<bool inverse, typename T, int simd>
+CM_INLINE void butterfly2(matrix_ref<T, 2, simd> re, matrix_ref<T, 2, simd> im) {
+  vector<T, simd> t = re.row(0);
+  re.row(0) += re.row(1);
+  re.row(1) = t - re.row(1);
+  t = im.row(0);
+  im.row(0) += im.row(1);
+  im.row(1) = t - im.row(1);
+}
+
+/* butterfly4: in place 4 point DFT of rows 0..3, input and output in natural
+ * order. Needs no multiplications.
+ */
+template<bool inverse, typename T, int simd>
+CM_INLINE void butterfly4(matrix_ref<T, 4, simd> re, matrix_ref<T, 4, simd> im) {
+  // Rows of s/d: (x0 +- x2, x1 +- x3).
+  matrix<T, 2, simd> sre = re.template select<2, 1, simd, 1>(0, 0) +
+                           re.template select<2, 1, simd, 1>(2, 0);
+  matrix<T, 2, simd> sim = im.template select<2, 1, simd, 1>(0, 0) +
+                           im.template select<2, 1, simd, 1>(2, 0);
+  matrix<T, 2, simd> dre = re.template select<2, 1, simd, 1>(0, 0) -
+                           re.template select<2, 1, simd, 1>(2, 0);
+  matrix<T, 2, simd> dim = im.template select<2, 1, simd, 1>(0, 0) -
+                           im.template select<2, 1, simd, 1>(2, 0);
+  mul_j<inverse>(dre.row(1), dim.row(1));
+  re.row(0) = sre.row(0) + sre.row(1);
+  im.row(0) = sim.row(0) + sim.row(1);
+  re.row(2) = sre.row(0) - sre.row(1);
+  im.row(2) = sim.row(0) - sim.row(1);
+  re.row(1) = dre.row(0) + dre.row(1);
+  im.row(1) = dim.row(0) + dim.row(1);
+  re.row(3) = dre.row(0) - dre.row(1);
+  im.row(3) = dim.row(0) - dim.row(1);
+}
+
+/* butterfly8: in place 8 point DFT of rows 0..7, input and output in natural
+ * order. Two 4 point DFTs of the even and odd rows are combined with the
+ * W_8 twiddles, which take 4 multiplications per lane.
+ */
+template<bool inverse, typename T, int simd>
+CM_INLINE void butterfly8(matrix_ref<T, 8, simd> re, matrix_ref<T, 8, simd> im) {
+  matrix<T, 4, simd> ere = re.template select<4, 2, simd, 1>(0, 0);
+  matrix<T, 4, simd> eim = im.template select<4, 2, simd, 1>(0, 0);
+  matrix<T, 4, simd> ore = re.template select<4, 2, simd, 1>(1, 0);
+  matrix<T, 4, simd> oim = im.template select<4, 2, simd, 1>(1, 0);
+  butterfly4<inverse>(ere.select_all(), eim.select_all());
+  butterfly4<inverse>(ore.select_all(), oim.select_all());
+
+  // W_8^1 = (1 -+ j) / sqrt(2), W_8^2 = -+j, W_8^3 = W_8^1 * W_8^2.
+  const T r = static_cast<T>(numbers::inv_sqrt2);
+#pragma unroll
+  for (int i = 1; i < 4; i += 2) {
+    vector<T, simd> x = ore.row(i);
+    vector<T, simd> y = oim.row(i);
+    if constexpr (inverse) {
+      ore.row(i) = (x - y) * r;
+      oim.row(i) = (x + y) * r;
+    } else {
+      ore.row(i) = (x + y) * r;
+      oim.row(i) = (y - x) * r;
+    }
+  }
+  mul_j<inverse>(ore.row(2), oim.row(2));
+  mul_j<inverse>(ore.row(3), oim.row(3));
+
+  re.template select<4, 1, simd, 1>(0, 0) = ere + ore;
+  im.template select<4, 1, simd, 1>(0, 0) = eim + oim;
+  re.template select<4, 1, simd, 1>(4, 0) = ere - ore;
+  im.template select<4, 1, simd, 1>(4, 0) = eim - oim;
+}
+
+/* butterfly: dispatches to the radix-r butterfly, r is 2, 4 or 8. */
+template<int r, bool inverse, typename T, int simd>
+CM_INLINE void butterfly(matrix_ref<T, r, simd> re, matrix_ref<T, r, simd> im) {
+  if constexpr (r == 8)
+    butterfly8<inverse>(re, im);
+  else if constexpr (r == 4)
+    butterfly4<inverse>(re, im);
+  else
+    butterfly2<inverse>(re, im);
+}
+
+namespace fft_detail {
+
+// One Stockham pass combining groups of ns points with radix r, followed by
+// the remaining passes. All loops are unrolled, so every row index and
+// twiddle factor is a compile time constant.
+template<typename T, int simd, int n, int ns, bool inverse>
+CM_INLINE void grf_passes(matrix_ref<T, n, simd> re, matrix_ref<T, n, simd> im) {
+  if constexpr (ns < n) {
+    constexpr int r = pass_radix(n / ns);
+    matrix<T, n, simd> ore;
+    matrix<T, n, simd> oim;
+#pragma unroll
+    for (int j = 0; j < n / r; ++j) {
+      matrix<T, r, simd> vre;
+      matrix<T, r, simd> vim;
+#pragma unroll
+      for (int q = 0; q < r; ++q) {
+        vre.row(q) = re.row(j + q * (n / r));
+        vim.row(q) = im.row(j + q * (n / r));
+      }
+      int k0 = j % ns;
+#pragma unroll
+      for (int q = 1; q < r; ++q) {
+        int k = q * k0 * (n / (ns * r));
+        if (k != 0) {
+          float s = twiddle_sin<n>(k);
+          cmul(vre.row(q), vim.row(q), static_cast<T>(twiddle_cos<n>(k)),
+               static_cast<T>(inverse ? s : -s));
+        }
+      }
+      butterfly<r, inverse>(vre.select_all(), vim.select_all());
+      int d = (j - k0) * r + k0;
+#pragma unroll
+      for (int q = 0; q < r; ++q) {
+        ore.row(d + q * ns) = vre.row(q);
+        oim.row(d + q * ns) = vim.row(q);
+      }
+    }
+    re = ore;
+    im = oim;
+    grf_passes<T, simd, n, ns * r, inverse>(re, im);
+  }
+}
+
+// SLM counterpart of grf_passes: the points live in the SLM buffers src and
+// dst (n real parts followed by n imaginary parts), lanes process simd
+// consecutive butterflies and the threads of the group split the butterflies
+// of every pass. Returns the buffer holding the result.
+template<typename T, int simd, int n, int ns, bool inverse>
+CM_INLINE uint slm_passes(uint src, uint dst, uint twiddles, uint thread,
+                          uint threads) {
+  if constexpr (ns == n) {
+    return src;
+  } else {
+    constexpr int r = pass_radix(n / ns);
+    vector<uint, 32> all(lane_init);
+    vector<uint, simd> lane = all.template select<simd, 1>(0);
+    for (uint j0 = thread * simd; j0 < n / r; j0 += threads * simd) {
+      vector<uint, simd> j = j0 + lane;
+      matrix<T, r, simd> vre;
+      matrix<T, r, simd> vim;
+#pragma unroll
+      for (int q = 0; q < r; ++q) {
+        cm_slm_read(src, j + q * (n / r), vre.row(q));
+        cm_slm_read(src, j + (q * (n / r) + n), vim.row(q));
+      }
+      vector<uint, simd> k0 = j & (ns - 1);
+#pragma unroll
+      for (int q = 1; q < r; ++q) {
+        vector<uint, simd> k = k0 * (q * (n / (ns * r)));
+        vector<T, simd> wr;
+        vector<T, simd> wi;
+        cm_slm_read(twiddles, k, wr.select_all());
+        cm_slm_read(twiddles, k + n, wi.select_all());
+        if constexpr (inverse)
+          wi = -wi;
+        cmul(vre.row(q), vim.row(q), wr, wi);
+      }
+      butterfly<r, inverse>(vre.select_all(), vim.select_all());
+      vector<uint, simd> d = (j - k0) * r + k0;
+#pragma unroll
+      for (int q = 0; q < r; ++q) {
+        cm_slm_write(dst, d + q * ns, vre.row(q));
+        cm_slm_write(dst, d + (q * ns + n), vim.row(q));
+      }
+    }
+    cm_barrier();
+    return slm_passes<T, simd, n, ns * r, inverse>(dst, src, twiddles, thread,
+                                                  threads);
+  }
+}
+
+} // namespace fft_detail
+
+/* fft: in register forward FFT of simd independent n point transforms held in
+ * the columns of (re, im). n must be a power of 2. Every pass needs a second
+ * n x simd copy of the data, so n * simd should stay within a few hundred
+ * points to avoid spills; larger transforms belong in SLM (see fft_slm).
+ */
+template<typename T, int simd, int n>
+CM_INLINE void fft(matrix_ref<T, n, simd> re, matrix_ref<T, n, simd> im) {
+  fft_detail::type_check<T>();
+  CM_STATIC_ERROR(details::isPowerOf2(n) && n >= 2,
+                  "fft size must be a power of 2");
+  fft_detail::grf_passes<T, simd, n, 1, false>(re, im);
+}
+
+/* ifft: unnormalized inverse of fft. */
+template<typename T, int simd, int n>
+CM_INLINE void ifft(matrix_ref<T, n, simd> re, matrix_ref<T, n, simd> im) {
+  fft_detail::type_check<T>();
+  CM_STATIC_ERROR(details::isPowerOf2(n) && n >= 2,
+                  "fft size must be a power of 2");
+  fft_detail::grf_passes<T, simd, n, 1, true>(re, im);
+}
+
+/* init_twiddles: stores the n twiddle factors W_n^k, k in [0, n), into the
+ * SLM buffer twiddles as n real parts followed by n imaginary parts. The
+ * threads of the group share the work; thread is the caller's index in the
+ * group and threads the group size. A barrier is needed before the table is
+ * used.
+ */
+template<typename T, int n>
+CM_INLINE void init_twiddles(uint twiddles, uint thread, uint threads) {
+  fft_detail::type_check<T>();
+  CM_STATIC_ERROR(details::isPowerOf2(n) && n >= 8,
+                  "SLM twiddle tables need at least 8 points");
+  vector<uint, 8> lane(fft_detail::lane_init);
+  for (uint k0 = thread * 8; k0 < n; k0 += threads * 8) {
+    vector<uint, 8> k = k0 + lane;
+    vector<float, 8> c;
+    vector<float, 8> s;
+    fft_detail::twiddle<n>(k, c.select_all(), s.select_all());
+    vector<T, 8> wr = c;
+    vector<T, 8> wi = -s;
+    cm_slm_write(twiddles, k, wr);
+    cm_slm_write(twiddles, k + n, wi);
+  }
+}
+
+/* fft_slm: forward FFT of one n point transform held in SLM, computed by all
+ * threads of a group together.
+ *
+ * data and scratch are SLM buffers of 2 * n elements each (n real parts
+ * followed by n imaginary parts); twiddles is a table built by init_twiddles.
+ * The input is read from data, scratch is used for the ping-pong passes, and
+ * the returned buffer (data or scratch) holds the result. The caller must
+ * barrier after filling data; every pass ends with a barrier so the result
+ * can be read right away. simd is the number of butterflies a thread handles
+ * per step (8, 16 or 32) and n must be at least 8 * simd.
+ */
+template<typename T, int simd, int n>
+CM_INLINE uint fft_slm(uint data, uint scratch, uint twiddles, uint thread,
+                       uint threads) {
+  fft_detail::type_check<T>();
+  CM_STATIC_ERROR(details::isPowerOf2(n) && n >= 8 * simd,
+                  "SLM fft size must be a power of 2 of at least 8 * simd");
+  return fft_detail::slm_passes<T, simd, n, 1, false>(data, scratch, twiddles,
+                                                      thread, threads);
+}
+
+/* ifft_slm: unnormalized inverse of fft_slm. */
+template<typename T, int simd, int n>
+CM_INLINE uint ifft_slm(uint data, uint scratch, uint twiddles, uint thread,
+                        uint threads) {
+  fft_detail::type_check<T>();
+  CM_STATIC_ERROR(details::isPowerOf2(n) && n >= 8 * simd,
+                  "SLM fft size must be a power of 2 of at least 8 * simd");
+  return fft_detail::slm_passes<T, simd, n, 1, true>(data, scratch, twiddles,
+                                                     thread, threads);
+}
+
+} // namespace fft
+} // namespace cmtl
+
+#endif // CM_CMTL_FFT_H
@@ -0,0 +1,354 @@
+/*===================== begin_copyright_notice ==================================
+
+ Copyright (c) 2021, Intel Corporation
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+======================= end_copyright_notice ==================================*/
+
+#ifndef CM_CMTL_FILTER_H
+#define CM_CMTL_FILTER_H
+
+#include "../cm.h"
+
+/* cm/cmtl/filter.h provides 2D image filters: general and separable
+ * convolution, box filters built from running window sums, and integral
+ * images.
+ *
+ * Every filter comes in two forms:
+ *  - a *_tile function working purely on registers, for kernels that chain
+ *    several filters on the same data;
+ *  - a surface function that reads the input tile with its halo using media
+ *    block reads, filters it and writes a th x tw output tile whose top left
+ *    pixel is (x, y).
+ *
+ * Coordinates are in pixels. Reads past the surface edge are clamped by the
+ * hardware, so the halo of border tiles replicates the edge pixels; this
+ * requires the surface width in bytes to be a multiple of 4. Output tiles
+ * must have a width of a whole number of dwords.
+ *
+ * Filtering is done in float. Integer outputs are rounded to nearest even and
+ * saturated to the output type.
+ */
+
+namespace cmtl {
+namespace filter {
+
+namespace filter_detail {
+
+// Reads a h x w tile as bh x bw media blocks, h % bh == 0 and w % bw == 0.
+template<typename T, int h, int w, int bh, int bw>
+CM_INLINE void read_blocks(SurfaceIndex surf, int x, int y,
+                           matrix_ref<T, h, w> tile) {
+#pragma unroll
+  for (int i = 0; i < h; i += bh)
+#pragma unroll
+    for (int j = 0; j < w; j += bw)
+      read(surf, (x + j) * sizeof(T), y + i,
+           tile.template select<bh, 1, bw, 1>(i, j));
+}
+
+template<typename T, int h, int w, int bh, int bw>
+CM_INLINE void write_blocks(SurfaceIndex surf, int x, int y,
+                            matrix_ref<T, h, w> tile) {
+#pragma unroll
+  for (int i = 0; i < h; i += bh)
+#pragma unroll
+    for (int j = 0; j < w; j += bw)
+      write(surf, (x + j) * sizeof(T), y + i,
+            tile.template select<bh, 1, bw, 1>(i, j));
+}
+
+// Tiles of any size are split into 32 byte x 8 row media blocks, plus the
+// right and bottom remainders.
+template<typename T, int h, int w>
+CM_INLINE void read_tile(SurfaceIndex surf, int x, int y,
+                         matrix_ref<T, h, w> tile) {
+  constexpr int bh = 8;
+  constexpr int bw = 32 / sizeof(T);
+  constexpr int fh = h / bh * bh;
+  constexpr int fw = w / bw * bw;
+  constexpr int rh = h - fh;
+  constexpr int rw = w - fw;
+  if constexpr (fh > 0 && fw > 0)
+    read_blocks<T, fh, fw, bh, bw>(
+        surf, x, y, tile.template select<fh, 1, fw, 1>(0, 0));
+  if constexpr (fh > 0 && rw > 0)
+    read_blocks<T, fh, rw, bh, rw>(
+        surf, x + fw, y, tile.template select<fh, 1, rw, 1>(0, fw));
+  if constexpr (rh > 0 && fw > 0)
+    read_blocks<T, rh, fw, rh, bw>(
+        surf, x, y + fh, tile.template select<rh, 1, fw, 1>(fh, 0));
+  if constexpr (rh > 0 && rw > 0)
+    read_blocks<T, rh, rw, rh, rw>(
+        surf, x + fw, y + fh, tile.template select<rh, 1, rw, 1>(fh, fw));
+}
+
+template<typename T, int h, int w>
+CM_INLINE void write_tile(SurfaceIndex surf, int x, int y,
+                          matrix_ref<T, h, w> tile) {
+  CM_STATIC_ERROR((w * sizeof(T)) % details::DWORD == 0,
+                  "output tile width must be a whole number of dwords");
+  constexpr int bh = 8;
+  constexpr int bw = 32 / sizeof(T);
+  constexpr int fh = h / bh * bh;
+  constexpr int fw = w / bw * bw;
+  constexpr int rh = h - fh;
+  constexpr int rw = w - fw;
+  if constexpr (fh > 0 && fw > 0)
+    write_blocks<T, fh, fw, bh, bw>(
+        surf, x, y, tile.template select<fh, 1, fw, 1>(0, 0));
+  if constexpr (fh > 0 && rw > 0)
+    write_blocks<T, fh, rw, bh, rw>(
+        surf, x + fw, y, tile.template select<fh, 1, rw, 1>(0, fw));
+  if constexpr (rh > 0 && fw > 0)
+    write_blocks<T, rh, fw, rh, bw>(
+        surf, x, y + fh, tile.template select<rh, 1, fw, 1>(fh, 0));
+  if constexpr (rh > 0 && rw > 0)
+    write_blocks<T, rh, rw, rh, rw>(
+        surf, x + fw, y + fh, tile.template select<rh, 1, rw, 1>(fh, fw));
+}
+
+// Reads a h x w tile of Tin pixels at (x, y) and widens it to float.
+template<typename Tin, int h, int w>
+CM_INLINE matrix<float, h, w> read_float_tile(SurfaceIndex surf, int x,
+                                              int y) {
+  matrix<Tin, h, w> in;
+  read_tile<Tin, h, w>(surf, x, y, in.select_all());
+  return in;
+}
+
+// Narrows a float tile to Tout and writes it at (x, y).
+template<typename Tout, int h, int w>
+CM_INLINE void write_float_tile(SurfaceIndex surf, int x, int y,
+                                matrix<float, h, w> acc) {
+  matrix<Tout, h, w> out;
+  if constexpr (details::is_float_or_half<Tout>::value)
+    out = acc;
+  else
+    out = cm_rnde<Tout>(acc, SAT);
+  write_tile<Tout, h, w>(surf, x, y, out.select_all());
+}
+
+// Inclusive prefix sum of every row: step s adds the values s pixels to the
+// left, doubling s until it covers the row.
+template<typename T, int h, int w, int s>
+CM_INLINE void scan_rows(matrix_ref<T, h, w> m) {
+  if constexpr (s < w) {
+    matrix<T, h, w - s> t = m.template select<h, 1, w - s, 1>(0, 0);
+    m.template select<h, 1, w - s, 1>(0, s) += t;
+    scan_rows<T, h, w, s * 2>(m);
+  }
+}
+
+} // namespace filter_detail
+
+/* window_sum_h: sums of k horizontally adjacent pixels,
+ *   out(i, j) = in(i, j) + ... + in(i, j + k - 1).
+ *
+ * The window is built by doubling (sums of 2, 4, 8... pixels reused for the
+ * next size), so it takes O(log k) full tile additions instead of k - 1.
+ */
+template<int k, typename T, int h, int w>
+CM_INLINE matrix<T, h, w - k + 1> window_sum_h(matrix<T, h, w> in) {
+  CM_STATIC_ERROR(k >= 1 && k <= w, "window must fit in the tile");
+  if constexpr (k == 1) {
+    return in;
+  } else if constexpr (k % 2 == 0) {
+    matrix<T, h, w - k / 2 + 1> p = window_sum_h<k / 2>(in);
+    return p.template select<h, 1, w - k + 1, 1>(0, 0) +
+           p.template select<h, 1, w - k + 1, 1>(0, k / 2);
+  } else {
+    matrix<T, h, w - k + 2> p = window_sum_h<k - 1>(in);
+    return p.template select<h, 1, w - k + 1, 1>(0, 0) +
+           in.template select<h, 1, w - k + 1, 1>(0, k - 1);
+  }
+}
+
+/* window_sum_v: sums of k vertically adjacent pixels,
+ *   out(i, j) = in(i, j) + ... + in(i + k - 1, j).
+ */
+template<int k, typename T, int h, int w>
+CM_INLINE matrix<T, h - k + 1, w> window_sum_v(matrix<T, h, w> in) {
+  CM_STATIC_ERROR(k >= 1 && k <= h, "window must fit in the tile");
+  if constexpr (k == 1) {
+    return in;
+  } else if constexpr (k % 2 == 0) {
+    matrix<T, h - k / 2 + 1, w> p = window_sum_v<k / 2>(in);
+    return p.template select<h - k + 1, 1, w, 1>(0, 0) +
+           p.template select<h - k + 1, 1, w, 1>(k / 2, 0);
+  } else {
+    matrix<T, h - k + 2, w> p = window_sum_v<k - 1>(in);
+    return p.template select<h - k + 1, 1, w, 1>(0, 0) +
+           in.template select<h - k + 1, 1, w, 1>(k - 1, 0);
+  }
+}
+
+/* convolve_tile: 2D correlation of a (th + kh - 1) x (tw + kw - 1) input
+ * tile with a kh x kw kernel, producing a th x tw tile.
+ */
+template<int kh, int kw, int th, int tw>
+CM_INLINE matrix<float, th, tw>
+convolve_tile(matrix<float, th + kh - 1, tw + kw - 1> in,
+              matrix<float, kh, kw> kernel) {
+  matrix<float, th, tw> acc = 0;
+#pragma unroll
+  for (int a = 0; a < kh; ++a)
+#pragma unroll
+    for (int b = 0; b < kw; ++b)
+      acc += kernel(a, b) * in.template select<th, 1, tw, 1>(a, b);
+  return acc;
+}
+
+/* convolve_separable_tile: convolution with the separable kh x kw kernel
+ * vk^T * hk, where vk has kh taps and hk has kw taps. The horizontal pass
+ * produces th + kh - 1 intermediate rows that stay in registers for the
+ * vertical pass, so each output pixel costs kh + kw multiply-adds instead of
+ * kh * kw.
+ */
+template<int kh, int kw, int th, int tw>
+CM_INLINE matrix<float, th, tw>
+convolve_separable_tile(matrix<float, th + kh - 1, tw + kw - 1> in,
+                        vector<float, kw> hk, vector<float, kh> vk) {
+  matrix<float, th + kh - 1, tw> rows = 0;
+#pragma unroll
+  for (int b = 0; b < kw; ++b)
+    rows += hk(b) * in.template select<th + kh - 1, 1, tw, 1>(0, b);
+  matrix<float, th, tw> acc = 0;
+#pragma unroll
+  for (int a = 0; a < kh; ++a)
+    acc += vk(a) * rows.template select<th, 1, tw, 1>(a, 0);
+  return acc;
+}
+
+/* box_sum_tile: sums of kh x kw windows of a (th + kh - 1) x (tw + kw - 1)
+ * input tile, see window_sum_h and window_sum_v.
+ */
+template<int kh, int kw, int th, int tw, typename T>
+CM_INLINE matrix<T, th, tw>
+box_sum_tile(matrix<T, th + kh - 1, tw + kw - 1> in) {
+  matrix<T, th + kh - 1, tw> rows = window_sum_h<kw>(in);
+  return window_sum_v<kh>(rows);
+}
+
+/* integral_tile: in place 2D inclusive prefix sum of a th x tw tile, offset
+ * by the integral image values around it:
+ *  top    - the integral row right above the tile,
+ *  left   - the integral column right left of the tile,
+ *  corner - the integral value above and left of the tile.
+ * Pass zeros for tiles on the top or left image border.
+ *
+ * Rows are scanned in log2(tw) shifted additions, columns with th - 1 row
+ * additions.
+ */
+template<typename T, int th, int tw>
+CM_INLINE void integral_tile(matrix_ref<T, th, tw> m, vector<T, tw> top,
+                             vector<T, th> left, T corner) {
+  filter_detail::scan_rows<T, th, tw, 1>(m);
+  m.row(0) += top - corner;
+#pragma unroll
+  for (int i = 1; i < th; ++i)
+    m.row(i) += m.row(i - 1);
+#pragma unroll
+  for (int i = 0; i < th; ++i)
+    m.row(i) += left(i);
+}
+
+/* convolve: dst tile at (x, y) = src correlated with kernel, centered on
+ * (kh / 2, kw / 2).
+ */
+template<typename Tin, typename Tout, int kh, int kw, int th, int tw>
+CM_INLINE void convolve(SurfaceIndex src, SurfaceIndex dst, int x, int y,
+                        matrix<float, kh, kw> kernel) {
+  matrix<float, th + kh - 1, tw + kw - 1> in =
+      filter_detail::read_float_tile<Tin, th + kh - 1, tw + kw - 1>(
+          src, x - kw / 2, y - kh / 2);
+  filter_detail::write_float_tile<Tout>(
+      dst, x, y, convolve_tile<kh, kw, th, tw>(in, kernel));
+}
+
+/* convolve_separable: dst tile at (x, y) = src convolved with the kh x kw
+ * kernel vk^T * hk, centered on (kh / 2, kw / 2).
+ */
+template<typename Tin, typename Tout, int kh, int kw, int th, int tw>
+CM_INLINE void convolve_separable(SurfaceIndex src, SurfaceIndex dst, int x,
+                                  int y, vector<float, kw> hk,
+                                  vector<float, kh> vk) {
+  matrix<float, th + kh - 1, tw + kw - 1> in =
+      filter_detail::read_float_tile<Tin, th + kh - 1, tw + kw - 1>(
+          src, x - kw / 2, y - kh / 2);
+  filter_detail::write_float_tile<Tout>(
+      dst, x, y, convolve_separable_tile<kh, kw, th, tw>(in, hk, vk));
+}
+
+/* box_filter: dst tile at (x, y) = mean of the (2 * r + 1) x (2 * r + 1)
+ * neighbourhood of every pixel.
+ */
+template<typename Tin, typename Tout, int r, int th, int tw>
+CM_INLINE void box_filter(SurfaceIndex src, SurfaceIndex dst, int x, int y) {
+  constexpr int k = 2 * r + 1;
+  matrix<float, th + k - 1, tw + k - 1> in =
+      filter_detail::read_float_tile<Tin, th + k - 1, tw + k - 1>(src, x - r,
+                                                                  y - r);
+  matrix<float, th, tw> acc = box_sum_tile<k, k, th, tw>(in);
+  acc *= 1.0f / (k * k);
+  filter_detail::write_float_tile<Tout>(dst, x, y, acc);
+}
+
+/* integral_image: computes the th x tw tile at (x, y) of the integral image
+ * of src into dst, as CalcIntImage does for 16 x 16 tiles. Tacc is the 4 byte
+ * accumulator type (uint for integer input, float otherwise).
+ *
+ * The tile reads the integral values of its left, top and top left
+ * neighbours back from dst, so those tiles must be complete before the call,
+ * e.g. with cm_wait() under a wavefront thread dependency; signal dependents
+ * with cm_fence() and cm_signal() afterwards.
+ */
+template<typename Tin, typename Tacc, int th, int tw>
+CM_INLINE void integral_image(SurfaceIndex src, SurfaceIndex dst, int x,
+                              int y) {
+  CM_STATIC_ERROR(sizeof(Tacc) == details::DWORD,
+                  "integral images use 4 byte accumulators");
+  CM_STATIC_ERROR(th <= 64, "integral tiles are at most 64 rows high");
+  matrix<Tin, th, tw> in;
+  filter_detail::read_tile<Tin, th, tw>(src, x, y, in.select_all());
+  matrix<Tacc, th, tw> m = in;
+
+  vector<Tacc, tw> top = 0;
+  matrix<Tacc, th, 1> left = 0;
+  vector<Tacc, 1> corner = 0;
+  if (y > 0) {
+    matrix<Tacc, 1, tw> row;
+    filter_detail::read_tile<Tacc, 1, tw>(dst, x, y - 1, row.select_all());
+    top = row;
+  }
+  if (x > 0)
+    read(dst, (x - 1) * sizeof(Tacc), y, left);
+  if (x > 0 && y > 0)
+    read(dst, (x - 1) * sizeof(Tacc), y - 1, corner);
+
+  integral_tile<Tacc, th, tw>(m.select_all(), top, left.template format<Tacc>(),
+                              corner(0));
+  filter_detail::write_tile<Tacc, th, tw>(dst, x, y, m.select_all());
+}
+
+} // namespace filter
+} // namespace cmtl
+
+#endif // CM_CMTL_FILTER_H
@@ -0,0 +1,405 @@
+/*===================== begin_copyright_notice ==================================
+
+ Copyright (c) 2021, Intel Corporation
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+======================= end_copyright_notice ==================================*/
+
+#ifndef CM_CMTL_SPARSE_H
+#define CM_CMTL_SPARSE_H
+
+#include "../cm.h"
+
+/* cm/cmtl/sparse.h provides sparse matrix - dense vector (SpMV) and sparse
+ * matrix - dense matrix (SpMM) products for the CSR, ELL and sliced ELL
+ * storage formats.
+ *
+ * All routines compute the rows [row0, row0 + rows) of the result, so a kernel
+ * normally calls them once per thread with row0 = thread_id * rows. row0 must
+ * be a multiple of rows. Rows at or past nrows are never written.
+ *
+ * Values, column indices and row (slice) pointers are streamed with dword
+ * aligned block reads, x is gathered with scattered reads, and the per-row
+ * partial sums are kept in a rows x simd accumulator that is reduced with a
+ * log2(simd) deep tree of full width adds.
+ *
+ * Common template parameters:
+ *  T    - element type of the matrix values, x and y; must be 4 bytes wide
+ *         (float, int or uint).
+ *  simd - number of nonzeros (CSR) or rows (ELL, sliced ELL) handled by one
+ *         vector operation; power of 2, at most 32.
+ *  rows - number of rows handled by one call (rows per thread); power of 2,
+ *         at most 32. For ELL and sliced ELL rows must be a multiple of simd.
+ *
+ * Storage formats (all indices are 32-bit and 0-based):
+ *  CSR        - values[nnz], columns[nnz], row_ptr[nrows + 1].
+ *  ELL        - values[width * ld], columns[width * ld], column major: entry
+ *               k of row r is at k * ld + r, where ld >= nrows is the
+ *               padded row count. Padding entries must have value 0 and a
+ *               valid column index (0 is fine).
+ *  sliced ELL - rows are grouped in slices of simd rows, each slice is
+ *               stored as a column major ELL block of its own width.
+ *               slice_ptr[nrows / simd + 1] holds the element offset of every
+ *               slice (a multiple of simd), entry k of row s * simd + i is at
+ *               slice_ptr[s] + k * simd + i. Padding is as for ELL. Row
+ *               sorting within a window (SELL-C-sigma) is left to the caller,
+ *               y is produced in storage order.
+ *
+ * SpMM variants multiply by a dense row major matrix x with n columns and
+ * produce a dense row major y with n columns. n must be a multiple of 4, and
+ * rows * n elements are kept in registers.
+ */
+
+namespace cmtl {
+namespace sparse {
+
+namespace sparse_detail {
+
+const uint lane_init[32] = {0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  10,
+                            11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21,
+                            22, 23, 24, 25, 26, 27, 28, 29, 30, 31};
+
+template<typename T, int simd, int rows>
+CM_INLINE void arg_check() {
+  CM_STATIC_ERROR(sizeof(T) == details::DWORD,
+                  "sparse routines support 4-byte element types only");
+  CM_STATIC_ERROR(details::isPowerOf2(simd, 32),
+                  "simd must be a power of 2 no greater than 32");
+  CM_STATIC_ERROR(details::isPowerOf2(rows, 32),
+                  "rows must be a power of 2 no greater than 32");
+}
+
+template<int simd>
+CM_INLINE vector<uint, simd> lanes() {
+  vector<uint, 32> all(lane_init);
+  return all.template select<simd, 1>(0);
+}
+
+// Reads n consecutive elements starting at element offset using as few dword
+// aligned block reads as possible.
+template<typename T, int n>
+CM_INLINE void read_stream(SurfaceIndex buf, uint offset,
+                           vector_ref<T, n> out) {
+  constexpr int chunk = 8 * details::OWORD / sizeof(T);
+  constexpr int full = n / chunk * chunk;
+#pragma unroll
+  for (int i = 0; i < full; i += chunk)
+    read(DWALIGNED(buf), (offset + i) * sizeof(T),
+         out.template select<chunk, 1>(i));
+  if constexpr (n % chunk != 0)
+    read(DWALIGNED(buf), (offset + full) * sizeof(T),
+         out.template select<n % chunk, 1>(full));
+}
+
+// Writes n consecutive elements starting at element offset, which must be
+// oword aligned, splitting the data into power of 2 oword block writes.
+template<typename T, int n>
+CM_INLINE void write_stream(SurfaceIndex buf, uint offset,
+                            vector_ref<T, n> in) {
+  constexpr int per_oword = details::OWORD / sizeof(T);
+  CM_STATIC_ERROR(n % per_oword == 0,
+                  "block writes must cover a whole number of owords");
+  constexpr int chunk = 8 * per_oword;
+  constexpr int full = n / chunk * chunk;
+#pragma unroll
+  for (int i = 0; i < full; i += chunk)
+    write(buf, (offset + i) * sizeof(T), in.template select<chunk, 1>(i));
+  constexpr int rem = n - full;
+  if constexpr ((rem & (4 * per_oword)) != 0)
+    write(buf, (offset + full) * sizeof(T),
+          in.template select<4 * per_oword, 1>(full));
+  constexpr int rem4 = rem & (4 * per_oword);
+  if constexpr ((rem & (2 * per_oword)) != 0)
+    write(buf, (offset + full + rem4) * sizeof(T),
+          in.template select<2 * per_oword, 1>(full + rem4));
+  constexpr int rem2 = rem4 + (rem & (2 * per_oword));
+  if constexpr ((rem & per_oword) != 0)
+    write(buf, (offset + full + rem2) * sizeof(T),
+          in.template select<per_oword, 1>(full + rem2));
+}
+
+// Sums every row of acc. Instead of a horizontal reduction per row, the two
+// halves of all rows are added at once until one column is left.
+template<typename T, int rows, int width>
+CM_INLINE vector<T, rows> row_sums(matrix<T, rows, width> acc) {
+  if constexpr (width == 1) {
+    return acc.template format<T>();
+  } else {
+    matrix<T, rows, width / 2> half =
+        acc.template select<rows, 1, width / 2, 1>(0, 0) +
+        acc.template select<rows, 1, width / 2, 1>(0, width / 2);
+    return row_sums<T, rows, width / 2>(half);
+  }
+}
+
+// Writes y[row0, row0 + rows) skipping the rows at or past nrows. Full tiles
+// go out with a single block write when the tile is at least one oword.
+template<typename T, int rows>
+CM_INLINE void write_rows(SurfaceIndex y, uint row0, uint nrows,
+                          vector<T, rows> sums) {
+  if constexpr (rows * sizeof(T) >= details::OWORD) {
+    if (row0 + rows <= nrows) {
+      write(y, row0 * sizeof(T), sums);
+      return;
+    }
+  }
+#pragma unroll
+  for (int r = 0; r < rows; ++r)
+    if (row0 + r < nrows)
+      write(y, row0 + r, sums(r));
+}
+
+// Adds a(i) * x[col(i)] to acc for every lane i: lanes are independent rows
+// (ELL, sliced ELL).
+template<typename T, int simd, int n>
+CM_INLINE void axpy_lanes(SurfaceIndex x, vector<T, simd> a,
+                          vector<uint, simd> col, matrix_ref<T, simd, n> acc) {
+#pragma unroll
+  for (int i = 0; i < simd; ++i) {
+    vector<T, n> xrow;
+    read_stream(x, col(i) * n, xrow.select_all());
+    acc.row(i) += a(i) * xrow;
+  }
+}
+
+// Adds a(i) * x[col(i)] to acc for the first count lanes: lanes are
+// nonzeros of one row (CSR).
+template<typename T, int simd, int n>
+CM_INLINE void axpy_row(SurfaceIndex x, vector<T, simd> a,
+                        vector<uint, simd> col, uint count,
+                        vector_ref<T, n> acc) {
+  for (uint i = 0; i < count; ++i) {
+    vector<T, n> xrow;
+    read_stream(x, col(i) * n, xrow.select_all());
+    acc += a(i) * xrow;
+  }
+}
+
+} // namespace sparse_detail
+
+/* spmv_csr: y = A * x for the rows [row0, row0 + rows) of a CSR matrix A.
+ *
+ * Every row is processed simd nonzeros at a time; the tail of the last step
+ * is masked off so rows of any length are handled.
+ */
+template<typename T, int simd, int rows>
+CM_INLINE void spmv_csr(SurfaceIndex values, SurfaceIndex columns,
+                        SurfaceIndex row_ptr, SurfaceIndex x, SurfaceIndex y,
+                        uint row0, uint nrows) {
+  sparse_detail::arg_check<T, simd, rows>();
+  vector<uint, rows + 1> ptr;
+  sparse_detail::read_stream(row_ptr, row0, ptr.select_all());
+  vector<uint, simd> lane = sparse_detail::lanes<simd>();
+
+  matrix<T, rows, simd> acc = 0;
+#pragma unroll
+  for (int r = 0; r < rows; ++r) {
+    uint begin = ptr(r);
+    uint end = row0 + r < nrows ? ptr(r + 1) : begin;
+    for (uint j = begin; j < end; j += simd) {
+      vector<T, simd> a;
+      vector<uint, simd> col;
+      sparse_detail::read_stream(values, j, a.select_all());
+      sparse_detail::read_stream(columns, j, col.select_all());
+      // Lanes past the end of the row gather x[0] rather than whatever the
+      // next row's column indices point at, and their products are dropped
+      // rather than their values zeroed, as 0 * Inf or 0 * NaN is NaN.
+      vector<ushort, simd> tail = lane >= end - j;
+      col.merge(0, tail);
+      vector<T, simd> xv;
+      read(x, 0, col, xv);
+      vector<T, simd> prod = a * xv;
+      prod.merge(0, tail);
+      acc.row(r) += prod;
+    }
+  }
+  sparse_detail::write_rows<T, rows>(
+      y, row0, nrows, sparse_detail::row_sums<T, rows, simd>(acc));
+}
+
+/* spmv_ell: y = A * x for the rows [row0, row0 + rows) of an ELL matrix A
+ * with width entries per row and leading dimension ld.
+ *
+ * Every lane handles one row, so no reduction is needed.
+ */
+template<typename T, int simd, int rows>
+CM_INLINE void spmv_ell(SurfaceIndex values, SurfaceIndex columns,
+                        SurfaceIndex x, SurfaceIndex y, uint width, uint ld,
+                        uint row0, uint nrows) {
+  sparse_detail::arg_check<T, simd, rows>();
+  CM_STATIC_ERROR(rows % simd == 0, "rows must be a multiple of simd");
+  constexpr int blocks = rows / simd;
+
+  matrix<T, blocks, simd> acc = 0;
+  for (uint k = 0; k < width; ++k) {
+#pragma unroll
+    for (int b = 0; b < blocks; ++b) {
+      uint offset = k * ld + row0 + b * simd;
+      vector<T, simd> a;
+      vector<uint, simd> col;
+      sparse_detail::read_stream(values, offset, a.select_all());
+      sparse_detail::read_stream(columns, offset, col.select_all());
+      vector<T, simd> xv;
+      read(x, 0, col, xv);
+      acc.row(b) += a * xv;
+    }
+  }
+  sparse_detail::write_rows<T, rows>(y, row0, nrows, acc.template format<T>());
+}
+
+/* spmv_sell: y = A * x for the rows [row0, row0 + rows) of a sliced ELL
+ * matrix A with slices of simd rows.
+ *
+ * Every slice is only as wide as its longest row, so unlike ELL a few long
+ * rows do not inflate the work of the whole matrix.
+ */
+template<typename T, int simd, int rows>
+CM_INLINE void spmv_sell(SurfaceIndex values, SurfaceIndex columns,
+                         SurfaceIndex slice_ptr, SurfaceIndex x,
+                         SurfaceIndex y, uint row0, uint nrows) {
+  sparse_detail::arg_check<T, simd, rows>();
+  CM_STATIC_ERROR(rows % simd == 0, "rows must be a multiple of simd");
+  constexpr int blocks = rows / simd;
+
+  vector<uint, blocks + 1> ptr;
+  sparse_detail::read_stream(slice_ptr, row0 / simd, ptr.select_all());
+
+  matrix<T, blocks, simd> acc = 0;
+#pragma unroll
+  for (int b = 0; b < blocks; ++b) {
+    uint begin = ptr(b);
+    uint end = row0 + b * simd < nrows ? ptr(b + 1) : begin;
+    for (uint offset = begin; offset < end; offset += simd) {
+      vector<T, simd> a;
+      vector<uint, simd> col;
+      sparse_detail::read_stream(values, offset, a.select_all());
+      sparse_detail::read_stream(columns, offset, col.select_all());
+      vector<T, simd> xv;
+      read(x, 0, col, xv);
+      acc.row(b) += a * xv;
+    }
+  }
+  sparse_detail::write_rows<T, rows>(y, row0, nrows, acc.template format<T>());
+}
+
+/* spmm_csr: y = A * x for the rows [row0, row0 + rows) of a CSR matrix A and
+ * a dense row major matrix x with n columns.
+ *
+ * The nonzeros of a row are streamed simd at a time and the matching rows of
+ * x are fetched with block reads.
+ */
+template<typename T, int simd, int rows, int n>
+CM_INLINE void spmm_csr(SurfaceIndex values, SurfaceIndex columns,
+                        SurfaceIndex row_ptr, SurfaceIndex x, SurfaceIndex y,
+                        uint row0, uint nrows) {
+  sparse_detail::arg_check<T, simd, rows>();
+  vector<uint, rows + 1> ptr;
+  sparse_detail::read_stream(row_ptr, row0, ptr.select_all());
+
+  matrix<T, rows, n> acc = 0;
+#pragma unroll
+  for (int r = 0; r < rows; ++r) {
+    uint begin = ptr(r);
+    uint end = row0 + r < nrows ? ptr(r + 1) : begin;
+    for (uint j = begin; j < end; j += simd) {
+      vector<T, simd> a;
+      vector<uint, simd> col;
+      sparse_detail::read_stream(values, j, a.select_all());
+      sparse_detail::read_stream(columns, j, col.select_all());
+      sparse_detail::axpy_row<T, simd, n>(x, a, col, cm_min<uint>(end - j, simd),
+                                          acc.row(r));
+    }
+  }
+#pragma unroll
+  for (int r = 0; r < rows; ++r)
+    if (row0 + r < nrows)
+      sparse_detail::write_stream(y, (row0 + r) * n, acc.row(r));
+}
+
+/* spmm_ell: y = A * x for the rows [row0, row0 + rows) of an ELL matrix A
+ * with width entries per row and leading dimension ld, and a dense row major
+ * matrix x with n columns.
+ */
+template<typename T, int simd, int rows, int n>
+CM_INLINE void spmm_ell(SurfaceIndex values, SurfaceIndex columns,
+                        SurfaceIndex x, SurfaceIndex y, uint width, uint ld,
+                        uint row0, uint nrows) {
+  sparse_detail::arg_check<T, simd, rows>();
+  CM_STATIC_ERROR(rows % simd == 0, "rows must be a multiple of simd");
+  constexpr int blocks = rows / simd;
+
+  matrix<T, rows, n> acc = 0;
+  for (uint k = 0; k < width; ++k) {
+#pragma unroll
+    for (int b = 0; b < blocks; ++b) {
+      uint offset = k * ld + row0 + b * simd;
+      vector<T, simd> a;
+      vector<uint, simd> col;
+      sparse_detail::read_stream(values, offset, a.select_all());
+      sparse_detail::read_stream(columns, offset, col.select_all());
+      sparse_detail::axpy_lanes<T, simd, n>(
+          x, a, col, acc.template select<simd, 1, n, 1>(b * simd, 0));
+    }
+  }
+#pragma unroll
+  for (int r = 0; r < rows; ++r)
+    if (row0 + r < nrows)
+      sparse_detail::write_stream(y, (row0 + r) * n, acc.row(r));
+}
+
+/* spmm_sell: y = A * x for the rows [row0, row0 + rows) of a sliced ELL
+ * matrix A with slices of simd rows, and a dense row major matrix x with n
+ * columns.
+ */
+template<typename T, int simd, int rows, int n>
+CM_INLINE void spmm_sell(SurfaceIndex values, SurfaceIndex columns,
+                         SurfaceIndex slice_ptr, SurfaceIndex x,
+                         SurfaceIndex y, uint row0, uint nrows) {
+  sparse_detail::arg_check<T, simd, rows>();
+  CM_STATIC_ERROR(rows % simd == 0, "rows must be a multiple of simd");
+  constexpr int blocks = rows / simd;
+
+  vector<uint, blocks + 1> ptr;
+  sparse_detail::read_stream(slice_ptr, row0 / simd, ptr.select_all());
+
+  matrix<T, rows, n> acc = 0;
+#pragma unroll
+  for (int b = 0; b < blocks; ++b) {
+    uint begin = ptr(b);
+    uint end = row0 + b * simd < nrows ? ptr(b + 1) : begin;
+    for (uint offset = begin; offset < end; offset += simd) {
+      vector<T, simd> a;
+      vector<uint, simd> col;
+      sparse_detail::read_stream(values, offset, a.select_all());
+      sparse_detail::read_stream(columns, offset, col.select_all());
+      sparse_detail::axpy_lanes<T, simd, n>(
+          x, a, col, acc.template select<simd, 1, n, 1>(b * simd, 0));
+    }
+  }
+#pragma unroll
+  for (int r = 0; r < rows; ++r)
+    if (row0 + r < nrows)
+      sparse_detail::write_stream(y, (row0 + r) * n, acc.row(r));
+}
+
+} // namespace sparse
+} // namespace cmtl
+
+#endif // CM_CMTL_SPARSE_H
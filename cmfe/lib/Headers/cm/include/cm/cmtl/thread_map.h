@@ -0,0 +1,188 @@
+/*===================== begin_copyright_notice ==================================
+
+ Copyright (c) 2021, Intel Corporation
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+======================= end_copyright_notice ==================================*/
+
+#ifndef CM_CMTL_THREAD_MAP_H
+#define CM_CMTL_THREAD_MAP_H
+
+#include "../cm.h"
+
+/* cm/cmtl/thread_map.h remaps the linear ids of cm_linear.h
+ * (cm_linear_global_id(), cm_linear_group_id(), ...) onto a 2D grid of
+ * width x height work items so that consecutive ids cover compact 2D
+ * regions rather than whole rows. Tiled kernels (GEMM, convolution,
+ * transpose) then share more of their input in the caches.
+ *
+ * Every mapping is a bijection from [0, width * height) to the grid for any
+ * width and height: the compile-time tile shape only governs the order, grid
+ * edges that do not fill a whole tile are walked row by row. Tile sizes are
+ * template parameters so that the work within a tile reduces to shifts and
+ * masks; the grid width is only divided by once per call.
+ *
+ * All routines are constexpr and can also be evaluated on the host.
+ *
+ *   auto p = cmtl::thread_map::z_order<8, 8>(cm_linear_group_id(),
+ *                                            groups_x, groups_y);
+ *   ... process tile (p.x, p.y) ...
+ */
+
+namespace cmtl {
+namespace thread_map {
+
+/* coord: a position on the grid */
+struct coord {
+  uint x;
+  uint y;
+};
+
+namespace thread_map_detail {
+
+// Spreads the low 16 bits of v to the even bit positions.
+CM_INLINE constexpr uint spread(uint v) {
+  v &= 0x0000ffff;
+  v = (v | (v << 8)) & 0x00ff00ff;
+  v = (v | (v << 4)) & 0x0f0f0f0f;
+  v = (v | (v << 2)) & 0x33333333;
+  v = (v | (v << 1)) & 0x55555555;
+  return v;
+}
+
+// Gathers the even bits of v into the low 16 bits.
+CM_INLINE constexpr uint compact(uint v) {
+  v &= 0x55555555;
+  v = (v | (v >> 1)) & 0x33333333;
+  v = (v | (v >> 2)) & 0x0f0f0f0f;
+  v = (v | (v >> 4)) & 0x00ff00ff;
+  v = (v | (v >> 8)) & 0x0000ffff;
+  return v;
+}
+
+CM_INLINE constexpr int log2(int n) {
+  int l = 0;
+  while (n > 1) {
+    n >>= 1;
+    l++;
+  }
+  return l;
+}
+
+// Morton order inside a tw x th tile, both powers of 2. The shorter side's
+// bits are interleaved, the extra bits of the longer side come on top.
+template<int tw, int th>
+CM_INLINE constexpr coord morton_in_tile(uint i) {
+  constexpr int bx = log2(tw);
+  constexpr int by = log2(th);
+  constexpr int m = bx < by ? bx : by;
+  uint high = i >> (2 * m);
+  coord c = {compact(i), compact(i >> 1)};
+  c.x &= (1u << m) - 1;
+  c.y &= (1u << m) - 1;
+  if constexpr (bx > by)
+    c.x |= high << m;
+  else
+    c.y |= high << m;
+  return c;
+}
+
+// Walks the grid in bands of th rows. A band is cut into tw x th tiles that
+// are visited left to right, the ids within a tile are ordered by morton or
+// row major, and the columns right of the last whole tile form a narrower
+// tile of their own. Rows below the last whole band are row major.
+template<int tw, int th, bool morton>
+CM_INLINE constexpr coord tiled(uint id, uint width, uint height) {
+  constexpr uint tile = tw * th;
+  uint full_h = height / th * th;
+  if (id >= full_h * width) {
+    uint r = id - full_h * width;
+    return {r % width, full_h + r / width};
+  }
+  uint band = id / (width * th);
+  uint r = id - band * width * th;
+  uint y0 = band * th;
+  uint full_w = width / tw * tw;
+  if (r >= full_w * th) {
+    uint rest = width - full_w;
+    r -= full_w * th;
+    return {full_w + r % rest, y0 + r / rest};
+  }
+  uint t = r / tile;
+  uint i = r % tile;
+  coord c = {i % tw, i / tw};
+  if constexpr (morton)
+    c = morton_in_tile<tw, th>(i);
+  return {t * tw + c.x, y0 + c.y};
+}
+
+} // namespace thread_map_detail
+
+/* morton_encode: interleave the bits of x (even bits) and y (odd bits), both
+ * coordinates must be below 65536.
+ */
+CM_INLINE constexpr uint morton_encode(uint x, uint y) {
+  return thread_map_detail::spread(x) | (thread_map_detail::spread(y) << 1);
+}
+
+/* morton_decode: inverse of morton_encode */
+CM_INLINE constexpr coord morton_decode(uint id) {
+  return {thread_map_detail::compact(id), thread_map_detail::compact(id >> 1)};
+}
+
+/* z_order: Z-order (Morton) curve inside tw x th supertiles, the supertiles
+ * are visited in row major order. tw and th must be powers of 2.
+ */
+template<int tw, int th>
+CM_INLINE constexpr coord z_order(uint id, uint width, uint height) {
+  CM_STATIC_ERROR(details::isPowerOf2(tw) && details::isPowerOf2(th),
+                  "z_order tile sides must be powers of 2");
+  return thread_map_detail::tiled<tw, th, true>(id, width, height);
+}
+
+/* supertile: row major order inside tw x th supertiles, the supertiles are
+ * visited in row major order.
+ */
+template<int tw, int th>
+CM_INLINE constexpr coord supertile(uint id, uint width, uint height) {
+  CM_STATIC_ERROR(tw > 0 && th > 0, "supertile sides must be positive");
+  return thread_map_detail::tiled<tw, th, false>(id, width, height);
+}
+
+/* row_swizzle: the grid is cut into bands of rows rows (the last band may be
+ * shorter) and every band is walked column by column, so consecutive ids
+ * move down a column of the band before moving right. This is the usual
+ * GEMM ordering: the ids of one wave share both a few rows of A and a few
+ * columns of B.
+ */
+template<int rows>
+CM_INLINE constexpr coord row_swizzle(uint id, uint width, uint height) {
+  CM_STATIC_ERROR(rows > 0, "row_swizzle band height must be positive");
+  uint band = id / (width * rows);
+  uint y0 = band * rows;
+  uint h = height - y0 < rows ? height - y0 : rows;
+  uint r = id - y0 * width;
+  return {r / h, y0 + r % h};
+}
+
+} // namespace thread_map
+} // namespace cmtl
+
+#endif // CM_CMTL_THREAD_MAP_H
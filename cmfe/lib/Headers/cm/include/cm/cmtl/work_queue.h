@@ -0,0 +1,264 @@
+/*===================== begin_copyright_notice ==================================
+
+ Copyright (c) 2021, Intel Corporation
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+======================= end_copyright_notice ==================================*/
+
+#ifndef CM_CMTL_WORK_QUEUE_H
+#define CM_CMTL_WORK_QUEUE_H
+
+#include "../cm.h"
+
+/* cm/cmtl/work_queue.h provides a work queue shared by the threads of a
+ * thread group and kept in Shared Local Memory, so persistent thread kernels
+ * can balance irregular work (graph traversal, flood fill, BVH walks) inside
+ * a group without going through global memory.
+ *
+ * A queue of up to capacity items owns a whole SLM buffer of
+ * storage_size<capacity>() bytes (see cm_slm_alloc). The buffer starts with
+ * an 8 dword header: the head and tail counters followed by scratch dwords
+ * that are targeted by the unused lanes of the counter atomics. The item
+ * slots follow the header.
+ *
+ * Slots are claimed with SLM atomics on the counters, so any number of
+ * threads may push concurrently, or pop concurrently. Pushing and popping
+ * the same queue must be separated by sync(): a popped slot is only known to
+ * be written once every pusher reached the barrier. Kernels usually keep two
+ * queues and swap them every round:
+ *
+ *   init(cur); init(next);
+ *   ... seed cur, sync() ...
+ *   for (;;) {
+ *     while (pop<capacity>(cur, item))
+ *       ... push<capacity>(next, new_item) ...
+ *     sync();
+ *     init(cur);                  // cur is consumed, reset it
+ *     if (size<capacity>(next) == 0)
+ *       break;
+ *     ... exchange cur and next ...
+ *   }
+ *
+ * A queue holds at most capacity items between two resets. Pushes past
+ * capacity are dropped and reported by the push functions and overflow().
+ *
+ * Common template parameters:
+ *  capacity - number of item slots.
+ *  T        - item type, must be 4 bytes wide (int, uint or float).
+ *  n        - number of items handled by one batch operation; 8, 16 or 32.
+ */
+
+namespace cmtl {
+namespace work_queue {
+
+namespace work_queue_detail {
+
+constexpr uint header_dwords = 8;
+constexpr ushort head = 0;
+constexpr ushort tail = 1;
+constexpr uint scratch = header_dwords - 1;
+
+const ushort lane_init[32] = {0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  10,
+                              11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21,
+                              22, 23, 24, 25, 26, 27, 28, 29, 30, 31};
+
+template<typename T, int n>
+CM_INLINE void arg_check() {
+  CM_STATIC_ERROR(sizeof(T) == details::DWORD,
+                  "work queue items must be 4 bytes wide");
+  CM_STATIC_ERROR(n == 8 || n == 16 || n == 32,
+                  "batch size must be 8, 16 or 32");
+}
+
+template<int n>
+CM_INLINE vector<ushort, n> lanes() {
+  vector<ushort, 32> all(lane_init);
+  return all.template select<n, 1>(0);
+}
+
+// Adds head_add to the head and tail_add to the tail counter in a single
+// atomic message and returns the previous head and tail in lanes 0 and 1.
+// The other lanes add 0 to the scratch part of the header.
+CM_INLINE vector<uint, 8> bump(uint slm, uint head_add, uint tail_add) {
+  vector<ushort, 8> addr = lanes<8>();
+  vector<uint, 8> add = 0;
+  add(head) = head_add;
+  add(tail) = tail_add;
+  vector<uint, 8> old;
+  cm_slm_atomic(slm, ATOMIC_ADD, addr, old, add);
+  return old;
+}
+
+// Number of slots that were handed out, clamped to the capacity.
+template<int capacity>
+CM_INLINE uint filled(uint tail_value) {
+  return tail_value < capacity ? tail_value : capacity;
+}
+
+} // namespace work_queue_detail
+
+/* storage_size: size in bytes of the SLM buffer backing a queue */
+template<int capacity>
+constexpr uint storage_size() {
+  return (work_queue_detail::header_dwords + capacity) * details::DWORD;
+}
+
+/* reset: empty the queue. Must be called by a single thread, and the queue
+ * must not be used by any thread before the following barrier.
+ */
+CM_INLINE void reset(uint slm) {
+  vector<uint, work_queue_detail::header_dwords> header = 0;
+  cm_slm_block_write(slm, 0, header);
+}
+
+/* sync: make the SLM updates of every thread visible to the whole group and
+ * wait for it. Separates the push and pop phases of a queue.
+ */
+CM_INLINE void sync() {
+#if CM_GENX > 900
+  cm_slm_fence(CM_GLOBAL_COHERENT_FENCE);
+#endif
+  cm_barrier();
+}
+
+/* init: empty the queue on behalf of the whole thread group. Every thread of
+ * the group must call it, it ends with sync().
+ */
+CM_INLINE void init(uint slm) {
+  if (cm_linear_local_id() == 0)
+    reset(slm);
+  sync();
+}
+
+/* size: number of items pushed since the last reset. Popping does not change
+ * it, so it can be read while other threads pop.
+ */
+template<int capacity>
+CM_INLINE uint size(uint slm) {
+  vector<uint, work_queue_detail::header_dwords> header;
+  cm_slm_block_read(slm, 0, header);
+  return work_queue_detail::filled<capacity>(header(work_queue_detail::tail));
+}
+
+/* overflow: number of pushes dropped because the queue was full */
+template<int capacity>
+CM_INLINE uint overflow(uint slm) {
+  vector<uint, work_queue_detail::header_dwords> header;
+  cm_slm_block_read(slm, 0, header);
+  uint pushed = header(work_queue_detail::tail);
+  return pushed > capacity ? pushed - capacity : 0;
+}
+
+/* push: append a single item, returns false if the queue was full */
+template<int capacity, typename T>
+CM_INLINE bool push(uint slm, T item) {
+  using namespace work_queue_detail;
+  arg_check<T, 8>();
+  vector<uint, 8> old = bump(slm, 0, 1);
+  uint slot = old(tail);
+  if (slot >= capacity)
+    return false;
+  // All lanes store the same value to the same slot.
+  vector<uint, 8> addr = header_dwords + slot;
+  vector<T, 8> data = item;
+  cm_slm_write(slm, addr, data);
+  return true;
+}
+
+/* push_n: append the first count (at most n) items of a batch with a single
+ * slot reservation, returns the number of items actually pushed.
+ */
+template<int capacity, typename T, int n>
+CM_INLINE uint push_n(uint slm, vector<T, n> items, uint count) {
+  using namespace work_queue_detail;
+  arg_check<T, n>();
+  count = count < n ? count : n;
+  vector<uint, 8> old = bump(slm, 0, count);
+  uint first = old(tail);
+  uint end = filled<capacity>(first + count);
+  uint pushed = first < end ? end - first : 0;
+  vector<uint, n> lane = lanes<n>();
+  vector<uint, n> addr = scratch;
+  addr.merge(header_dwords + first + lane, lane < pushed);
+  cm_slm_write(slm, addr, items);
+  return pushed;
+}
+
+/* push_masked: append the items of the lanes whose mask is set. Every active
+ * lane claims its own slot in the same atomic message, so no prefix sum over
+ * the mask is needed; the order of the items in the queue is unspecified.
+ * Returns the number of items actually pushed.
+ */
+template<int capacity, typename T, int n>
+CM_INLINE uint push_masked(uint slm, vector<T, n> items,
+                           vector<ushort, n> mask) {
+  using namespace work_queue_detail;
+  arg_check<T, n>();
+  vector<ushort, n> counter = tail;
+  vector<uint, n> add = 0;
+  add.merge(1, mask);
+  vector<uint, n> slot;
+  cm_slm_atomic(slm, ATOMIC_ADD, counter, slot, add);
+  vector<ushort, n> valid = (mask != 0) & (slot < capacity);
+  vector<uint, n> addr = scratch;
+  addr.merge(header_dwords + slot, valid);
+  cm_slm_write(slm, addr, items);
+  return cm_sum<uint>(valid);
+}
+
+/* pop: take a single item, returns false if the queue is empty */
+template<int capacity, typename T>
+CM_INLINE bool pop(uint slm, T &item) {
+  using namespace work_queue_detail;
+  arg_check<T, 8>();
+  vector<uint, 8> old = bump(slm, 1, 0);
+  if (old(head) >= filled<capacity>(old(tail)))
+    return false;
+  vector<uint, 8> addr = header_dwords + old(head);
+  vector<T, 8> data;
+  cm_slm_read(slm, addr, data);
+  item = data(0);
+  return true;
+}
+
+/* pop_n: take up to n items with a single slot reservation. The items land in
+ * the leading lanes of items, the remaining lanes are left unspecified.
+ * Returns the number of items taken.
+ */
+template<int capacity, typename T, int n>
+CM_INLINE uint pop_n(uint slm, vector_ref<T, n> items) {
+  using namespace work_queue_detail;
+  arg_check<T, n>();
+  vector<uint, 8> old = bump(slm, n, 0);
+  uint first = old(head);
+  uint avail = filled<capacity>(old(tail));
+  uint taken = first < avail ? avail - first : 0;
+  taken = taken < n ? taken : n;
+  vector<uint, n> lane = lanes<n>();
+  vector<uint, n> addr = scratch;
+  addr.merge(header_dwords + first + lane, lane < taken);
+  cm_slm_read(slm, addr, items);
+  return taken;
+}
+
+} // namespace work_queue
+} // namespace cmtl
+
+#endif // CM_CMTL_WORK_QUEUE_H
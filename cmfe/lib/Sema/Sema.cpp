@@ -40,6 +40,7 @@
 #include "clang/Sema/TemplateInstCallback.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallSet.h"
+#include "llvm/Support/Timer.h"
 using namespace clang;
 using namespace sema;
 
@@ -426,6 +427,8 @@ void Sema::PrintStats() const {
   llvm::errs() << "\n*** Semantic Analysis Stats:\n";
   llvm::errs() << NumSFINAEErrors << " SFINAE diagnostics trapped.\n";
 
+  PrintCMRegionCheckStats();
+
   BumpAlloc.PrintStats();
   AnalysisWarnings.PrintStats();
 }
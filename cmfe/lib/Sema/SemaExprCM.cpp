@@ -34,9 +34,100 @@
 #include "clang/AST/ExprCM.h"
 #include "clang/AST/ExprCXX.h"
 #include "llvm/ADT/SmallBitVector.h"
+#include "llvm/Support/Timer.h"
 using namespace clang;
 using namespace sema;
 
+namespace {
+
+// Kinds of memoised CM region checks, the first element of every key.
+enum CMRegionCheckKind : uint64_t {
+  CMRC_Select,
+  CMRC_Replicate,
+  CMRC_Format
+};
+
+// Key element standing for a region parameter that is not a constant.
+const uint64_t CMRegionNonConst = ~0ULL;
+
+// Times and counts a CM region check. Nested checks are attributed to the
+// outermost one.
+class CMRegionCheckScope {
+  Sema &S;
+
+public:
+  explicit CMRegionCheckScope(Sema &S) : S(S) {
+    ++S.NumCMRegionChecks;
+    if (S.CMRegionCheckDepth++ == 0 && S.CMRegionCheckTimer)
+      S.CMRegionCheckTimer->startTimer();
+  }
+  ~CMRegionCheckScope() {
+    if (--S.CMRegionCheckDepth == 0 && S.CMRegionCheckTimer)
+      S.CMRegionCheckTimer->stopTimer();
+  }
+};
+
+} // namespace
+
+static uint64_t getCMRegionTypeKey(QualType T) {
+  return reinterpret_cast<uintptr_t>(T.getCanonicalType().getAsOpaquePtr());
+}
+
+// Reads the value of an integer literal, possibly behind parentheses or a
+// substituted non-type template parameter. These are by far the most common
+// region parameters and need no trip through the constant evaluator.
+static bool getCMRegionLiteral(Expr *E, ASTContext &Ctx, llvm::APSInt &Val) {
+  Expr *Inner = E->IgnoreParens();
+  if (auto *Subst = dyn_cast<SubstNonTypeTemplateParmExpr>(Inner))
+    Inner = Subst->getReplacement()->IgnoreParens();
+  auto *Lit = dyn_cast<IntegerLiteral>(Inner);
+  if (!Lit || !Ctx.hasSameType(Lit->getType(), E->getType()))
+    return false;
+  Val = llvm::APSInt(Lit->getValue(),
+                     Lit->getType()->isUnsignedIntegerOrEnumerationType());
+  return true;
+}
+
+// Same as Expr::isIntegerConstantExpr with a shortcut for literals.
+static bool isCMRegionConstant(Sema &S, Expr *E, llvm::APSInt &Val,
+                               SourceLocation *Loc = nullptr) {
+  ++S.NumCMRegionParamEvals;
+  if (getCMRegionLiteral(E, S.Context, Val))
+    return true;
+  return E->isIntegerConstantExpr(Val, S.Context, Loc);
+}
+
+QualType Sema::LookupCMRegionCheck(ArrayRef<uint64_t> Key) {
+  llvm::FoldingSetNodeID ID;
+  CMRegionCheck::Profile(ID, Key);
+  void *InsertPos = nullptr;
+  CMRegionCheck *Check = CMRegionChecks.FindNodeOrInsertPos(ID, InsertPos);
+  if (!Check)
+    return QualType();
+  ++NumCMRegionCheckHits;
+  return Check->getResult();
+}
+
+void Sema::RecordCMRegionCheck(ArrayRef<uint64_t> Key, QualType Result) {
+  llvm::FoldingSetNodeID ID;
+  CMRegionCheck::Profile(ID, Key);
+  void *InsertPos = nullptr;
+  if (CMRegionChecks.FindNodeOrInsertPos(ID, InsertPos))
+    return;
+  CMRegionCheck *Check =
+      new (BumpAlloc) CMRegionCheck(Key.copy(BumpAlloc), Result);
+  CMRegionChecks.InsertNode(Check, InsertPos);
+}
+
+void Sema::PrintCMRegionCheckStats() const {
+  if (!NumCMRegionChecks)
+    return;
+  llvm::errs() << NumCMRegionChecks << " CM region checks, "
+               << NumCMRegionCheckHits << " answered from "
+               << CMRegionChecks.size() << " memoised regions, "
+               << NumCMRegionParamEvals << " region parameters evaluated.\n";
+}
+
 // \brief Semantic actions for CM vector/matrix all() member function
 ExprResult Sema::ActOnCMAll(SourceLocation AllLoc, Expr *Base,
                             SourceLocation RParenLoc) {
@@ -203,6 +294,21 @@ ExprResult Sema::BuildCMFormat(Expr *Base, SourceLocation FormatLoc,
     return ExprError();
   }
 
+  CMRegionCheckScope CheckScope(*this);
+
+  // The vector form depends on nothing but the two types, so it is checked
+  // only once per pair.
+  SmallVector<uint64_t, 3> Key;
+  if (Args.size() == 0 && !ElementType.isNull()) {
+    Key = {CMRC_Format, getCMRegionTypeKey(BaseTy),
+           getCMRegionTypeKey(ElementType)};
+    QualType CheckedTy = LookupCMRegionCheck(Key);
+    if (!CheckedTy.isNull())
+      return new (Context) CMFormatExpr(Context, Base, FormatLoc, ElementType,
+                                        Args, RPLoc, CheckedTy,
+                                        Base->getValueKind());
+  }
+
   // Check the element type.
   if (ElementType.isNull() ||
       !ElementType->isCMElementType(/*AllowNonArithmetic*/ false)) {
@@ -232,13 +338,14 @@ ExprResult Sema::BuildCMFormat(Expr *Base, SourceLocation FormatLoc,
     unsigned NumElts = BaseTySize / EltTySize;
     FormatType = Context.getCMVectorType(true, ElementType, NumElts, FormatLoc,
                                          FormatLoc, FormatLoc);
+    RecordCMRegionCheck(Key, FormatType);
   } else {
     assert(NumArgs == 2 && "invalid number of arguments");
 
     llvm::APSInt ConstVal;
     SourceLocation Loc;
     // Determine the number of rows
-    if (!Args[0]->isIntegerConstantExpr(ConstVal, Context, &Loc)) {
+    if (!isCMRegionConstant(*this, Args[0], ConstVal, &Loc)) {
       Diag(Loc, diag::err_cm_format_non_const_value) << 0;
       return ExprError();
     }
@@ -254,7 +361,7 @@ ExprResult Sema::BuildCMFormat(Expr *Base, SourceLocation FormatLoc,
       return ExprError();
 
     // Determine the number of columns
-    if (!Args[1]->isIntegerConstantExpr(ConstVal, Context, &Loc)) {
+    if (!isCMRegionConstant(*this, Args[1], ConstVal, &Loc)) {
       Diag(Loc, diag::err_cm_format_non_const_value) << 1;
       return ExprError();
     }
@@ -347,6 +454,8 @@ ExprResult Sema::ActOnCMISelect(SourceLocation ISelectLoc, Expr *Base,
                      RPLoc, Context.DependentTy, VK_RValue);
   }
 
+  CMRegionCheckScope CheckScope(*this);
+
   // Check the number of arguments.
   bool IsVector = Base->getType()->isCMVectorType();
   // no arguments case has already been caught during Parse
@@ -477,6 +586,8 @@ ExprResult Sema::BuildCMMerge(Expr *Base, SourceLocation MergeLoc,
   if (!CheckCMArithmeticType(Base->getExprLoc(), BaseTy))
     return ExprError();
 
+  CMRegionCheckScope CheckScope(*this);
+
   for (unsigned I = 0, N = Args.size(); I < N; ++I) {
     Expr *Arg = Args[I];
     QualType ArgTy = Arg->getType();
@@ -752,6 +863,8 @@ ExprResult Sema::ActOnCMReplicate(SourceLocation ReplicateLoc, Expr *Base,
         ReplicateArgs.size(), RParenLoc, ExprTy, VK_RValue);
   }
 
+  CMRegionCheckScope CheckScope(*this);
+
   unsigned NumArgs = ReplicateArgs.size();
   unsigned NumOffsets = Offsets.size();
 
@@ -849,8 +962,33 @@ ExprResult Sema::ActOnCMReplicate(SourceLocation ReplicateLoc, Expr *Base,
     }
   }
 
+  // Get any constant offsets that may contribute to the maximum element index.
+  // A non-constant offset is checked as if it were zero.
+  int64_t OffsetVals[2] = {0, 0};
+  if (WidthArg) {
+    for (unsigned I = 0, N = std::min<unsigned>(NumOffsets, 2); I < N; ++I) {
+      Expr::EvalResult OffsetValueResult;
+      if (!Offsets[I]->isValueDependent() &&
+          Offsets[I]->EvaluateAsInt(OffsetValueResult, Context))
+        OffsetVals[I] = OffsetValueResult.Val.getInt().getSExtValue();
+    }
+  }
+
+  // Replicates of the same type with the same arguments and offsets are
+  // checked only once.
+  SmallVector<uint64_t, 9> Key = {
+      CMRC_Replicate, getCMRegionTypeKey(BaseTy), NumArgs,
+      uint64_t(Vals[0]), uint64_t(Vals[1]), uint64_t(Vals[2]),
+      uint64_t(Vals[3]), uint64_t(OffsetVals[0]), uint64_t(OffsetVals[1])};
+  QualType CheckedTy = LookupCMRegionCheck(Key);
+  if (!CheckedTy.isNull())
+    return new (Context) CMSelectExpr(
+        Context, CMSelectExpr::SK_replicate, Base, ReplicateLoc, ArgExprs,
+        ReplicateArgs.size(), RParenLoc, CheckedTy, VK_RValue);
+
   // Check for the most likely out-of-bounds conditions that are detectable at
   // compile time.
+  bool Clean = true;
   if (WidthArg) {
     unsigned NumElts = BaseTy->getCMVectorMatrixSize();
     unsigned VS = 0;
@@ -860,13 +998,9 @@ ExprResult Sema::ActOnCMReplicate(SourceLocation ReplicateLoc, Expr *Base,
     if (const CMMatrixType *M = BaseTy->getAs<CMMatrixType>())
       RowSize = M->getNumColumns();
     bool BaseTypeIsMatrix = BaseTy->isCMMatrixType();
-    // Get any constant offsets that may contribute to the maximum element index
-    int64_t I = 0;
-    int64_t J = 0;
+    int64_t I = OffsetVals[0];
+    int64_t J = OffsetVals[1];
     if (NumOffsets >= 1) {
-      Expr::EvalResult OffsetValueResult;
-      if (Offsets[0]->EvaluateAsInt(OffsetValueResult, Context))
-        I = OffsetValueResult.Val.getInt().getSExtValue();
       if (I < 0) {
         Diag(Offsets[0]->getExprLoc(), diag::err_cm_replicate_offset_negative)
           << (int)I;
@@ -875,9 +1009,6 @@ ExprResult Sema::ActOnCMReplicate(SourceLocation ReplicateLoc, Expr *Base,
       ElmtOffset = I;
     }
     if (NumOffsets == 2) {
-      Expr::EvalResult OffsetValueResult;
-      if (Offsets[1]->EvaluateAsInt(OffsetValueResult, Context))
-        J = OffsetValueResult.Val.getInt().getSExtValue();
       if (J < 0) {
         Diag(Offsets[1]->getExprLoc(), diag::err_cm_replicate_offset_negative)
           << (int)J;
@@ -904,6 +1035,7 @@ ExprResult Sema::ActOnCMReplicate(SourceLocation ReplicateLoc, Expr *Base,
         OffsetRange[0] = Offsets[0]->getSourceRange();
       if (J > 0)
         OffsetRange[1] = Offsets[0]->getSourceRange();
+      Clean = false;
       Diag(ReplicateLoc, diag::warn_cm_replicate_out_of_bounds)
           << BaseTypeIsMatrix
           << ReplicateArgs[0]->getSourceRange()
@@ -938,6 +1070,8 @@ ExprResult Sema::ActOnCMReplicate(SourceLocation ReplicateLoc, Expr *Base,
     ExprTy = Context.getCMVectorType(false, EltTy, Vals[0] * Vals[2],
                                      ReplicateLoc, ReplicateLoc, ReplicateLoc);
   }
+  if (Clean)
+    RecordCMRegionCheck(Key, ExprTy);
 
   return new (Context) CMSelectExpr(
       Context, CMSelectExpr::SK_replicate, Base, ReplicateLoc, ArgExprs,
@@ -1052,6 +1186,8 @@ ExprResult Sema::ActOnCMSelect(SourceLocation SelectLoc, Expr *Base,
         ConstArgs.size(), RParenLoc, ExprTy, VK_LValue);
   }
 
+  CMRegionCheckScope CheckScope(*this);
+
   // Check the base type.
   bool IsMatrix = BaseTy->isCMMatrixType();
   if (!CheckCMArithmeticType(SelectLoc, BaseTy))
@@ -1076,7 +1212,35 @@ ExprResult Sema::ActOnCMSelect(SourceLocation SelectLoc, Expr *Base,
     return ExprError();
   }
 
-  // Check the constant arguments.
+  // Regions over the same type with the same literal parameters and constant
+  // offsets are checked only once.
+  SmallVector<uint64_t, 10> Key = {CMRC_Select, getCMRegionTypeKey(BaseTy),
+                                   Args.size()};
+  for (Expr *E : ConstArgs) {
+    llvm::APSInt Val;
+    if (!getCMRegionLiteral(E, Context, Val)) {
+      Key.clear();
+      break;
+    }
+    Key.push_back(Val.getSExtValue());
+  }
+  llvm::APSInt OffsetVals[2];
+  bool IsConstOffset[2] = {false, false};
+  for (unsigned I = 0, N = std::min<unsigned>(Args.size(), 2); I < N; ++I) {
+    IsConstOffset[I] = !Args[I]->isValueDependent() &&
+                       Args[I]->getType()->isIntegralOrEnumerationType() &&
+                       isCMRegionConstant(*this, Args[I], OffsetVals[I]);
+    if (!Key.empty())
+      Key.push_back(IsConstOffset[I] ? OffsetVals[I].getSExtValue()
+                                     : CMRegionNonConst);
+  }
+  QualType CheckedTy;
+  if (!Key.empty())
+    CheckedTy = LookupCMRegionCheck(Key);
+
+  // Check the constant arguments. A memoised region has literal constant
+  // arguments that passed these checks before, so they are neither evaluated
+  // nor checked again; only their type is unified.
   unsigned Size = 0; // VSize for matrix case.
   unsigned Stride = 0; // VStride for matrix case
   unsigned HSize = 0;
@@ -1085,7 +1249,8 @@ ExprResult Sema::ActOnCMSelect(SourceLocation SelectLoc, Expr *Base,
   for (unsigned I = 0, N = ConstArgs.size(); I < N; ++I) {
     llvm::APSInt ConstVal;
     SourceLocation Loc;
-    if (!ConstArgs[I]->isIntegerConstantExpr(ConstVal, Context, &Loc)) {
+    if (CheckedTy.isNull() &&
+        !isCMRegionConstant(*this, ConstArgs[I], ConstVal, &Loc)) {
       Diag(Loc, diag::err_cm_select_non_const_value) << I;
       return ExprError();
     }
@@ -1098,6 +1263,9 @@ ExprResult Sema::ActOnCMSelect(SourceLocation SelectLoc, Expr *Base,
     else
       return ExprError();
 
+    if (!CheckedTy.isNull())
+      continue;
+
     // Check static constraints.
     if (I == 0) {
       // size or v_size
@@ -1176,7 +1344,14 @@ ExprResult Sema::ActOnCMSelect(SourceLocation SelectLoc, Expr *Base,
     return ExprError();
   }
 
+  if (!CheckedTy.isNull())
+    return new (Context)
+        CMSelectExpr(Context, CMSelectExpr::SK_select, Base, SelectLoc,
+                     ArgExprs, ConstArgs.size(), RParenLoc, CheckedTy,
+                     VK_LValue);
+
   // Out-of-bound checks.
+  bool Clean = true;
   if (IsMatrix) {
     assert(Size > 0 && Stride > 0 && HSize > 0 && HStride > 0);
     const CMMatrixType *MT = BaseTy->castAs<CMMatrixType>();
@@ -1185,10 +1360,9 @@ ExprResult Sema::ActOnCMSelect(SourceLocation SelectLoc, Expr *Base,
 
     unsigned VOffset = 0;
     int VOffsetSigned = 0;
-    llvm::APSInt Val;
-    if (Args.size() >= 1 && Args[0]->isIntegerConstantExpr(Val, Context)) {
-      VOffset = Val.getZExtValue();
-      VOffsetSigned = Val.getSExtValue();
+    if (IsConstOffset[0]) {
+      VOffset = OffsetVals[0].getZExtValue();
+      VOffsetSigned = OffsetVals[0].getSExtValue();
     }
 
     // negative VOffset
@@ -1200,12 +1374,14 @@ ExprResult Sema::ActOnCMSelect(SourceLocation SelectLoc, Expr *Base,
 
     // degenerate case of VOffset >= NRows
     if (VOffset >= NRows) {
+      Clean = false;
       Diag(SelectLoc, diag::warn_cm_select_out_of_bounds_offset)
           << 1 << VOffset << (NRows - 1)
           << Args[0]->getSourceRange();
     }
 
     if ((Size - 1) * Stride + VOffset >= NRows) {
+      Clean = false;
       // highlight VOffset if it is non-zero as it contributes to the out of
       // bounds value
       if (VOffset)
@@ -1221,9 +1397,9 @@ ExprResult Sema::ActOnCMSelect(SourceLocation SelectLoc, Expr *Base,
 
     unsigned HOffset = 0;
     int HOffsetSigned = 0;
-    if (Args.size() >= 2 && Args[1]->isIntegerConstantExpr(Val, Context)) {
-      HOffset = Val.getZExtValue();
-      HOffsetSigned = Val.getSExtValue();
+    if (IsConstOffset[1]) {
+      HOffset = OffsetVals[1].getZExtValue();
+      HOffsetSigned = OffsetVals[1].getSExtValue();
     }
 
     // negative HOffset
@@ -1235,12 +1411,14 @@ ExprResult Sema::ActOnCMSelect(SourceLocation SelectLoc, Expr *Base,
 
     // degenerate case of HOffset >= NCols
     if (HOffset >= NCols) {
+      Clean = false;
       Diag(SelectLoc, diag::warn_cm_select_out_of_bounds_offset)
           << 2 << HOffset << (NCols - 1)
           << Args[1]->getSourceRange();
     }
 
     if ((HSize - 1) * HStride + HOffset >= NCols) {
+      Clean = false;
       // highlight HOffset if it is non-zero as it contributes to the out of
       // bounds value
       if (HOffset)
@@ -1260,10 +1438,9 @@ ExprResult Sema::ActOnCMSelect(SourceLocation SelectLoc, Expr *Base,
 
     unsigned Offset = 0;
     int OffsetSigned = 0;
-    llvm::APSInt Val;
-    if (Args.size() >= 1 && Args[0]->isIntegerConstantExpr(Val, Context)) {
-      Offset = Val.getZExtValue();
-      OffsetSigned = Val.getSExtValue();
+    if (IsConstOffset[0]) {
+      Offset = OffsetVals[0].getZExtValue();
+      OffsetSigned = OffsetVals[0].getSExtValue();
     }
 
     // negative Offset
@@ -1275,12 +1452,14 @@ ExprResult Sema::ActOnCMSelect(SourceLocation SelectLoc, Expr *Base,
 
     // degenerate case of offset >= NumElts
     if (Offset >= NumElts) {
+      Clean = false;
       Diag(SelectLoc, diag::warn_cm_select_out_of_bounds_offset)
           << 0 << Offset << (NumElts - 1)
           << Args[0]->getSourceRange();
     }
 
     if ((Size - 1) * Stride + Offset >= NumElts) {
+      Clean = false;
       // highlight the offset if it is non-zero as it contributes to the out of
       // bounds value
       if (Offset)
@@ -1302,6 +1481,8 @@ ExprResult Sema::ActOnCMSelect(SourceLocation SelectLoc, Expr *Base,
           : Context.getCMVectorType(
                 /*IsReference*/ true, BaseTy->getCMVectorMatrixElementType(),
                 Size, SelectLoc, SelectLoc, SelectLoc);
+  if (Clean && !Key.empty())
+    RecordCMRegionCheck(Key, ExprTy);
 
   return new (Context)
       CMSelectExpr(Context, CMSelectExpr::SK_select, Base, SelectLoc, ArgExprs,
@@ -0,0 +1,117 @@
+#include <cm/cm.h>
+#include <cm/cmtl.h>
+
+// The twiddle table is computed at compile time; check it against known
+// values before instantiating the transforms.
+static_assert(cmtl::fft::fft_detail::quarter_wave_v<8>.v[0] == 0.0f, "");
+static_assert(cmtl::fft::fft_detail::quarter_wave_v<8>.v[1] ==
+                  0.707106781186547524f, "");
+static_assert(cmtl::fft::fft_detail::quarter_wave_v<8>.v[2] == 1.0f, "");
+static_assert(cmtl::fft::fft_detail::quarter_wave_v<32>.v[1] ==
+                  0.195090322016128268f, "");
+
+#define SIMD 8
+
+_GENX_MAIN_ void fft_grf(SurfaceIndex buf)
+{
+  matrix<float, 16, SIMD> re;
+  matrix<float, 16, SIMD> im;
+  read(buf, 0, 0, re);
+  read(buf, 0, 16, im);
+  cmtl::fft::fft<float, SIMD, 16>(re, im);
+  cmtl::fft::ifft<float, SIMD, 16>(re, im);
+  write(buf, 0, 0, re);
+  write(buf, 0, 16, im);
+
+  matrix<half, 32, SIMD> hre;
+  matrix<half, 32, SIMD> him = 0;
+  hre.select<16, 1, SIMD, 1>(0, 0) = re;
+  hre.select<16, 1, SIMD, 1>(16, 0) = im;
+  cmtl::fft::fft<half, SIMD, 32>(hre, him);
+  matrix<float, 8, SIMD> out = hre.select<8, 4, SIMD, 1>(0, 0) +
+                               him.select<8, 4, SIMD, 1>(0, 0);
+  write(buf, 0, 32, out);
+}
+
+_GENX_MAIN_ void fft_slm(SurfaceIndex buf)
+{
+  constexpr int N = 256;
+  cm_slm_init(3 * 2 * N * sizeof(float));
+  uint data = cm_slm_alloc(2 * N * sizeof(float));
+  uint scratch = cm_slm_alloc(2 * N * sizeof(float));
+  uint twiddles = cm_slm_alloc(2 * N * sizeof(float));
+
+  uint thread = cm_linear_local_id();
+  uint threads = cm_linear_local_size();
+  cmtl::fft::init_twiddles<float, N>(twiddles, thread, threads);
+  cm_slm_load(data, buf, 0, 2 * N * sizeof(float));
+  cm_barrier();
+
+  uint result = cmtl::fft::fft_slm<float, 16, N>(data, scratch, twiddles,
+                                                  thread, threads);
+  vector<float, 16> v;
+  cm_slm_block_read(result, thread * 16 * sizeof(float), v);
+  write(buf, thread * 16 * sizeof(float), v);
+}
+
+// Transforms with known results, one per column: an impulse, whose transform
+// is all ones; an alternating sequence, whose transform is N at point N / 2;
+// a constant, whose transform is N at point 0; and a complex ramp, which a
+// forward and an inverse transform scale by N. The other columns are zero.
+// The input is constant, so the transforms and the comparison with the
+// expected values fold away, and the kernel writes the mismatch flag as an
+// immediate, which is checked in the vISA.
+
+_GENX_MAIN_ void fft_known(SurfaceIndex buf)
+{
+  constexpr int N = 16;
+  matrix<float, N, SIMD> re = 0.0f, im = 0.0f;
+  matrix<float, N, SIMD> ere = 0.0f, eim = 0.0f;
+#pragma unroll
+  for (int i = 0; i < N; ++i) {
+    re(i, 1) = i % 2 ? -1.0f : 1.0f;
+    re(i, 2) = 1.0f;
+    re(i, 3) = i;
+    im(i, 3) = N - i;
+    ere(i, 0) = 1.0f;
+  }
+  re(0, 0) = 1.0f;
+  ere(N / 2, 1) = N;
+  ere(0, 2) = N;
+
+  matrix<float, N, SIMD> fre = re, fim = im;
+  cmtl::fft::fft<float, SIMD, N>(fre, fim);
+  matrix<float, N, SIMD> rre = fre, rim = fim;
+  cmtl::fft::ifft<float, SIMD, N>(rre, rim);
+
+  // The ramp is only checked after the round trip.
+  ere.column(3) = fre.column(3);
+  eim.column(3) = fim.column(3);
+
+  const float tol = 0.01f;
+  matrix<float, N, SIMD> d0 = fre - ere;
+  matrix<float, N, SIMD> d1 = fim - eim;
+  matrix<float, N, SIMD> d2 = rre - N * re;
+  matrix<float, N, SIMD> d3 = rim - N * im;
+  matrix<ushort, N, SIMD> bad = (d0 > tol) | (d0 < -tol) | (d1 > tol) |
+                                (d1 < -tol) | (d2 > tol) | (d2 < -tol) |
+                                (d3 > tol) | (d3 < -tol);
+  vector<int, SIMD> out = bad.any();
+  write(buf, 0, out);
+}
+
+// output a warning just to have some output from the compiler to check
+#warning fft.cpp
+
+// RUN: %cmc -mCM_old_asm_name -mdump_asm -Qxcm_jit_target=SKL %w -Wno-pass-failed 2>&1 | FileCheck --implicit-check-not error %w
+// RUN: FileCheck -input-file=%W_2.visaasm -check-prefix=KNOWN %w
+// RUN: rm %W.isa %W_0.visaasm %W_0.asm %W_0.dat %W_1.visaasm %W_1.asm %W_1.dat %W_2.visaasm %W_2.asm %W_2.dat
+// CHECK: warning: fft.cpp
+// CHECK: 1 warning generated
+//
+// No mismatch, and nothing left to compare at run time.
+//
+// KNOWN-NOT: cmp
+// KNOWN: mov (M1, 8) V{{[0-9]+}}(0,0)<1> 0x0:{{u?d}}
+// KNOWN-NOT: cmp
+// KNOWN: oword_st
@@ -0,0 +1,127 @@
+#include <cm/cm.h>
+#include <cm/cmtl.h>
+
+const float gauss5[] = {0.0625f, 0.25f, 0.375f, 0.25f, 0.0625f};
+const float sharpen3x3[] = {0.0f, -1.0f, 0.0f, -1.0f, 5.0f, -1.0f, 0.0f, -1.0f, 0.0f};
+
+_GENX_MAIN_ void filters(SurfaceIndex src, SurfaceIndex dst)
+{
+  int x = cm_group_id(0) * 16;
+  int y = cm_group_id(1) * 8;
+
+  vector<float, 5> g(gauss5);
+  cmtl::filter::convolve_separable<uchar, uchar, 5, 5, 8, 16>(src, dst, x, y,
+                                                              g, g);
+  matrix<float, 3, 3> k(sharpen3x3);
+  cmtl::filter::convolve<uchar, uchar, 3, 3, 8, 16>(src, dst, x, y, k);
+  cmtl::filter::box_filter<uchar, uchar, 3, 8, 16>(src, dst, x, y);
+  cmtl::filter::box_filter<float, float, 2, 6, 8>(src, dst, x, y);
+}
+
+_GENX_MAIN_ void integral(SurfaceIndex src, SurfaceIndex dst)
+{
+  int x = cm_group_id(0) * 16;
+  int y = cm_group_id(1) * 16;
+  cm_wait();
+  cmtl::filter::integral_image<uchar, uint, 16, 16>(src, dst, x, y);
+  cm_fence();
+  cm_signal();
+}
+
+// The register forms of the filters on a constant tile, against scalar
+// references. The kernels are 3 x 3 and 3 x 5, so swapping the kernel
+// height and width gives the wrong answer. The tile is constant, so the
+// filters and the comparison fold away, and the kernel writes the mismatch
+// flag as an immediate, which is checked in the vISA.
+
+const float blur3[] = {0.25f, 0.5f, 0.25f};
+
+_GENX_MAIN_ void filter_known(SurfaceIndex buf)
+{
+  constexpr int TH = 4;
+  constexpr int TW = 8;
+  matrix<float, TH + 2, TW + 4> in;
+#pragma unroll
+  for (int i = 0; i < TH + 2; ++i)
+#pragma unroll
+    for (int j = 0; j < TW + 4; ++j)
+      in(i, j) = (i * 7 + j * 3) % 11;
+
+  matrix<float, 3, 3> k(sharpen3x3);
+  vector<float, 3> vk(blur3);
+  vector<float, 5> hk(gauss5);
+  vector<float, TW> top;
+  vector<float, TH> left;
+#pragma unroll
+  for (int j = 0; j < TW; ++j)
+    top(j) = j + 1;
+#pragma unroll
+  for (int i = 0; i < TH; ++i)
+    left(i) = 2 * i + 1;
+  const float corner = 1.0f;
+
+  matrix<float, TH, TW> conv = cmtl::filter::convolve_tile<3, 3, TH, TW>(
+      in.select<TH + 2, 1, TW + 2, 1>(0, 0), k);
+  matrix<float, TH, TW> sep =
+      cmtl::filter::convolve_separable_tile<3, 5, TH, TW>(in, hk, vk);
+  matrix<float, TH, TW> box = cmtl::filter::box_sum_tile<3, 5, TH, TW>(in);
+  matrix<float, TH, TW> integ = in.select<TH, 1, TW, 1>(0, 0);
+  cmtl::filter::integral_tile<float, TH, TW>(integ, top, left, corner);
+
+  matrix<float, TH, TW> rconv = 0.0f, rsep = 0.0f, rbox = 0.0f, rint;
+#pragma unroll
+  for (int i = 0; i < TH; ++i) {
+#pragma unroll
+    for (int j = 0; j < TW; ++j) {
+#pragma unroll
+      for (int a = 0; a < 3; ++a) {
+#pragma unroll
+        for (int b = 0; b < 5; ++b) {
+          if (b < 3)
+            rconv(i, j) += k(a, b) * in(i + a, j + b);
+          rsep(i, j) += vk(a) * hk(b) * in(i + a, j + b);
+          rbox(i, j) += in(i + a, j + b);
+        }
+      }
+      // Sum of in over the rectangle up to (i, j), built from its
+      // neighbours.
+      rint(i, j) = in(i, j);
+      if (i > 0)
+        rint(i, j) += rint(i - 1, j);
+      if (j > 0)
+        rint(i, j) += rint(i, j - 1);
+      if (i > 0 && j > 0)
+        rint(i, j) -= rint(i - 1, j - 1);
+    }
+  }
+#pragma unroll
+  for (int i = 0; i < TH; ++i)
+    rint.row(i) += top + left(i) - corner;
+
+  const float tol = 0.001f;
+  matrix<float, TH, TW> d0 = conv - rconv;
+  matrix<float, TH, TW> d1 = sep - rsep;
+  matrix<float, TH, TW> d2 = box - rbox;
+  matrix<float, TH, TW> d3 = integ - rint;
+  matrix<ushort, TH, TW> bad = (d0 > tol) | (d0 < -tol) | (d1 > tol) |
+                               (d1 < -tol) | (d2 > tol) | (d2 < -tol) |
+                               (d3 > tol) | (d3 < -tol);
+  vector<int, 8> out = bad.any();
+  write(buf, 0, out);
+}
+
+// output a warning just to have some output from the compiler to check
+#warning filter.cpp
+
+// RUN: %cmc -mCM_old_asm_name -mdump_asm -Qxcm_jit_target=SKL %w -Wno-pass-failed 2>&1 | FileCheck --implicit-check-not error %w
+// RUN: FileCheck -input-file=%W_2.visaasm -check-prefix=KNOWN %w
+// RUN: rm %W.isa %W_0.visaasm %W_0.asm %W_0.dat %W_1.visaasm %W_1.asm %W_1.dat %W_2.visaasm %W_2.asm %W_2.dat
+// CHECK: warning: filter.cpp
+// CHECK: 1 warning generated
+//
+// No mismatch, and nothing left to compare at run time.
+//
+// KNOWN-NOT: cmp
+// KNOWN: mov (M1, 8) V{{[0-9]+}}(0,0)<1> 0x0:{{u?d}}
+// KNOWN-NOT: cmp
+// KNOWN: oword_st
@@ -0,0 +1,157 @@
+#include <cm/cm.h>
+#include <cm/cmtl.h>
+
+// Instantiate every sparse routine for the common configurations to make sure
+// the templates compile down to valid vISA.
+
+#define ROWS 8
+
+_GENX_MAIN_ void spmv(SurfaceIndex values, SurfaceIndex columns,
+                      SurfaceIndex ptr, SurfaceIndex x, SurfaceIndex y,
+                      uint width, uint ld, uint nrows)
+{
+  uint row0 = cm_linear_global_id() * ROWS;
+  cmtl::sparse::spmv_csr<float, 16, ROWS>(values, columns, ptr, x, y, row0,
+                                          nrows);
+  cmtl::sparse::spmv_csr<int, 8, 1>(values, columns, ptr, x, y, row0, nrows);
+  cmtl::sparse::spmv_ell<float, 8, ROWS>(values, columns, x, y, width, ld,
+                                         row0, nrows);
+  cmtl::sparse::spmv_sell<float, 8, 16>(values, columns, ptr, x, y, row0,
+                                        nrows);
+}
+
+_GENX_MAIN_ void spmm(SurfaceIndex values, SurfaceIndex columns,
+                      SurfaceIndex ptr, SurfaceIndex x, SurfaceIndex y,
+                      uint width, uint ld, uint nrows)
+{
+  uint row0 = cm_linear_global_id() * ROWS;
+  cmtl::sparse::spmm_csr<float, 16, ROWS, 12>(values, columns, ptr, x, y, row0,
+                                              nrows);
+  cmtl::sparse::spmm_ell<float, 8, ROWS, 16>(values, columns, x, y, width, ld,
+                                             row0, nrows);
+  cmtl::sparse::spmm_sell<float, 8, ROWS, 40>(values, columns, ptr, x, y,
+                                              row0, nrows);
+}
+
+// Self checks: each thread computes its rows with a cmtl routine, then
+// recomputes them one nonzero at a time and writes the number of rows that
+// differ to errors[thread]. Integer matrices make the comparison exact, so a
+// host running these kernels on any matrix in the documented format expects
+// errors to be all zero. The CSR rows of any length exercise the masked tail
+// of the last step.
+
+template<typename T>
+CM_INLINE T load(SurfaceIndex buf, uint i)
+{
+  vector<uint, 8> idx = i;
+  vector<T, 8> v;
+  read(buf, 0, idx, v);
+  return v(0);
+}
+
+CM_INLINE void report(SurfaceIndex errors, uint thread, uint bad)
+{
+  vector<uint, 4> out = bad;
+  write(errors, thread * 16, out);
+}
+
+_GENX_MAIN_ void spmv_csr_check(SurfaceIndex values, SurfaceIndex columns,
+                                SurfaceIndex ptr, SurfaceIndex x,
+                                SurfaceIndex y, SurfaceIndex errors,
+                                uint nrows)
+{
+  uint thread = cm_linear_global_id();
+  uint row0 = thread * ROWS;
+  cmtl::sparse::spmv_csr<int, 16, ROWS>(values, columns, ptr, x, y, row0,
+                                        nrows);
+  cm_fence();
+  uint bad = 0;
+  for (uint row = row0; row < row0 + ROWS && row < nrows; ++row) {
+    int ref = 0;
+    for (uint k = load<uint>(ptr, row); k < load<uint>(ptr, row + 1); ++k)
+      ref += load<int>(values, k) * load<int>(x, load<uint>(columns, k));
+    bad += load<int>(y, row) != ref;
+  }
+  report(errors, thread, bad);
+}
+
+_GENX_MAIN_ void spmv_ell_check(SurfaceIndex values, SurfaceIndex columns,
+                                SurfaceIndex x, SurfaceIndex y,
+                                SurfaceIndex errors, uint width, uint ld,
+                                uint nrows)
+{
+  uint thread = cm_linear_global_id();
+  uint row0 = thread * ROWS;
+  cmtl::sparse::spmv_ell<int, 8, ROWS>(values, columns, x, y, width, ld, row0,
+                                       nrows);
+  cm_fence();
+  uint bad = 0;
+  for (uint row = row0; row < row0 + ROWS && row < nrows; ++row) {
+    int ref = 0;
+    for (uint k = 0; k < width; ++k)
+      ref += load<int>(values, k * ld + row) *
+             load<int>(x, load<uint>(columns, k * ld + row));
+    bad += load<int>(y, row) != ref;
+  }
+  report(errors, thread, bad);
+}
+
+_GENX_MAIN_ void spmv_sell_check(SurfaceIndex values, SurfaceIndex columns,
+                                 SurfaceIndex ptr, SurfaceIndex x,
+                                 SurfaceIndex y, SurfaceIndex errors,
+                                 uint nrows)
+{
+  uint thread = cm_linear_global_id();
+  uint row0 = thread * 16;
+  cmtl::sparse::spmv_sell<int, 8, 16>(values, columns, ptr, x, y, row0,
+                                      nrows);
+  cm_fence();
+  uint bad = 0;
+  for (uint row = row0; row < row0 + 16 && row < nrows; ++row) {
+    uint begin = load<uint>(ptr, row / 8);
+    uint end = load<uint>(ptr, row / 8 + 1);
+    int ref = 0;
+    for (uint k = begin + row % 8; k < end; k += 8)
+      ref += load<int>(values, k) * load<int>(x, load<uint>(columns, k));
+    bad += load<int>(y, row) != ref;
+  }
+  report(errors, thread, bad);
+}
+
+_GENX_MAIN_ void spmm_csr_check(SurfaceIndex values, SurfaceIndex columns,
+                                SurfaceIndex ptr, SurfaceIndex x,
+                                SurfaceIndex y, SurfaceIndex errors,
+                                uint nrows)
+{
+  constexpr int N = 12;
+  uint thread = cm_linear_global_id();
+  uint row0 = thread * ROWS;
+  cmtl::sparse::spmm_csr<int, 16, ROWS, N>(values, columns, ptr, x, y, row0,
+                                           nrows);
+  cm_fence();
+  uint bad = 0;
+  for (uint row = row0; row < row0 + ROWS && row < nrows; ++row) {
+    vector<int, N> ref = 0;
+    for (uint k = load<uint>(ptr, row); k < load<uint>(ptr, row + 1); ++k) {
+      uint col = load<uint>(columns, k);
+      int a = load<int>(values, k);
+#pragma unroll
+      for (int c = 0; c < N; ++c)
+        ref(c) += a * load<int>(x, col * N + c);
+    }
+    bool differs = false;
+#pragma unroll
+    for (int c = 0; c < N; ++c)
+      differs |= load<int>(y, row * N + c) != ref(c);
+    bad += differs;
+  }
+  report(errors, thread, bad);
+}
+
+// output a warning just to have some output from the compiler to check
+#warning sparse.cpp
+
+// RUN: %cmc -mCM_old_asm_name %w -Wno-pass-failed 2>&1 | FileCheck --implicit-check-not error %w
+// RUN: rm %W.isa
+// CHECK: warning: sparse.cpp
+// CHECK: 1 warning generated
@@ -0,0 +1,77 @@
+#include <cm/cm.h>
+#include <cm/cmtl.h>
+
+// Check at compile time that every remapping is a bijection onto the grid,
+// including grids that are not a multiple of the tile shape, and use the
+// mappings in a kernel to make sure they compile down to valid vISA.
+
+namespace tmap = cmtl::thread_map;
+
+template <int w, int h, typename F>
+constexpr bool bijective(F f) {
+  bool seen[w * h] = {};
+  for (uint id = 0; id < w * h; id++) {
+    tmap::coord c = f(id, w, h);
+    if (c.x >= w || c.y >= h || seen[c.y * w + c.x])
+      return false;
+    seen[c.y * w + c.x] = true;
+  }
+  return true;
+}
+
+template <int w, int h>
+constexpr bool all_bijective() {
+  return bijective<w, h>(tmap::z_order<4, 4>) &&
+         bijective<w, h>(tmap::z_order<8, 2>) &&
+         bijective<w, h>(tmap::z_order<2, 8>) &&
+         bijective<w, h>(tmap::supertile<4, 4>) &&
+         bijective<w, h>(tmap::supertile<3, 5>) &&
+         bijective<w, h>(tmap::row_swizzle<4>) &&
+         bijective<w, h>(tmap::row_swizzle<3>);
+}
+
+static_assert(all_bijective<16, 16>(), "");
+static_assert(all_bijective<32, 8>(), "");
+static_assert(all_bijective<17, 13>(), "");
+static_assert(all_bijective<1, 30>(), "");
+static_assert(all_bijective<30, 1>(), "");
+
+constexpr bool morton_roundtrip() {
+  for (uint id = 0; id < 4096; id++) {
+    tmap::coord c = tmap::morton_decode(id);
+    if (tmap::morton_encode(c.x, c.y) != id)
+      return false;
+  }
+  return true;
+}
+
+static_assert(morton_roundtrip(), "");
+static_assert(tmap::morton_encode(3, 0) == 5, "");
+static_assert(tmap::z_order<4, 4>(5, 16, 16).x == 3, "");
+static_assert(tmap::z_order<4, 4>(16, 16, 16).x == 4, "");
+static_assert(tmap::row_swizzle<4>(5, 16, 16).x == 1, "");
+static_assert(tmap::row_swizzle<4>(5, 16, 16).y == 1, "");
+
+_GENX_MAIN_ void remap(SurfaceIndex out, uint groups_x, uint groups_y)
+{
+  uint id = cm_linear_group_id();
+  tmap::coord z = tmap::z_order<8, 8>(id, groups_x, groups_y);
+  tmap::coord s = tmap::supertile<4, 2>(id, groups_x, groups_y);
+  tmap::coord r = tmap::row_swizzle<8>(id, groups_x, groups_y);
+  vector<uint, 8> v = 0;
+  v(0) = z.x;
+  v(1) = z.y;
+  v(2) = s.x;
+  v(3) = s.y;
+  v(4) = r.x;
+  v(5) = r.y;
+  write(out, id * 32, v);
+}
+
+// output a warning just to have some output from the compiler to check
+#warning thread_map.cpp
+
+// RUN: %cmc -mCM_old_asm_name %w -Wno-pass-failed 2>&1 | FileCheck --implicit-check-not error %w
+// RUN: rm %W.isa
+// CHECK: warning: thread_map.cpp
+// CHECK: 1 warning generated
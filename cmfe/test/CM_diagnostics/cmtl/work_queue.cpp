@@ -0,0 +1,208 @@
+#include <cm/cm.h>
+#include <cm/cmtl.h>
+
+// Instantiate the group work queue and the SLM backed CachedStack to make sure
+// the templates compile down to valid vISA.
+
+#define CAPACITY 1024
+#define W 8
+#define CACHESIZE 32
+#define MAXSIZE 128
+#define THREADS 16
+
+namespace wq = cmtl::work_queue;
+
+_GENX_MAIN_ void queue(SurfaceIndex out)
+{
+  cm_slm_init(2 * wq::storage_size<CAPACITY>());
+  uint cur = cm_slm_alloc(wq::storage_size<CAPACITY>());
+  uint next = cm_slm_alloc(wq::storage_size<CAPACITY>());
+  wq::init(cur);
+  wq::init(next);
+
+  vector<uint, 16> seeds;
+  for (int i = 0; i < 16; i++)
+    seeds(i) = cm_linear_local_id() * 16 + i;
+  wq::push_n<CAPACITY>(cur, seeds, 16);
+  wq::sync();
+
+  uint visited = 0;
+  for (;;) {
+    uint item;
+    while (wq::pop<CAPACITY>(cur, item)) {
+      visited++;
+      if (item % 3 == 0)
+        wq::push<CAPACITY>(next, item / 3);
+    }
+    vector<uint, 16> batch;
+    uint taken = wq::pop_n<CAPACITY>(cur, batch.select_all());
+    wq::push_masked<CAPACITY>(next, batch, (batch & 1) == 0);
+    visited += taken;
+    wq::sync();
+    wq::init(cur);
+    if (wq::size<CAPACITY>(next) == 0)
+      break;
+    uint tmp = cur;
+    cur = next;
+    next = tmp;
+  }
+  write(out, cm_linear_global_id(), visited + wq::overflow<CAPACITY>(cur));
+}
+
+_GENX_MAIN_ void stack(SurfaceIndex out)
+{
+  // 16 threads with 3 spilled cache lines per channel is 48KB, within the
+  // 64KB of SLM a group can have.
+  constexpr uint size =
+      cmtl::CachedStackSLMSize<int, W, CACHESIZE, MAXSIZE, THREADS>();
+  static_assert(size <= 64 * 1024, "SLM is limited to 64KB per group");
+  cm_slm_init(size);
+  uint slm = cm_slm_alloc(size);
+
+  matrix<short, 2, W> context;
+  matrix<int, 2, W> context_ii;
+  matrix<int, W, CACHESIZE> cache;
+  vector<int, W> element = 0;
+  vector<short, W> mask = 1;
+  vector<short, W> empty;
+
+  cmtl::CachedStackSLMInit<int, W, CACHESIZE>(context, context_ii, MAXSIZE);
+  for (int i = 0; i < 100; i++) {
+    element += i;
+    cmtl::CachedStackPush<int, W, CACHESIZE>(slm, context, context_ii, cache,
+                                             element);
+  }
+  cmtl::CachedStackEmpty<W>(context, context_ii, empty);
+  while (empty.any() == false) {
+    cmtl::CachedStackPop<int, W, CACHESIZE>(slm, context, context_ii, cache,
+                                            element, mask);
+    cmtl::CachedStackEmpty<W>(context, context_ii, empty);
+  }
+  write(out, 0, element);
+}
+
+// Self checks, which write 0 to errors for each group (queue_check) or
+// thread (stack_check) that sees what a scalar model of the structure
+// predicts.
+//
+// queue_check: every thread pushes 16 items with push_n, one with push and
+// the 8 even lanes of 16 with push_masked, then the group drains the queue
+// with pop_n and pop. The count and sum of the popped items must match the
+// items pushed, recomputed by one thread for every thread of the group.
+
+_GENX_MAIN_ void queue_check(SurfaceIndex errors)
+{
+  cm_slm_init(wq::storage_size<CAPACITY>() + 32);
+  uint q = cm_slm_alloc(wq::storage_size<CAPACITY>());
+  uint totals = cm_slm_alloc(32);
+  uint id = cm_linear_local_id();
+  uint threads = cm_linear_local_size();
+  if (id == 0) {
+    vector<uint, 8> zero = 0;
+    cm_slm_block_write(totals, 0, zero);
+  }
+  wq::init(q);
+
+  vector<uint, 16> lane;
+  for (int i = 0; i < 16; i++)
+    lane(i) = i;
+  vector<uint, 16> items = id * 16 + lane;
+  wq::push_n<CAPACITY>(q, items, 16);
+  wq::push<CAPACITY>(q, 100000 + id);
+  items += 200000;
+  vector<ushort, 16> even = (lane & 1) == 0;
+  wq::push_masked<CAPACITY>(q, items, even);
+  wq::sync();
+
+  uint count = 0, sum = 0, item;
+  vector<uint, 16> batch;
+  while (uint taken = wq::pop_n<CAPACITY>(q, batch.select_all())) {
+    count += taken;
+    vector<uint, 16> kept = 0;
+    kept.merge(batch, lane < taken);
+    sum += cm_sum<uint>(kept);
+  }
+  while (wq::pop<CAPACITY>(q, item)) {
+    count++;
+    sum += item;
+  }
+  vector<ushort, 8> addr;
+  for (int i = 0; i < 8; i++)
+    addr(i) = i;
+  vector<uint, 8> add = 0, old;
+  add(0) = count;
+  add(1) = sum;
+  cm_slm_atomic(totals, ATOMIC_ADD, addr, old, add);
+  wq::sync();
+
+  if (id == 0) {
+    uint ref_count = 0, ref_sum = 0;
+    for (uint t = 0; t < threads; t++) {
+      for (uint i = 0; i < 16; i++) {
+        ref_sum += t * 16 + i;
+        if (i % 2 == 0) {
+          ref_sum += 200000 + t * 16 + i;
+          ref_count++;
+        }
+      }
+      ref_sum += 100000 + t;
+      ref_count += 17;
+    }
+    vector<uint, 8> got;
+    cm_slm_block_read(totals, 0, got);
+    vector<uint, 4> bad = 0;
+    bad(0) = got(0) != ref_count;
+    bad(1) = got(1) != ref_sum;
+    bad(2) = wq::size<CAPACITY>(q) != ref_count;
+    bad(3) = wq::overflow<CAPACITY>(q);
+    write(errors, cm_linear_group_id() * 16, bad);
+  }
+}
+
+// stack_check: every channel pushes 100 values, spilling past the register
+// cache into SLM, and must pop them back in reverse order before the stack
+// reports empty.
+
+_GENX_MAIN_ void stack_check(SurfaceIndex errors)
+{
+  constexpr uint size =
+      cmtl::CachedStackSLMSize<int, W, CACHESIZE, MAXSIZE, THREADS>();
+  cm_slm_init(size);
+  uint slm = cm_slm_alloc(size);
+
+  matrix<short, 2, W> context;
+  matrix<int, 2, W> context_ii;
+  matrix<int, W, CACHESIZE> cache;
+  vector<int, W> channel;
+  for (int c = 0; c < W; c++)
+    channel(c) = c;
+  vector<short, W> mask = 1;
+  vector<short, W> empty;
+
+  cmtl::CachedStackSLMInit<int, W, CACHESIZE>(context, context_ii, MAXSIZE);
+  for (int i = 0; i < 100; i++) {
+    vector<int, W> element = i * W + channel;
+    cmtl::CachedStackPush<int, W, CACHESIZE>(slm, context, context_ii, cache,
+                                             element);
+  }
+  vector<int, W> bad = 0;
+  for (int i = 99; i >= 0; i--) {
+    cmtl::CachedStackEmpty<W>(context, context_ii, empty);
+    bad.merge(bad + 1, empty != 0);
+    vector<int, W> element;
+    cmtl::CachedStackPop<int, W, CACHESIZE>(slm, context, context_ii, cache,
+                                            element, mask);
+    bad.merge(bad + 1, element != i * W + channel);
+  }
+  cmtl::CachedStackEmpty<W>(context, context_ii, empty);
+  bad.merge(bad + 1, empty == 0);
+  write(errors, cm_linear_global_id() * W * sizeof(int), bad);
+}
+
+// output a warning just to have some output from the compiler to check
+#warning work_queue.cpp
+
+// RUN: %cmc -mCM_old_asm_name %w -Wno-pass-failed 2>&1 | FileCheck --implicit-check-not error %w
+// RUN: rm %W.isa
+// CHECK: warning: work_queue.cpp
+// CHECK: 1 warning generated
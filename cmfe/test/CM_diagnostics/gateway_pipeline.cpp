@@ -0,0 +1,59 @@
+#include <cm/cm.h>
+
+// Wavefront, stage ring and split barrier helpers on every scoreboard and
+// barrier flavour.
+
+#define SLOTS 4
+
+_GENX_MAIN_ void wavefront(SurfaceIndex S)
+{
+  uint x = get_thread_origin_x();
+  uint y = get_thread_origin_y();
+  matrix<uchar, 8, 32> tile;
+
+  cm_wavefront_wait<3>();
+  read(S, x * 32, y * 8, tile);
+  tile += 1;
+  write(S, x * 32, y * 8, tile);
+  cm_wavefront_signal<3>();
+}
+
+_GENX_MAIN_ void pipeline(SurfaceIndex in, SurfaceIndex out, uint count)
+{
+  cm_slm_init(cm_stage_ring_size<SLOTS, float, 16>());
+  uint ring = cm_slm_alloc(cm_stage_ring_size<SLOTS, float, 16>());
+  cm_stage_ring_init(ring);
+
+  vector<float, 16> data;
+  if (cm_linear_local_id() == 0) {
+    for (uint i = 0; i < count; i++) {
+      read(in, i * 64, data);
+      data *= 2.0f;
+      cm_stage_ring_push<SLOTS>(ring, data);
+    }
+  } else if (cm_linear_local_id() == 1) {
+    for (uint i = 0; i < count; i++) {
+      cm_stage_ring_pop<SLOTS>(ring, data.select_all());
+      write(out, i * 64, data);
+    }
+  }
+
+  cm_barrier_arrive();
+  vector<uint, 8> id = cm_linear_global_id();
+  cm_barrier_wait();
+  write(out, count * 64 + cm_linear_local_id() * 32, id);
+}
+
+#warning gateway_pipeline.cpp
+
+// RUN: %cmc -mCM_old_asm_name -march=BDW %w -Wno-pass-failed 2>&1 | FileCheck --implicit-check-not error %w
+// RUN: rm %W.isa
+// RUN: %cmc -mCM_old_asm_name -march=SKL %w -Wno-pass-failed 2>&1 | FileCheck --implicit-check-not error %w
+// RUN: rm %W.isa
+// RUN: %cmc -mCM_old_asm_name -march=ICLLP %w -Wno-pass-failed 2>&1 | FileCheck --implicit-check-not error %w
+// RUN: rm %W.isa
+// RUN: %cmc -mCM_old_asm_name -march=TGLLP %w -Wno-pass-failed 2>&1 | FileCheck --implicit-check-not error %w
+// RUN: rm %W.isa
+
+// CHECK: warning: gateway_pipeline.cpp
+// CHECK: 1 warning generated
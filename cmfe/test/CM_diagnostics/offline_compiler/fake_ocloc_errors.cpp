@@ -0,0 +1,39 @@
+// REQUIRES: fake-ocloc
+//
+// Check cmoc reports the ways ocloc can fail, using the fake ocloc.
+//
+// RUN: not env CMOC_OCLOC_DIR=%fake_ocloc_dir FAKE_OCLOC_FAIL=invoke \
+// RUN:     %cmoc -mcpu=SKL %w -I%cm_headers -o %t.gen 2>&1 \
+// RUN:     | FileCheck %w -check-prefix=INVOKE
+//
+// INVOKE: fake-ocloc: error: failing as FAKE_OCLOC_FAIL asks
+// INVOKE: Call to oclocInvoke failed
+//
+// RUN: not env CMOC_OCLOC_DIR=%fake_ocloc_dir FAKE_OCLOC_FAIL=free \
+// RUN:     %cmoc -mcpu=SKL %w -I%cm_headers -o %t.gen 2>&1 \
+// RUN:     | FileCheck %w -check-prefix=FREE
+//
+// FREE: Call to oclocFreeOutput failed
+//
+// RUN: not env CMOC_OCLOC_DIR=%fake_ocloc_dir FAKE_OCLOC_FAIL=no-binary \
+// RUN:     %cmoc -mcpu=SKL %w -I%cm_headers -o %t.gen 2>&1 \
+// RUN:     | FileCheck %w -check-prefix=NOBIN
+//
+// NOBIN: ocloc did not produce a .gen binary
+
+// ocloc rejects a SPIR-V input that is not SPIR-V.
+// RUN: echo garbage > %t.spv
+// RUN: not env CMOC_OCLOC_DIR=%fake_ocloc_dir \
+// RUN:     %cmoc -mcpu=SKL %t.spv -o %t.gen 2>&1 \
+// RUN:     | FileCheck %w -check-prefix=BADSPV
+//
+// BADSPV: fake-ocloc: error: cmoc_spirv: not a whole SPIR-V module
+// BADSPV: Call to oclocInvoke failed
+
+// RUN: rm -f %t.gen %t.spv
+
+#include <cm/cm.h>
+
+extern "C" _GENX_MAIN_
+void test_kernel() {
+}
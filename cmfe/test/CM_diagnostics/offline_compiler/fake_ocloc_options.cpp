@@ -0,0 +1,61 @@
+// REQUIRES: fake-ocloc
+//
+// Check the ocloc command line cmoc composes, and that it picks the binary
+// for the requested format out of the ocloc outputs, using the fake ocloc.
+//
+// RUN: rm -f %t.log
+// RUN: env CMOC_OCLOC_DIR=%fake_ocloc_dir FAKE_OCLOC_LOG=%t.log \
+// RUN:     %cmoc -mcpu=SKL %w -I%cm_headers -mCM_optimize_none \
+// RUN:     -mllvm -genx-memory-report -mllvm -finalizer-opts=-noschedule \
+// RUN:     -o %W.gen
+// RUN: FileCheck %w -check-prefix=LOG-CM < %t.log
+// RUN: FileCheck %w -check-prefix=BIN-CM < %W.gen
+//
+// LOG-CM: oclocInvoke: "ocloc" "compile" "-device" "skl" "-spirv_input" "-file" "cmoc_spirv"
+// LOG-CM-SAME: "-options" "-vc-codegen -optimize=none"
+// LOG-CM-SAME: "-internal_options" " -binary-format=cm -llvm-options='-genx-memory-report -finalizer-opts=\"-noschedule\"'"
+// LOG-CM-NEXT: source: cmoc_spirv {{[0-9]+}} bytes
+// LOG-CM-NEXT: headers: 0
+// LOG-CM-NEXT: outputs: cmoc_spirv.dbg cmoc_spirv.gen stdout.log
+// LOG-CM-NEXT: result: 0
+//
+// BIN-CM: FAKE-OCLOC-BINARY
+// BIN-CM-NEXT: device: skl
+// BIN-CM-NEXT: revision_id:
+// BIN-CM-NEXT: input: spirv {{[0-9]+}} bytes
+// BIN-CM-NEXT: format: cm
+
+// RUN: rm -f %t.log
+// RUN: env CMOC_OCLOC_DIR=%fake_ocloc_dir FAKE_OCLOC_LOG=%t.log \
+// RUN:     %cmoc -mcpu=TGLLP %w -I%cm_headers -binary-format=ocl -o %W.bin
+// RUN: FileCheck %w -check-prefix=LOG-OCL < %t.log
+// RUN: FileCheck %w -check-prefix=BIN-OCL < %W.bin
+//
+// LOG-OCL: "-device" "tgllp"
+// LOG-OCL-SAME: "-options" "-vc-codegen "
+// LOG-OCL-SAME: "-internal_options" " -binary-format=ocl"
+// LOG-OCL: outputs: cmoc_spirv.dbg cmoc_spirv.bin stdout.log
+//
+// BIN-OCL: device: tgllp
+// BIN-OCL: format: ocl
+
+// A SPIR-V input goes to ocloc as it is.
+// RUN: %cmoc -mcpu=SKL %w -I%cm_headers -emit-spirv -o %W.spv
+// RUN: rm -f %t.log
+// RUN: env CMOC_OCLOC_DIR=%fake_ocloc_dir FAKE_OCLOC_LOG=%t.log \
+// RUN:     %cmoc -mcpu=SKL %W.spv -o %W.gen
+// RUN: FileCheck %w -check-prefix=LOG-SPV < %t.log
+//
+// LOG-SPV: "-spirv_input" "-file" "cmoc_spirv"
+// LOG-SPV: result: 0
+
+// RUN: rm %W.gen %W.bin %W.spv %t.log
+
+#include <cm/cm.h>
+
+extern "C" _GENX_MAIN_
+void test_kernel(SurfaceIndex S) {
+  vector<int, 8> v;
+  read(S, 0, v);
+  write(S, 0, v + 1);
+}
@@ -0,0 +1,26 @@
+// REQUIRES: fake-ocloc
+//
+// With -ftime-report cmoc times its own phases, and asks ocloc for a time
+// report too. With the fake ocloc the backend phase is close to pure driver
+// overhead.
+//
+// RUN: rm -f %t.log
+// RUN: env CMOC_OCLOC_DIR=%fake_ocloc_dir FAKE_OCLOC_LOG=%t.log \
+// RUN:     %cmoc -mcpu=SKL %w -I%cm_headers -ftime-report -o %t.gen 2>&1 \
+// RUN:     | FileCheck %w
+// RUN: FileCheck %w -check-prefix=LOG < %t.log
+//
+// CHECK: CM offline compiler driver
+// CHECK-DAG: Frontend
+// CHECK-DAG: Backend (ocloc)
+// CHECK-DAG: Write output file
+//
+// LOG: "-internal_options" " -binary-format=cm -ftime-report"
+
+// RUN: rm %t.gen %t.log
+
+#include <cm/cm.h>
+
+extern "C" _GENX_MAIN_
+void test_kernel() {
+}
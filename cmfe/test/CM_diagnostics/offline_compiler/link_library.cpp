@@ -0,0 +1,54 @@
+// RUN: %cmoc -mcpu=SKL %w -I%cm_headers -DCM_LIBRARY -emit-llvm -o %W.lib.bc
+// RUN: %cmoc -mcpu=SKL %w -I%cm_headers -DCM_LIBRARY -emit-spirv -o %W.lib.spv
+// RUN: %cmoc -mcpu=SKL %w -I%cm_headers -DCM_SINGLE_TU -emit-llvm -S -o %W.tu.ll
+// RUN: FileCheck -input-file=%W.tu.ll %w
+// RUN: %cmoc -mcpu=SKL %w -I%cm_headers -mCM_link_library %W.lib.bc -emit-llvm -S -o %W.bc.ll
+// RUN: FileCheck -input-file=%W.bc.ll --implicit-check-not unused_helper %w
+// RUN: %cmoc -mcpu=SKL %w -I%cm_headers -mCM_link_library %W.lib.spv -emit-llvm -S -o %W.spv.ll
+// RUN: FileCheck -input-file=%W.spv.ll --implicit-check-not unused_helper %w
+// RUN: %cmc -mCM_old_asm_name -march=SKL %w -mCM_link_library %W.lib.bc -Wno-pass-failed 2>&1 | FileCheck --implicit-check-not error --check-prefix=CHECK-VISA %w
+// RUN: rm %W.isa
+// RUN: %cmc -mCM_old_asm_name -Qxcm_jit_target=SKL %w -DCM_SINGLE_TU -Wno-pass-failed
+// RUN: cp %W_0.visaasm %t.tu.visaasm
+// RUN: %cmc -mCM_old_asm_name -Qxcm_jit_target=SKL %w -mCM_link_library %W.lib.bc -Wno-pass-failed
+// RUN: diff %t.tu.visaasm %W_0.visaasm
+// RUN: rm %W.isa %W_0.visaasm %W_0.asm %W_0.dat %t.tu.visaasm
+// RUN: rm %W.lib.bc %W.lib.spv %W.tu.ll %W.bc.ll %W.spv.ll
+
+// A library compiled on its own and linked with the kernel gives the same
+// module as one translation unit: the helper the kernel calls is linked in,
+// the unused one is dropped, and the vISA is identical to that of the single
+// translation unit build.
+
+// CHECK-DAG: define {{.*}}@test_kernel(
+// CHECK-DAG: define {{.*}}scale_add
+// CHECK-VISA: warning: link_library.cpp
+// CHECK-VISA: 1 warning generated
+
+#include <cm/cm.h>
+
+#if defined(CM_LIBRARY) || defined(CM_SINGLE_TU)
+_GENX_ vector<float, 16> scale_add(vector<float, 16> a, vector<float, 16> b,
+                                   float s) {
+  return a * s + b;
+}
+#else
+_GENX_ vector<float, 16> scale_add(vector<float, 16> a, vector<float, 16> b,
+                                   float s);
+#endif
+
+#ifdef CM_LIBRARY
+_GENX_ vector<float, 16> unused_helper(vector<float, 16> a) {
+  return a * a;
+}
+#else
+#warning link_library.cpp
+
+extern "C" _GENX_MAIN_
+void test_kernel(SurfaceIndex S) {
+  vector<float, 16> a, b;
+  read(S, 0, a);
+  read(S, 64, b);
+  write(S, 128, scale_add(a, b, 2.0f));
+}
+#endif
@@ -0,0 +1,46 @@
+// RUN: %cmoc -mcpu=SKL %w -I%cm_headers -emit-llvm -S -o %W.text.ll
+// RUN: FileCheck -input-file=%W.text.ll --check-prefix=CHECK-SPEC %w
+// RUN: rm %W.text.ll
+// RUN: %cmc -mCM_old_asm_name -march=SKL %w -Wno-pass-failed 2>&1 | FileCheck --implicit-check-not error --check-prefix=CHECK-VISA %w
+// RUN: rm %W.isa
+
+// The loop bound stays a call until the kernel is loaded. Compiled straight
+// to vISA it takes its default value.
+
+// CHECK-SPEC: call {{.*}}__spirv_SpecConstant{{.*}}(i32 3, i32 {{.*}})
+// CHECK-SPEC: call {{.*}}__spirv_SpecConstant{{.*}}(i32 7, float {{.*}})
+// CHECK-VISA: warning: spec_constant.cpp
+// CHECK-VISA: 1 warning generated
+
+// In SPIR-V each call is an OpSpecConstant holding the default, with a SpecId
+// decoration. The module is dumped as hex words joined into a single line,
+// so that an instruction can be matched as a word sequence.
+// RUN: %cmoc -mcpu=SKL %w -I%cm_headers -emit-spirv -o %W.spv
+// RUN: od -An -tx4 -v %W.spv | tr -d '\n' | FileCheck --check-prefix=CHECK-SPV %w
+// RUN: rm %W.spv
+
+// OpDecorate <id> SpecId <n> is 0x00040047 <id> 0x1 <n>, and OpSpecConstant
+// <type> <id> <value> is 0x00040032 <type> <id> <value>.
+// CHECK-SPV-DAG: 00040047 [[TAPS:[0-9a-f]+]] 00000001 00000003
+// CHECK-SPV-DAG: 00040047 [[SCALE:[0-9a-f]+]] 00000001 00000007
+// CHECK-SPV-DAG: 00040032 {{[0-9a-f]+}} [[TAPS]] 00000004
+// CHECK-SPV-DAG: 00040032 {{[0-9a-f]+}} [[SCALE]] 3f000000
+
+#include <cm/cm.h>
+
+#warning spec_constant.cpp
+
+extern "C" _GENX_MAIN_
+void test_kernel(SurfaceIndex S) {
+  int taps = cm_spec_constant<3>(4);
+  float scale = cm_spec_constant<7>(0.5f);
+
+  vector<float, 16> acc = 0;
+  vector<float, 16> v;
+  for (int i = 0; i < taps; i++) {
+    read(S, i * 64, v);
+    acc += v;
+  }
+  acc *= scale;
+  write(S, 0, acc);
+}
@@ -0,0 +1,59 @@
+// REQUIRES: cmc-jit
+//
+// Load the SPIR-V of a kernel with specialization constants through libcmc,
+// once with the defaults and once specialized, and compare the vISA.
+//
+// RUN: rm -rf %t.generic %t.spec
+// RUN: mkdir %t.generic %t.spec
+// RUN: %cmoc -mcpu=SKL %w -I%cm_headers -emit-spirv -o %t.spv
+//
+// RUN: cd %t.generic && %cmc_jit %t.spv -o generic.isa
+// RUN: cd %t.generic && %genxir generic.isa -platform SKL -dumpcommonisa
+// RUN: cat %t.generic/*.visaasm | FileCheck --check-prefix=GENERIC %w
+//
+// taps = 2 and scale = 0.25f.
+// RUN: cd %t.spec && %cmc_jit %t.spv -spec 3=2 -spec 7=0x3e800000 -o spec.isa
+// RUN: cd %t.spec && %genxir spec.isa -platform SKL -dumpcommonisa
+// RUN: cat %t.spec/*.visaasm | FileCheck --check-prefix=SPEC %w
+// RUN: cat %t.spec/*.visaasm | grep -c oword_ld | FileCheck --check-prefix=SPEC-LD %w
+//
+// An unknown SpecId is ignored and the defaults stay.
+// RUN: %cmc_jit %t.spv -spec 5=1 -o %t.unknown.isa
+// RUN: cmp %t.generic/generic.isa %t.unknown.isa
+//
+// RUN: rm -rf %t.generic %t.spec %t.spv %t.unknown.isa
+
+// The generic kernel scales by the default.
+// GENERIC: .kernel
+// GENERIC: 0x3f000000:f
+// GENERIC-NOT: 0x3e800000:f
+
+// The specialized kernel scales by the given value, and its loop is unrolled
+// into exactly two reads.
+// SPEC: .kernel
+// SPEC-NOT: 0x3f000000:f
+// SPEC-NOT: jmp
+// SPEC: oword_ld
+// SPEC-NOT: jmp
+// SPEC: oword_ld
+// SPEC-NOT: jmp
+// SPEC: 0x3e800000:f
+// SPEC-NOT: 0x3f000000:f
+// SPEC-LD: {{^2$}}
+
+#include <cm/cm.h>
+
+extern "C" _GENX_MAIN_
+void test_kernel(SurfaceIndex S) {
+  int taps = cm_spec_constant<3>(4);
+  float scale = cm_spec_constant<7>(0.5f);
+
+  vector<float, 16> acc = 0;
+  vector<float, 16> v;
+  for (int i = 0; i < taps; i++) {
+    read(S, i * 64, v);
+    acc += v;
+  }
+  acc *= scale;
+  write(S, 0, acc);
+}
@@ -0,0 +1,48 @@
+#include <cm/cm.h>
+
+// Many identical regions instantiated from templates. All but the first of
+// each are answered from the memoised region checks.
+
+template <int N>
+_GENX_ void sum(vector_ref<int, 16> v, vector_ref<int, 8> out) {
+  out += v.select<8, 2>(0);
+  out += v.select<8, 2>(1);
+  out += v.replicate<2, 4>(N % 4);
+  out += v.format<short>().select<8, 4>(0);
+  sum<N - 1>(v, out);
+}
+
+template <>
+_GENX_ void sum<0>(vector_ref<int, 16> v, vector_ref<int, 8> out) {
+  out += v.select<8, 1>(8);
+}
+
+template <int N>
+_GENX_ void tile(matrix_ref<float, 8, 8> m, vector_ref<float, 16> out) {
+  out += m.select<2, 1, 8, 1>(N % 7, 0).format<float>();
+  out += m.select<4, 2, 4, 2>(0, 1).format<float>();
+  tile<N - 1>(m, out);
+}
+
+template <>
+_GENX_ void tile<0>(matrix_ref<float, 8, 8> m, vector_ref<float, 16> out) {}
+
+_GENX_MAIN_ void test(SurfaceIndex S) {
+  vector<int, 16> v;
+  vector<int, 8> out = 0;
+  read(S, 0, v);
+  sum<32>(v, out);
+
+  matrix<float, 8, 8> m = v(0);
+  vector<float, 16> f = 0;
+  tile<32>(m, f);
+
+  out += f.select<8, 2>(0);
+  write(S, 0, out);
+}
+
+// RUN: %cmc -mCM_old_asm_name -ftime-report %w 2>&1 | FileCheck %w
+// RUN: rm %W.isa
+
+// CHECK: {{[0-9]+}} CM region checks, {{[0-9]+}} answered from {{[0-9]+}} memoised regions, {{[0-9]+}} region parameters evaluated.
+// CHECK: CM region checks
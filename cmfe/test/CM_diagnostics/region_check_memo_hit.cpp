@@ -0,0 +1,27 @@
+#include <cm/cm.h>
+
+// The same select repeated in a kernel. Every repeat is answered from the
+// memoised region checks before its size and stride are evaluated; only its
+// offset is evaluated, as it is part of the memo key. Compiling with and
+// without the repeats, the difference is four checks, all answered from the
+// memo, and one evaluated parameter for each.
+
+_GENX_MAIN_ void test(SurfaceIndex S) {
+  vector<int, 16> v;
+  read(S, 0, v);
+  vector<int, 8> out = v.select<8, 2>(1);
+#if REPEAT
+  out += v.select<8, 2>(1);
+  out += v.select<8, 2>(1);
+  out += v.select<8, 2>(1);
+  out += v.select<8, 2>(1);
+#endif
+  write(S, 0, out);
+}
+
+// RUN: %cmc -mCM_old_asm_name -ftime-report -DREPEAT=0 %w 2>&1 | grep " CM region checks, " > %t.once
+// RUN: %cmc -mCM_old_asm_name -ftime-report -DREPEAT=1 %w 2>&1 | grep " CM region checks, " > %t.repeat
+// RUN: cat %t.once %t.repeat | awk 'NR == 1 { c = $1; h = $5; m = $8; e = $11 } NR == 2 { print "checks +" ($1 - c) ", hits +" ($5 - h) ", memoised +" ($8 - m) ", evaluated +" ($11 - e) }' | FileCheck %w
+// RUN: rm %W.isa
+
+// CHECK: checks +4, hits +4, memoised +0, evaluated +4
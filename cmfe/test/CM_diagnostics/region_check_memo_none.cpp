@@ -0,0 +1,11 @@
+// A kernel without any CM region makes no region checks, so -ftime-report
+// prints no region check counters for it.
+
+__declspec(genx_main) void empty() {}
+
+// RUN: %cmc -mCM_old_asm_name -ftime-report %w 2>&1 | FileCheck %w
+// RUN: rm %W.isa
+
+// CHECK-NOT: CM region checks,
+// CHECK: Clang front-end time report
+// CHECK-NOT: CM region checks,
@@ -0,0 +1,34 @@
+#include <cm/cm.h>
+
+// A stress test for the memoised region checks: DEPTH levels of template
+// recursion, each checking the same three regions. The base type is a
+// template parameter, so every level checks its regions again. Compiling at
+// two depths, each of the 256 extra levels makes three checks, all answered
+// from the memo: the memo does not grow, and only the offset of each select
+// is evaluated.
+
+template <int N, typename T>
+_GENX_ void level(vector_ref<T, 32> v, vector_ref<T, 8> out) {
+  out += v.template select<8, 4>(1);
+  out += v.template select<8, 2>(16);
+  out += v.template select<8, 1>(3);
+  level<N - 1, T>(v, out);
+}
+
+template <>
+_GENX_ void level<0, int>(vector_ref<int, 32> v, vector_ref<int, 8> out) {}
+
+_GENX_MAIN_ void test(SurfaceIndex S) {
+  vector<int, 32> v;
+  read(S, 0, v);
+  vector<int, 8> out = 0;
+  level<DEPTH, int>(v, out);
+  write(S, 0, out);
+}
+
+// RUN: %cmc -mCM_old_asm_name -ftime-report -DDEPTH=4 %w 2>&1 | grep " CM region checks, " > %t.shallow
+// RUN: %cmc -mCM_old_asm_name -ftime-report -DDEPTH=260 %w 2>&1 | grep " CM region checks, " > %t.deep
+// RUN: cat %t.shallow %t.deep | awk 'NR == 1 { c = $1; h = $5; m = $8; e = $11 } NR == 2 { print "checks +" ($1 - c) ", hits +" ($5 - h) ", memoised +" ($8 - m) ", evaluated +" ($11 - e) }' | FileCheck %w
+// RUN: rm %W.isa
+
+// CHECK: checks +768, hits +768, memoised +0, evaluated +768
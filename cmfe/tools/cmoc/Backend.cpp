@@ -160,7 +160,8 @@ static void saveOutputs(uint32_t NumOutputs, uint8_t **DataOutputs,
         llvm::StringRef Name{std::get<2>(File)};
         return Name.endswith(RequiredExtension);
       });
-  assert(BinIt != Zip.end() && "Output binary is missing");
+  if (BinIt == Zip.end())
+    FatalError("ocloc did not produce a " + RequiredExtension + " binary");
 
   llvm::ArrayRef<uint8_t> BinRef{std::get<0>(*BinIt),
                                  static_cast<std::size_t>(std::get<1>(*BinIt))};
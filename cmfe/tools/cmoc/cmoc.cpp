@@ -31,6 +31,7 @@
 #include <llvm/Support/FileSystem.h>
 #include <llvm/Support/Path.h>
 #include <llvm/Support/Process.h>
+#include <llvm/Support/Timer.h>
 
 #include <llvm/ADT/StringExtras.h>
 
@@ -131,6 +132,10 @@ public:
     assert(DriverInvocation);
     return translateOutputType(DriverInvocation->getOutputType());
   }
+  bool getTimePasses() const {
+    assert(DriverInvocation);
+    return DriverInvocation->getTimePasses();
+  }
 
   CmocContext(int argc, const char **argv);
 
@@ -370,12 +375,24 @@ int main(int argc, const char **argv) {
 
   checkInputOutputCompatibility(Ctx.getInputKind(), Ctx.getOutputKind());
 
+  // With -ftime-report, time the phases of the driver too, so that its own
+  // overhead around the frontend and ocloc can be told apart. The report is
+  // printed when the group goes out of scope.
+  llvm::TimerGroup DriverTimers("cmoc", "CM offline compiler driver");
+  llvm::Timer FETimer("fe", "Frontend", DriverTimers);
+  llvm::Timer InputTimer("input", "Read input file", DriverTimers);
+  llvm::Timer BETimer("be", "Backend (ocloc)", DriverTimers);
+  llvm::Timer OutputTimer("output", "Write output file", DriverTimers);
+  const bool TimePasses = Ctx.getTimePasses();
+
   BinaryData VCOptInput;
   // If input is text, run CM Frontend
   if (Ctx.getInputKind() == InputKind::TEXT) {
+    llvm::TimeRegion Region(TimePasses ? &FETimer : nullptr);
     VCOptInput = Ctx.runFE(
         (Ctx.getOutputKind() == OutputKind::VISA) ? "-emit-spirv" : "");
   } else {
+    llvm::TimeRegion Region(TimePasses ? &InputTimer : nullptr);
     std::ifstream InputFile(Ctx.getInputFilename(), std::ios::binary);
     if (!InputFile.is_open())
       FatalError("could not open input file\n");
@@ -393,6 +410,7 @@ int main(int argc, const char **argv) {
   BinaryData PrimaryOutput;
   if (Ctx.getOutputKind() == OutputKind::VISA) {
     ILTranslationResult TranslatedResult;
+    llvm::TimeRegion Region(TimePasses ? &BETimer : nullptr);
     Ctx.runVCOpt(VCOptInput, Ctx.getInputKind(), TranslatedResult);
     PrimaryOutput = std::move(TranslatedResult.KernelBinary);
   } else {
@@ -403,6 +421,7 @@ int main(int argc, const char **argv) {
   if (OutputFilename.empty())
     OutputFilename = makeDefaultFilename(Ctx.getOutputKind());
 
+  llvm::TimeRegion Region(TimePasses ? &OutputTimer : nullptr);
   if (auto Err = WriteBinaryToFile(OutputFilename, PrimaryOutput))
     FatalError("error during writing output file: " + Err.message());
 
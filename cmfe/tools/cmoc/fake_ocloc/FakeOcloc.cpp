@@ -0,0 +1,326 @@
+/*===================== begin_copyright_notice ==================================
+
+ Copyright (c) 2021, Intel Corporation
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+======================= end_copyright_notice ==================================*/
+
+// A stand-in for libocloc, for testing the cmoc finalization path on machines
+// without a real ocloc (or a GPU).
+//
+// It implements the two entry points cmoc looks up, oclocInvoke and
+// oclocFreeOutput. oclocInvoke checks the command line and the sources it is
+// given the way cmoc is expected to send them: a "compile" command for a
+// known device, one SPIR-V (with -spirv_input) or vISA source named by -file,
+// "-vc-codegen" in -options and a -binary-format in -internal_options. On
+// success it returns a synthetic binary, with the extension that binary
+// format asks for, among a few other outputs. The binary is text describing
+// the invocation, so tests can check it with FileCheck.
+//
+// Environment variables:
+//   FAKE_OCLOC_LOG  - file to append a record of each invocation to
+//   FAKE_OCLOC_FAIL - make a step fail: "invoke" (oclocInvoke returns an
+//                     error), "free" (oclocFreeOutput returns an error) or
+//                     "no-binary" (the binary is left out of the outputs)
+//
+// This deliberately depends on nothing but the C++ standard library, like
+// the real library does as far as cmoc is concerned.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#define FAKE_OCLOC_API extern "C" __declspec(dllexport)
+#else
+#define FAKE_OCLOC_API extern "C" __attribute__((visibility("default")))
+#endif
+
+namespace {
+
+// Error codes, as in ocloc_api.h.
+enum {
+  OCLOC_SUCCESS = 0,
+  OCLOC_INVALID_DEVICE = -33,
+  OCLOC_INVALID_COMMAND_LINE = -5150,
+  OCLOC_INVALID_FILE = -5151
+};
+
+const char *const KnownDevices[] = {"bdw", "bxt", "glk", "kbl",
+                                    "skl", "icllp", "tgllp"};
+
+struct Invocation {
+  std::string Device;
+  std::string RevisionId;
+  std::string File;
+  std::string Options;
+  std::string InternalOptions;
+  bool SpirvInput = false;
+};
+
+struct Output {
+  std::string Name;
+  std::string Data;
+};
+
+std::string getEnv(const char *Name) {
+  const char *Value = std::getenv(Name);
+  return Value ? Value : "";
+}
+
+bool failAt(const char *Step) { return getEnv("FAKE_OCLOC_FAIL") == Step; }
+
+bool isKnownDevice(const std::string &Name) {
+  for (const char *Device : KnownDevices)
+    if (Name == Device)
+      return true;
+  return false;
+}
+
+int error(int Code, const std::string &Msg) {
+  std::fprintf(stderr, "fake-ocloc: error: %s\n", Msg.c_str());
+  return Code;
+}
+
+// Parse the command line. Returns an empty string on success, otherwise the
+// reason it is rejected.
+std::string parseArgs(unsigned NumArgs, const char *Argv[], Invocation &Inv) {
+  if (NumArgs < 2 || std::strcmp(Argv[1], "compile") != 0)
+    return "expected a compile command";
+  for (unsigned i = 2; i != NumArgs; ++i) {
+    std::string Arg = Argv[i];
+    if (Arg == "-spirv_input") {
+      Inv.SpirvInput = true;
+      continue;
+    }
+    std::string *Value = nullptr;
+    if (Arg == "-device")
+      Value = &Inv.Device;
+    else if (Arg == "-revision_id")
+      Value = &Inv.RevisionId;
+    else if (Arg == "-file")
+      Value = &Inv.File;
+    else if (Arg == "-options")
+      Value = &Inv.Options;
+    else if (Arg == "-internal_options")
+      Value = &Inv.InternalOptions;
+    else
+      return "unknown option " + Arg;
+    if (++i == NumArgs)
+      return "missing value for " + Arg;
+    *Value = Argv[i];
+  }
+  if (Inv.Device.empty())
+    return "no -device";
+  if (Inv.File.empty())
+    return "no -file";
+  if (Inv.Options.compare(0, 11, "-vc-codegen") != 0)
+    return "-options does not start with -vc-codegen";
+  return "";
+}
+
+// Get the value of -binary-format in the internal options, or an empty
+// string.
+std::string getBinaryFormat(const std::string &InternalOptions) {
+  const std::string Key = "-binary-format=";
+  auto Pos = InternalOptions.find(Key);
+  if (Pos == std::string::npos)
+    return "";
+  Pos += Key.size();
+  return InternalOptions.substr(Pos,
+                                InternalOptions.find(' ', Pos) - Pos);
+}
+
+uint32_t readWord(const uint8_t *Data, bool Swap) {
+  uint32_t W;
+  std::memcpy(&W, Data, sizeof(W));
+  if (Swap)
+    W = (W >> 24) | ((W >> 8) & 0xff00) | ((W << 8) & 0xff0000) | (W << 24);
+  return W;
+}
+
+// Check the source is SPIR-V: a whole number of words, with a header of
+// magic, version, generator, bound and schema. Returns an empty string if it
+// is, otherwise the reason it is not.
+std::string checkSpirv(const uint8_t *Data, uint64_t Len) {
+  const uint32_t Magic = 0x07230203;
+  if (Len < 5 * 4 || Len % 4)
+    return "not a whole SPIR-V module (" + std::to_string(Len) + " bytes)";
+  bool Swap = readWord(Data, false) != Magic;
+  if (Swap && readWord(Data, true) != Magic)
+    return "bad SPIR-V magic number";
+  uint32_t Version = readWord(Data + 4, Swap);
+  if ((Version >> 16) != 1 || ((Version >> 8) & 0xff) > 6)
+    return "unsupported SPIR-V version";
+  if (!readWord(Data + 12, Swap))
+    return "SPIR-V id bound is 0";
+  if (readWord(Data + 16, Swap))
+    return "SPIR-V schema is not 0";
+  return "";
+}
+
+// Check the source is vISA, which starts with "CISA" and the version.
+std::string checkVisa(const uint8_t *Data, uint64_t Len) {
+  if (Len < 6 || std::memcmp(Data, "CISA", 4) != 0)
+    return "bad vISA magic number";
+  return "";
+}
+
+void quote(std::ostream &OS, const char *Str) {
+  OS << '"';
+  for (; *Str; ++Str)
+    (*Str == '"' ? OS << '\\' : OS) << *Str;
+  OS << '"';
+}
+
+void logInvocation(unsigned NumArgs, const char *Argv[], uint32_t NumSources,
+                   const uint64_t *LenSources, const char **NameOfSources,
+                   uint32_t NumInputHeaders,
+                   const std::vector<Output> &Outputs, int Result) {
+  std::string LogName = getEnv("FAKE_OCLOC_LOG");
+  if (LogName.empty())
+    return;
+  std::ostringstream OS;
+  OS << "oclocInvoke:";
+  for (unsigned i = 0; i != NumArgs; ++i) {
+    OS << ' ';
+    quote(OS, Argv[i]);
+  }
+  OS << '\n';
+  for (uint32_t i = 0; i != NumSources; ++i)
+    OS << "  source: " << NameOfSources[i] << ' ' << LenSources[i]
+       << " bytes\n";
+  OS << "  headers: " << NumInputHeaders << '\n';
+  OS << "  outputs:";
+  for (auto &Out : Outputs)
+    OS << ' ' << Out.Name;
+  OS << "\n  result: " << Result << '\n';
+  if (FILE *Log = std::fopen(LogName.c_str(), "a")) {
+    std::fputs(OS.str().c_str(), Log);
+    std::fclose(Log);
+  }
+}
+
+// Hand the outputs over in the same layout as the real library: arrays of
+// data, lengths and names, all allocated with malloc.
+void returnOutputs(const std::vector<Output> &Outputs, uint32_t *NumOutputs,
+                   uint8_t ***DataOutputs, uint64_t **LenOutputs,
+                   char ***NameOfOutputs) {
+  uint32_t N = Outputs.size();
+  *NumOutputs = N;
+  *DataOutputs = static_cast<uint8_t **>(std::malloc(N * sizeof(uint8_t *)));
+  *LenOutputs = static_cast<uint64_t *>(std::malloc(N * sizeof(uint64_t)));
+  *NameOfOutputs = static_cast<char **>(std::malloc(N * sizeof(char *)));
+  for (uint32_t i = 0; i != N; ++i) {
+    const Output &Out = Outputs[i];
+    (*DataOutputs)[i] = static_cast<uint8_t *>(std::malloc(Out.Data.size()));
+    std::memcpy((*DataOutputs)[i], Out.Data.data(), Out.Data.size());
+    (*LenOutputs)[i] = Out.Data.size();
+    (*NameOfOutputs)[i] = static_cast<char *>(std::malloc(Out.Name.size() + 1));
+    std::memcpy((*NameOfOutputs)[i], Out.Name.c_str(), Out.Name.size() + 1);
+  }
+}
+
+} // namespace
+
+FAKE_OCLOC_API int
+oclocInvoke(unsigned NumArgs, const char *Argv[], const uint32_t NumSources,
+            const uint8_t **DataSources, const uint64_t *LenSources,
+            const char **NameOfSources, const uint32_t NumInputHeaders,
+            const uint8_t **DataInputHeaders, const uint64_t *LenInputHeaders,
+            const char **NameOfInputHeaders, uint32_t *NumOutputs,
+            uint8_t ***DataOutputs, uint64_t **LenOutputs,
+            char ***NameOfOutputs) {
+  std::vector<Output> Outputs;
+  std::ostringstream BuildLog;
+  Invocation Inv;
+  int Result = OCLOC_SUCCESS;
+
+  std::string Err = parseArgs(NumArgs, Argv, Inv);
+  std::string BinaryFormat = getBinaryFormat(Inv.InternalOptions);
+  if (Err.empty() && BinaryFormat != "cm" && BinaryFormat != "ocl" &&
+      BinaryFormat != "ze")
+    Err = "bad or missing -binary-format in -internal_options";
+  if (!Err.empty()) {
+    Result = error(OCLOC_INVALID_COMMAND_LINE, Err);
+  } else if (!isKnownDevice(Inv.Device)) {
+    Result = error(OCLOC_INVALID_DEVICE, "unknown device " + Inv.Device);
+  } else if (NumSources != 1 || Inv.File != NameOfSources[0]) {
+    Result = error(OCLOC_INVALID_FILE,
+                   "expected the single source to be named " + Inv.File);
+  } else {
+    Err = Inv.SpirvInput ? checkSpirv(DataSources[0], LenSources[0])
+                         : checkVisa(DataSources[0], LenSources[0]);
+    if (!Err.empty())
+      Result = error(OCLOC_INVALID_FILE, Inv.File + ": " + Err);
+  }
+  if (Result == OCLOC_SUCCESS && failAt("invoke"))
+    Result = error(OCLOC_INVALID_FILE, "failing as FAKE_OCLOC_FAIL asks");
+
+  if (Result != OCLOC_SUCCESS) {
+    BuildLog << "Build failed with error code: " << Result << '\n';
+  } else {
+    // The binary describes the invocation. It goes after an output of
+    // another kind so that the caller has to look for it.
+    std::ostringstream Binary;
+    Binary << "FAKE-OCLOC-BINARY\n"
+           << "device: " << Inv.Device << '\n'
+           << "revision_id: " << Inv.RevisionId << '\n'
+           << "input: " << (Inv.SpirvInput ? "spirv" : "visa") << ' '
+           << LenSources[0] << " bytes\n"
+           << "format: " << BinaryFormat << '\n'
+           << "options: " << Inv.Options << '\n'
+           << "internal_options: " << Inv.InternalOptions << '\n';
+    Outputs.push_back({Inv.File + ".dbg", "FAKE-OCLOC-DEBUG-INFO\n"});
+    if (!failAt("no-binary"))
+      Outputs.push_back(
+          {Inv.File + (BinaryFormat == "cm" ? ".gen" : ".bin"), Binary.str()});
+    BuildLog << "Build succeeded.\n";
+  }
+  Outputs.push_back({"stdout.log", BuildLog.str()});
+
+  logInvocation(NumArgs, Argv, NumSources, LenSources, NameOfSources,
+                NumInputHeaders, Outputs, Result);
+  returnOutputs(Outputs, NumOutputs, DataOutputs, LenOutputs, NameOfOutputs);
+  return Result;
+}
+
+FAKE_OCLOC_API int oclocFreeOutput(uint32_t *NumOutputs, uint8_t ***DataOutputs,
+                                   uint64_t **LenOutputs,
+                                   char ***NameOfOutputs) {
+  for (uint32_t i = 0; i != *NumOutputs; ++i) {
+    std::free((*DataOutputs)[i]);
+    std::free((*NameOfOutputs)[i]);
+  }
+  std::free(*DataOutputs);
+  std::free(*LenOutputs);
+  std::free(*NameOfOutputs);
+  *NumOutputs = 0;
+  *DataOutputs = nullptr;
+  *LenOutputs = nullptr;
+  *NameOfOutputs = nullptr;
+  if (failAt("free"))
+    return error(OCLOC_INVALID_FILE, "failing as FAKE_OCLOC_FAIL asks");
+  return OCLOC_SUCCESS;
+}
@@ -97,6 +97,10 @@ void initializeCMImpParamPass(PassRegistry&);
 void initializeCMKernelArgOffsetPass(PassRegistry&);
 void initializeCMABIPass(PassRegistry&);
 void initializeCMLowerLoadStorePass(PassRegistry&);
+void initializeCMLoopVectorizePass(PassRegistry&);
+void initializeCMSVMAlignPeelPass(PassRegistry&);
+void initializeCMSLMStagingPass(PassRegistry&);
+void initializeCMKernelVariantsPass(PassRegistry&);
 void initializeGenXSimplifyPass(PassRegistry&);
 void initializeCodeGenPreparePass(PassRegistry&);
 void initializeConstantHoistingLegacyPassPass(PassRegistry&);
@@ -41,7 +41,9 @@
 #ifndef LLVM_SUPPORT_SPIRV_H
 #define LLVM_SUPPORT_SPIRV_H
 
+#include <cstdint>
 #include <iostream>
+#include <map>
 #include <string>
 
 namespace llvm {
@@ -67,6 +69,9 @@ void initializeTransOCLMDPass(PassRegistry &);
 namespace SPIRV {
 class SPIRVModule;
 
+/// \brief Values for specialization constants, keyed by SpecId.
+typedef std::map<uint32_t, uint64_t> SPIRVSpecConstMap;
+
 /// \brief Check if a string contains SPIR-V binary.
 bool IsSPIRVBinary(std::string &Img);
 
@@ -101,6 +106,13 @@ bool writeSPIRV(llvm::Module *M, llvm::raw_ostream &OS, std::string &ErrMsg);
 bool readSPIRV(llvm::LLVMContext &C, std::istream &IS, llvm::Module *&M,
                std::string &ErrMsg);
 
+/// \brief Load SPIRV from istream and translate to LLVM module, giving each
+/// OpSpecConstant whose SpecId is in \p SpecConsts the value mapped to it
+/// instead of its default. The value holds the bit pattern of the constant.
+/// \returns true if succeeds.
+bool readSPIRV(llvm::LLVMContext &C, std::istream &IS, llvm::Module *&M,
+               std::string &ErrMsg, const SPIRV::SPIRVSpecConstMap &SpecConsts);
+
 /// \brief Regularize LLVM module by removing entities not representable by
 /// SPIRV.
 bool regularizeLLVMForSPIRV(llvm::Module *M, std::string &ErrMsg);
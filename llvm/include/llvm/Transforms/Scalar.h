@@ -435,6 +435,32 @@ Pass *createCMABIPass();
 //
 Pass *createCMLowerLoadStorePass();
 
+//===----------------------------------------------------------------------===//
+//
+// CMLoopVectorize - Vectorize loops that process a CM vector element by element.
+//
+Pass *createCMLoopVectorizePass();
+
+//===----------------------------------------------------------------------===//
+//
+// CMSVMAlignPeel - Peel CM loops so that their SVM block accesses are aligned.
+//
+Pass *createCMSVMAlignPeelPass();
+
+//===----------------------------------------------------------------------===//
+//
+// CMSLMStaging - Stage read-only surface tiles shared by a CM thread group in
+// SLM.
+//
+Pass *createCMSLMStagingPass();
+
+//===----------------------------------------------------------------------===//
+//
+// CMKernelVariants - Add CM kernel variants specialized on their arguments, as
+// given by -cm-kernel-variant.
+//
+ModulePass *createCMKernelVariantsPass();
+
 FunctionPass *createGenXReduceIntSizePass();
 FunctionPass *createGenXRegionCollapsingPass();
 FunctionPass *createGenXSimplifyPass();
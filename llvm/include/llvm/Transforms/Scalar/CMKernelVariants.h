@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2020, Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+//===----------------------------------------------------------------------===//
+//
+/// CMKernelVariants
+/// ----------------
+///
+/// Cloning of CM kernels into variants specialized on predicates over their
+/// arguments. See CMKernelVariants.cpp for details.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef CMKERNELVARIANTS_H
+#define CMKERNELVARIANTS_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include <string>
+
+namespace llvm {
+
+class Function;
+class Module;
+
+// A predicate a kernel variant is specialized on.
+struct CMArgPredicate {
+  enum PredicateKind {
+    Value, // the argument equals Val, its bits zero extended to 64 bits
+    Align  // the argument is a multiple of Val, a power of two
+  };
+  unsigned ArgIndex;
+  PredicateKind Kind;
+  uint64_t Val;
+};
+
+// A variant of a kernel, named by its kernel name or else its function name.
+struct CMKernelVariant {
+  std::string Kernel;
+  SmallVector<CMArgPredicate, 4> Predicates;
+};
+
+// cloneCMKernelVariants : clone the kernel of each variant as <kernel>_v<N>,
+// specialized on the variant's predicates, and add it to genx.kernels. The
+// clones are returned in Clones, in the order of the variants.
+//
+// Return:  false, with no clones, if a variant names an unknown kernel or a
+//          predicate does not apply to its argument
+bool cloneCMKernelVariants(Module &M, ArrayRef<CMKernelVariant> Variants,
+                           SmallVectorImpl<Function *> &Clones);
+
+} // namespace llvm
+
+#endif // CMKERNELVARIANTS_H
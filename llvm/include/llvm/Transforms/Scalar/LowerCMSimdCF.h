@@ -72,6 +72,7 @@ public:
   void processFunction(Function *F);
 
 private:
+  bool foldUniformSimdBranches();
   bool findSimdBranches(unsigned CMWidth);
   void determinePredicatedBlocks();
   void markPredicatedBranches();
@@ -29,6 +29,7 @@
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetOptions.h"
 #include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Scalar/CMKernelVariants.h"
 
 #include <memory>
 #include <sstream>
@@ -101,6 +102,23 @@ struct JITContext {
     }
     return p;
   }
+
+  // get an array of kernel variant descriptions.
+  cmc_kernel_variant *get_variants(const std::vector<std::string> &names,
+                                   unsigned num_variants,
+                                   const cmc_kernel_variant *variants) {
+    cmc_kernel_variant *p = new (Allocator) cmc_kernel_variant[num_variants];
+    for (unsigned i = 0; i < num_variants; ++i) {
+      unsigned n = variants[i].num_predicates;
+      cmc_arg_predicate *preds = new (Allocator) cmc_arg_predicate[n];
+      std::copy(variants[i].predicates, variants[i].predicates + n, preds);
+      p[i].kernel = get_string(variants[i].kernel);
+      p[i].name = get_string(names[i]);
+      p[i].num_predicates = n;
+      p[i].predicates = preds;
+    }
+    return p;
+  }
 };
 
 } // namespace
@@ -111,15 +129,103 @@ static bool isKernel(Function *F) {
   return F->hasDLLExportStorageClass();
 }
 
+// Convert the variants of the C API to those of cloneCMKernelVariants.
+static std::vector<CMKernelVariant>
+getKernelVariants(unsigned num_variants, const cmc_kernel_variant *variants) {
+  std::vector<CMKernelVariant> Variants(num_variants);
+  for (unsigned i = 0; i < num_variants; ++i) {
+    const cmc_kernel_variant &V = variants[i];
+    Variants[i].Kernel = V.kernel ? V.kernel : "";
+    for (unsigned j = 0; j < V.num_predicates; ++j) {
+      const cmc_arg_predicate &P = V.predicates[j];
+      CMArgPredicate::PredicateKind Kind;
+      switch (P.kind) {
+      case CMC_PREDICATE_VALUE:
+        Kind = CMArgPredicate::Value;
+        break;
+      case CMC_PREDICATE_ALIGN:
+        Kind = CMArgPredicate::Align;
+        break;
+      default:
+        // Make the variant invalid, with an argument index out of range.
+        Kind = CMArgPredicate::Value;
+        Variants[i].Predicates.push_back({~0U, Kind, 0});
+        continue;
+      }
+      Variants[i].Predicates.push_back({P.arg_index, Kind, P.value});
+    }
+  }
+  return Variants;
+}
+
+// Specialized values reach the IR as plain constants. Fold them through and
+// fully unroll loops whose trip counts they decide, so that the specialized
+// kernel is not just the generic one with different operands.
+static void addSpecializationPasses(legacy::PassManagerBase &PM) {
+  PM.add(createSCCPPass());
+  PM.add(createInstructionCombiningPass());
+  PM.add(createCFGSimplificationPass());
+  PM.add(createLoopRotatePass());
+  PM.add(createIndVarSimplifyPass());
+  PM.add(createLoopUnrollPass());
+  PM.add(createInstructionCombiningPass());
+  PM.add(createCFGSimplificationPass());
+}
+
+// Read the options libcmc acts on from compile_options:
+//   -memory-budget=<MB>  cap the memory of the GenX analyses, see
+//                        GenXMemoryBudget.h
+// Other options are ignored.
+static bool parseOptions(const char *Options, unsigned &MemoryBudget) {
+  if (!Options)
+    return true;
+  SmallVector<StringRef, 8> Args;
+  StringRef(Options).split(Args, ' ', -1, false);
+  for (StringRef Arg : Args) {
+    if (Arg.consume_front("-memory-budget=") &&
+        Arg.getAsInteger(10, MemoryBudget))
+      return false;
+  }
+  return true;
+}
+
 cmc_error_t cmc_load_and_compile(const char *input, size_t input_size,
                                  const char *const compile_options,
                                  cmc_jit_info **output) {
+  return cmc_load_and_compile_spec(input, input_size, compile_options, 0,
+                                   nullptr, nullptr, output);
+}
+
+cmc_error_t cmc_load_and_compile_spec(const char *input, size_t input_size,
+                                      const char *const compile_options,
+                                      unsigned num_spec_consts,
+                                      const uint32_t *spec_ids,
+                                      const uint64_t *spec_values,
+                                      cmc_jit_info **output) {
+  return cmc_load_and_compile_variants(input, input_size, compile_options,
+                                       num_spec_consts, spec_ids, spec_values,
+                                       0, nullptr, output);
+}
+
+cmc_error_t cmc_load_and_compile_variants(
+    const char *input, size_t input_size, const char *const compile_options,
+    unsigned num_spec_consts, const uint32_t *spec_ids,
+    const uint64_t *spec_values, unsigned num_variants,
+    const cmc_kernel_variant *variants, cmc_jit_info **output) {
   // Initialize llvm
   LLVMContext Context;
   LLVMInitializeGenXTarget();
   LLVMInitializeGenXTargetInfo();
 
   // Parse options
+  unsigned MemoryBudget = 0;
+  if (!parseOptions(compile_options, MemoryBudget))
+    return cmc_error_t::CMC_ERROR_INVALID_OPTION;
+
+  // Collect specialization constant values.
+  SPIRV::SPIRVSpecConstMap SpecConsts;
+  for (unsigned i = 0; i < num_spec_consts; ++i)
+    SpecConsts[spec_ids[i]] = spec_values[i];
 
   // Parse the input stream
   std::unique_ptr<Module> M;
@@ -128,7 +234,7 @@ cmc_error_t cmc_load_and_compile(const char *input, size_t input_size,
     std::istringstream IS(spirv_input);
     std::string ErrMsg;
     Module *SpirM = nullptr;
-    if (!readSPIRV(Context, IS, SpirM, ErrMsg))
+    if (!readSPIRV(Context, IS, SpirM, ErrMsg, SpecConsts))
       return cmc_error_t::CMC_ERROR_READING_SPIRV;
     if (verifyModule(*SpirM))
       return cmc_error_t::CMC_ERROR_BROKEN_INPUT_IR;
@@ -139,6 +245,20 @@ cmc_error_t cmc_load_and_compile(const char *input, size_t input_size,
     M.reset(SpirM);
   }
 
+  // Add the specialized kernel variants.
+  SmallVector<Function *, 4> VariantClones;
+  if (!cloneCMKernelVariants(*M, getKernelVariants(num_variants, variants),
+                             VariantClones))
+    return cmc_error_t::CMC_ERROR_INVALID_VARIANT;
+  std::vector<std::string> VariantNames;
+  for (Function *F : VariantClones)
+    VariantNames.push_back(F->getName());
+
+  // The GenX backend reads the budget from the module, since options set
+  // through cl::opt would be shared by every compile in the process.
+  if (MemoryBudget)
+    M->addModuleFlag(Module::Override, "genx.memory.budget", MemoryBudget);
+
   // Setup the target machine to compile the input IR.
   output_stream os;
   {
@@ -181,6 +301,20 @@ cmc_error_t cmc_load_and_compile(const char *input, size_t input_size,
     TargetLibraryInfoImpl TLII(Triple(M->getTargetTriple()));
     PM.add(new TargetLibraryInfoWrapperPass(TLII));
 
+    // Specialization constants may be used by any kernel, so fold the whole
+    // module for them. The variants only need their own clones folded.
+    if (!SpecConsts.empty())
+      addSpecializationPasses(PM);
+    else if (!VariantClones.empty()) {
+      legacy::FunctionPassManager FPM(M.get());
+      FPM.add(new TargetLibraryInfoWrapperPass(TLII));
+      addSpecializationPasses(FPM);
+      FPM.doInitialization();
+      for (Function *F : VariantClones)
+        FPM.run(*F);
+      FPM.doFinalization();
+    }
+
     // Recompute argument offset.
     unsigned Width = 32;
     PM.add(createCMKernelArgOffsetPass(Width, /* OCLCodeGen*/true));
@@ -226,6 +360,13 @@ cmc_error_t cmc_load_and_compile(const char *input, size_t input_size,
     info->num_kernels = kernel_names.size();
     info->kernel_info = context->get_kernel_info(kernel_names, arg_descs);
 
+    // variants
+    info->num_variants = num_variants;
+    info->variants = nullptr;
+    if (num_variants)
+      info->variants =
+          context->get_variants(VariantNames, num_variants, variants);
+
     *output = info;
   }
 
@@ -246,6 +387,10 @@ const char *cmc_get_error_string(cmc_error_t err) {
     return "error in loading GenX target";
   case CMC_ERROR_IN_COMPILING_IR:
     return "error in compiling input IR";
+  case CMC_ERROR_INVALID_VARIANT:
+    return "kernel variant does not match the input";
+  case CMC_ERROR_INVALID_OPTION:
+    return "invalid compile option";
   default:
     break;
   }
@@ -21,9 +21,46 @@ typedef enum _cmc_error_t {
   CMC_ERROR_READING_SPIRV      = 2,
   CMC_ERROR_BROKEN_INPUT_IR    = 3,
   CMC_ERROR_IN_LOADING_TARGET  = 4,
-  CMC_ERROR_IN_COMPILING_IR    = 5
+  CMC_ERROR_IN_COMPILING_IR    = 5,
+  CMC_ERROR_INVALID_VARIANT    = 6,
+  CMC_ERROR_INVALID_OPTION     = 7
 } cmc_error_t;
 
+typedef enum _cmc_predicate_kind_t {
+  /// The argument equals the predicate value.
+  CMC_PREDICATE_VALUE          = 0,
+  /// The argument is a multiple of the predicate value, a power of two.
+  CMC_PREDICATE_ALIGN          = 1
+} cmc_predicate_kind_t;
+
+typedef struct _cmc_arg_predicate {
+  /// The index of the kernel argument.
+  unsigned arg_index;
+
+  /// What the predicate says about the argument.
+  cmc_predicate_kind_t kind;
+
+  /// For a value predicate, the bit pattern of the argument zero extended to
+  /// 64 bits. For an alignment predicate, the alignment.
+  uint64_t value;
+
+} cmc_arg_predicate;
+
+typedef struct _cmc_kernel_variant {
+  /// The name of the kernel this is a variant of.
+  const char *kernel;
+
+  /// The name of the variant kernel in the binary. Ignored on input.
+  const char *name;
+
+  /// The number of predicates the variant is specialized on.
+  unsigned num_predicates;
+
+  /// The predicates, all of which must hold to launch the variant.
+  const cmc_arg_predicate *predicates;
+
+} cmc_kernel_variant;
+
 typedef struct _cmc_kernel_info {
   /// The kernel name.
   const char *name;
@@ -59,13 +96,50 @@ typedef struct _cmc_jit_info {
   /// allocations that will be freed in the end.
   void *context;
 
+  /// The number of specialized kernel variants in this binary.
+  unsigned num_variants;
+
+  /// The variant table. The runtime may launch variants[i].name in place of
+  /// variants[i].kernel, with the same arguments, when every predicate of the
+  /// variant holds for them. Variants of one kernel are listed in the order
+  /// they were requested, so the first match is the one to use.
+  cmc_kernel_variant *variants;
+
 } cmc_jit_info;
 
+/// Compile a SPIR-V module to vISA. The options are separated by spaces;
+/// -memory-budget=<MB> caps the memory used by the backend's analyses,
+/// trading optimization for footprint as the cap is approached. Other
+/// options are ignored.
 __EXPORT__ cmc_error_t cmc_load_and_compile(const char *input,
                                             size_t input_size,
                                             const char *const options,
                                             cmc_jit_info **output);
 
+/// Same as cmc_load_and_compile, but the SPIR-V specialization constant with
+/// SpecId spec_ids[i] takes the value spec_values[i], given as the bit pattern
+/// of the constant zero extended to 64 bits. Constants not listed keep their
+/// default. The IR is folded and loops with now constant trip counts are
+/// unrolled before code generation.
+__EXPORT__ cmc_error_t cmc_load_and_compile_spec(const char *input,
+                                                 size_t input_size,
+                                                 const char *const options,
+                                                 unsigned num_spec_consts,
+                                                 const uint32_t *spec_ids,
+                                                 const uint64_t *spec_values,
+                                                 cmc_jit_info **output);
+
+/// Same as cmc_load_and_compile_spec, and in addition compiles a clone of a
+/// kernel for each of the num_variants entries of variants. Each clone is
+/// specialized on its argument predicates and optimized on its own. The
+/// clones are listed in kernel_info with the other kernels and described by
+/// the variant table of the output.
+__EXPORT__ cmc_error_t cmc_load_and_compile_variants(
+    const char *input, size_t input_size, const char *const options,
+    unsigned num_spec_consts, const uint32_t *spec_ids,
+    const uint64_t *spec_values, unsigned num_variants,
+    const cmc_kernel_variant *variants, cmc_jit_info **output);
+
 __EXPORT__ const char *cmc_get_error_string(cmc_error_t err);
 
 __EXPORT__ cmc_error_t cmc_free_jit_info(cmc_jit_info *output);
@@ -274,8 +274,10 @@ private:
 
 class SPIRVToLLVM {
 public:
-  SPIRVToLLVM(Module *LLVMModule, SPIRVModule *TheSPIRVModule)
-      : M(LLVMModule), BM(TheSPIRVModule), DbgTran(BM, M) {
+  SPIRVToLLVM(Module *LLVMModule, SPIRVModule *TheSPIRVModule,
+              const SPIRVSpecConstMap &TheSpecConsts)
+      : M(LLVMModule), BM(TheSPIRVModule), SpecConsts(TheSpecConsts),
+        DbgTran(BM, M) {
     assert(M);
     Context = &M->getContext();
   }
@@ -294,6 +296,7 @@ public:
                     bool CreatePlaceHolder = true);
   Value *transValueWithoutDecoration(SPIRVValue *, Function *F, BasicBlock *,
                                      bool CreatePlaceHolder = true);
+  uint64_t getSpecConstantValue(SPIRVSpecConstant *BConst);
   Value *transDeviceEvent(SPIRVValue *BV, Function *F, BasicBlock *BB);
   Value *transEnqueuedBlock(SPIRVValue *BF, SPIRVValue *BC, SPIRVValue *BCSize,
                             SPIRVValue *BCAligment, Function *F,
@@ -403,6 +406,7 @@ private:
   SPIRVToLLVMFunctionMap FuncMap;
   SPIRVBlockToLLVMStructMap BlockMap;
   SPIRVToLLVMPlaceholderMap PlaceholderMap;
+  const SPIRVSpecConstMap &SpecConsts;
   SPIRVToLLVMDbgTran DbgTran;
 
   Type *mapType(SPIRVType *BT, Type *T) {
@@ -1336,6 +1340,18 @@ Value *SPIRVToLLVM::oclTransConstantPipeStorage(
 /// When CreatePlaceHolder is true, create a load instruction of a
 /// global variable as placeholder for SPIRV instruction. Otherwise,
 /// create instruction and replace placeholder if there is one.
+// Returns the value supplied for a specialization constant through its SpecId,
+// or its default value if none was supplied.
+uint64_t SPIRVToLLVM::getSpecConstantValue(SPIRVSpecConstant *BConst) {
+  SPIRVWord SpecId = 0;
+  if (BConst->hasDecorate(DecorationSpecId, 0, &SpecId)) {
+    auto Loc = SpecConsts.find(SpecId);
+    if (Loc != SpecConsts.end())
+      return Loc->second;
+  }
+  return BConst->getZExtIntValue();
+}
+
 Value *SPIRVToLLVM::transValueWithoutDecoration(SPIRVValue *BV, Function *F,
                                                 BasicBlock *BB,
                                                 bool CreatePlaceHolder) {
@@ -1345,15 +1361,19 @@ Value *SPIRVToLLVM::transValueWithoutDecoration(SPIRVValue *BV, Function *F,
 
   // Translation of non-instruction values
   switch (OC) {
-  case OpConstant: {
-    SPIRVConstant *BConst = static_cast<SPIRVConstant *>(BV);
+  case OpConstant:
+  case OpSpecConstant: {
+    uint64_t ConstValue =
+        OC == OpConstant
+            ? static_cast<SPIRVConstant *>(BV)->getZExtIntValue()
+            : getSpecConstantValue(static_cast<SPIRVSpecConstant *>(BV));
     SPIRVType *BT = BV->getType();
     Type *LT = transType(BT);
     switch (BT->getOpCode()) {
     case OpTypeBool:
     case OpTypeInt:
       return mapValue(
-          BV, ConstantInt::get(LT, BConst->getZExtIntValue(),
+          BV, ConstantInt::get(LT, ConstValue,
                                static_cast<SPIRVTypeInt *>(BT)->isSigned()));
     case OpTypeFloat: {
       const llvm::fltSemantics *FS = nullptr;
@@ -1373,7 +1393,7 @@ Value *SPIRVToLLVM::transValueWithoutDecoration(SPIRVValue *BV, Function *F,
       return mapValue(
           BV, ConstantFP::get(*Context,
                               APFloat(*FS, APInt(BT->getFloatBitWidth(),
-                                                 BConst->getZExtIntValue()))));
+                                                 ConstValue))));
     }
     default:
       llvm_unreachable("Not implemented");
@@ -3124,12 +3144,17 @@ Instruction *SPIRVToLLVM::transOCLRelational(SPIRVInstruction *I,
 
 bool llvm::readSPIRV(LLVMContext &C, std::istream &IS, Module *&M,
                      std::string &ErrMsg) {
+  return readSPIRV(C, IS, M, ErrMsg, SPIRVSpecConstMap());
+}
+
+bool llvm::readSPIRV(LLVMContext &C, std::istream &IS, Module *&M,
+                     std::string &ErrMsg, const SPIRVSpecConstMap &SpecConsts) {
   M = new Module("", C);
   std::unique_ptr<SPIRVModule> BM(SPIRVModule::createSPIRVModule());
 
   IS >> *BM;
 
-  SPIRVToLLVM BTL(M, BM.get());
+  SPIRVToLLVM BTL(M, BM.get(), SpecConsts);
   bool Succeed = true;
   if (!BTL.translate()) {
     BM->getError(ErrMsg);
@@ -735,7 +735,6 @@ _SPIRV_OP(TypeMatrix)
 _SPIRV_OP(TypeRuntimeArray)
 _SPIRV_OP(SpecConstantTrue)
 _SPIRV_OP(SpecConstantFalse)
-_SPIRV_OP(SpecConstant)
 _SPIRV_OP(SpecConstantComposite)
 _SPIRV_OP(Image)
 _SPIRV_OP(ImageTexelPointer)
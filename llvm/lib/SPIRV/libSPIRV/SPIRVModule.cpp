@@ -549,7 +549,7 @@ void SPIRVModuleImpl::layoutEntry(SPIRVEntry *E) {
     if (isTypeOpCode(OC))
       TypeVec.push_back(static_cast<SPIRVType *>(E));
     else if (isConstantOpCode(OC))
-      ConstVec.push_back(static_cast<SPIRVConstant *>(E));
+      ConstVec.push_back(static_cast<SPIRVValue *>(E));
     break;
   }
 }
@@ -1299,7 +1299,7 @@ class TopologicalSort {
     if (OC == OpTypeInt)
       TypeIntVec.push_back(static_cast<SPIRVType *>(E));
     else if (isConstantOpCode(OC)) {
-      SPIRVConstant *C = static_cast<SPIRVConstant *>(E);
+      SPIRVValue *C = static_cast<SPIRVValue *>(E);
       if (C->getType()->isTypeInt())
         ConstIntVec.push_back(C);
       else
@@ -52,7 +52,8 @@
 namespace SPIRV {
 
 class SPIRVBasicBlock;
-class SPIRVConstant;
+template <spv::Op> class SPIRVConstantBase;
+typedef SPIRVConstantBase<spv::OpConstant> SPIRVConstant;
 class SPIRVEntry;
 class SPIRVFunction;
 class SPIRVInstruction;
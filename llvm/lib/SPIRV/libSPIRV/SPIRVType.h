@@ -311,7 +311,8 @@ private:
   SPIRVWord CompCount; // Component Count
 };
 
-class SPIRVConstant;
+template <spv::Op> class SPIRVConstantBase;
+typedef SPIRVConstantBase<spv::OpConstant> SPIRVConstant;
 class SPIRVTypeArray : public SPIRVType {
 public:
   // Complete constructor
@@ -123,34 +123,34 @@ protected:
   SPIRVType *Type; // Value Type
 };
 
-class SPIRVConstant : public SPIRVValue {
+template <Op OC> class SPIRVConstantBase : public SPIRVValue {
 public:
   // Complete constructor for integer constant
-  SPIRVConstant(SPIRVModule *M, SPIRVType *TheType, SPIRVId TheId,
-                uint64_t TheValue)
-      : SPIRVValue(M, 0, OpConstant, TheType, TheId) {
+  SPIRVConstantBase(SPIRVModule *M, SPIRVType *TheType, SPIRVId TheId,
+                    uint64_t TheValue)
+      : SPIRVValue(M, 0, OC, TheType, TheId) {
     Union.UInt64Val = TheValue;
     recalculateWordCount();
     validate();
   }
   // Complete constructor for float constant
-  SPIRVConstant(SPIRVModule *M, SPIRVType *TheType, SPIRVId TheId,
-                float TheValue)
-      : SPIRVValue(M, 0, OpConstant, TheType, TheId) {
+  SPIRVConstantBase(SPIRVModule *M, SPIRVType *TheType, SPIRVId TheId,
+                    float TheValue)
+      : SPIRVValue(M, 0, OC, TheType, TheId) {
     Union.FloatVal = TheValue;
     recalculateWordCount();
     validate();
   }
   // Complete constructor for double constant
-  SPIRVConstant(SPIRVModule *M, SPIRVType *TheType, SPIRVId TheId,
-                double TheValue)
-      : SPIRVValue(M, 0, OpConstant, TheType, TheId) {
+  SPIRVConstantBase(SPIRVModule *M, SPIRVType *TheType, SPIRVId TheId,
+                    double TheValue)
+      : SPIRVValue(M, 0, OC, TheType, TheId) {
     Union.DoubleVal = TheValue;
     recalculateWordCount();
     validate();
   }
   // Incomplete constructor
-  SPIRVConstant() : SPIRVValue(OpConstant), NumWords(0) {}
+  SPIRVConstantBase() : SPIRVValue(OC), NumWords(0) {}
   uint64_t getZExtIntValue() const { return Union.UInt64Val; }
   float getFloatValue() const { return Union.FloatVal; }
   double getDoubleValue() const { return Union.DoubleVal; }
@@ -191,6 +191,9 @@ protected:
   } Union;
 };
 
+typedef SPIRVConstantBase<OpConstant> SPIRVConstant;
+typedef SPIRVConstantBase<OpSpecConstant> SPIRVSpecConstant;
+
 template <Op OC> class SPIRVConstantEmpty : public SPIRVValue {
 public:
   // Complete constructor
@@ -33,6 +33,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "FunctionGroup.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/IR/Dominators.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/LegacyPassManagers.h"
@@ -185,6 +186,8 @@ public:
 private:
   bool RunAllPassesOnFunctionGroup(FunctionGroup &FG);
   bool RunPassOnFunctionGroup(Pass *P, FunctionGroup &FG);
+  size_t getTrackedMemory();
+  void releaseUnneededAnalyses(unsigned PassNo, genx::MemoryBudget &Budget);
 };
 
 } // end anonymous namespace.
@@ -228,6 +231,7 @@ bool FGPassManager::RunPassOnFunctionGroup(Pass *P, FunctionGroup &FG)
 bool FGPassManager::RunAllPassesOnFunctionGroup(FunctionGroup &FG)
 {
   bool Changed = false;
+  genx::MemoryBudget &Budget = FG.getParent()->getMemoryBudget();
   // Run all passes on current FunctionGroup.
   for (unsigned PassNo = 0, e = getNumContainedPasses();
        PassNo != e; ++PassNo) {
@@ -242,14 +246,100 @@ bool FGPassManager::RunAllPassesOnFunctionGroup(FunctionGroup &FG)
       dumpPassInfo(P, MODIFICATION_MSG, ON_FG_MSG, "");
     dumpPreservedSet(P);
 
+    // Measure before anything is freed, which is what the pass ran with.
+    if (Budget.isActive()) {
+      Budget.setTracked(getTrackedMemory());
+      Budget.recordPass(P->getPassName());
+    }
+
     verifyPreservedAnalysis(P);
     removeNotPreservedAnalysis(P);
     recordAvailableAnalysis(P);
     removeDeadPasses(P, "", ON_FG_MSG);
+
+    if (Budget.isActive()) {
+      Budget.setTracked(getTrackedMemory());
+      if (Budget.isOverBudget()) {
+        releaseUnneededAnalyses(PassNo, Budget);
+        Budget.setTracked(getTrackedMemory());
+      }
+    }
   }
   return Changed;
 }
 
+/// getTrackedMemory - Sum the memory footprints of the FunctionGroup passes.
+/// This includes analyses that are no longer available but still hold their
+/// results, as that memory is not returned until they are released or run
+/// again.
+size_t FGPassManager::getTrackedMemory()
+{
+  size_t Bytes = 0;
+  for (unsigned i = 0, e = getNumContainedPasses(); i != e; ++i) {
+    Pass *P = getContainedPass(i);
+    if (!P->getAsPMDataManager())
+      Bytes += static_cast<FunctionGroupPass *>(P)->getMemoryFootprint();
+  }
+  return Bytes;
+}
+
+/// releaseUnneededAnalyses - Over the memory budget, release the results of
+/// FunctionGroup analyses that no pass after PassNo needs on this
+/// FunctionGroup: available ones that would otherwise be kept until their
+/// last user, and invalidated ones that would otherwise be kept until they
+/// next run. An analysis counts as needed if a remaining pass requires or
+/// uses it, directly or through another needed analysis, or a needed analysis
+/// holds pointers into its results (FunctionGroupPass::getHeldAnalyses).
+void FGPassManager::releaseUnneededAnalyses(unsigned PassNo,
+                                            genx::MemoryBudget &Budget)
+{
+  SmallPtrSet<AnalysisID, 16> Needed;
+  SmallVector<AnalysisID, 16> Worklist;
+  auto AddNeeded = [&](Pass *P) {
+    AnalysisUsage *AU = getTopLevelManager()->findAnalysisUsage(P);
+    SmallVector<AnalysisID, 4> Held;
+    if (P->getPotentialPassManagerType() == PMT_FunctionGroupPassManager)
+      static_cast<FunctionGroupPass *>(P)->getHeldAnalyses(Held);
+    for (auto Set : {&AU->getRequiredSet(), &AU->getRequiredTransitiveSet(),
+                     &AU->getUsedSet(), &Held})
+      for (AnalysisID ID : *Set)
+        if (Needed.insert(ID).second)
+          Worklist.push_back(ID);
+  };
+  for (unsigned i = PassNo + 1, e = getNumContainedPasses(); i != e; ++i) {
+    Pass *P = getContainedPass(i);
+    if (!P->getAsPMDataManager()) {
+      AddNeeded(P);
+      continue;
+    }
+    FPPassManager *FPP = (FPPassManager*)P;
+    for (unsigned j = 0, je = FPP->getNumContainedPasses(); j != je; ++j)
+      AddNeeded(FPP->getContainedPass(j));
+  }
+  while (!Worklist.empty())
+    if (Pass *P = findAnalysisPass(Worklist.pop_back_val(), true))
+      AddNeeded(P);
+
+  auto &Available = *getAvailableAnalysis();
+  for (unsigned i = 0, e = getNumContainedPasses(); i != e; ++i) {
+    Pass *P = getContainedPass(i);
+    if (P->getAsPMDataManager() ||
+        !static_cast<FunctionGroupPass *>(P)->getMemoryFootprint())
+      continue;
+    // Another instance of the same analysis may be the available one, so
+    // only free this one through the pass manager if it is.
+    if (Available.lookup(P->getPassID()) == P) {
+      if (Needed.count(P->getPassID()))
+        continue;
+      freePass(P, "", ON_FG_MSG);
+    } else
+      P->releaseMemory();
+    DEBUG(dbgs() << "Released " << P->getPassName()
+                 << " early to stay within the memory budget\n");
+    Budget.noteReleased();
+  }
+}
+
 /// run - Execute all of the passes scheduled for execution.  Keep track of
 /// whether any of the passes modifies the module, and if so, return true.
 bool FGPassManager::runOnModule(Module &M)
@@ -293,6 +383,7 @@ bool FGPassManager::doFinalization(FunctionGroupAnalysis &FGA)
       Changed |= ((FunctionGroupPass*)getContainedPass(i))->doFinalization(FGA);
     }
   }
+  FGA.getMemoryBudget().print(errs());
   return Changed;
 }
 
@@ -42,6 +42,7 @@
 #ifndef FUNCTIONGROUP_H
 #define FUNCTIONGROUP_H
 
+#include "GenXMemoryBudget.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/ValueHandle.h"
@@ -94,6 +95,7 @@ class FunctionGroupAnalysis : public ModulePass {
   Module *M;
   SmallVector<FunctionGroup *, 8> Groups;
   std::map<Function *, FunctionGroup *> GroupMap;
+  genx::MemoryBudget Budget;
 
 public:
   static char ID;
@@ -101,11 +103,18 @@ public:
   ~FunctionGroupAnalysis() { clear(); }
   virtual StringRef getPassName() const { return "function group analysis"; }
   // runOnModule : does almost nothing
-  bool runOnModule(Module &ArgM) { clear(); M = &ArgM; return false; }
+  bool runOnModule(Module &ArgM) {
+    clear();
+    M = &ArgM;
+    Budget.init(ArgM);
+    return false;
+  }
   // getModule : get the Module that this FunctionGroupAnalysis is for
   Module *getModule() { return M; }
   // clear : clear out the FunctionGroupAnalysis
   void clear();
+  // getMemoryBudget : get the memory budget for the FunctionGroup passes
+  genx::MemoryBudget &getMemoryBudget() { return Budget; }
   // getGroup : get the FunctionGroup containing Function F, else 0
   FunctionGroup *getGroup(Function *F);
   // getGroupForHead : get the FunctionGroup for which Function F is the
@@ -163,6 +172,16 @@ public:
     return false;
   }
 
+  // getMemoryFootprint - An analysis should return an estimate of the bytes
+  // it currently holds, so that the pass manager can keep the FunctionGroup
+  // passes within the memory budget (see GenXMemoryBudget.h).
+  virtual size_t getMemoryFootprint() const { return 0; }
+
+  // getHeldAnalyses - An analysis whose results point into other analyses'
+  // results should add those analyses' IDs, so that the pass manager does not
+  // release them early while this one is still needed.
+  virtual void getHeldAnalyses(SmallVectorImpl<AnalysisID> &IDs) const {}
+
   // Assign pass manager to manager this pass
   void assignPassManager(PMStack &PMS, PassManagerType PMT) override;
 
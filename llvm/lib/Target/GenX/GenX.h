@@ -48,6 +48,7 @@ class FunctionGroup;
 class FunctionGroupPass;
 class FunctionPass;
 class GenXSubtarget;
+class GenXTargetMachine;
 class Instruction;
 class MDNode;
 class ModulePass;
@@ -83,6 +84,7 @@ FunctionPass *createGenXLegalizationPass();
 ModulePass *createGenXEmulatePass();
 FunctionPass *createGenXDeadVectorRemovalPass();
 FunctionPass *createGenXPatternMatchPass(const TargetOptions *Options);
+FunctionPass *createGenXDivRemReductionPass();
 FunctionPass *createGenXPostLegalizationPass();
 FunctionPass *createTransformPrivMemPass();
 FunctionPass *createGenXPromotePredicatePass();
@@ -105,6 +107,8 @@ FunctionPass *createGenXTidyControlFlowPass();
 FunctionGroupPass *createGenXVisaRegAllocPass();
 FunctionGroupPass *createGenXVisaFuncWriterPass();
 ModulePass *createGenXVisaWriterPass(raw_pwrite_stream &o);
+ModulePass *createGenXDeterminismCheckPass(GenXTargetMachine *TM,
+                                          bool DisableVerify);
 
 // Utility function to get the integral log base 2 of an integer, or -1 if
 // the input is not a power of 2.
@@ -259,6 +263,8 @@ inline bool skipOptWithLargeBlock(const Function &F) {
                      [](const BasicBlock &BB) { return BB.size() >= 5000; });
 }
 
+// Skip optimizations on function groups with large blocks, or whose
+// analyses are already near the memory budget (see GenXMemoryBudget.h).
 bool skipOptWithLargeBlock(FunctionGroup &FG);
 
 // isRdRegion : test whether the intrinsic id is rdregion
@@ -94,6 +94,7 @@
 #include "GenXNumbering.h"
 #include "GenXRegion.h"
 #include "llvm/ADT/DepthFirstIterator.h"
+#include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/Analysis/CFG.h"
 #include "llvm/IR/BasicBlock.h"
@@ -197,7 +198,10 @@ private:
   bool processCommonAddrs(ArrayRef<Instruction *> Addrs);
   void processCommonAddrsWithValidOffsets(ArrayRef<Instruction *> Addrs);
   bool vectorizeAddrs(LiveRange *LR);
-  void addAddrConvIfExtract(std::map<std::pair<Value *, int>, ExtractBucket> *ExtractBuckets, Value *Index);
+  // Buckets of address conversions extracting from the same vector, in the
+  // order they are first seen.
+  typedef MapVector<std::pair<Value *, int>, ExtractBucket> ExtractBuckets_t;
+  void addAddrConvIfExtract(ExtractBuckets_t *ExtractBuckets, Value *Index);
   bool vectorizeAddrsFromOneVector(ArrayRef<Instruction *> Addrs);
   DominatorTree *getDominatorTree();
   bool isValueInCurrentFunc(Value *V);
@@ -314,8 +318,9 @@ bool GenXAddressCommoning::processBaseReg(LiveRange *LR)
 {
   // Gather the address conversions used by regions of this base register into
   // buckets, one for each distinct input. A bucket discards duplicate address
-  // conversions.
-  std::map<Bale, Bucket> Buckets;
+  // conversions. The bale hash includes pointer values, so the buckets are
+  // kept in the order they are first seen rather than in hash order.
+  MapVector<Bale, Bucket, std::map<Bale, unsigned>> Buckets;
   for (auto vi = LR->value_begin(), ve = LR->value_end(); vi != ve; ++vi) {
     Value *V = vi->getValue();
     // Ignore the value if it is in the wrong function. That can happen because
@@ -646,7 +651,7 @@ bool GenXAddressCommoning::vectorizeAddrs(LiveRange *LR)
   // Gather the address conversions from an extract from a vector used by
   // regions of this base register into buckets, one for each distinct vector
   // being extracted from and each distinct address conversion offset.
-  std::map<std::pair<Value *, int>, ExtractBucket> ExtractBuckets;
+  ExtractBuckets_t ExtractBuckets;
   for (auto vi = LR->value_begin(), ve = LR->value_end(); vi != ve; ++vi) {
     Value *V = vi->getValue();
     // Ignore the value if it is in the wrong function. That can happen because
@@ -694,7 +699,7 @@ bool GenXAddressCommoning::vectorizeAddrs(LiveRange *LR)
  * vector that the extract is extracted from.
  */
 void GenXAddressCommoning::addAddrConvIfExtract(
-    std::map<std::pair<Value *, int>, ExtractBucket> *ExtractBuckets, Value *Index)
+    ExtractBuckets_t *ExtractBuckets, Value *Index)
 {
   while (getIntrinsicID(Index) == Intrinsic::genx_add_addr)
     Index = cast<Instruction>(Index)->getOperand(0);
@@ -30,6 +30,7 @@
 
 #include "FunctionGroup.h"
 #include "GenX.h"
+#include "GenXNumbering.h"
 #include "llvm/IR/IntrinsicsGenX.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/FileSystem.h"
@@ -67,6 +68,9 @@ public:
   virtual StringRef getPassName() const { return "GenX analysis dumper pass"; }
   void getAnalysisUsage(AnalysisUsage &AU) const {
     FunctionGroupPass::getAnalysisUsage(AU);
+    // The dumped analyses print instruction numbers, so keep the numbering
+    // alive until the dump.
+    AU.addUsedIfAvailable<GenXNumbering>();
     AU.setPreservesAll();
   }
   bool runOnFunctionGroup(FunctionGroup &FG);
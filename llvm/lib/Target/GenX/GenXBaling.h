@@ -395,6 +395,11 @@ public:
     Kind(_Kind), ST(_ST), Liveness(nullptr) {}
   // clear : clear out the analysis
   void clear() { InstMap.clear(); }
+  // getInstMapFootprint : estimate the bytes held by the baling info
+  size_t getInstMapFootprint() const {
+    return genx::MemoryBudget::getValueMapFootprint(InstMap.size(),
+                                                    sizeof(genx::BaleInfo));
+  }
   // processFunctionGroup : process all the Functions in a FunctionGroup
   bool processFunctionGroup(FunctionGroup *FG);
   // processFunction : process one Function
@@ -504,6 +509,7 @@ public:
   }
   void getAnalysisUsage(AnalysisUsage &AU) const;
   bool runOnFunctionGroup(FunctionGroup &FG);
+  size_t getMemoryFootprint() const override { return getInstMapFootprint(); }
   // createPrinterPass : get a pass to print the IR, together with the GenX
   // specific analyses
   virtual Pass *createPrinterPass(raw_ostream &O,
@@ -187,6 +187,7 @@
 #include "GenXNumbering.h"
 #include "GenXRegion.h"
 #include "GenXSubtarget.h"
+#include "llvm/ADT/SetVector.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DebugInfo.h"
@@ -1359,8 +1360,9 @@ void GenXCoalescing::coalesceGlobalLoads(FunctionGroup *FG) {
     if (!LR1)
       continue;
 
-    // Collect all loads.
-    std::set<Instruction *> LoadsInGroup;
+    // Collect all loads, in use list order rather than pointer order, as
+    // that is the order they get coalesced in.
+    SetVector<Instruction *> LoadsInGroup;
     for (auto UI : GV.users()) {
       if (auto LI = dyn_cast<LoadInst>(UI)) {
         assert(LI->getPointerOperand() == &GV);
@@ -48,13 +48,37 @@
 ///       of defs and uses from each other to reduce register pressure in
 ///       between.
 ///
+/// 3. An intrinsic with side effects (such as an atomic) is always kept, but
+///    its result may still be dead. Its two address "old value" input is
+///    only live where the result is live, and if no element of the result is
+///    used then the old value input is set to undef and the uses of the
+///    result are nulled out. For an intrinsic whose result is marked
+///    RAW_NULLALLOWED, that leaves the result unused, so it gets no register
+///    and the message is emitted in its no-return form with a V0
+///    destination.
+///
+/// 4. A gather4 message (gather4_typed, gather4_scaled or svm_gather4_scaled)
+///    reads every channel enabled in its channel mask, and its result holds
+///    one row of elements per enabled channel. If all the elements of a
+///    channel's row are unused, that channel is dropped from the channel mask,
+///    so the message has a shorter response, and the remaining rows are
+///    packed together in a narrower result. This is only done when each use
+///    of the result is a rdregion that reads from a single row, which is then
+///    moved to the row's new position, and when the "old value" input is
+///    constant, so that it can be packed in the same way. It can be disabled
+///    with -genx-dvr-narrow-channels=false.
+///
 //===----------------------------------------------------------------------===//
 #define DEBUG_TYPE "GENX_DEAD_VECTOR_REMOVAL"
 
 #include "GenX.h"
 #include "GenXBaling.h"
+#include "GenXIntrinsics.h"
 #include "GenXRegion.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SmallBitVector.h"
 #include "llvm/Analysis/CFG.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Function.h"
@@ -64,8 +88,9 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 
+#include <algorithm>
 #include <queue>
-#include <set>
+#include <vector>
 
 using namespace llvm;
 using namespace genx;
@@ -74,52 +99,13 @@ using namespace Intrinsic::GenXRegion;
 static cl::opt<unsigned> LimitGenXDeadVectorRemoval("limit-genx-dead-vector-removal", cl::init(UINT_MAX), cl::Hidden,
                                       cl::desc("Limit GenX dead element removal."));
 
-namespace {
+static cl::opt<bool> NarrowChannels("genx-dvr-narrow-channels", cl::init(true), cl::Hidden,
+                                    cl::desc("Narrow gather4 channel masks to the channels used."));
 
-// LiveBitsStorage : encapsulate how live bits for a vector value are stored
-// For 31/63 elements or fewer, the bitmap is inside the LiveBitsStorage
-// object. For 32/64 elements or more, the bitmap is separately allocated.
-class LiveBitsStorage {
-  uintptr_t V;
-public:
-  LiveBitsStorage() : V(0) {}
-  ~LiveBitsStorage() {
-    if (auto P = getExternal())
-      delete[] P;
-    V = 0;
-  }
-private:
-  // getExternal : get the external pointer, 0 if none
-  // Whether we have an external pointer is encoded in the top bit.
-  // The pointer itself is shifted down one and stored in the other bits.
-  uintptr_t *getExternal() {
-    if ((intptr_t)V >= 0)
-      return nullptr; // top bit not set, not external
-    return (uintptr_t *)(V * 2);
-  }
-  // setExternal : set the external pointer
-  void setExternal(uintptr_t *P) {
-    assert(!getExternal());
-    V = (uintptr_t)P >> 1 | (uintptr_t)1U << (sizeof(uintptr_t) * 8 - 1);
-  }
-public:
-  // setNumElements : set the number of elements to be stored in this
-  // LiveBitsStorage. Allocate external storage if necessary.
-  void setNumElements(unsigned NumElements) {
-    if (NumElements >= sizeof(uintptr_t) * 8 - 1) {
-      unsigned Size = NumElements + sizeof(uintptr_t) * 8 - 1
-            / (sizeof(uintptr_t) * 8);
-      setExternal(new uintptr_t[Size]);
-      memset(getExternal(), 0, Size * sizeof(uintptr_t));
-    }
-  }
-  // get : get the pointer to the bitmap
-  uintptr_t *get() {
-    if (auto P = getExternal())
-      return P;
-    return &V;
-  }
-};
+static cl::opt<bool> ReverseWorkList("genx-dvr-reverse-worklist", cl::init(false), cl::Hidden,
+                                     cl::desc("Seed the work list in reverse instruction order (for testing)."));
+
+namespace {
 
 // LiveBits : encapsulate a pointer to a bitmap of element liveness and its size
 class LiveBits {
@@ -128,8 +114,8 @@ class LiveBits {
 public:
   static const unsigned BitsPerWord = sizeof(uintptr_t) * 8;
   LiveBits() : P(nullptr), NumElements(0) {}
-  LiveBits(LiveBitsStorage *LBS, unsigned NumElements)
-    : P(LBS->get()), NumElements(NumElements) {}
+  LiveBits(uintptr_t *P, unsigned NumElements)
+    : P(P), NumElements(NumElements) {}
   // getNumElements : get the number of elements in this bitmap
   unsigned getNumElements() const { return NumElements; }
   // get : get a bit value
@@ -161,12 +147,28 @@ static raw_ostream &operator<<(raw_ostream &OS, const LiveBits &LB) {
 }
 #endif
 
+// getNumLiveBits : get the number of elements tracked for an instruction
+static unsigned getNumLiveBits(Instruction *Inst) {
+  if (auto VT = dyn_cast<VectorType>(Inst->getType()))
+    return VT->getNumElements();
+  return 1;
+}
+
 // GenXDeadVectorRemoval : dead vector element removal pass
 class GenXDeadVectorRemoval : public FunctionPass {
-  std::map<Instruction *, LiveBitsStorage> InstMap;
-  std::set<Instruction *> WorkListSet;
-  std::queue<Instruction *> WorkList;
-  std::set<Instruction *> WrRegionsWithUsedOldInput;
+  // Dense numbering of the instructions in the function, and the reverse.
+  DenseMap<Instruction *, unsigned> InstNums;
+  std::vector<Instruction *> Insts;
+  // The live bits of all instructions, in one allocation. Those of
+  // instruction number N start at word LiveWordOffsets[N], and are only
+  // meaningful once HasLiveBits[N] is set.
+  std::vector<uintptr_t> LiveWords;
+  std::vector<unsigned> LiveWordOffsets;
+  BitVector HasLiveBits;
+  // Instruction numbers on the work list, and which instructions are there.
+  std::queue<unsigned> WorkList;
+  BitVector InWorkList;
+  BitVector WrRegionsWithUsedOldInput;
   bool WorkListPhase;
 public:
   static char ID;
@@ -176,20 +178,34 @@ public:
   bool runOnFunction(Function &F);
 private:
   void clear() {
-    InstMap.clear();
-    WorkListSet.clear();
+    InstNums.clear();
+    Insts.clear();
+    LiveWords.clear();
+    LiveWordOffsets.clear();
+    HasLiveBits.clear();
     assert(WorkList.empty());
+    InWorkList.clear();
     WrRegionsWithUsedOldInput.clear();
   }
+  void numberInstructions(Function *F);
   bool nullOutInstructions(Function *F);
+  bool narrowChannelMasks(Function *F);
+  bool narrowChannelMask(CallInst *CI);
   void processInst(Instruction *Inst);
   void processRdRegion(Instruction *Inst, LiveBits LB);
   void processWrRegion(Instruction *Inst, LiveBits LB);
   void processBitCast(Instruction *Inst, LiveBits LB);
   void processElementwise(Instruction *Inst, LiveBits LB);
+  void processRootInst(Instruction *Inst);
+  bool nullOutRootResult(Instruction *Inst);
   void markWhollyLive(Value *V);
   void addToWorkList(Instruction *Inst);
   LiveBits getLiveBits(Instruction *Inst, bool Create = false);
+  unsigned getInstNum(Instruction *Inst) const {
+    auto i = InstNums.find(Inst);
+    assert(i != InstNums.end() && "instruction not numbered");
+    return i->second;
+  }
 };
 
 } // end anonymous namespace
@@ -229,6 +245,7 @@ static bool isRootInst(Instruction *Inst) {
  */
 bool GenXDeadVectorRemoval::runOnFunction(Function &F)
 {
+  numberInstructions(&F);
   // First scan all the code to compute the initial live set
   WorkListPhase = false;
   for (po_iterator<BasicBlock *> i = po_begin(&F.getEntryBlock()),
@@ -237,9 +254,9 @@ bool GenXDeadVectorRemoval::runOnFunction(Function &F)
     for (Instruction *Inst = BB->getTerminator(); Inst;) {
       if (isRootInst(Inst))
         processInst(Inst);
-      else if (WorkListSet.count(Inst)) {
+      else if (InWorkList.test(getInstNum(Inst))) {
         if (!isa<PHINode>(Inst))
-          WorkListSet.erase(Inst);
+          InWorkList.reset(getInstNum(Inst));
         processInst(Inst);
       }
       Inst = (Inst == &BB->front()) ? nullptr : Inst->getPrevNode();
@@ -247,26 +264,63 @@ bool GenXDeadVectorRemoval::runOnFunction(Function &F)
   }
 
   WorkListPhase = true;
-  // initialize the worklist
-  for (auto Inst : WorkListSet) {
-    WorkList.push(Inst);
+  // initialize the worklist. The fixpoint does not depend on the order, which
+  // -genx-dvr-reverse-worklist lets a test check.
+  if (ReverseWorkList) {
+    for (int Num = InWorkList.find_last(); Num >= 0;
+         Num = InWorkList.find_prev(Num))
+      WorkList.push(Num);
+  } else {
+    for (int Num = InWorkList.find_first(); Num >= 0;
+         Num = InWorkList.find_next(Num))
+      WorkList.push(Num);
   }
   // process until the work list is empty.
   DEBUG(dbgs() << "GenXDeadVectorRemoval: process work list\n");
   while (!WorkList.empty()) {
-    Instruction *Inst = WorkList.front();
+    unsigned Num = WorkList.front();
     WorkList.pop();
-    WorkListSet.erase(Inst);
-    processInst(Inst);
+    InWorkList.reset(Num);
+    processInst(Insts[Num]);
   }
   // Null out unused instructions so the subsequent dead code removal pass
   // removes them.
   DEBUG(dbgs() << "GenXDeadVectorRemoval: null out instructions\n");
   bool Modified = nullOutInstructions(&F);
+  // Narrow the channel masks of gather4 messages whose channels are not all
+  // used.
+  if (NarrowChannels)
+    Modified |= narrowChannelMasks(&F);
   clear();
   return Modified;
 }
 
+/***********************************************************************
+ * numberInstructions : number the instructions in the function and lay out
+ *    their live bits
+ *
+ * The bitmaps of all instructions are allocated here in one go, so a
+ * LiveBits stays valid while the bitmaps of other instructions are created.
+ */
+void GenXDeadVectorRemoval::numberInstructions(Function *F)
+{
+  unsigned NumWords = 0;
+  for (auto fi = F->begin(), fe = F->end(); fi != fe; ++fi) {
+    for (auto bi = fi->begin(), be = fi->end(); bi != be; ++bi) {
+      Instruction *Inst = &*bi;
+      InstNums[Inst] = Insts.size();
+      Insts.push_back(Inst);
+      LiveWordOffsets.push_back(NumWords);
+      NumWords += (getNumLiveBits(Inst) + LiveBits::BitsPerWord - 1)
+          / LiveBits::BitsPerWord;
+    }
+  }
+  LiveWords.assign(NumWords, 0);
+  HasLiveBits.resize(Insts.size());
+  InWorkList.resize(Insts.size());
+  WrRegionsWithUsedOldInput.resize(Insts.size());
+}
+
 /***********************************************************************
  * nullOutInstructions : null out unused instructions so the subsequent dead
  * code removal pass removes them
@@ -284,9 +338,17 @@ bool GenXDeadVectorRemoval::nullOutInstructions(Function *F)
   for (auto fi = F->begin(), fe = F->end(); fi != fe; ++fi) {
     for (auto bi = fi->begin(), be = fi->end(); bi != be; ++bi) {
       Instruction *Inst = &*bi;
-      // Ignore "root" instructions.
-      if (isRootInst(Inst))
+      // A "root" instruction is kept, but its result may be dead.
+      if (isRootInst(Inst)) {
+        if (nullOutRootResult(Inst)) {
+          if (++Count > LimitGenXDeadVectorRemoval)
+            return Modified;
+          if (LimitGenXDeadVectorRemoval != UINT_MAX)
+            dbgs() << "-limit-genx-dead-vector-removal " << Count << "\n";
+          Modified = true;
+        }
         continue;
+      }
       // See if the instruction has no used elements. If so, null out its uses.
       auto LB = getLiveBits(Inst);
       if (LB.isAllZero()) {
@@ -307,8 +369,7 @@ bool GenXDeadVectorRemoval::nullOutInstructions(Function *F)
         // instruction (even if it has bits set from other uses), and we can
         // undef out the input.
         Use *U = &Inst->getOperandUse(Intrinsic::GenXRegion::OldValueOperandNum);
-        if (WrRegionsWithUsedOldInput.find(Inst)
-          == WrRegionsWithUsedOldInput.end()) {
+        if (!WrRegionsWithUsedOldInput.test(getInstNum(Inst))) {
           if (!isa<UndefValue>(*U)) {
             if (++Count > LimitGenXDeadVectorRemoval)
               return Modified;
@@ -346,6 +407,173 @@ bool GenXDeadVectorRemoval::nullOutInstructions(Function *F)
   return Modified;
 }
 
+/***********************************************************************
+ * narrowChannelMasks : narrow the channel mask of each gather4 message to
+ *    the channels whose result is used
+ *
+ * This runs after nullOutInstructions, so a rdregion of a gather4 result
+ * that has no live elements has already had its uses nulled out.
+ */
+bool GenXDeadVectorRemoval::narrowChannelMasks(Function *F)
+{
+  SmallVector<CallInst *, 4> Gathers;
+  for (auto fi = F->begin(), fe = F->end(); fi != fe; ++fi) {
+    for (auto bi = fi->begin(), be = fi->end(); bi != be; ++bi) {
+      switch (getIntrinsicID(&*bi)) {
+        case Intrinsic::genx_gather4_typed:
+        case Intrinsic::genx_gather4_scaled:
+        case Intrinsic::genx_svm_gather4_scaled:
+          Gathers.push_back(cast<CallInst>(&*bi));
+          break;
+      }
+    }
+  }
+  bool Modified = false;
+  for (auto CI : Gathers)
+    Modified |= narrowChannelMask(CI);
+  return Modified;
+}
+
+/***********************************************************************
+ * narrowChannelMask : narrow the channel mask of one gather4 message
+ *
+ * Enter:   CI = the gather4_typed, gather4_scaled or svm_gather4_scaled
+ *
+ * Return:  true if the message was replaced by a narrower one
+ *
+ * The result of the message is made of rows of W elements, W being the
+ * number of addresses. There is one row for each enabled channel in R, G, B,
+ * A order, followed by any rows that only ever take the "old value" input.
+ * A channel whose row is wholly dead is dropped from the channel mask, and a
+ * dead trailing row is dropped from the result. The live rows are packed
+ * together in the new result.
+ */
+bool GenXDeadVectorRemoval::narrowChannelMask(CallInst *CI)
+{
+  // The channel mask of gather4_typed gives the channels to read, and that
+  // of gather4_scaled and svm_gather4_scaled the channels not to read.
+  unsigned IID = getIntrinsicID(CI);
+  unsigned MaskNum = 1, PredNum = 0, AddrNum = 5;
+  bool MaskEnables = false;
+  if (IID == Intrinsic::genx_gather4_typed) {
+    MaskNum = 0;
+    PredNum = 1;
+    AddrNum = 3;
+    MaskEnables = true;
+  } else if (IID == Intrinsic::genx_svm_gather4_scaled)
+    AddrNum = 4;
+  unsigned OldValNum = CI->getNumArgOperands() - 1;
+  auto MaskC = dyn_cast<ConstantInt>(CI->getArgOperand(MaskNum));
+  auto OldVal = dyn_cast<Constant>(CI->getArgOperand(OldValNum));
+  if (!MaskC || !OldVal)
+    return false;
+  // A wholly dead result is left to nullOutInstructions.
+  auto LB = getLiveBits(CI);
+  if (!LB.getNumElements() || LB.isAllZero())
+    return false;
+  auto VT = cast<VectorType>(CI->getType());
+  unsigned W = CI->getArgOperand(AddrNum)->getType()->getVectorNumElements();
+  unsigned NumRows = VT->getNumElements() / W;
+  if (NumRows * W != VT->getNumElements())
+    return false;
+  unsigned Mask = MaskC->getZExtValue();
+  unsigned Enabled = (MaskEnables ? Mask : ~Mask) & 0xf;
+  unsigned NumChannels = countPopulation(Enabled);
+  if (!NumChannels || NumChannels > NumRows)
+    return false;
+  SmallBitVector LiveRows(NumRows);
+  for (unsigned Idx = 0, End = LB.getNumElements(); Idx != End; ++Idx)
+    if (LB.get(Idx))
+      LiveRows.set(Idx / W);
+  unsigned NewEnabled = Enabled;
+  for (unsigned Channel = 0, Row = 0; Channel != 4; ++Channel) {
+    if (Enabled >> Channel & 1) {
+      if (!LiveRows[Row])
+        NewEnabled &= ~(1U << Channel);
+      ++Row;
+    }
+  }
+  if (!NewEnabled) {
+    // Only old value rows are live, but the message must still read a
+    // channel. Keep the first one.
+    NewEnabled = Enabled & -Enabled;
+    LiveRows.set(0);
+  }
+  if (LiveRows.all())
+    return false;
+  // Check that each use is a direct rdregion reading within one row. A use
+  // with no uses of its own is dead and is erased.
+  SmallVector<std::pair<Instruction *, unsigned>, 4> Users;
+  SmallVector<Instruction *, 4> DeadUsers;
+  for (auto ui = CI->use_begin(), ue = CI->use_end(); ui != ue; ++ui) {
+    auto User = cast<Instruction>(ui->getUser());
+    if (!isRdRegion(getIntrinsicID(User))
+        || ui->getOperandNo() != Intrinsic::GenXRegion::OldValueOperandNum)
+      return false;
+    if (User->use_empty()) {
+      DeadUsers.push_back(User);
+      continue;
+    }
+    Region R(User, BaleInfo());
+    if (R.Indirect || !R.isWholeNumRows())
+      return false;
+    int Lo = R.Offset / R.ElementBytes, Hi = Lo;
+    int RowSpan = (int)(R.NumElements / R.Width - 1) * R.VStride;
+    int ColSpan = (int)(R.Width - 1) * R.Stride;
+    Lo += std::min(RowSpan, 0) + std::min(ColSpan, 0);
+    Hi += std::max(RowSpan, 0) + std::max(ColSpan, 0);
+    if (Lo < 0 || (unsigned)Lo / W != (unsigned)Hi / W
+        || !LiveRows[Lo / W])
+      return false;
+    Users.push_back(std::make_pair(User, (unsigned)Lo / W));
+  }
+  // Work out where each live row goes in the new result.
+  SmallVector<unsigned, 8> NewRow(NumRows);
+  unsigned NumNewRows = 0;
+  for (unsigned Row = 0; Row != NumRows; ++Row)
+    if (LiveRows[Row])
+      NewRow[Row] = NumNewRows++;
+  auto NewTy = VectorType::get(VT->getElementType(), NumNewRows * W);
+  // Pack the live rows of the old value in the same way.
+  Constant *NewOldVal = UndefValue::get(NewTy);
+  if (!isa<UndefValue>(OldVal)) {
+    NewOldVal = nullptr;
+    for (unsigned Row = 0; Row != NumRows; ++Row) {
+      if (!LiveRows[Row])
+        continue;
+      auto Sub = getConstantSubvector(OldVal, Row * W, W);
+      NewOldVal = NewOldVal ? concatConstants(NewOldVal, Sub) : Sub;
+    }
+  }
+  SmallVector<Value *, 8> Args;
+  for (unsigned i = 0, e = CI->getNumArgOperands(); i != e; ++i)
+    Args.push_back(CI->getArgOperand(i));
+  Args[MaskNum] = ConstantInt::get(MaskC->getType(),
+      (Mask & ~0xfU) | (MaskEnables ? NewEnabled : ~NewEnabled & 0xf));
+  Args[OldValNum] = NewOldVal;
+  Type *Tys[] = { NewTy, Args[PredNum]->getType(), Args[AddrNum]->getType() };
+  auto Decl = Intrinsic::getDeclaration(CI->getParent()->getParent()->getParent(),
+      (Intrinsic::ID)IID, Tys);
+  auto NewCI = CallInst::Create(Decl, Args, CI->getName() + ".narrow", CI);
+  NewCI->setDebugLoc(CI->getDebugLoc());
+  DEBUG(dbgs() << "narrowed channels of " << *CI << "\n  to " << *NewCI << "\n");
+  // Move each rdregion of the result to its row's new position.
+  for (auto &Entry : Users) {
+    Instruction *User = Entry.first;
+    unsigned Row = Entry.second;
+    Region R(User, BaleInfo());
+    R.Offset -= (Row - NewRow[Row]) * W * R.ElementBytes;
+    auto NewRd = R.createRdRegion(NewCI, User->getName(), User,
+        User->getDebugLoc(), /*AllowScalar=*/!User->getType()->isVectorTy());
+    User->replaceAllUsesWith(NewRd);
+    User->eraseFromParent();
+  }
+  for (auto User : DeadUsers)
+    User->eraseFromParent();
+  CI->eraseFromParent();
+  return true;
+}
+
 /***********************************************************************
  * processInst : process an instruction in the dead element removal pass
  */
@@ -353,9 +581,7 @@ void GenXDeadVectorRemoval::processInst(Instruction *Inst)
 {
   DEBUG(dbgs() << "  " << *Inst << "\n       has bits " << getLiveBits(Inst) << "\n");
   if (isRootInst(Inst)) {
-    // This is a "root" instruction. Mark its inputs as wholly live.
-    for (unsigned oi = 0, oe = Inst->getNumOperands(); oi != oe; ++oi)
-      markWhollyLive(Inst->getOperand(oi));
+    processRootInst(Inst);
     return;
   }
   // Check for the result of the instruction not being used at all.
@@ -397,6 +623,79 @@ void GenXDeadVectorRemoval::processInst(Instruction *Inst)
     markWhollyLive(Inst->getOperand(oi));
 }
 
+/***********************************************************************
+ * processRootInst : process a "root" instruction for element liveness
+ *
+ * All inputs are wholly live, except a two address "old value" input of an
+ * intrinsic with the same type as the result. That only supplies the result
+ * elements that the intrinsic does not write, so it is live exactly where the
+ * result is live.
+ */
+void GenXDeadVectorRemoval::processRootInst(Instruction *Inst)
+{
+  int TwoAddrNum = -1;
+  if (auto CI = dyn_cast<CallInst>(Inst))
+    if (getIntrinsicID(CI) != Intrinsic::not_intrinsic)
+      TwoAddrNum = getTwoAddressOperandNum(CI);
+  for (unsigned oi = 0, oe = Inst->getNumOperands(); oi != oe; ++oi) {
+    Value *Opnd = Inst->getOperand(oi);
+    if ((int)oi != TwoAddrNum || Opnd->getType() != Inst->getType()) {
+      markWhollyLive(Opnd);
+      continue;
+    }
+    auto OpndInst = dyn_cast<Instruction>(Opnd);
+    auto LB = getLiveBits(Inst);
+    if (!OpndInst || !LB.getNumElements())
+      continue;
+    if (getLiveBits(OpndInst, /*Create=*/true).orBits(LB))
+      addToWorkList(OpndInst);
+  }
+}
+
+/***********************************************************************
+ * nullOutRootResult : null out the result of a "root" instruction if no
+ *    element of it is used
+ *
+ * Return:  true if anything changed
+ *
+ * The instruction itself stays. Its two address "old value" input, if any,
+ * is set to undef, and any uses of its result are set to undef.
+ */
+bool GenXDeadVectorRemoval::nullOutRootResult(Instruction *Inst)
+{
+  auto CI = dyn_cast<CallInst>(Inst);
+  if (!CI || CI->getType()->isVoidTy())
+    return false;
+  // Only consider messages whose raw result is allowed to be null (V0), that
+  // is intrinsics with a RAW_NULLALLOWED result. Other raw results (e.g. a raw
+  // send) must keep their destination even if it is dead.
+  unsigned IID = getIntrinsicID(CI);
+  if (IID == Intrinsic::not_intrinsic)
+    return false;
+  GenXIntrinsicInfo::ArgInfo RetInfo = GenXIntrinsicInfo(IID).getRetInfo();
+  if (!RetInfo.isRaw() || !RetInfo.rawNullAllowed())
+    return false;
+  auto LB = getLiveBits(Inst);
+  if (LB.getNumElements() && !LB.isAllZero())
+    return false;
+  bool Modified = false;
+  int TwoAddrNum = getTwoAddressOperandNum(CI);
+  if (TwoAddrNum >= 0 && !isa<UndefValue>(CI->getOperand(TwoAddrNum))) {
+    Use *U = &CI->getOperandUse(TwoAddrNum);
+    *U = UndefValue::get((*U)->getType());
+    DEBUG(dbgs() << "null out old value input in " << *CI << "\n");
+    Modified = true;
+  }
+  DEBUG(if (!CI->use_empty())
+    dbgs() << "nulled out uses of " << *CI << "\n");
+  while (!CI->use_empty()) {
+    Use *U = &*CI->use_begin();
+    *U = UndefValue::get((*U)->getType());
+    Modified = true;
+  }
+  return Modified;
+}
+
 /***********************************************************************
  * processRdRegion : process a rdregion instruction for element liveness
  */
@@ -508,7 +807,7 @@ void GenXDeadVectorRemoval::processWrRegion(Instruction *Inst, LiveBits LB)
   if (UsedOldInput) {
     // We know that at least one element of the "old value" input is used,
     // so add the wrregion to the used old input set.
-    WrRegionsWithUsedOldInput.insert(Inst);
+    WrRegionsWithUsedOldInput.set(getInstNum(Inst));
   }
 }
 
@@ -587,9 +886,13 @@ void GenXDeadVectorRemoval::markWhollyLive(Value *V)
 void GenXDeadVectorRemoval::addToWorkList(Instruction *Inst)
 {
   DEBUG(dbgs() << "    " << Inst->getName() << " now " << getLiveBits(Inst) << "\n");
-  if (WorkListSet.insert(Inst).second && WorkListPhase) {
+  unsigned Num = getInstNum(Inst);
+  if (InWorkList.test(Num))
+    return;
+  InWorkList.set(Num);
+  if (WorkListPhase) {
     DEBUG(dbgs() << "    adding " << Inst->getName() << " to work list\n");
-    WorkList.push(Inst);
+    WorkList.push(Num);
   }
 }
 
@@ -602,25 +905,19 @@ void GenXDeadVectorRemoval::addToWorkList(Instruction *Inst)
  */
 LiveBits GenXDeadVectorRemoval::getLiveBits(Instruction *Inst, bool Create)
 {
-  unsigned NumElements = 1;
-  if (auto VT = dyn_cast<VectorType>(Inst->getType()))
-    NumElements = VT->getNumElements();
-  LiveBitsStorage *LBS = nullptr;
-  if (!Create) {
-    auto i = InstMap.find(Inst);
-    if (i == InstMap.end())
+  auto i = InstNums.find(Inst);
+  if (i == InstNums.end()) {
+    // An instruction created after the analysis has no bitmap.
+    assert(!Create);
+    return LiveBits();
+  }
+  unsigned Num = i->second;
+  if (!HasLiveBits.test(Num)) {
+    if (!Create)
       return LiveBits();
-    LBS = &i->second;
-  } else {
-    auto Ret = InstMap.insert(std::map<Instruction *,
-          LiveBitsStorage>::value_type(Inst, LiveBitsStorage()));
-    LBS = &Ret.first->second;
-    if (Ret.second) {
-      // New entry. Set its number of elements.
-      LBS->setNumElements(NumElements);
-    }
+    HasLiveBits.set(Num);
   }
-  return LiveBits(LBS, NumElements);
+  return LiveBits(&LiveWords[LiveWordOffsets[Num]], getNumLiveBits(Inst));
 }
 
 /***********************************************************************
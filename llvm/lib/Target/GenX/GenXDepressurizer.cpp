@@ -960,6 +960,13 @@ void GenXDepressurizer::attemptSinking(Instruction *InsertBefore,
   } else {
     // Try to sink a group of candidates to reduce register pressure.
     // Do NOT Allow Clone for now.
+    // The candidates were gathered in the (pointer) order of the live set, so
+    // put them in definition order first; which superbale absorbs which
+    // depends on it.
+    std::sort(SecondRound.begin(), SecondRound.end(),
+              [](const SinkCandidate &Lhs, const SinkCandidate &Rhs) {
+                return Lhs.SB->Number > Rhs.SB->Number;
+              });
     for (auto i = SecondRound.begin(), ie = SecondRound.end(); i != ie; ++i) {
       if (i->SB == nullptr)
         continue;
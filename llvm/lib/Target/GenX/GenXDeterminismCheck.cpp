@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2020, Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+//===----------------------------------------------------------------------===//
+//
+/// GenXDeterminismCheck
+/// --------------------
+///
+/// This pass is added only with -genx-determinism-check. It runs first in the
+/// GenX backend, compiles two copies of the module to vISA with the rest of the
+/// backend pipeline, and reports a fatal error if the two vISA files differ in
+/// any byte. The module itself is left alone for the real compile that
+/// follows.
+///
+/// Before the second compile the heap is perturbed by keeping a batch of
+/// blocks of assorted sizes allocated, with holes between them, so that the IR
+/// and the analyses of the second compile land at different addresses and in
+/// a different relative order. A pass that iterates over a pointer keyed
+/// container in a way that affects the generated code is then likely to make
+/// the two vISA files differ.
+///
+//===----------------------------------------------------------------------===//
+#define DEBUG_TYPE "GENX_DETERMINISM_CHECK"
+
+#include "GenX.h"
+#include "GenXTargetMachine.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+class GenXDeterminismCheck : public ModulePass {
+  GenXTargetMachine *TM;
+  bool DisableVerify;
+public:
+  static char ID;
+  explicit GenXDeterminismCheck(GenXTargetMachine *TM, bool DisableVerify)
+      : ModulePass(ID), TM(TM), DisableVerify(DisableVerify) {}
+  virtual StringRef getPassName() const { return "GenX determinism check"; }
+  void getAnalysisUsage(AnalysisUsage &AU) const { AU.setPreservesAll(); }
+  bool runOnModule(Module &M);
+private:
+  void compile(const Module &M, SmallVectorImpl<char> &Visa);
+};
+
+} // end anonymous namespace
+
+char GenXDeterminismCheck::ID = 0;
+
+ModulePass *llvm::createGenXDeterminismCheckPass(GenXTargetMachine *TM,
+                                                 bool DisableVerify) {
+  return new GenXDeterminismCheck(TM, DisableVerify);
+}
+
+/***********************************************************************
+ * perturbHeap : allocate blocks of assorted sizes and free every third one
+ *
+ * The blocks that are kept are returned in Blocks, and must stay allocated
+ * until the compile that is meant to see the perturbed heap has finished.
+ */
+static void perturbHeap(std::vector<std::unique_ptr<char[]>> &Blocks)
+{
+  for (unsigned i = 0; i != 4096; ++i) {
+    unsigned Size = 8 + (i * 37) % 1000;
+    Blocks.emplace_back(new char[Size]);
+    // Touch the block so the allocation cannot be elided.
+    Blocks.back()[Size - 1] = (char)i;
+  }
+  for (unsigned i = 0; i < Blocks.size(); i += 3)
+    Blocks[i].reset();
+}
+
+/***********************************************************************
+ * compile : compile a copy of the module to vISA
+ *
+ * The vISA written does not depend on the file type asked for, so this
+ * always asks for an object file.
+ */
+void GenXDeterminismCheck::compile(const Module &M, SmallVectorImpl<char> &Visa)
+{
+  std::unique_ptr<Module> Copy = CloneModule(&M);
+  raw_svector_ostream OS(Visa);
+  legacy::PassManager PM;
+  TM->setInDeterminismCheck(true);
+  bool Failed = TM->addPassesToEmitFile(
+      PM, OS, TargetMachine::CGFT_ObjectFile, DisableVerify);
+  TM->setInDeterminismCheck(false);
+  assert(!Failed && "GenX accepts object files");
+  (void)Failed;
+  PM.run(*Copy);
+}
+
+/***********************************************************************
+ * runOnModule : compile twice and compare
+ */
+bool GenXDeterminismCheck::runOnModule(Module &M)
+{
+  SmallVector<char, 0> First, Second;
+  compile(M, First);
+  {
+    std::vector<std::unique_ptr<char[]>> Blocks;
+    perturbHeap(Blocks);
+    compile(M, Second);
+  }
+  DEBUG(dbgs() << "GenXDeterminismCheck: " << First.size() << " and "
+               << Second.size() << " bytes of vISA\n");
+  if (First.size() == Second.size() &&
+      std::equal(First.begin(), First.end(), Second.begin()))
+    return false;
+  // Find the first difference to report.
+  size_t Offset = 0;
+  while (Offset != First.size() && Offset != Second.size() &&
+         First[Offset] == Second[Offset])
+    ++Offset;
+  report_fatal_error(Twine("GenX determinism check failed: vISA for module ") +
+                     M.getModuleIdentifier() + " differs at byte " +
+                     Twine(Offset) + " (sizes " + Twine(First.size()) +
+                     " and " + Twine(Second.size()) + ")");
+}
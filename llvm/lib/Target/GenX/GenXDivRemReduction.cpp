@@ -0,0 +1,371 @@
+/*
+ * Copyright (c) 2020, Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+//===----------------------------------------------------------------------===//
+//
+/// GenXDivRemReduction
+/// -------------------
+///
+/// GenXDivRemReduction is a function pass that strength reduces 32 bit integer
+/// division and remainder by a divisor that is not a compile time constant,
+/// but is invariant: a kernel argument, or a value defined outside the loop
+/// containing the division. Index calculations like ``gid / width`` and
+/// ``gid % width`` are the typical case. Integer division is emulated on
+/// targets where emulateIDivRem() is true, and goes to the slow math unit
+/// elsewhere.
+///
+/// For each such divisor D, the pass computes the reciprocal
+/// ``M = 0xffffffff / D`` once, and rewrites each division of N by D as
+///
+/// .. code-block:: text
+///
+///   T = umulh(N, M)
+///   R = N - T * D
+///   C = R >= D
+///   Q = T + C            ; N / D
+///   Rem = R - (C ? D : 0) ; N % D
+///
+/// Because M is rounded down, T is either the exact quotient or one less, and
+/// the single compare corrects it. A signed division or remainder is done on
+/// the absolute values, with the reciprocal computed from the absolute value
+/// of D, and the sign fixed up afterwards. A division and remainder of the
+/// same operands in the same block share one sequence.
+///
+/// A divisor that is a splat of a scalar is handled on the scalar, so the
+/// reciprocal is a scalar and is splatted at each use.
+///
+/// The reciprocal is only ever computed where the original program already
+/// divides by D, so it cannot add a division by zero on a path that a guard
+/// protected, or a division on a path that did none. It goes just before a
+/// division, and is hoisted to the preheader of each enclosing loop in which
+/// D is invariant and that division runs on every iteration that exits the
+/// loop. Later divisions by D dominated by that point share it.
+///
+/// The transformation is done for a group of divisions sharing a reciprocal
+/// when there is more than one of them, or the reciprocal was hoisted out of
+/// a loop, since in both cases its one-off cost is amortized.
+///
+//===----------------------------------------------------------------------===//
+#define DEBUG_TYPE "GENX_DIVREMREDUCTION"
+
+#include "GenX.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include <algorithm>
+
+using namespace llvm;
+using namespace genx;
+
+static cl::opt<bool> EnableGenXDivRemReduction(
+    "enable-genx-divrem-reduction", cl::init(true), cl::Hidden,
+    cl::desc("Enable GenX strength reduction of division by invariants."));
+
+namespace {
+
+// GenXDivRemReduction : strength reduce division by invariant divisors
+class GenXDivRemReduction : public FunctionPass {
+  // Reciprocal : the precomputed values for one divisor
+  struct Reciprocal {
+    Value *Divisor = nullptr; // D, or |D| for signed
+    Value *Magic = nullptr;   // 0xffffffff / Divisor
+  };
+  // The key is the divisor with any splat peeled off, and whether it is
+  // used signed.
+  typedef std::pair<Value *, bool> DivisorKey;
+  // Group : divisions by one divisor that share a reciprocal computed
+  // before InsertBefore
+  struct Group {
+    Instruction *InsertBefore = nullptr;
+    bool Hoisted = false;
+    SmallVector<BinaryOperator *, 4> Insts;
+    Reciprocal R;
+  };
+  // Quotient and remainder already computed for a (dividend, divisor,
+  // signed) triple in the current basic block.
+  struct QuotRem {
+    BasicBlock *BB;
+    Value *Quot;
+    Value *Rem;
+  };
+  DenseMap<std::pair<Value *, DivisorKey>, QuotRem> BlockResults;
+  LoopInfo *LI = nullptr;
+  DominatorTree *DT = nullptr;
+
+public:
+  static char ID;
+  explicit GenXDivRemReduction() : FunctionPass(ID) {}
+  virtual StringRef getPassName() const {
+    return "GenX division by invariant reduction";
+  }
+  void getAnalysisUsage(AnalysisUsage &AU) const;
+  bool runOnFunction(Function &F);
+
+private:
+  static bool isCandidate(Instruction *Inst);
+  static bool isSigned(Instruction *Inst) {
+    return Inst->getOpcode() == Instruction::SDiv ||
+           Inst->getOpcode() == Instruction::SRem;
+  }
+  static Value *getDivisorKey(Value *V);
+  Instruction *getInsertPoint(BinaryOperator *Inst, Value *D, bool &Hoisted);
+  Reciprocal getReciprocal(DivisorKey Key, Instruction *InsertBefore);
+  void reduce(BinaryOperator *Inst, DivisorKey Key, const Reciprocal &R);
+};
+
+} // end anonymous namespace
+
+char GenXDivRemReduction::ID = 0;
+namespace llvm { void initializeGenXDivRemReductionPass(PassRegistry &); }
+INITIALIZE_PASS_BEGIN(GenXDivRemReduction, "GenXDivRemReduction",
+                      "GenXDivRemReduction", false, false)
+INITIALIZE_PASS_DEPENDENCY(DominatorTreeWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(LoopInfoWrapperPass)
+INITIALIZE_PASS_END(GenXDivRemReduction, "GenXDivRemReduction",
+                    "GenXDivRemReduction", false, false)
+
+FunctionPass *llvm::createGenXDivRemReductionPass() {
+  initializeGenXDivRemReductionPass(*PassRegistry::getPassRegistry());
+  return new GenXDivRemReduction();
+}
+
+void GenXDivRemReduction::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.addRequired<DominatorTreeWrapperPass>();
+  AU.addRequired<LoopInfoWrapperPass>();
+  AU.addPreserved<DominatorTreeWrapperPass>();
+  AU.addPreserved<LoopInfoWrapperPass>();
+  AU.setPreservesCFG();
+}
+
+/***********************************************************************
+ * GenXDivRemReduction::runOnFunction : process one function
+ */
+bool GenXDivRemReduction::runOnFunction(Function &F) {
+  if (!EnableGenXDivRemReduction)
+    return false;
+  LI = &getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+  DT = &getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+
+  // Gather the candidate divisions, grouped by divisor, in reverse post
+  // order so that a division comes after any division dominating it.
+  MapVector<DivisorKey, SmallVector<BinaryOperator *, 4>> Divisions;
+  ReversePostOrderTraversal<Function *> RPOT(&F);
+  for (BasicBlock *BB : RPOT)
+    for (auto &I : *BB)
+      if (isCandidate(&I)) {
+        DivisorKey Key(getDivisorKey(I.getOperand(1)), isSigned(&I));
+        Divisions[Key].push_back(cast<BinaryOperator>(&I));
+      }
+
+  bool Modified = false;
+  for (auto &Entry : Divisions) {
+    DivisorKey Key = Entry.first;
+    // Each division joins the first group whose reciprocal would dominate
+    // it, or starts a new one.
+    SmallVector<Group, 4> Groups;
+    for (auto Inst : Entry.second) {
+      auto G = std::find_if(Groups.begin(), Groups.end(), [&](Group &Other) {
+        return DT->dominates(Other.InsertBefore, Inst);
+      });
+      if (G == Groups.end()) {
+        Groups.emplace_back();
+        G = &Groups.back();
+        G->InsertBefore = getInsertPoint(Inst, Key.first, G->Hoisted);
+      }
+      G->Insts.push_back(Inst);
+    }
+    for (auto &G : Groups) {
+      // Worth doing if the reciprocal is shared, or it is computed outside
+      // a loop that contains the division.
+      if (G.Insts.size() < 2 && !G.Hoisted)
+        continue;
+      G.R = getReciprocal(Key, G.InsertBefore);
+      for (auto Inst : G.Insts) {
+        DEBUG(dbgs() << "GenXDivRemReduction: reducing " << *Inst << "\n");
+        reduce(Inst, Key, G.R);
+      }
+      Modified = true;
+    }
+    BlockResults.clear();
+  }
+  return Modified;
+}
+
+/***********************************************************************
+ * isCandidate : check whether an instruction is a 32 bit division or
+ *      remainder by a non-constant divisor
+ */
+bool GenXDivRemReduction::isCandidate(Instruction *Inst) {
+  switch (Inst->getOpcode()) {
+  case Instruction::UDiv:
+  case Instruction::URem:
+  case Instruction::SDiv:
+  case Instruction::SRem:
+    break;
+  default:
+    return false;
+  }
+  if (!Inst->getType()->getScalarType()->isIntegerTy(32))
+    return false;
+  return !isa<Constant>(getDivisorKey(Inst->getOperand(1)));
+}
+
+/***********************************************************************
+ * getDivisorKey : get the value the reciprocal is computed from, which is
+ *      the divisor, or the scalar it is a splat of
+ */
+Value *GenXDivRemReduction::getDivisorKey(Value *V) {
+  if (auto SVI = dyn_cast<ShuffleVectorInst>(V)) {
+    auto Splat = ShuffleVectorAnalyzer(SVI).getAsSplat();
+    if (Splat.Input && !Splat.Input->getType()->isVectorTy())
+      return Splat.Input;
+  }
+  return V;
+}
+
+/***********************************************************************
+ * getInsertPoint : get where to compute the reciprocal for a division
+ *
+ * This is the division itself, moved out to the preheader of each
+ * enclosing loop in which the divisor is invariant and the division's block
+ * dominates every exiting block. Such a division runs whenever the loop is
+ * entered, so the reciprocal divides by zero only where the original
+ * program already did.
+ */
+Instruction *GenXDivRemReduction::getInsertPoint(BinaryOperator *Inst,
+                                                 Value *D, bool &Hoisted) {
+  Instruction *InsertBefore = Inst;
+  BasicBlock *BB = Inst->getParent();
+  Hoisted = false;
+  for (Loop *L = LI->getLoopFor(BB); L; L = L->getParentLoop()) {
+    BasicBlock *Preheader = L->getLoopPreheader();
+    if (!Preheader || !L->isLoopInvariant(D))
+      break;
+    SmallVector<BasicBlock *, 4> Exiting;
+    L->getExitingBlocks(Exiting);
+    if (!std::all_of(Exiting.begin(), Exiting.end(), [&](BasicBlock *E) {
+          return DT->dominates(BB, E);
+        }))
+      break;
+    BB = Preheader;
+    InsertBefore = Preheader->getTerminator();
+    Hoisted = true;
+  }
+  return InsertBefore;
+}
+
+/***********************************************************************
+ * getReciprocal : compute the reciprocal of a divisor
+ */
+GenXDivRemReduction::Reciprocal
+GenXDivRemReduction::getReciprocal(DivisorKey Key, Instruction *InsertBefore) {
+  Reciprocal R;
+  Value *D = Key.first;
+  IRBuilder<> Builder(InsertBefore);
+  Builder.SetCurrentDebugLocation(InsertBefore->getDebugLoc());
+  if (Key.second) {
+    // Signed: use |D|. The absolute value of INT_MIN is 0x80000000, which is
+    // still right when treated as unsigned.
+    Value *Zero = Constant::getNullValue(D->getType());
+    Value *IsNeg = Builder.CreateICmpSLT(D, Zero, D->getName() + ".isneg");
+    D = Builder.CreateSelect(IsNeg, Builder.CreateNeg(D), D,
+                             D->getName() + ".abs");
+  }
+  R.Divisor = D;
+  R.Magic = Builder.CreateUDiv(Constant::getAllOnesValue(D->getType()), D,
+                               D->getName() + ".recip");
+  return R;
+}
+
+/***********************************************************************
+ * reduce : rewrite one division or remainder using the reciprocal
+ */
+void GenXDivRemReduction::reduce(BinaryOperator *Inst, DivisorKey Key,
+                                 const Reciprocal &R) {
+  Value *N = Inst->getOperand(0);
+  bool Signed = Key.second;
+  bool IsDiv = Inst->getOpcode() == Instruction::UDiv ||
+               Inst->getOpcode() == Instruction::SDiv;
+  auto CacheKey = std::make_pair(N, Key);
+  auto Cached = BlockResults.find(CacheKey);
+  if (Cached != BlockResults.end() &&
+      Cached->second.BB == Inst->getParent()) {
+    Inst->replaceAllUsesWith(IsDiv ? Cached->second.Quot
+                                   : Cached->second.Rem);
+    Inst->eraseFromParent();
+    return;
+  }
+
+  IRBuilder<> Builder(Inst);
+  Builder.SetCurrentDebugLocation(Inst->getDebugLoc());
+  Type *Ty = Inst->getType();
+  Value *D = R.Divisor;
+  Value *M = R.Magic;
+  if (Ty->isVectorTy() && !D->getType()->isVectorTy()) {
+    unsigned Width = Ty->getVectorNumElements();
+    D = Builder.CreateVectorSplat(Width, D);
+    M = Builder.CreateVectorSplat(Width, M);
+  }
+  Value *Zero = Constant::getNullValue(Ty);
+  Value *AbsN = N;
+  Value *NIsNeg = nullptr;
+  if (Signed) {
+    NIsNeg = Builder.CreateICmpSLT(N, Zero);
+    AbsN = Builder.CreateSelect(NIsNeg, Builder.CreateNeg(N), N);
+  }
+  // T = umulh(N, M) is the quotient or one less.
+  Type *Tys[] = {Ty, Ty};
+  Function *MulH = Intrinsic::getDeclaration(Inst->getModule(),
+                                             Intrinsic::genx_umulh, Tys);
+  Value *T = Builder.CreateCall(MulH, {AbsN, M});
+  Value *Rem = Builder.CreateSub(AbsN, Builder.CreateMul(T, D));
+  Value *C = Builder.CreateICmpUGE(Rem, D);
+  Value *Quot = Builder.CreateAdd(T, Builder.CreateZExt(C, Ty));
+  Rem = Builder.CreateSub(Rem, Builder.CreateSelect(C, D, Zero));
+  if (Signed) {
+    // The quotient is negative if the signs differ, the remainder takes the
+    // sign of the dividend.
+    Value *DOrig = Inst->getOperand(1);
+    Value *QIsNeg = Builder.CreateICmpSLT(Builder.CreateXor(N, DOrig), Zero);
+    Quot = Builder.CreateSelect(QIsNeg, Builder.CreateNeg(Quot), Quot);
+    Rem = Builder.CreateSelect(NIsNeg, Builder.CreateNeg(Rem), Rem);
+  }
+  if (IsDiv)
+    Quot->takeName(Inst);
+  else
+    Rem->takeName(Inst);
+  BlockResults[CacheKey] = {Inst->getParent(), Quot, Rem};
+  Inst->replaceAllUsesWith(IsDiv ? Quot : Rem);
+  Inst->eraseFromParent();
+}
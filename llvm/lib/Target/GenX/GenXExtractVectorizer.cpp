@@ -38,6 +38,7 @@
 
 #include "GenX.h"
 #include "GenXRegion.h"
+#include "llvm/ADT/MapVector.h"
 #include "llvm/Analysis/CFG.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Constants.h"
@@ -155,7 +156,10 @@ void GenXExtractVectorizer::processExtracted(Value *V)
 {
   // Gather the scalar extracting rdregion uses of V into buckets, one for
   // each binaryoperator with constant rhs that the extracted value is used in.
-  std::map<BucketIndex, SmallVector<Extract, 4>> Buckets;
+  // BucketIndex compares pointers, so the buckets are kept in the order they
+  // are first seen to keep the output independent of allocation addresses.
+  MapVector<BucketIndex, SmallVector<Extract, 4>,
+            std::map<BucketIndex, unsigned>> Buckets;
   for (auto ui = V->use_begin(), ue = V->use_end(); ui != ue; ++ui) {
     auto user = cast<Instruction>(ui->getUser());
     if (!isRdRegion(getIntrinsicID(user)))
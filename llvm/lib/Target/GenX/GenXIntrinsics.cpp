@@ -1876,7 +1876,7 @@ const GenXIntrinsicInfo::DescrElementType GenXIntrinsicInfo::Table[] = {
   URAW | 3, // src0
   NULLRAW, // src1 (null variable)
   TWOADDR | 4, // not in vISA instruction: old value of result
-  URAW | 0, // dst
+  URAW | RAW_NULLALLOWED | 0, // dst
   END,
 
   Intrinsic::genx_svm_atomic_sub,
@@ -1889,7 +1889,7 @@ const GenXIntrinsicInfo::DescrElementType GenXIntrinsicInfo::Table[] = {
   URAW | 3, // src0
   NULLRAW, // src1 (null variable)
   TWOADDR | 4, // not in vISA instruction: old value of result
-  URAW | 0, // dst
+  URAW | RAW_NULLALLOWED | 0, // dst
   END,
 
   Intrinsic::genx_svm_atomic_min,
@@ -1902,7 +1902,7 @@ const GenXIntrinsicInfo::DescrElementType GenXIntrinsicInfo::Table[] = {
   URAW | 3, // src0
   NULLRAW, // src1 (null variable)
   TWOADDR | 4, // not in vISA instruction: old value of result
-  URAW | 0, // dst
+  URAW | RAW_NULLALLOWED | 0, // dst
   END,
 
   Intrinsic::genx_svm_atomic_max,
@@ -1915,7 +1915,7 @@ const GenXIntrinsicInfo::DescrElementType GenXIntrinsicInfo::Table[] = {
   URAW | 3, // src0
   NULLRAW, // src1 (null variable)
   TWOADDR | 4, // not in vISA instruction: old value of result
-  URAW | 0, // dst
+  URAW | RAW_NULLALLOWED | 0, // dst
   END,
 
   Intrinsic::genx_svm_atomic_xchg,
@@ -1928,7 +1928,7 @@ const GenXIntrinsicInfo::DescrElementType GenXIntrinsicInfo::Table[] = {
   URAW | 3, // src0
   NULLRAW, // src1 (null variable)
   TWOADDR | 4, // not in vISA instruction: old value of result
-  URAW | 0, // dst
+  URAW | RAW_NULLALLOWED | 0, // dst
   END,
 
   Intrinsic::genx_svm_atomic_and,
@@ -1941,7 +1941,7 @@ const GenXIntrinsicInfo::DescrElementType GenXIntrinsicInfo::Table[] = {
   URAW | 3, // src0
   NULLRAW, // src1 (null variable)
   TWOADDR | 4, // not in vISA instruction: old value of result
-  URAW | 0, // dst
+  URAW | RAW_NULLALLOWED | 0, // dst
   END,
 
   Intrinsic::genx_svm_atomic_or,
@@ -1954,7 +1954,7 @@ const GenXIntrinsicInfo::DescrElementType GenXIntrinsicInfo::Table[] = {
   URAW | 3, // src0
   NULLRAW, // src1 (null variable)
   TWOADDR | 4, // not in vISA instruction: old value of result
-  URAW | 0, // dst
+  URAW | RAW_NULLALLOWED | 0, // dst
   END,
 
   Intrinsic::genx_svm_atomic_xor,
@@ -1967,7 +1967,7 @@ const GenXIntrinsicInfo::DescrElementType GenXIntrinsicInfo::Table[] = {
   URAW | 3, // src0
   NULLRAW, // src1 (null variable)
   TWOADDR | 4, // not in vISA instruction: old value of result
-  URAW | 0, // dst
+  URAW | RAW_NULLALLOWED | 0, // dst
   END,
 
   Intrinsic::genx_svm_atomic_imin,
@@ -1980,7 +1980,7 @@ const GenXIntrinsicInfo::DescrElementType GenXIntrinsicInfo::Table[] = {
   SRAW | 3, // src0
   NULLRAW, // src1 (null variable)
   TWOADDR | 4, // not in vISA instruction: old value of result
-  SRAW | 0, // dst
+  SRAW | RAW_NULLALLOWED | 0, // dst
   END,
 
   Intrinsic::genx_svm_atomic_imax,
@@ -1993,7 +1993,7 @@ const GenXIntrinsicInfo::DescrElementType GenXIntrinsicInfo::Table[] = {
   SRAW | 3, // src0
   NULLRAW, // src1 (null variable)
   TWOADDR | 4, // not in vISA instruction: old value of result
-  SRAW | 0, // dst
+  SRAW | RAW_NULLALLOWED | 0, // dst
   END,
 
   Intrinsic::genx_svm_atomic_inc,
@@ -2006,7 +2006,7 @@ const GenXIntrinsicInfo::DescrElementType GenXIntrinsicInfo::Table[] = {
   NULLRAW, // src0 (null variable)
   NULLRAW, // src1 (null variable)
   TWOADDR | 3, // not in vISA instruction: old value of result
-  URAW | 0, // dst
+  URAW | RAW_NULLALLOWED | 0, // dst
   END,
 
   Intrinsic::genx_svm_atomic_dec,
@@ -2019,7 +2019,7 @@ const GenXIntrinsicInfo::DescrElementType GenXIntrinsicInfo::Table[] = {
   NULLRAW, // src0 (null variable)
   NULLRAW, // src1 (null variable)
   TWOADDR | 3, // not in vISA instruction: old value of result
-  URAW | 0, // dst
+  URAW | RAW_NULLALLOWED | 0, // dst
   END,
 
   Intrinsic::genx_svm_atomic_cmpxchg,
@@ -2032,7 +2032,7 @@ const GenXIntrinsicInfo::DescrElementType GenXIntrinsicInfo::Table[] = {
   URAW | 3, // src0
   URAW | 4, // src1
   TWOADDR | 5, // not in vISA instruction: old value of result
-  URAW | 0, // dst
+  URAW | RAW_NULLALLOWED | 0, // dst
   END,
 
   Intrinsic::genx_load,
@@ -139,6 +139,34 @@
 /// do find a need to cope with it, then the illegal rdpredregion will need to be
 /// lowered to bit twiddling code.
 ///
+/// Padding odd widths
+/// ^^^^^^^^^^^^^^^^^^
+///
+/// Splitting a non power of two width gives one instruction per power of two
+/// piece, so a width 7 operation takes three instructions (4, 2 and 1) where
+/// a width 8 one would do. Before the main splitting, padOddWidths looks for
+/// bales that can be executed at the next power of two width instead, with
+/// the extra lanes unused:
+///
+/// * the padded width must be allowed for the main instruction, and fit in
+///   two GRFs for every value in the bale;
+///
+/// * every vector operand must be a constant (padded by repeating its last
+///   element) or a baled in 1D direct rdregion that can read the extra
+///   elements without going off the end of its input;
+///
+/// * the bale must not be headed by a wrregion, as the extra lanes would then
+///   overwrite elements of the old value, and must not involve predicates or
+///   integer division.
+///
+/// The padded bale then gives a wider result, and each use reads the original
+/// lanes out of it with a rdregion, which is free when it bales into the user
+/// and costs a move otherwise. A cost model compares the number of
+/// instructions from padding, including such moves, with the number of
+/// pieces from splitting, and pads only when that gives fewer. The pass runs
+/// forwards, so a user that is itself padded reads the padded result
+/// directly. -genx-legalize-pad=false disables it.
+///
 /// Other tasks of GenXLegalization
 /// ^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
 ///
@@ -173,6 +201,7 @@
 #include "KillAnalysis.h"
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/CFG.h"
 #include "llvm/Analysis/ScalarEvolution.h"
 #include "llvm/Analysis/ScalarEvolutionExpressions.h"
@@ -183,12 +212,20 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Intrinsics.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include <set>
 
 using namespace llvm;
 using namespace genx;
 
+STATISTIC(NumPadded, "Number of odd width bales padded instead of split");
+
+static cl::opt<bool> EnablePadding("genx-legalize-pad", cl::init(true),
+    cl::Hidden,
+    cl::desc("Pad odd width operations to a power of two width when that "
+             "takes fewer instructions than splitting them"));
+
 namespace {
 
 // Information on a part of a predicate.
@@ -322,6 +359,9 @@ public:
 private:
   void clearBale() { B.clear(); Fixed4 = nullptr; TwiceWidth = nullptr; }
   unsigned getExecSizeAllowedBits(Instruction *Inst);
+  void padOddWidths(Function *F);
+  bool padBale(Instruction *Inst);
+  unsigned getPaddedWidth(unsigned Width);
   bool processInst(Instruction *Inst);
   bool processBale(Instruction *InsertBefore);
   bool noSplitProcessing();
@@ -407,6 +447,9 @@ bool GenXLegalization::runOnFunction(Function &F)
     }
   }
 
+  // Pad odd width bales where that is cheaper than splitting them.
+  padOddWidths(&F);
+
   // Legalize instructions. This does a postordered depth first traversal of the
   // CFG, and scans backwards in each basic block, to ensure that, if we unbale
   // anything, it then gets processed subsequently.
@@ -505,6 +548,273 @@ unsigned GenXLegalization::getExecSizeAllowedBits(Instruction *Inst)
   return 0x3f;
 }
 
+/***********************************************************************
+ * padOddWidths : pad odd width bales to a power of two width where that is
+ *    cheaper than splitting them
+ *
+ * This scans forwards, in reverse postorder, so that the padded result of a
+ * bale is available when its users are considered.
+ */
+void GenXLegalization::padOddWidths(Function *F)
+{
+  if (!EnablePadding)
+    return;
+  // CurrentInst is the next instruction to consider. padBale erases Inst and
+  // the rest of its bale, all of which are before it, and may replace
+  // rdregion users after it, which eraseInst and padBale keep it up to date
+  // for.
+  ReversePostOrderTraversal<Function *> RPOT(F);
+  for (BasicBlock *BB : RPOT) {
+    for (CurrentInst = &BB->front(); CurrentInst;) {
+      Instruction *Inst = CurrentInst;
+      CurrentInst = Inst->getNextNode();
+      padBale(Inst);
+    }
+  }
+}
+
+/***********************************************************************
+ * canBaleNarrowedRead : check whether a use of a padded value can bale in
+ *    the rdregion of its original lanes
+ *
+ * This is used for the cost estimate only. A rdregion user does not need the
+ * extra rdregion at all, as it can read the same region out of the padded
+ * value.
+ */
+static bool canBaleNarrowedRead(Use *U)
+{
+  auto User = cast<Instruction>(U->getUser());
+  unsigned IntrinID = getIntrinsicID(User);
+  if (isRdRegion(IntrinID))
+    return U->getOperandNo() == Intrinsic::GenXRegion::OldValueOperandNum;
+  if (isWrRegion(IntrinID))
+    return U->getOperandNo() == Intrinsic::GenXRegion::NewValueOperandNum;
+  switch (IntrinID) {
+  case Intrinsic::not_intrinsic:
+    if (isa<SelectInst>(User))
+      return U->getOperandNo() != 0;
+    if (isa<BitCastInst>(User))
+      return false;
+    return isa<BinaryOperator>(User) || isa<CastInst>(User) ||
+           isa<CmpInst>(User);
+  case Intrinsic::genx_constanti:
+  case Intrinsic::genx_constantf:
+    return false;
+  default:
+    return isa<CallInst>(User) &&
+           GenXIntrinsicInfo(IntrinID).getRetInfo().getCategory() ==
+               GenXIntrinsicInfo::GENERAL;
+  }
+}
+
+/***********************************************************************
+ * getPaddedWidth : get the width the bale could be padded to
+ *
+ * Enter:   Width = execution width of the bale in B, not a power of two
+ *
+ * Return:  the padded width, 0 if the bale cannot be padded
+ *
+ * See "Padding odd widths" in the comment at the top of the file.
+ */
+unsigned GenXLegalization::getPaddedWidth(unsigned Width)
+{
+  auto Main = B.getMainInst();
+  if (!Main)
+    return 0;
+  for (auto &BI : B) {
+    switch (BI.Info.Type) {
+    case BaleInfo::MAININST:
+    case BaleInfo::SATURATE:
+    case BaleInfo::NOTMOD:
+    case BaleInfo::NEGMOD:
+    case BaleInfo::ABSMOD:
+    case BaleInfo::ZEXT:
+    case BaleInfo::SEXT:
+    case BaleInfo::RDREGION:
+      break;
+    default:
+      // wrregion, predicates, address adds and the like.
+      return 0;
+    }
+  }
+  Instruction *MainInst = Main->Inst;
+  switch (MainInst->getOpcode()) {
+  case Instruction::SDiv:
+  case Instruction::UDiv:
+  case Instruction::SRem:
+  case Instruction::URem:
+    // The extra lanes could divide by 0.
+    return 0;
+  case Instruction::BitCast:
+  case Instruction::ICmp:
+  case Instruction::FCmp:
+  case Instruction::Select:
+    return 0;
+  case Instruction::Call:
+    switch (unsigned IntrinID = getIntrinsicID(MainInst)) {
+    case Intrinsic::not_intrinsic:
+    case Intrinsic::genx_constanti:
+    case Intrinsic::genx_constantf:
+    case Intrinsic::genx_constantpred:
+      return 0;
+    default:
+      if (GenXIntrinsicInfo(IntrinID).getRetInfo().getCategory()
+          != GenXIntrinsicInfo::GENERAL)
+        return 0;
+      break;
+    }
+    break;
+  default:
+    if (!isa<BinaryOperator>(MainInst) && !isa<CastInst>(MainInst))
+      return 0;
+    break;
+  }
+  unsigned PaddedWidth = PowerOf2Ceil(Width);
+  if (!(getExecSizeAllowedBits(MainInst) & PaddedWidth) || Fixed4 || TwiceWidth)
+    return 0;
+  unsigned TwoGRFWidth = ST ? (2 * ST->getGRFWidth()) : 64;
+  auto FitsGRFs = [=](Type *Ty) {
+    auto VT = dyn_cast<VectorType>(Ty);
+    if (!VT)
+      return true;
+    unsigned ElementBits = VT->getElementType()->getPrimitiveSizeInBits();
+    return ElementBits > 1 && PaddedWidth * ElementBits / 8 <= TwoGRFWidth;
+  };
+  for (auto &BI : B) {
+    if (!FitsGRFs(BI.Inst->getType()))
+      return 0;
+    if (BI.Info.Type == BaleInfo::RDREGION) {
+      // The rdregion must be able to read the extra elements out of its
+      // input, as a legal region.
+      Region R(BI.Inst, BI.Info);
+      if (R.Indirect || R.is2D())
+        return 0;
+      unsigned InputWidth =
+          BI.Inst->getOperand(0)->getType()->getVectorNumElements();
+      int LastIdx = R.Offset / int(R.ElementBytes)
+          + int(PaddedWidth - 1) * R.Stride;
+      if (LastIdx < 0 || unsigned(LastIdx) >= InputWidth)
+        return 0;
+      R.NumElements = R.Width = PaddedWidth;
+      if (R.getLegalSize(0, true/*Allow2D*/, InputWidth, ST,
+            &(Baling->AlignInfo)) < PaddedWidth)
+        return 0;
+      continue;
+    }
+    // Any other vector operand must be a constant or baled in.
+    unsigned NumOperands = BI.Inst->getNumOperands();
+    if (auto CI = dyn_cast<CallInst>(BI.Inst))
+      NumOperands = CI->getNumArgOperands();
+    for (unsigned i = 0; i != NumOperands; ++i) {
+      Value *Opnd = BI.Inst->getOperand(i);
+      if (!FitsGRFs(Opnd->getType()))
+        return 0;
+      if (isa<VectorType>(Opnd->getType()) && !isa<Constant>(Opnd)
+          && !BI.Info.isOperandBaled(i))
+        return 0;
+    }
+  }
+  return PaddedWidth;
+}
+
+/***********************************************************************
+ * padBale : pad the bale headed by Inst if it has an odd width, and padding
+ *    takes fewer instructions than splitting
+ *
+ * Return:  true if the bale was padded (and erased)
+ */
+bool GenXLegalization::padBale(Instruction *Inst)
+{
+  auto VT = dyn_cast<VectorType>(Inst->getType());
+  if (!VT || isa<PHINode>(Inst) || VT->getElementType()->isIntegerTy(1))
+    return false;
+  unsigned Width = VT->getNumElements();
+  if (Width == 1 || isPowerOf2_32(Width) || Baling->isBaled(Inst))
+    return false;
+  clearBale();
+  Baling->buildBale(Inst, &B);
+  unsigned PaddedWidth = getPaddedWidth(Width);
+  if (!PaddedWidth) {
+    clearBale();
+    return false;
+  }
+  // Cost model. Splitting gives one instruction per power of two piece of
+  // Width, as the padded width fits in one instruction. Padding gives one
+  // instruction, plus a move of the original width (itself split) for each
+  // use that cannot bale in the read of the original lanes.
+  unsigned SplitCost = countPopulation(Width);
+  unsigned PadCost = 1;
+  for (auto &U : Inst->uses()) {
+    if (isa<PHINode>(U.getUser())) {
+      clearBale();
+      return false;
+    }
+    if (!canBaleNarrowedRead(&U))
+      PadCost += SplitCost;
+  }
+  if (PadCost >= SplitCost) {
+    clearBale();
+    return false;
+  }
+  DEBUG(dbgs() << "padding to width " << PaddedWidth << ": ";
+        B.print(dbgs()));
+  // Create the padded bale before the original head, operands first.
+  for (auto &BI : B) {
+    Value *NewV = nullptr;
+    if (BI.Info.Type == BaleInfo::RDREGION) {
+      Region R(BI.Inst, BI.Info);
+      R.NumElements = R.Width = PaddedWidth;
+      NewV = R.createRdRegion(BI.Inst->getOperand(0), "", Inst,
+          BI.Inst->getDebugLoc());
+    } else
+      NewV = splitInst(nullptr, BI, 0, PaddedWidth, Inst,
+          BI.Inst->getDebugLoc());
+    NewV->setName(BI.Inst->getName() + ".pad");
+    Baling->setBaleInfo(cast<Instruction>(NewV), BI.Info);
+    SplitMap[BI.Inst] = NewV;
+  }
+  auto NewHead = cast<Instruction>(SplitMap[Inst]);
+  SplitMap.clear();
+  // Give each use the original lanes of the padded value.
+  Region Narrow(Inst);
+  SmallVector<Use *, 4> Uses;
+  for (auto &U : Inst->uses())
+    Uses.push_back(&U);
+  for (Use *U : Uses) {
+    auto User = cast<Instruction>(U->getUser());
+    if (isRdRegion(User)
+        && U->getOperandNo() == Intrinsic::GenXRegion::OldValueOperandNum) {
+      // The rdregion reads the same elements out of the padded value. Its
+      // intrinsic is overloaded on the input type, so it is replaced by a
+      // new one rather than given the padded operand.
+      Region R(User, BaleInfo());
+      auto NewRd = R.createRdRegion(NewHead, "", User, User->getDebugLoc());
+      NewRd->takeName(User);
+      Baling->setBaleInfo(NewRd, Baling->getBaleInfo(User));
+      User->replaceAllUsesWith(NewRd);
+      // Make sure the new rdregion is considered for padding in its turn.
+      if (CurrentInst == User)
+        CurrentInst = NewRd;
+      eraseInst(User);
+      continue;
+    }
+    auto NewRd = Narrow.createRdRegion(NewHead, Inst->getName() + ".narrow",
+        User, Inst->getDebugLoc());
+    Baling->setBaleInfo(NewRd, BaleInfo(BaleInfo::RDREGION));
+    U->set(NewRd);
+    // Re-bale the user, so the rdregion gets baled in where it can be.
+    if (canBaleNarrowedRead(U))
+      Baling->processInst(User);
+  }
+  // Erase the original bale, head first so each one loses its last use
+  // before it is erased.
+  for (auto bi = B.rbegin(), be = B.rend(); bi != be; ++bi)
+    eraseInst(bi->Inst);
+  clearBale();
+  ++NumPadded;
+  return true;
+}
+
 /***********************************************************************
  * processInst : process one instruction to legalize execution width and GRF
  *    crossing
@@ -1729,8 +2039,17 @@ Value *GenXLegalization::getSplitOperand(Instruction *Inst, unsigned OperandNum,
   Value *V = Inst->getOperand(OperandNum);
   if (!isa<VectorType>(V->getType()))
     return V; // operand not vector, e.g. variable index in region
-  if (auto C = dyn_cast<Constant>(V))
-    return getConstantSubvector(C, StartIdx, Size);
+  if (auto C = dyn_cast<Constant>(V)) {
+    unsigned NumElements = V->getType()->getVectorNumElements();
+    if (StartIdx + Size <= NumElements)
+      return getConstantSubvector(C, StartIdx, Size);
+    // A padded bale (see padBale) reads past the end of the constant. Repeat
+    // its last element in the extra lanes.
+    SmallVector<Constant *, 32> Elements;
+    for (unsigned i = StartIdx; i != StartIdx + Size; ++i)
+      Elements.push_back(C->getAggregateElement(std::min(i, NumElements - 1)));
+    return ConstantVector::get(Elements);
+  }
   // Split a non-constant vector.
   if (Instruction *OperandInst = dyn_cast<Instruction>(V)) {
     auto i = SplitMap.find(OperandInst);
@@ -64,6 +64,22 @@ void GenXLiveness::getAnalysisUsage(AnalysisUsage &AU) const
   AU.setPreservesAll();
 }
 
+/***********************************************************************
+ * getHeldAnalyses : the analyses GenXLiveness points into
+ *
+ * Live ranges are built with the numbering and baling passed in by
+ * setNumbering and setBaling. Only the memory budget's early release looks
+ * at this, so that those are not freed while GenXLiveness is still needed;
+ * without a budget their lifetime is as before.
+ */
+void GenXLiveness::getHeldAnalyses(SmallVectorImpl<AnalysisID> &IDs) const
+{
+  if (Numbering)
+    IDs.push_back(&GenXNumbering::ID);
+  if (Baling)
+    IDs.push_back(&GenXGroupBaling::ID);
+}
+
 /***********************************************************************
  * runOnFunctionGroup : do nothing
  */
@@ -97,6 +113,30 @@ void GenXLiveness::clear()
   ArgAddressBaseMap.clear();
 }
 
+/***********************************************************************
+ * getMemoryFootprint : estimate the bytes held by the live ranges
+ */
+size_t GenXLiveness::getMemoryFootprint() const
+{
+  size_t Bytes = MemoryBudget::getMapFootprint(LiveRangeMap)
+      + MemoryBudget::getMapFootprint(UnifiedRets)
+      + MemoryBudget::getMapFootprint(UnifiedRetToFunc)
+      + MemoryBudget::getMapFootprint(ArgAddressBaseMap);
+  for (auto &Entry : LiveRangeMap) {
+    LiveRange *LR = Entry.second;
+    // A live range is shared by all its values; count it for the first one.
+    if (LR->Values.empty() || LR->Values.front().get() != Entry.first)
+      continue;
+    Bytes += sizeof(LiveRange);
+    // Segments and values beyond the inline two are on the heap.
+    if (LR->Segments.capacity() > 2)
+      Bytes += LR->Segments.capacity() * sizeof(Segment);
+    if (LR->Values.capacity() > 2)
+      Bytes += LR->Values.capacity() * sizeof(AssertingSV);
+  }
+  return Bytes;
+}
+
 /***********************************************************************
  * setLiveRange : add a SimpleValue to a LiveRange
  *
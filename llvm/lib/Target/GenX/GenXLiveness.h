@@ -314,7 +314,11 @@ struct Segment {
   bool operator<(Segment Rhs) const {
     if (Start != Rhs.Start)
       return Start < Rhs.Start;
-    return End < Rhs.End;
+    if (End != Rhs.End)
+      return End < Rhs.End;
+    // Stronger first, so the order (and thus the result of sortAndMerge) does
+    // not depend on the order the segments were added in.
+    return Strength > Rhs.Strength;
   }
   bool isWeak() { return Strength == WEAK; }
 };
@@ -579,6 +583,10 @@ public:
   using Pass::print; // Indicates we aren't replacing base class version of print
   virtual void print(raw_ostream &OS) const;
   virtual void releaseMemory() override { clear(); }
+  // getMemoryFootprint : estimate the bytes held by the live ranges
+  size_t getMemoryFootprint() const override;
+  // getHeldAnalyses : the analyses the live ranges point into
+  void getHeldAnalyses(SmallVectorImpl<AnalysisID> &IDs) const override;
 
 private:
   void clear();
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2020, Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+//===----------------------------------------------------------------------===//
+//
+// MemoryBudget tracks the memory held by the FunctionGroup analyses against
+// an optional budget. See GenXMemoryBudget.h for more details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "GenXMemoryBudget.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+
+using namespace llvm;
+using namespace genx;
+
+static cl::opt<unsigned> GenXMemoryBudgetMB("genx-memory-budget", cl::init(0),
+    cl::Hidden, cl::value_desc("megabytes"),
+    cl::desc("Memory budget for the GenX FunctionGroup analyses, 0 for none"));
+
+static cl::opt<bool> GenXMemoryReport("genx-memory-report", cl::init(false),
+    cl::Hidden,
+    cl::desc("Report the peak memory usage of each GenX FunctionGroup pass"));
+
+/***********************************************************************
+ * init : read the budget for this module
+ *
+ * -genx-memory-budget wins over the "genx.memory.budget" module flag.
+ */
+void MemoryBudget::init(const Module &M)
+{
+  clear();
+  unsigned MB = GenXMemoryBudgetMB;
+  if (!GenXMemoryBudgetMB.getNumOccurrences()) {
+    if (auto Flag = mdconst::extract_or_null<ConstantInt>(
+            M.getModuleFlag("genx.memory.budget")))
+      MB = Flag->getZExtValue();
+  }
+  Budget = size_t(MB) << 20;
+  Report = GenXMemoryReport;
+}
+
+void MemoryBudget::clear()
+{
+  Budget = 0;
+  Report = false;
+  Tracked = PeakTracked = 0;
+  NumReleased = 0;
+  Passes.clear();
+  PassIndex.clear();
+}
+
+void MemoryBudget::setTracked(size_t Bytes)
+{
+  Tracked = Bytes;
+  PeakTracked = std::max(PeakTracked, Bytes);
+}
+
+/***********************************************************************
+ * recordPass : record the usage after a pass ran
+ *
+ * A pass runs once per function group; the report keeps its worst run.
+ */
+void MemoryBudget::recordPass(StringRef Name)
+{
+  if (!Report)
+    return;
+  auto Ins = PassIndex.insert(std::make_pair(Name, Passes.size()));
+  if (Ins.second)
+    Passes.push_back({Name.str(), 0, 0});
+  PassUsage &PU = Passes[Ins.first->second];
+  PU.PeakTracked = std::max(PU.PeakTracked, Tracked);
+  PU.PeakHeap = std::max(PU.PeakHeap, sys::Process::GetMallocUsage());
+}
+
+/***********************************************************************
+ * print : print the per pass report
+ *
+ * Sizes are in kilobytes. The heap column is the malloc usage of the whole
+ * process, and is 0 on hosts where it is not known.
+ */
+void MemoryBudget::print(raw_ostream &OS) const
+{
+  if (!Report)
+    return;
+  OS << "GenX memory report (budget ";
+  if (Budget)
+    OS << (Budget >> 20) << " MB";
+  else
+    OS << "none";
+  OS << ")\n";
+  OS << format("  %10s %10s  %s\n", "tracked KB", "heap KB", "pass");
+  for (auto &PU : Passes)
+    OS << format("  %10zu %10zu  ", PU.PeakTracked >> 10, PU.PeakHeap >> 10)
+       << PU.Name << "\n";
+  OS << "  peak tracked: " << (PeakTracked >> 10) << " KB\n";
+  OS << "  analyses released early: " << NumReleased << "\n";
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2020, Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+//===----------------------------------------------------------------------===//
+//
+/// genx::MemoryBudget : memory budget for the FunctionGroup passes
+/// ---------------------------------------------------------------
+///
+/// MemoryBudget keeps track of the memory held by the analyses run under the
+/// FunctionGroup pass manager (liveness, numbering, baling and the like),
+/// which is where a huge, fully unrolled kernel spends most of its memory.
+/// Each such analysis reports an estimate of its footprint through
+/// FunctionGroupPass::getMemoryFootprint, and the pass manager sums those
+/// after every pass.
+///
+/// The budget is set in megabytes with -genx-memory-budget, or by the
+/// "genx.memory.budget" module flag, which is how libcmc passes it. Once
+/// set:
+///
+/// * When the tracked usage is over the budget, the pass manager releases
+///   every analysis that no remaining pass in the function group needs,
+///   rather than keeping preserved analyses around until their last user.
+///
+/// * When the tracked usage is near the budget, optional optimizations that
+///   build large side tables of their own are skipped for the function
+///   group (see genx::skipOptWithLargeBlock).
+///
+/// -genx-memory-report prints the peak tracked usage after each pass, and
+/// the peak heap usage of the process where it is known, at the end of the
+/// FunctionGroup passes.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef GENXMEMORYBUDGET_H
+#define GENXMEMORYBUDGET_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+class Module;
+class raw_ostream;
+
+namespace genx {
+
+class MemoryBudget {
+  // Budget in bytes, 0 if there is none.
+  size_t Budget = 0;
+  bool Report = false;
+  // Bytes held by the tracked analyses, as last measured, and the peak.
+  size_t Tracked = 0;
+  size_t PeakTracked = 0;
+  // Number of analyses released early because of the budget.
+  unsigned NumReleased = 0;
+  // Per pass peaks, in the order the passes first ran.
+  struct PassUsage {
+    std::string Name;
+    size_t PeakTracked;
+    size_t PeakHeap;
+  };
+  std::vector<PassUsage> Passes;
+  StringMap<unsigned> PassIndex;
+
+public:
+  // init : read the budget from the command line or the module flag
+  void init(const Module &M);
+  void clear();
+  // isActive : whether there is anything to track
+  bool isActive() const { return Budget || Report; }
+  size_t getBudget() const { return Budget; }
+  size_t getTracked() const { return Tracked; }
+  // setTracked : record the bytes currently held by the tracked analyses
+  void setTracked(size_t Bytes);
+  // isOverBudget : the tracked analyses hold more than the budget
+  bool isOverBudget() const { return Budget && Tracked > Budget; }
+  // isNearBudget : the tracked analyses hold at least three quarters of the
+  // budget, so optional optimizations should not build large tables
+  bool isNearBudget() const { return Budget && Tracked >= Budget - Budget / 4; }
+  // recordPass : record the usage after a pass ran
+  void recordPass(StringRef Name);
+  // noteReleased : an analysis was released early
+  void noteReleased() { ++NumReleased; }
+  // print : print the per pass report, if one was requested
+  void print(raw_ostream &OS) const;
+
+  // Footprint estimates for the containers the analyses are built from.
+  template <typename MapT> static size_t getMapFootprint(const MapT &M) {
+    // A red-black tree node is the value plus a color and three links.
+    return M.size() * (sizeof(typename MapT::value_type) + 4 * sizeof(void *));
+  }
+  static size_t getValueMapFootprint(size_t NumEntries, size_t ValueSize) {
+    // ValueMap is a DenseMap keyed by a callback value handle, which keeps
+    // its load factor under 3/4; count it as half full.
+    return NumEntries * 2 * (5 * sizeof(void *) + ValueSize);
+  }
+};
+
+} // end namespace genx
+} // end namespace llvm
+
+#endif // GENXMEMORYBUDGET_H
@@ -84,6 +84,17 @@ void GenXNumbering::clear()
   NumberToPhiIncomingMap.clear();
 }
 
+/***********************************************************************
+ * getMemoryFootprint : estimate the bytes held by the numbering
+ */
+size_t GenXNumbering::getMemoryFootprint() const
+{
+  return MemoryBudget::getValueMapFootprint(BBNumbers.size(), sizeof(BBNumber))
+      + MemoryBudget::getValueMapFootprint(Numbers.size(), sizeof(unsigned))
+      + MemoryBudget::getValueMapFootprint(StartNumbers.size(), sizeof(unsigned))
+      + MemoryBudget::getMapFootprint(NumberToPhiIncomingMap);
+}
+
 /***********************************************************************
  * numberInstructionsInFunc : number the instructions in a function
  */
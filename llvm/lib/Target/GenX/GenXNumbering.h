@@ -113,6 +113,8 @@ public:
   virtual StringRef getPassName() const { return "GenX numbering"; }
   void getAnalysisUsage(AnalysisUsage &AU) const;
   bool runOnFunctionGroup(FunctionGroup &FG);
+  void releaseMemory() override { clear(); }
+  size_t getMemoryFootprint() const override;
   // get BBNumber struct for a basic block
   const BBNumber *getBBNumber(BasicBlock *BB) { return &BBNumbers[BB]; }
   // get and set instruction number
@@ -27,15 +27,33 @@
 ///
 /// This pass tears down a series of raw send chained through the old value
 /// operand when it's safe.
+///
+/// It also uses genx::SendDescriptor to decode raw sends with constant
+/// descriptors, so they optimize like the typed intrinsic for the same
+/// message:
+///
+/// * A message that only reads memory gets the readonly attribute on the
+///   call, so later EarlyCSE, LICM, dead code and dead vector removal treat
+///   it like ``llvm.genx.oword.ld`` and friends.
+///
+/// * A read or write message with a zero response length never writes its
+///   destination, so its result is replaced by the old value operand and the
+///   send becomes the noresult variant. The destination then no longer needs
+///   a live range.
+///
 //===----------------------------------------------------------------------===//
 //
 
 #define DEBUG_TYPE "GENX_RAWSENDRIPPER"
 #include "GenX.h"
+#include "GenXSendDescriptor.h"
+#include "GenXSubtarget.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
 
 using namespace llvm;
@@ -44,6 +62,7 @@ using namespace genx;
 namespace {
 
 class GenXRawSendRipper : public FunctionPass {
+  const GenXSubtarget *ST = nullptr;
 
 public:
   static char ID;
@@ -58,6 +77,9 @@ public:
   }
 
   bool runOnFunction(Function &F) override;
+
+private:
+  bool dropResponse(CallInst *CI);
 };
 
 } // End anonymous namespace
@@ -77,19 +99,78 @@ FunctionPass *llvm::createGenXRawSendRipperPass() {
 
 bool GenXRawSendRipper::runOnFunction(Function &F) {
   bool Changed = false;
+  if (auto P = getAnalysisIfAvailable<GenXSubtargetPass>())
+    ST = P->getSubtarget();
   Value *True = ConstantInt::getTrue(F.getContext());
+  SmallVector<CallInst *, 4> NoResponse;
   for (auto &BB : F)
     for (auto &I : BB) {
       auto IID = getIntrinsicID(&I);
-      if (IID != Intrinsic::genx_raw_send)
+      unsigned OldValueOpnd = 0;
+      switch (IID) {
+      case Intrinsic::genx_raw_send:
+        OldValueOpnd = 5;
+        break;
+      case Intrinsic::genx_raw_sends:
+        OldValueOpnd = 6;
+        break;
+      case Intrinsic::genx_raw_send_noresult:
+      case Intrinsic::genx_raw_sends_noresult:
+        break;
+      default:
         continue;
+      }
       auto II = cast<IntrinsicInst>(&I);
-      if (II->getOperand(1) != True)
+      if (auto SD = SendDescriptor::get(II, ST)) {
+        DEBUG(dbgs() << "raw send " << *SD << ": " << *II << "\n");
+        if (OldValueOpnd && SD->hasNoResponse()) {
+          NoResponse.push_back(II);
+          continue;
+        }
+        if (OldValueOpnd && SD->isReadOnly() && !II->onlyReadsMemory()) {
+          II->setOnlyReadsMemory();
+          Changed = true;
+        }
+      }
+      if (!OldValueOpnd || II->getOperand(1) != True)
         continue;
-      Value *Old = II->getOperand(5);
+      Value *Old = II->getOperand(OldValueOpnd);
       if (isa<UndefValue>(Old))
         continue;
-      II->setOperand(5, UndefValue::get(Old->getType()));
+      II->setOperand(OldValueOpnd, UndefValue::get(Old->getType()));
+      Changed = true;
     }
+  for (auto CI : NoResponse)
+    Changed |= dropResponse(CI);
   return Changed;
 }
+
+/***********************************************************************
+ * dropResponse : turn a raw send whose message has no response into the
+ *    noresult variant
+ *
+ * The destination registers are never written, so the result is just the
+ * old value operand.
+ */
+bool GenXRawSendRipper::dropResponse(CallInst *CI) {
+  bool IsSplit = getIntrinsicID(CI) == Intrinsic::genx_raw_sends;
+  unsigned NumArgs = IsSplit ? 6 : 5;
+  SmallVector<Value *, 6> Args;
+  SmallVector<Type *, 3> Tys;
+  for (unsigned i = 0; i != NumArgs; ++i)
+    Args.push_back(CI->getArgOperand(i));
+  Tys.push_back(Args[1]->getType()); // predicate
+  Tys.push_back(Args[4]->getType()); // src
+  if (IsSplit)
+    Tys.push_back(Args[5]->getType()); // src2
+  Function *Decl = Intrinsic::getDeclaration(
+      CI->getModule(),
+      IsSplit ? Intrinsic::genx_raw_sends_noresult
+              : Intrinsic::genx_raw_send_noresult,
+      Tys);
+  auto NewCI = CallInst::Create(Decl, Args, "", CI);
+  NewCI->setDebugLoc(CI->getDebugLoc());
+  CI->replaceAllUsesWith(CI->getArgOperand(NumArgs));
+  CI->eraseFromParent();
+  return true;
+}
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2020, Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+//===----------------------------------------------------------------------===//
+//
+// Decoding of constant raw send message descriptors. See
+// GenXSendDescriptor.h.
+//
+//===----------------------------------------------------------------------===//
+#include "GenXSendDescriptor.h"
+#include "GenX.h"
+#include "GenXSubtarget.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/Format.h"
+
+using namespace llvm;
+using namespace genx;
+
+/***********************************************************************
+ * SendDescriptor constructor : decode exDesc and desc for the target
+ */
+SendDescriptor::SendDescriptor(unsigned ExDesc, unsigned Desc, bool IsSplit,
+                               const GenXSubtarget *ST)
+    : ExDesc(ExDesc), Desc(Desc), SFID(ExDesc & 0xf), Kind(MK_Other),
+      IsSplit(IsSplit), HasExMsgLength(false) {
+  // The split send extended message length only exists on SKL+, where
+  // sends is available.
+  HasExMsgLength = IsSplit && (!ST || ST->isSKLplus());
+  Kind = classify(SFID, getMsgType(), ST);
+  // Sampler messages keep their message type in desc[16:12] rather than
+  // desc[18:14]; every message type bar the cache flush reads memory.
+  if (SFID == SFID_SAMPLER)
+    Kind = ((Desc >> 12) & 0x1f) == 0x1f ? MK_Other : MK_Read;
+}
+
+/***********************************************************************
+ * classify : classify a data port message type
+ *
+ * Enter:   SFID = shared function id
+ *          MsgType = desc[18:14]
+ *          ST = subtarget, 0 if unknown (assume the oldest supported
+ *               target)
+ *
+ * Anything not known to be a plain read, write or atomic is MK_Other. In
+ * particular the memory fence, and all messages to the gateway, URB,
+ * thread spawner and render cache, stay MK_Other.
+ */
+SendDescriptor::MessageKind SendDescriptor::classify(unsigned SFID,
+                                                     unsigned MsgType,
+                                                     const GenXSubtarget *ST) {
+  bool IsBDWPlus = ST && ST->isBDWplus();
+  switch (SFID) {
+  case SFID_DP_CC:
+    // Constant cache: oword block, unaligned oword block, oword dual block,
+    // dword scattered read.
+    return MsgType <= 3 ? MK_Read : MK_Other;
+  case SFID_DP_DC0:
+    // Scratch block messages have desc[18] set, and desc[17] says whether
+    // it is a write.
+    if (MsgType & 0x10)
+      return MsgType & 0x8 ? MK_Write : MK_Read;
+    switch (MsgType) {
+    case 0x0: // oword block read
+    case 0x1: // unaligned oword block read
+    case 0x2: // oword dual block read
+    case 0x3: // dword scattered read
+    case 0x4: // byte scattered read
+      return MK_Read;
+    case 0x8: // oword block write
+    case 0xa: // oword dual block write
+    case 0xb: // dword scattered write
+    case 0xc: // byte scattered write
+      return MK_Write;
+    }
+    return MK_Other;
+  case SFID_DP_DC1:
+    switch (MsgType) {
+    case 0x1: // untyped surface read
+    case 0x4: // media block read
+    case 0x5: // typed surface read
+      return MK_Read;
+    case 0x9: // untyped surface write
+    case 0xa: // media block write
+    case 0xd: // typed surface write
+      return MK_Write;
+    case 0x2: // untyped atomic
+    case 0x3: // untyped atomic simd4x2
+    case 0x6: // typed atomic
+    case 0x7: // typed atomic simd4x2
+    case 0xb: // atomic counter
+    case 0xc: // atomic counter simd4x2
+      return MK_Atomic;
+    }
+    if (!IsBDWPlus)
+      return MK_Other;
+    // A64 (stateless 64 bit address) messages, BDW+.
+    switch (MsgType) {
+    case 0x10: // A64 scattered read
+    case 0x11: // A64 untyped surface read
+    case 0x14: // A64 block read
+      return MK_Read;
+    case 0x15: // A64 block write
+    case 0x19: // A64 untyped surface write
+    case 0x1a: // A64 scattered write
+      return MK_Write;
+    case 0x12: // A64 untyped atomic
+    case 0x13: // A64 untyped atomic simd4x2
+      return MK_Atomic;
+    }
+    return MK_Other;
+  }
+  return MK_Other;
+}
+
+/***********************************************************************
+ * get : decode the descriptors of a raw send intrinsic call
+ *
+ * Return:  the decoded descriptor, or None if CI is not a raw send or
+ *          either descriptor is not a constant
+ */
+Optional<SendDescriptor> SendDescriptor::get(const CallInst *CI,
+                                             const GenXSubtarget *ST) {
+  bool IsSplit = false;
+  switch (getIntrinsicID(const_cast<CallInst *>(CI))) {
+  case Intrinsic::genx_raw_send:
+  case Intrinsic::genx_raw_send_noresult:
+    break;
+  case Intrinsic::genx_raw_sends:
+  case Intrinsic::genx_raw_sends_noresult:
+    IsSplit = true;
+    break;
+  default:
+    return None;
+  }
+  // Both flavours have exDesc as arg 2 and desc as arg 3.
+  auto ExDesc = dyn_cast<ConstantInt>(CI->getArgOperand(2));
+  auto Desc = dyn_cast<ConstantInt>(CI->getArgOperand(3));
+  if (!ExDesc || !Desc)
+    return None;
+  return SendDescriptor(ExDesc->getZExtValue(), Desc->getZExtValue(), IsSplit,
+                        ST);
+}
+
+/***********************************************************************
+ * SendDescriptor::print : debug print
+ */
+void SendDescriptor::print(raw_ostream &OS) const {
+  static const char *KindNames[] = {"other", "read", "write", "atomic"};
+  OS << "sfid=" << SFID << " type=" << format_hex(getMsgType(), 4)
+     << " mlen=" << getMsgLength() << " rlen=" << getRespLength();
+  if (IsSplit)
+    OS << " exmlen=" << getExMsgLength();
+  if (hasHeader())
+    OS << " header";
+  OS << " " << KindNames[Kind];
+}
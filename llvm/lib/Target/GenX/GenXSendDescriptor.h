@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2020, Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+//===----------------------------------------------------------------------===//
+//
+/// genx::SendDescriptor : decoded raw send message descriptor
+/// ----------------------------------------------------------
+///
+/// A raw send (``llvm.genx.raw.send`` / ``llvm.genx.raw.sends`` and their
+/// noresult variants, as generated from ``cm_send`` and ``cm_sends``) is
+/// opaque to the rest of the backend: it could be any message to any shared
+/// function. When both the extended message descriptor and the message
+/// descriptor are constant, SendDescriptor decodes them into:
+///
+/// * the shared function id (SFID) from exDesc[3:0];
+///
+/// * the message length (desc[28:25]), the response length (desc[24:20]) and
+///   the header present bit (desc[19]), plus the extended message length
+///   (exDesc[9:6]) for a split send on SKL+;
+///
+/// * for the data cache, constant cache and sampler shared functions, the
+///   message type, classified as a read, a write or an atomic.
+///
+/// The classification is conservative: any SFID or message type not listed
+/// in the per-target tables in GenXSendDescriptor.cpp is *Other*, and a pass
+/// must then keep treating the send as having unknown side effects.
+///
+/// GenXRawSendRipper uses the classification to make raw sends optimize like
+/// the typed intrinsics. GenXVisaFuncWriter uses the lengths for the numsrc,
+/// numsrc2 and numdst fields of the vISA raw send, so the finalizer's
+/// scheduling and liveness see only the registers the message really reads
+/// and writes, rather than the whole payload and response variables.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef TARGET_GENXSENDDESCRIPTOR_H
+#define TARGET_GENXSENDDESCRIPTOR_H
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace llvm {
+
+class CallInst;
+class GenXSubtarget;
+
+namespace genx {
+
+class SendDescriptor {
+public:
+  // Shared function ids, as encoded in exDesc[3:0].
+  enum SFIDKind {
+    SFID_NULL = 0,
+    SFID_SAMPLER = 2,
+    SFID_GATEWAY = 3,
+    SFID_DP_DC2 = 4, // sampler cache data port before BDW
+    SFID_DP_RC = 5,
+    SFID_URB = 6,
+    SFID_SPAWNER = 7,
+    SFID_VME = 8,
+    SFID_DP_CC = 9,
+    SFID_DP_DC0 = 10,
+    SFID_PI = 11,
+    SFID_DP_DC1 = 12,
+    SFID_CRE = 13
+  };
+
+  // What a message does to memory.
+  enum MessageKind {
+    MK_Other,  // unknown, or has side effects beyond memory (e.g. gateway)
+    MK_Read,   // only reads memory
+    MK_Write,  // only writes memory
+    MK_Atomic, // reads and writes memory
+  };
+
+private:
+  unsigned ExDesc;
+  unsigned Desc;
+  unsigned SFID;
+  MessageKind Kind;
+  bool IsSplit;
+  bool HasExMsgLength;
+
+  SendDescriptor(unsigned ExDesc, unsigned Desc, bool IsSplit,
+                 const GenXSubtarget *ST);
+  static MessageKind classify(unsigned SFID, unsigned MsgType,
+                              const GenXSubtarget *ST);
+
+public:
+  // get : decode the descriptors of a raw send intrinsic call. Returns None
+  //  if CI is not a raw send, or either descriptor is not constant.
+  static Optional<SendDescriptor> get(const CallInst *CI,
+                                      const GenXSubtarget *ST);
+
+  unsigned getSFID() const { return SFID; }
+  // getMsgType : the data port message type, desc[18:14]. Only meaningful
+  //  for the data port shared functions.
+  unsigned getMsgType() const { return (Desc >> 14) & 0x1f; }
+  // getFuncControl : the function control field, desc[18:0].
+  unsigned getFuncControl() const { return Desc & 0x7ffff; }
+  // Payload and response lengths, in GRFs.
+  unsigned getMsgLength() const { return (Desc >> 25) & 0xf; }
+  unsigned getRespLength() const { return (Desc >> 20) & 0x1f; }
+  // getExMsgLength : the length of src2 of a split send, or 0 if unknown.
+  unsigned getExMsgLength() const {
+    return HasExMsgLength ? (ExDesc >> 6) & 0xf : 0;
+  }
+  bool hasHeader() const { return (Desc >> 19) & 1; }
+  bool isEOT() const { return (ExDesc >> 5) & 1; }
+  bool isSplit() const { return IsSplit; }
+
+  MessageKind getKind() const { return Kind; }
+  bool isRead() const { return Kind == MK_Read; }
+  bool isWrite() const { return Kind == MK_Write; }
+  bool isAtomic() const { return Kind == MK_Atomic; }
+  // isReadOnly : true if the message provably has no effect other than
+  //  reading memory and writing its response.
+  bool isReadOnly() const { return isRead() && !isEOT(); }
+  // hasNoResponse : true if the message provably does not write its
+  //  destination registers.
+  bool hasNoResponse() const {
+    return Kind != MK_Other && getRespLength() == 0;
+  }
+
+  void print(raw_ostream &OS) const;
+};
+
+inline raw_ostream &operator<<(raw_ostream &OS, const SendDescriptor &SD) {
+  SD.print(OS);
+  return OS;
+}
+
+} // End genx namespace
+} // End llvm namespace
+
+#endif
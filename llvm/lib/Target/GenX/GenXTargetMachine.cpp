@@ -34,6 +34,8 @@
 ///
 /// .. include:: GenXRegion.h
 ///
+/// .. include:: GenXSendDescriptor.h
+///
 /// .. include:: GenXSubtarget.h
 ///
 /// Pass documentation
@@ -68,6 +70,9 @@ using namespace llvm;
 static cl::opt<bool> DumpRegAlloc("genx-dump-regalloc", cl::init(false), cl::Hidden,
                   cl::desc("Enable dumping of GenX liveness and register allocation to a file."));
 
+static cl::opt<bool> DeterminismCheck("genx-determinism-check", cl::init(false), cl::Hidden,
+                  cl::desc("Compile twice with a perturbed heap and check the vISA is identical."));
+
 // There's another copy of DL string in clang/lib/Basic/Targets.cpp
 static std::string getDL(bool Is64Bit) {
   return Is64Bit ? "e-p:64:64-i64:64-n8:16:32" : "e-p:32:32-i64:64-n8:16:32";
@@ -132,6 +137,9 @@ bool GenXTargetMachine::addPassesToEmitFile(PassManagerBase &PM,
   // This adds it explicitly to allow passes access the subtarget object using
   // method getAnalysisIfAvailable.
   PM.add(createGenXSubtargetPass(Subtarget));
+  /// .. include:: GenXDeterminismCheck.cpp
+  if (DeterminismCheck && !InDeterminismCheck)
+    PM.add(createGenXDeterminismCheckPass(this, DisableVerify));
 
   PM.add(createTransformPrivMemPass());
   PM.add(createPromoteMemoryToRegisterPass());
@@ -204,6 +212,8 @@ bool GenXTargetMachine::addPassesToEmitFile(PassManagerBase &PM,
   PM.add(createEarlyCSEPass());
   /// .. include:: GenXPatternMatch.cpp
   PM.add(createGenXPatternMatchPass(&Options));
+  /// .. include:: GenXDivRemReduction.cpp
+  PM.add(createGenXDivRemReductionPass());
   if (!DisableVerify) PM.add(createVerifierPass());
   /// .. include:: GenXExtractVectorizer.cpp
   PM.add(createGenXExtractVectorizerPass());
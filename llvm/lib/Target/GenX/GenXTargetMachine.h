@@ -44,6 +44,8 @@ class MachineModuleInfo;
 class GenXTargetMachine : public TargetMachine {
   bool Is64Bit;
   GenXSubtarget Subtarget;
+  // Set while GenXDeterminismCheck builds the pipelines for its own compiles.
+  bool InDeterminismCheck = false;
 
 public:
   GenXTargetMachine(const Target &T, const Triple &TT, StringRef CPU,
@@ -59,6 +61,8 @@ public:
                                    MachineModuleInfo *MMI = nullptr) override;
 
   virtual const DataLayout *getDataLayout() const { return &DL; }
+
+  void setInDeterminismCheck(bool V) { InDeterminismCheck = V; }
 };
 
 class GenXTargetMachine32 : public GenXTargetMachine {
@@ -889,6 +889,8 @@ bool genx::isIdentityBale(const Bale &B) {
 }
 
 bool genx::skipOptWithLargeBlock(FunctionGroup &FG) {
+  if (FG.getParent()->getMemoryBudget().isNearBudget())
+    return true;
   for (auto fgi = FG.begin(), fge = FG.end(); fgi != fge; ++fgi) {
     auto F = *fgi;
     if (skipOptWithLargeBlock(*F))
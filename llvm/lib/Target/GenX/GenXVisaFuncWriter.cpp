@@ -58,6 +58,7 @@
 #include "GenXLiveness.h"
 #include "GenXModule.h"
 #include "GenXRegion.h"
+#include "GenXSendDescriptor.h"
 #include "GenXPressureTracker.h"
 #include "GenXSubtarget.h"
 #include "GenXVisa.h"
@@ -2112,6 +2113,21 @@ void VisaFuncWriter::buildIntrinsic(CallInst *CI, unsigned IntrinID,
           int DataSize = VT->getNumElements()
             * VT->getElementType()->getPrimitiveSizeInBits() / 8;
           DataSize = (DataSize + (GrfByteSize - 1)) / GrfByteSize;
+          // For a raw send with constant descriptors, the message and
+          // response lengths say how many of those GRFs the message really
+          // reads or writes, which lets the finalizer's scheduling and
+          // liveness ignore the rest.
+          if (auto SD = SendDescriptor::get(CI, ST)) {
+            unsigned Len = 0;
+            if (AI.isRet())
+              Len = SD->getRespLength();
+            else if (AI.getArgIdx() == 4)
+              Len = SD->getMsgLength();
+            else if (SD->isSplit() && AI.getArgIdx() == 5)
+              Len = SD->getExMsgLength();
+            if (Len && (int)Len < DataSize)
+              DataSize = Len;
+          }
           Code.push_back((uint8_t)DataSize);
         }
         break;
@@ -34,6 +34,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "PacketBuilder.h"
+#include "WIAnalysis.hpp"
 #include "llvm/Pass.h"
 #include "llvm/IR/Dominators.h"
 #include "llvm/Transforms/Scalar/CMRegion.h"
@@ -82,6 +83,9 @@ namespace llvm {
 /// g) vectorize SIMT-entry functions
 ///    - no change of function arguments
 ///    - no cloning, direct-vectorization on the function-body
+///    - an svm gather of one dword per lane from consecutive addresses,
+///      outside divergent control-flow, becomes an unaligned block read
+///      (WIAnalysis::isConsecutiveAccess)
 ///
 /// h) SIMD-control-flow lowering
 ///
@@ -97,6 +101,7 @@ public:
   virtual StringRef getPassName() const { return "GenX Packetize"; }
   void getAnalysisUsage(AnalysisUsage &AU) const {
     AU.addRequiredID(BreakCriticalEdgesID);
+    AU.addRequired<WIAnalysis>();
   };
   bool runOnModule(Module &M);
   void releaseMemory() override {
@@ -115,6 +120,7 @@ private:
   Function *getVectorIntrinsic(Module *M, Intrinsic::ID id, std::vector<Type *> &ArgTy);
   Value *packetizeConstant(Constant *pConstant);
   Value *packetizeGenXIntrinsic(Instruction *pInst);
+  Value *packetizeConsecutiveGather(CallInst *CI);
   Value *packetizeLLVMIntrinsic(Instruction *pInst);
   Value *packetizeLLVMInstruction(Instruction *pInst);
   Value *packetizeInstruction(Instruction *pInst);
@@ -150,6 +156,8 @@ private:
   std::map<Function*, std::set<unsigned>> FuncVectors;
   /// Map: original function and vectorization width ==> vectorized version
   std::map<std::pair<Function*, unsigned>, Function*> FuncMap;
+  /// work-item analysis of the SIMT-entry being vectorized, else null
+  WIAnalysis *WIA = nullptr;
 
   const DataLayout *DL;
 };
@@ -322,6 +330,10 @@ bool GenXPacketize::vectorizeSIMTEntry(Function &F)
   // find uniform instructions related to uniform arguments
   findUniformInsts(F);
 
+  // the arguments of a SIMT-entry are uniform, as WIAnalysis assumes, so
+  // its strides hold here (unlike in a function called in SIMT mode)
+  WIA = &getAnalysis<WIAnalysis>(F);
+
   uint32_t Width = 0;
   F.getFnAttribute("CMGenxSIMT").getValueAsString()
     .getAsInteger(0, Width);
@@ -352,6 +364,7 @@ bool GenXPacketize::vectorizeSIMTEntry(Function &F)
     }
   }
 
+  WIA = nullptr;
   removeDeadInstructions(F);
 
   return true;
@@ -1199,6 +1212,8 @@ Value* GenXPacketize::packetizeGenXIntrinsic(Instruction* inst)
         }
         break;
         case Intrinsic::genx_svm_gather: {
+          if (Value *Block = packetizeConsecutiveGather(CI))
+            return Block;
           Value *Predicate = getPacketizeValue(CI->getOperand(0));
           Value *NBlk = CI->getOperand(1);
           assert(isa<Constant>(NBlk));
@@ -1700,6 +1715,41 @@ void GenXPacketize::lowerControlFlowAfter(std::vector<Function*> &SIMTFuncs) {
     CFL.processFunction(SIMTFuncs[i]);
 }
 
+/***************************************************************************
+ * packetize an svm gather of one dword per lane as an unaligned block read
+ * from the address of lane 0, if the addresses of the lanes are consecutive
+ * and do not wrap, and every lane is enabled
+ */
+Value *GenXPacketize::packetizeConsecutiveGather(CallInst *CI)
+{
+  if (!WIA || WIA->insideDivergentCF(CI))
+    return nullptr;
+  auto Pred = dyn_cast<Constant>(CI->getOperand(0));
+  auto NBlk = dyn_cast<ConstantInt>(CI->getOperand(1));
+  Type *Ty = CI->getType();
+  if (!Pred || !Pred->isAllOnesValue() || !NBlk || !NBlk->isZero() ||
+      Ty->getVectorNumElements() != 1 || Ty->getScalarSizeInBits() != 32)
+    return nullptr;
+  // the address is the scalar address of the lane, possibly as <1 x i64>
+  Value *Addr = CI->getOperand(2);
+  if (Addr->getType()->isVectorTy()) {
+    auto IE = dyn_cast<InsertElementInst>(Addr);
+    if (!IE || !isa<UndefValue>(IE->getOperand(0)))
+      return nullptr;
+    Addr = IE->getOperand(1);
+  }
+  if (!WIA->isConsecutiveAccess(Addr, 4))
+    return nullptr;
+  Value *VecAddr = getPacketizeValue(CI->getOperand(2));
+  Value *Lane0Addr = B->IRB()->CreateExtractElement(VecAddr, (uint64_t)0);
+  Type *RetTy = B->GetVectorType(Ty);
+  auto Decl = Intrinsic::getDeclaration(
+      M, Intrinsic::genx_svm_block_ld_unaligned, RetTy);
+  auto Replacement = CallInst::Create(Decl, Lane0Addr, CI->getName(), CI);
+  Replacement->setDebugLoc(CI->getDebugLoc());
+  return Replacement;
+}
+
 // foward declare the initializer
 void initializeGenXPacketizePass(PassRegistry &);
 
@@ -1710,6 +1760,7 @@ using namespace llvm;
 char GenXPacketize::ID = 0;
 INITIALIZE_PASS_BEGIN(GenXPacketize, "GenXPacketize", "GenXPacketize", false, false)
 INITIALIZE_PASS_DEPENDENCY(BreakCriticalEdges)
+INITIALIZE_PASS_DEPENDENCY(WIAnalysis)
 INITIALIZE_PASS_END(GenXPacketize, "GenXPacketize", "GenXPacketize", false, false)
 
 namespace llvm {
@@ -25,8 +25,12 @@
 
 #include "llvm/IR/Intrinsics.h"
 #include "llvm/IR/IntrinsicsGenX.h"
+#include <llvm/Analysis/ValueTracking.h>
 #include <llvm/IR/CFG.h>
 #include <llvm/IR/Constants.h>
+#include <llvm/IR/GetElementPtrTypeIterator.h>
+#include <llvm/IR/Operator.h>
+#include <llvm/Support/KnownBits.h>
 #include <llvm/Support/CommandLine.h>
 #include <llvm/Support/Debug.h>
 
@@ -36,7 +40,7 @@
 
 using namespace llvm;
 
-static cl::opt<bool> PrintWiaCheck("print-wia-check", cl::init(true),
+static cl::opt<bool> PrintWiaCheck("print-wia-check", cl::init(false),
                                    cl::Hidden,
                                    cl::desc("Debug wia-check analysis"));
 
@@ -93,7 +97,13 @@ void WIAnalysis::print(raw_ostream &OS, const Module *) const {
       DenseMap<const Value *, WIDependancy>::const_iterator dep_it =
           m_deps.find(I);
       if (dep_it != m_deps.end()) {
-        OS << "  " << "STRIDE:" << dep_it->second << " " << *I;
+        OS << "  " << "STRIDE:" << dep_it->second;
+        if (dep_it->second != UNIFORM && dep_it->second != RANDOM) {
+          unsigned nw = whichNoWrap(I);
+          OS << ((nw & NW_SIGNED) ? " nsw" : "")
+             << ((nw & NW_UNSIGNED) ? " nuw" : "");
+        }
+        OS << " " << *I;
       } else {
         OS << "  unknown " << *I;
       }
@@ -120,6 +130,7 @@ bool WIAnalysis::runOnFunction(Function &F) {
   PDT = &getAnalysis<PostDominatorTreeWrapperPass>().getPostDomTree();
 
   m_deps.clear();
+  m_noWrap.clear();
   m_changed1.clear();
   m_changed2.clear();
   m_pChangedNew = &m_changed1;
@@ -211,6 +222,24 @@ WIAnalysis::WIDependancy WIAnalysis::whichDepend(const Value *val) {
   return m_deps[val];
 }
 
+unsigned WIAnalysis::whichNoWrap(const Value *val) const {
+  // arguments and constants are uniform
+  if (!isa<Instruction>(val))
+    return NW_BOTH;
+  auto dep_it = m_deps.find(val);
+  if (dep_it == m_deps.end() || dep_it->second == WIAnalysis::RANDOM)
+    return NW_NONE;
+  if (dep_it->second == WIAnalysis::UNIFORM)
+    return NW_BOTH;
+  auto nw_it = m_noWrap.find(val);
+  return nw_it == m_noWrap.end() ? NW_NONE : nw_it->second;
+}
+
+bool WIAnalysis::isConsecutiveAccess(const Value *ptr, unsigned ElemSize) {
+  return whichDepend(ptr) == (WIDependancy)ElemSize &&
+         (whichNoWrap(ptr) & NW_UNSIGNED);
+}
+
 bool WIAnalysis::stayUniformIfUsedAt(const Value *val, BasicBlock *use_blk) {
   const Instruction *inst = dyn_cast<Instruction>(val);
   // if it is a function argument, no problem to use it anywhere inside the
@@ -302,6 +331,7 @@ void WIAnalysis::calculate_dep(const Value *val) {
 
   bool hasOriginal = hasDependency(inst);
   WIDependancy orig;
+  unsigned origNoWrap = NW_NONE;
   // We only calculate dependency on unset instructions if all their operands
   // were already given dependency. This is good for compile time since these
   // instructions will be visited again after the operands dependency is set.
@@ -335,9 +365,11 @@ void WIAnalysis::calculate_dep(const Value *val) {
     if (orig == WIAnalysis::RANDOM) {
       return;
     }
+    origNoWrap = whichNoWrap(inst);
   }
 
   WIDependancy dep = orig;
+  m_curNoWrap = NW_NONE;
 
   // LLVM does not have compile time polymorphisms
   // TODO: to make things faster we may want to sort the list below according
@@ -377,8 +409,26 @@ void WIAnalysis::calculate_dep(const Value *val) {
   else if (const VAArgInst *VAI = dyn_cast<VAArgInst>(inst))
     dep = calculate_dep(VAI);
 
+  unsigned noWrap = NW_NONE;
+  if (dep == WIAnalysis::UNIFORM) {
+    noWrap = NW_BOTH;
+  } else if (dep != WIAnalysis::RANDOM) {
+    noWrap = m_curNoWrap;
+    // A strided integer that is non-negative in every lane cannot wrap, as
+    // the stride is less than half its range.
+    const IntegerType *intType = dyn_cast<IntegerType>(inst->getType());
+    if (noWrap != NW_BOTH && intType && intType->getBitWidth() > 11 &&
+        isKnownNonNegative(inst, m_func->getParent()->getDataLayout(), 0,
+                           nullptr, inst, DT))
+      noWrap = NW_BOTH;
+  }
+  if (dep != WIAnalysis::UNIFORM && dep != WIAnalysis::RANDOM)
+    m_noWrap[inst] = noWrap;
+  else
+    m_noWrap.erase(inst);
+
   // If the value was changed in this calculation
-  if (!hasOriginal || dep != orig) {
+  if (!hasOriginal || dep != orig || noWrap != origNoWrap) {
     // Save the new value of this instruction
     updateDepMap(inst, dep);
     // divergent branch, trigger updates due to control-dependence
@@ -549,101 +599,114 @@ WIAnalysis::WIDependancy WIAnalysis::calculate_dep(const BinaryOperator *inst) {
     return WIAnalysis::UNIFORM;
   }
 
-  // FIXME:: assumes that the X value does not cross the +/- border - risky !!!
-  // The pattern (and (X, C)), where C preserves the lower k bits of the value,
-  // is often used for truncating of numbers in 64bit. We assume that the index
-  // properties are not hurt by this.
-  if (inst->getOpcode() == Instruction::And) {
-    ConstantInt *C0 = dyn_cast<ConstantInt>(inst->getOperand(0));
-    ConstantInt *C1 = dyn_cast<ConstantInt>(inst->getOperand(1));
-    // Use any of the constants. Instcombine places constants on Op1
-    // so try Op1 first.
-    if (C1 || C0) {
-      ConstantInt *C = C1 ? C1 : C0;
-      WIAnalysis::WIDependancy dep = C1 ? dep0 : dep1;
-      // Cannot look at bit pattern of huge integers.
-      if (C->getBitWidth() < 65) {
-        uint64_t val = C->getZExtValue();
-        uint64_t ptr_mask = (1 << MinIndexBitwidthToPreserve) - 1;
-        // Zero all bits above the lower k bits that we are interested in
-        val &= (ptr_mask);
-        // Make sure that all of the remaining bits are active
-        if (val == ptr_mask) {
-          return dep;
-        }
-      }
+  const DataLayout &DL = m_func->getParent()->getDataLayout();
+  switch (inst->getOpcode()) {
+  case Instruction::And: {
+    // An and that only clears bits known to be zero is a copy of the other
+    // operand, as in the pattern (and (X, C)) used to truncate an index.
+    // Instcombine places constants on Op1 so try Op1 first.
+    const ConstantInt *C = dyn_cast<ConstantInt>(op1);
+    const Value *X = op0;
+    if (!C) {
+      C = dyn_cast<ConstantInt>(op0);
+      X = op1;
     }
-  }
-
-  // FIXME:: assumes that the X value does not cross the +/- border - risky !!!
-  // The pattern (ashr (shl X, C)C) is used for truncating of numbers in 64bit
-  // The constant C must leave at least 32bits of the original number
-  if (inst->getOpcode() == Instruction::AShr) {
-    BinaryOperator *SHL = dyn_cast<BinaryOperator>(inst->getOperand(0));
-    // We also allow add of uniform value between the ashr and shl instructions
-    // since instcombine creates this pattern when adding a constant.
-    // The shl forces all low bits to be zero, so there can be no carry to the
-    // high bits due to the addition. Addition with uniform preservs WI-dep.
-    if (SHL && SHL->getOpcode() == Instruction::Add) {
-      Value *addedVal = SHL->getOperand(1);
-      if (getDependency(addedVal) == WIAnalysis::UNIFORM) {
-        SHL = dyn_cast<BinaryOperator>(SHL->getOperand(0));
+    if (C) {
+      KnownBits Known = computeKnownBits(X, DL, 0, nullptr, inst, DT);
+      if ((~C->getValue() & ~Known.Zero).isNullValue()) {
+        m_curNoWrap = whichNoWrap(X);
+        return getDependency(X);
       }
     }
-
-    if (SHL && SHL->getOpcode() == Instruction::Shl) {
-      ConstantInt *c_ashr = dyn_cast<ConstantInt>(inst->getOperand(1));
-      ConstantInt *c_shl = dyn_cast<ConstantInt>(SHL->getOperand(1));
-      const IntegerType *AshrTy = cast<IntegerType>(inst->getType());
-      if (c_ashr && c_shl && c_ashr->getZExtValue() == c_shl->getZExtValue()) {
-        // If wordWidth - shift_width >= 32 bits
-        if ((AshrTy->getBitWidth() - c_shl->getZExtValue()) >=
-            MinIndexBitwidthToPreserve) {
-          // return the dep of the original X
-          return getDependency(SHL->getOperand(0));
-        }
-      }
+    return WIAnalysis::RANDOM;
+  }
+  case Instruction::Or:
+    // An or of values with no common bits set is an add that cannot carry.
+    if (dep0 != WIAnalysis::RANDOM && dep1 != WIAnalysis::RANDOM &&
+        haveNoCommonBitsSet(op0, op1, DL, nullptr, inst, DT)) {
+      m_curNoWrap = whichNoWrap(op0) & whichNoWrap(op1);
+      return clampDepend((int)dep0 + (int)dep1);
     }
+    return WIAnalysis::RANDOM;
+  case Instruction::AShr:
+  case Instruction::LShr: {
+    // The pattern (ashr (shl X, C), C) is used to sign extend the low bits
+    // of a number, (lshr (shl X, C), C) to zero extend them. Either one is a
+    // copy of X if X has no significant bits above those.
+    const BinaryOperator *SHL = dyn_cast<BinaryOperator>(op0);
+    const ConstantInt *c_shr = dyn_cast<ConstantInt>(op1);
+    if (!SHL || SHL->getOpcode() != Instruction::Shl || !c_shr ||
+        SHL->getOperand(1) != op1)
+      return WIAnalysis::RANDOM;
+    const Value *X = SHL->getOperand(0);
+    uint64_t c = c_shr->getZExtValue();
+    bool isCopy;
+    if (inst->getOpcode() == Instruction::AShr)
+      isCopy = ComputeNumSignBits(X, DL, 0, nullptr, inst, DT) > c;
+    else
+      isCopy = computeKnownBits(X, DL, 0, nullptr, inst, DT)
+                   .countMinLeadingZeros() >= c;
+    if (!isCopy)
+      return WIAnalysis::RANDOM;
+    m_curNoWrap = whichNoWrap(X);
+    return getDependency(X);
+  }
+  default:
+    break;
   }
 
   if (dep0 == WIAnalysis::RANDOM || dep1 == WIAnalysis::RANDOM) {
     return WIAnalysis::RANDOM;
   }
   // stride computation
+  //
+  // Add, sub, mul and shl keep a value affine in the lane modulo its bit
+  // width. The result only wraps across the lanes if an operand does or if
+  // the operation itself can wrap.
+  int64_t stride;
   switch (inst->getOpcode()) {
-    // Addition simply adds the stride value, except for ptr_consecutive
-    // which is promoted to strided.
-    // Another exception is when we subtract the tid: 1 - X which turns the
+    // Addition simply adds the stride value.
+    // An exception is when we subtract the tid: 1 - X which turns the
     // tid order to random.
-  case Instruction::Add: {
-    int stride = dep0 + dep1;
-    return clampDepend(stride);
-  }
-  case Instruction::Sub: {
-    int stride = dep0 - dep1;
-    return clampDepend(stride);
-  }
-  case Instruction::Mul:
-    if (const ConstantInt* ConstOpnd = dyn_cast<ConstantInt>(op0)) {
-      const int c = (int)ConstOpnd->getSExtValue();
-      return clampDepend(c*dep1);
-    }
-    else if (const ConstantInt* ConstOpnd = dyn_cast<ConstantInt>(op1)) {
-      const int c = (int)ConstOpnd->getSExtValue();
-      return clampDepend(c*dep0);
+  case Instruction::Add:
+    stride = (int64_t)dep0 + dep1;
+    break;
+  case Instruction::Sub:
+    stride = (int64_t)dep0 - dep1;
+    break;
+  case Instruction::Mul: {
+    const ConstantInt *ConstOpnd = dyn_cast<ConstantInt>(op0);
+    WIAnalysis::WIDependancy dep = dep1;
+    if (!ConstOpnd) {
+      ConstOpnd = dyn_cast<ConstantInt>(op1);
+      dep = dep0;
     }
+    if (!ConstOpnd || ConstOpnd->getValue().getMinSignedBits() > 32)
+      return WIAnalysis::RANDOM;
+    stride = ConstOpnd->getSExtValue() * dep;
     break;
+  }
   case Instruction::Shl:
     if (const ConstantInt* ConstOpnd = dyn_cast<ConstantInt>(op1)) {
-      const int c = (int)ConstOpnd->getSExtValue();
-      return clampDepend(dep0<<c);
+      uint64_t c = ConstOpnd->getZExtValue();
+      if (c >= 10)
+        return WIAnalysis::RANDOM;
+      stride = (int64_t)dep0 << c;
+      break;
     }
-    break;
+    return WIAnalysis::RANDOM;
   default:
     // TODO: Support more arithmetic if needed
     return WIAnalysis::RANDOM;
   }
-  return WIAnalysis::RANDOM;
+  if (stride < 0 || stride >= WIAnalysis::RANDOM)
+    return WIAnalysis::RANDOM;
+
+  const OverflowingBinaryOperator *OBO = cast<OverflowingBinaryOperator>(inst);
+  unsigned noWrap = whichNoWrap(op0) & whichNoWrap(op1);
+  m_curNoWrap = (OBO->hasNoSignedWrap() ? noWrap & NW_SIGNED : NW_NONE) |
+                (OBO->hasNoUnsignedWrap() ? noWrap & NW_UNSIGNED : NW_NONE);
+  return clampDepend((int)stride);
 }
 
 WIAnalysis::WIDependancy WIAnalysis::calculate_dep(const CallInst *inst) {
@@ -651,7 +714,18 @@ WIAnalysis::WIDependancy WIAnalysis::calculate_dep(const CallInst *inst) {
     auto IID = Callee->getIntrinsicID();
     switch (IID) {
     case Intrinsic::genx_lane_id:
+      m_curNoWrap = NW_BOTH;
       return (WIAnalysis::WIDependancy)1;
+    case Intrinsic::genx_smin:
+    case Intrinsic::genx_smax:
+    case Intrinsic::genx_umin:
+    case Intrinsic::genx_umax:
+      if (inst->getType() != inst->getArgOperand(0)->getType())
+        break;
+      return calculate_minmax_dep(inst->getArgOperand(0),
+                                  inst->getArgOperand(1),
+                                  IID == Intrinsic::genx_smin ||
+                                      IID == Intrinsic::genx_smax);
     default:
       break;
     }
@@ -677,8 +751,37 @@ WIAnalysis::calculate_dep(const GetElementPtrInst *inst) {
 
   const Value *lastInd = inst->getOperand(num);
   WIAnalysis::WIDependancy lastIndDep = getDependency(lastInd);
-  // \todo
-  return clampDepend((int)ptrDep + (int)lastIndDep);
+  if (ptrDep == WIAnalysis::RANDOM || lastIndDep == WIAnalysis::RANDOM) {
+    return WIAnalysis::RANDOM;
+  }
+
+  // The last index is sign extended to the pointer width and scaled by the
+  // size of what it indexes, giving a stride in bytes. The extension keeps
+  // the stride only if the index does not wrap as a signed value.
+  const DataLayout &DL = m_func->getParent()->getDataLayout();
+  unsigned indNoWrap = whichNoWrap(lastInd);
+  if (lastInd->getType()->getScalarSizeInBits() <
+          DL.getPointerTypeSizeInBits(inst->getType()) &&
+      !(indNoWrap & NW_SIGNED)) {
+    return WIAnalysis::RANDOM;
+  }
+  gep_type_iterator GTI = gep_type_begin(inst);
+  std::advance(GTI, num - 1);
+  uint64_t size = DL.getTypeAllocSize(GTI.getIndexedType());
+  if (lastIndDep != WIAnalysis::UNIFORM && size >= WIAnalysis::RANDOM) {
+    return WIAnalysis::RANDOM;
+  }
+  uint64_t stride = ptrDep + lastIndDep * size;
+  if (stride >= WIAnalysis::RANDOM) {
+    return WIAnalysis::RANDOM;
+  }
+
+  // An inbounds address computation does not wrap in any lane.
+  if (inst->isInBounds() && (whichNoWrap(opPtr) & NW_UNSIGNED) &&
+      (indNoWrap & NW_SIGNED)) {
+    m_curNoWrap = NW_UNSIGNED;
+  }
+  return clampDepend((int)stride);
 }
 
 WIAnalysis::WIDependancy WIAnalysis::calculate_dep(const PHINode *inst) {
@@ -748,12 +851,42 @@ WIAnalysis::WIDependancy WIAnalysis::calculate_dep(const SelectInst *inst) {
     Value *op2 = inst->getOperand(2);
     WIAnalysis::WIDependancy dep1 = getDependency(op1);
     WIAnalysis::WIDependancy dep2 = getDependency(op2);
-    if (dep1 == dep2)
+    if (dep1 == dep2) {
+      m_curNoWrap = whichNoWrap(op1) & whichNoWrap(op2);
       return dep1;
+    }
+    return WIAnalysis::RANDOM;
   }
+
+  // A select forming a min or max
+  Value *LHS = nullptr, *RHS = nullptr;
+  SelectPatternFlavor SPF =
+      matchSelectPattern(const_cast<SelectInst *>(inst), LHS, RHS).Flavor;
+  if (SPF == SPF_SMIN || SPF == SPF_SMAX)
+    return calculate_minmax_dep(LHS, RHS, true);
+  if (SPF == SPF_UMIN || SPF == SPF_UMAX)
+    return calculate_minmax_dep(LHS, RHS, false);
   return WIAnalysis::RANDOM;
 }
 
+WIAnalysis::WIDependancy WIAnalysis::calculate_minmax_dep(const Value *a,
+                                                          const Value *b,
+                                                          bool isSigned) {
+  // If both values have the same stride and neither wraps in the sense of the
+  // comparison, their difference is the same in every lane, so every lane
+  // picks the same one and the result keeps the stride.
+  WIAnalysis::WIDependancy depA = getDependency(a);
+  if (depA == WIAnalysis::RANDOM || depA != getDependency(b)) {
+    return WIAnalysis::RANDOM;
+  }
+  unsigned noWrap = whichNoWrap(a) & whichNoWrap(b);
+  if (!(noWrap & (isSigned ? NW_SIGNED : NW_UNSIGNED))) {
+    return WIAnalysis::RANDOM;
+  }
+  m_curNoWrap = noWrap;
+  return depA;
+}
+
 WIAnalysis::WIDependancy WIAnalysis::calculate_dep(const AllocaInst *inst) {
   // \todo
   return WIAnalysis::RANDOM;
@@ -767,26 +900,54 @@ WIAnalysis::WIDependancy WIAnalysis::calculate_dep(const CastInst *inst) {
   if (WIAnalysis::UNIFORM == dep0)
     return dep0;
 
+  const DataLayout &DL = m_func->getParent()->getDataLayout();
+  unsigned noWrap0 = whichNoWrap(op0);
   switch (inst->getOpcode()) {
-  case Instruction::SExt:
   case Instruction::FPTrunc:
   case Instruction::FPExt:
-  case Instruction::PtrToInt:
-  case Instruction::IntToPtr:
-  case Instruction::AddrSpaceCast:
   case Instruction::UIToFP:
   case Instruction::FPToUI:
   case Instruction::FPToSI:
   case Instruction::SIToFP:
     return dep0;
-  case Instruction::BitCast:
+  case Instruction::PtrToInt:
+  case Instruction::IntToPtr:
+  case Instruction::AddrSpaceCast:
+    if (DL.getTypeSizeInBits(inst->getSrcTy()) ==
+        DL.getTypeSizeInBits(inst->getDestTy()))
+      m_curNoWrap = noWrap0;
+    return dep0;
+  // An extension keeps the stride if the value does not wrap in the sense
+  // of the extension.
+  case Instruction::SExt:
+    if (noWrap0 & NW_SIGNED) {
+      m_curNoWrap = NW_SIGNED;
+      return dep0;
+    }
+    return WIAnalysis::RANDOM;
   case Instruction::ZExt:
+    if (noWrap0 & NW_UNSIGNED) {
+      m_curNoWrap = NW_BOTH;
+      return dep0;
+    }
+    return WIAnalysis::RANDOM;
+  case Instruction::BitCast:
     return WIAnalysis::RANDOM;
-    // FIXME:: assumes that the value does not cross the +/- border - risky !!!!
   case Instruction::Trunc: {
+    // The value stays affine modulo the narrower width, and the stride still
+    // fits. It does not wrap if no significant bits are lost.
     const Type *destType = inst->getDestTy();
     const IntegerType *intType = dyn_cast<IntegerType>(destType);
     if (intType && (intType->getBitWidth() >= MinIndexBitwidthToPreserve)) {
+      unsigned lost = op0->getType()->getScalarSizeInBits() -
+                      intType->getBitWidth();
+      if ((noWrap0 & NW_SIGNED) &&
+          ComputeNumSignBits(op0, DL, 0, nullptr, inst, DT) > lost)
+        m_curNoWrap |= NW_SIGNED;
+      if ((noWrap0 & NW_UNSIGNED) &&
+          computeKnownBits(op0, DL, 0, nullptr, inst, DT)
+                  .countMinLeadingZeros() >= lost)
+        m_curNoWrap |= NW_UNSIGNED;
       return dep0;
     }
     return WIAnalysis::RANDOM;
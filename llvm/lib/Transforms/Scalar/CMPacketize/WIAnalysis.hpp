@@ -99,10 +99,21 @@ public:
   /// @brief describes the type of dependency on the work item
   enum WIDependancy {
     UNIFORM = 0,         /// All elements in vector are constant
-    // stride-value between 1 and 1023
+    // stride-value between 1 and 1023, in bytes for a pointer
     RANDOM = 1024,        /// if stride >= 1024, treat as random      
   };
 
+  /// @brief describes which wrap-around a strided value is known not to have
+  /// across the lanes. The stride of a value holds modulo its bit width;
+  /// it holds exactly, so survives sign or zero extension, only if the value
+  /// does not wrap in that sense.
+  enum NoWrapKind {
+    NW_NONE = 0,
+    NW_SIGNED = 1,       /// lane values do not cross the signed border
+    NW_UNSIGNED = 2,     /// lane values do not cross the unsigned border
+    NW_BOTH = NW_SIGNED | NW_UNSIGNED,
+  };
+
   /// The WIAnalysis follows pointer arithmetic
   ///  and Index arithmetic when calculating dependency
   ///  properties. If a part of the index is lost due to
@@ -123,6 +134,16 @@ public:
   /// @return Dependency kind
   WIDependancy whichDepend(const llvm::Value *val);
 
+  /// @brief Returns the wrap-around the value is known not to have
+  /// @param val llvm::Value to test
+  /// @return NoWrapKind bits, NW_BOTH for a uniform value
+  unsigned whichNoWrap(const llvm::Value *val) const;
+
+  /// @brief Returns true if the pointer is consecutive for accesses of
+  /// ElemSize bytes and its addresses do not wrap, so the lanes can be
+  /// accessed with a single block message
+  bool isConsecutiveAccess(const llvm::Value *ptr, unsigned ElemSize);
+
   /// @brief Inform analysis that instruction was invalidated
   /// as pointer may later be reused
   /// @param val llvm::Value to invalidate
@@ -154,6 +175,7 @@ public:
 
   virtual void releaseMemory() {
     m_deps.clear();
+    m_noWrap.clear();
     m_changed1.clear();
     m_changed2.clear();
     m_ctrlBranches.clear();
@@ -181,6 +203,8 @@ private:
   WIDependancy calculate_dep(const llvm::CastInst *inst);
   WIDependancy calculate_dep(const llvm::VAArgInst *inst);
   WIDependancy calculate_dep(const llvm::LoadInst *inst);
+  WIDependancy calculate_minmax_dep(const llvm::Value *a, const llvm::Value *b,
+                                    bool isSigned);
   /*! \} */
 
   WIDependancy clampDepend(int stride) {
@@ -239,6 +263,10 @@ private:
 private:
   /// Stores an updated list of all dependencies
   llvm::DenseMap<const llvm::Value *, WIDependancy> m_deps;
+  /// NoWrapKind bits of the strided values
+  llvm::DenseMap<const llvm::Value *, unsigned> m_noWrap;
+  /// NoWrapKind bits of the value being calculated, set by calculate_dep
+  unsigned m_curNoWrap;
   /// for each block, store the list of diverging branches that affect it
   llvm::DenseMap<const llvm::BasicBlock *,
                  llvm::SmallPtrSet<const llvm::Instruction *, 4>>
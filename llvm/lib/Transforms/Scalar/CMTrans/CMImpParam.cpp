@@ -174,6 +174,7 @@ struct CMImpParam : public ModulePass {
 private:
   void replaceWithGlobal(CallInst *CI, Intrinsic::ID IID);
   bool AnalyzeImplicitUse(Module &M);
+  void collectOCLFunctions(Module &M, SmallPtrSetImpl<Function *> &Funcs);
   void MergeImplicits(ImplicitUseInfo &implicits, Function *F);
   void PropagateImplicits(Function *F, Module &M,
                           ImplicitUseInfo &implicits);
@@ -372,87 +373,116 @@ void CMImpParam::replaceWithGlobal(CallInst *CI, Intrinsic::ID IID) {
   CI->replaceAllUsesWith(Load);
 }
 
-// For each function, see if it uses an intrinsic that in turn requires an
-// implicit kernel argument
+// Check whether an intrinsic in turn requires an implicit kernel argument
 // (such as llvm.genx.local.size)
+static bool isImplicitArgIntrinsic(Intrinsic::ID IID) {
+  switch (IID) {
+  case Intrinsic::genx_local_size:
+  case Intrinsic::genx_local_id:
+  case Intrinsic::genx_group_count:
+  case Intrinsic::genx_get_scoreboard_deltas:
+  case Intrinsic::genx_get_scoreboard_bti:
+  case Intrinsic::genx_get_scoreboard_depcnt:
+  case Intrinsic::genx_local_id_x:
+  case Intrinsic::genx_local_id_y:
+  case Intrinsic::genx_local_id_z:
+  case Intrinsic::genx_group_or_local_size:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Find the functions that use an intrinsic requiring an implicit kernel
+// argument by walking the uses of the intrinsic declarations, rather than
+// scanning the code of every function.
 bool CMImpParam::AnalyzeImplicitUse(Module &M) {
   bool changed = false;
 
-  for (Module::iterator I = M.begin(), E = M.end(); I != E; ++I) {
-    Function *Fn = &*I;
-    DEBUG(dbgs() << "AnalyzeImplicitUse visiting " << Fn->getName());
-
-    bool implicitUse = false;
-
-    SmallVector<CallInst *, 8> ToErase;
-
-    // FIXME I think this should scan function declarations to find the implicit
-    // arg intrinsics, then scan their uses, instead of scanning the whole code
-    // to find calls to them.
-    for (inst_iterator II = inst_begin(Fn), IE = inst_end(Fn); II != IE; ++II) {
-      Instruction *Inst = &*II;
-      if (CallInst *CI = dyn_cast<CallInst>(Inst)) {
-        if (Function *Callee = CI->getCalledFunction()) {
-          Intrinsic::ID IID = (Intrinsic::ID)Callee->getIntrinsicID();
-          if (IID != Intrinsic::not_intrinsic) {
-            switch (IID) {
-              case Intrinsic::genx_local_size:
-              case Intrinsic::genx_local_id:
-              case Intrinsic::genx_group_count:
-              case Intrinsic::genx_get_scoreboard_deltas:
-              case Intrinsic::genx_get_scoreboard_bti:
-              case Intrinsic::genx_get_scoreboard_depcnt:
-              case Intrinsic::genx_local_id_x:
-              case Intrinsic::genx_local_id_y:
-              case Intrinsic::genx_local_id_z:
-              case Intrinsic::genx_group_or_local_size:
-                DEBUG(dbgs() << "AnalyzeImplicitUse found "
-                             << Intrinsic::getName(IID, None));
-                addImplicit(Fn, IID);
-                implicitUse = true;
-
-                // Replace the intrinsic with a load of a global at this point
-                replaceWithGlobal(CI, IID);
-                ToErase.push_back(CI);
-                changed = true;
-                break;
-              default:
-                // Ignore (default added to prevent compiler warnings)
-                break;
-            }
-          }
-        }
+  for (Function &Decl : M) {
+    Intrinsic::ID IID = (Intrinsic::ID)Decl.getIntrinsicID();
+    if (!isImplicitArgIntrinsic(IID))
+      continue;
+
+    SmallVector<CallInst *, 8> Calls;
+    for (User *U : Decl.users())
+      if (auto CI = dyn_cast<CallInst>(U))
+        if (CI->getCalledFunction() == &Decl)
+          Calls.push_back(CI);
+
+    for (CallInst *CI : Calls) {
+      changed = true;
+      // A dead read does not make the kernel take the implicit arg.
+      if (CI->use_empty()) {
+        CI->eraseFromParent();
+        continue;
       }
-    }
 
-    for (auto CI : ToErase)
-      CI->eraseFromParent();
-
-    // Mark this function as containing an implicit use intrinsic
-    if (implicitUse) {
+      Function *Fn = CI->getParent()->getParent();
+      DEBUG(dbgs() << "AnalyzeImplicitUse found "
+                   << Intrinsic::getName(IID, None) << " in "
+                   << Fn->getName() << "\n");
+      addImplicit(Fn, IID);
+      // Mark this function as containing an implicit use intrinsic
       ContainImplicit.insert(Fn);
+
+      // Replace the intrinsic with a load of a global at this point
+      replaceWithGlobal(CI, IID);
+      CI->eraseFromParent();
     }
   }
 
   return changed;
 }
 
-// Convert to implicit thread payload related intrinsics.
-bool CMImpParam::ConvertToOCLPayload(Module &M) {
-  // FIXME: right now if any kernel in the module needs to do conversion, all
-  // kernels will be converted.
-  bool DoConversion = false;
+// Collect the kernels compiled for OpenCL runtime and the functions they
+// reach in the call graph.
+void CMImpParam::collectOCLFunctions(Module &M,
+                                     SmallPtrSetImpl<Function *> &Funcs) {
+  SmallVector<Function *, 8> Worklist;
   if (NamedMDNode *Named = M.getNamedMetadata("genx.kernels")) {
     for (unsigned I = 0, E = Named->getNumOperands(); I != E; ++I) {
       MDNode *Node = Named->getOperand(I);
       auto F = dyn_cast_or_null<Function>(getValue(Node->getOperand(0)));
-      if (F && enablesOCLRT(F)) {
-        DoConversion = true;
-        break;
-      }
+      if (F && enablesOCLRT(F) && Funcs.insert(F).second)
+        Worklist.push_back(F);
     }
   }
-  if (!DoConversion)
+
+  CallGraph &CG = getAnalysis<CallGraphWrapperPass>().getCallGraph();
+  while (!Worklist.empty()) {
+    Function *F = Worklist.pop_back_val();
+    for (auto Callee : *CG[F])
+      if (Function *Fn = Callee.second->getFunction())
+        if (Funcs.insert(Fn).second)
+          Worklist.push_back(Fn);
+  }
+}
+
+// Return the mask of the elements of a vector value that are read. Only
+// extractelement with a constant index is understood, any other use reads
+// every element.
+static unsigned getUsedElements(Value *V) {
+  unsigned NumElts = V->getType()->getVectorNumElements();
+  unsigned Mask = 0;
+  for (User *U : V->users()) {
+    auto EEI = dyn_cast<ExtractElementInst>(U);
+    auto Idx = EEI ? dyn_cast<ConstantInt>(EEI->getIndexOperand()) : nullptr;
+    if (!Idx || Idx->getZExtValue() >= NumElts)
+      return (1U << NumElts) - 1;
+    Mask |= 1U << Idx->getZExtValue();
+  }
+  return Mask;
+}
+
+// Convert to implicit thread payload related intrinsics.
+bool CMImpParam::ConvertToOCLPayload(Module &M) {
+  // Only the kernels compiled for OpenCL runtime, and the functions they
+  // call, are converted. A function shared with a kernel for the CM runtime
+  // is converted too, as it can only have one payload.
+  SmallPtrSet<Function *, 8> OCLFuncs;
+  collectOCLFunctions(M, OCLFuncs);
+  if (OCLFuncs.empty())
     return false;
 
   bool Changed = false;
@@ -476,12 +506,18 @@ bool CMImpParam::ConvertToOCLPayload(Module &M) {
         Intrinsic::getDeclaration(&M, Intrinsic::genx_local_id_y),
         Intrinsic::getDeclaration(&M, Intrinsic::genx_local_id_z)};
 
-    for (auto UI = LIDFn->user_begin(); UI != LIDFn->user_end();) {
-      auto UInst = dyn_cast<Instruction>(*UI++);
-      if (UInst) {
+    SmallVector<User *, 8> Users(LIDFn->user_begin(), LIDFn->user_end());
+    for (auto U : Users) {
+      Instruction *UInst = dyn_cast<Instruction>(U);
+      if (UInst && OCLFuncs.count(UInst->getFunction())) {
+        // Each local id component is a separate thread payload field, so only
+        // read the ones that are used.
+        unsigned UsedIDs = getUsedElements(UInst);
         IRBuilder<> Builder(UInst);
         Value *Val = UndefValue::get(LIDFn->getReturnType());
-        for (int i : {0, 1, 2}) {
+        for (unsigned i : {0, 1, 2}) {
+          if (!(UsedIDs & (1U << i)))
+            continue;
           Value *V = Builder.CreateCall(IDs[i]);
           V = Builder.CreateExtractElement(V, uint64_t(0), ".ext0");
           // Divide local_id_x by dispatch SIMD size.
@@ -504,7 +540,8 @@ bool CMImpParam::ConvertToOCLPayload(Module &M) {
       Instruction *UInst = dyn_cast<Instruction>(U);
       auto ID = Intrinsic::genx_group_or_local_size;
       auto GLSZFn = Intrinsic::getDeclaration(&M, ID);
-      if (UInst && !UInst->use_empty()) {
+      if (UInst && !UInst->use_empty() &&
+          OCLFuncs.count(UInst->getFunction())) {
         IRBuilder<> Builder(UInst);
         Value *Base = Builder.CreateCall(GLSZFn);
         Value *Val = Builder.CreateExtractElement(Base, uint64_t(3), ".ext0");
@@ -525,7 +562,8 @@ bool CMImpParam::ConvertToOCLPayload(Module &M) {
       Instruction *UInst = dyn_cast<Instruction>(U);
       auto ID = Intrinsic::genx_group_or_local_size;
       auto GLSZFn = Intrinsic::getDeclaration(&M, ID);
-      if (UInst && !UInst->use_empty()) {
+      if (UInst && !UInst->use_empty() &&
+          OCLFuncs.count(UInst->getFunction())) {
         IRBuilder<> Builder(UInst);
         Value *Val = Builder.CreateCall(GLSZFn);
         Val = Builder.CreateShuffleVector(Val, UndefValue::get(Val->getType()),
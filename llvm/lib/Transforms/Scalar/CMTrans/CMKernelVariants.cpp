@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2020, Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+//===----------------------------------------------------------------------===//
+//
+/// CMKernelVariants
+/// ----------------
+///
+/// A kernel variant is a clone of a kernel specialized on predicates over its
+/// arguments, which the runtime launches instead of the kernel when they all
+/// hold:
+///
+/// * a value predicate says an argument equals a constant, and the clone
+///   uses the constant instead of the argument;
+///
+/// * an alignment predicate says an integer argument is a multiple of a
+///   power of two, and the clone uses the argument with its low bits masked
+///   off. That is the same value whenever the predicate holds, and lets the
+///   optimizer fold tests and address arithmetic on those bits.
+///
+/// Each clone is named <kernel>_v<N> and gets its own genx.kernels entry.
+///
+/// libcmc builds variants with cloneCMKernelVariants. The CMKernelVariants
+/// pass builds them from -cm-kernel-variant options, for use from cmc:
+///
+///   -cm-kernel-variant=<kernel>:<pred>[,<pred>...]
+///
+/// where <pred> is <arg>=<value> for a value predicate or <arg>%<align> for
+/// an alignment predicate, <arg> being the index of the argument.
+///
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "cmkernelvariants"
+#include "llvm/Transforms/Scalar/CMKernelVariants.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/IntrinsicsGenX.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include <map>
+
+using namespace llvm;
+
+static cl::list<std::string> CMKernelVariantOpts("cm-kernel-variant",
+    cl::Hidden, cl::ZeroOrMore,
+    cl::value_desc("kernel:arg=value|arg%align,..."),
+    cl::desc("Add a variant of a CM kernel specialized on its arguments"));
+
+// findKernel : find a kernel by kernel name or else by function name
+static Function *findKernel(Module &M, StringRef Name) {
+  for (auto &F : M.getFunctionList())
+    if (!F.empty() && genx::isKernel(&F) &&
+        genx::KernelMetadata(&F).getName() == Name)
+      return &F;
+  Function *F = M.getFunction(Name);
+  return F && !F->empty() && genx::isKernel(F) ? F : nullptr;
+}
+
+// isValidPredicate : check a predicate names an argument of F it applies to
+static bool isValidPredicate(const CMArgPredicate &P, Function *F) {
+  if (P.ArgIndex >= F->arg_size())
+    return false;
+  Type *Ty = std::next(F->arg_begin(), P.ArgIndex)->getType();
+  switch (P.Kind) {
+  case CMArgPredicate::Value:
+    return Ty->isIntegerTy() || Ty->isFloatingPointTy();
+  case CMArgPredicate::Align:
+    return Ty->isIntegerTy() && isPowerOf2_64(P.Val);
+  }
+  return false;
+}
+
+/***********************************************************************
+ * cloneCMKernelVariants : clone and specialize the kernel of each variant
+ */
+bool llvm::cloneCMKernelVariants(Module &M,
+                                 ArrayRef<CMKernelVariant> Variants,
+                                 SmallVectorImpl<Function *> &Clones) {
+  SmallVector<Function *, 4> Kernels;
+  for (auto &V : Variants) {
+    Function *F = findKernel(M, V.Kernel);
+    if (!F)
+      return false;
+    for (auto &P : V.Predicates)
+      if (!isValidPredicate(P, F))
+        return false;
+    Kernels.push_back(F);
+  }
+
+  LLVMContext &Ctx = M.getContext();
+  NamedMDNode *KernelsMD = M.getNamedMetadata("genx.kernels");
+  std::map<Function *, unsigned> NumClones;
+  for (unsigned i = 0, e = Variants.size(); i != e; ++i) {
+    const CMKernelVariant &V = Variants[i];
+    Function *F = Kernels[i];
+    ValueToValueMapTy VMap;
+    Function *Clone = CloneFunction(F, VMap);
+    Clone->setName(Twine(V.Kernel) + "_v" + Twine(++NumClones[F]));
+    Clone->setDLLStorageClass(F->getDLLStorageClass());
+    Clones.push_back(Clone);
+
+    if (KernelsMD) {
+      for (unsigned k = 0, ke = KernelsMD->getNumOperands(); k != ke; ++k) {
+        MDNode *Node = KernelsMD->getOperand(k);
+        if (Node->getNumOperands() < 3 ||
+            genx::getValueAsMetadata(Node->getOperand(0)) != F)
+          continue;
+        SmallVector<Metadata *, 9> Ops(Node->op_begin(), Node->op_end());
+        Ops[0] = ValueAsMetadata::get(Clone);
+        Ops[1] = MDString::get(Ctx, Clone->getName());
+        Ops[2] = MDString::get(Ctx, Clone->getName());
+        KernelsMD->addOperand(MDNode::get(Ctx, Ops));
+        break;
+      }
+    }
+
+    IRBuilder<> Builder(&*Clone->getEntryBlock().getFirstInsertionPt());
+    for (auto &P : V.Predicates) {
+      Argument *Arg = &*std::next(Clone->arg_begin(), P.ArgIndex);
+      Type *Ty = Arg->getType();
+      if (P.Kind == CMArgPredicate::Value) {
+        Constant *C = ConstantInt::get(
+            IntegerType::get(Ctx, Ty->getPrimitiveSizeInBits()), P.Val);
+        Arg->replaceAllUsesWith(ConstantExpr::getBitCast(C, Ty));
+      } else if (P.Val > 1) {
+        auto Aligned = cast<Instruction>(Builder.CreateAnd(
+            Arg, ~(P.Val - 1), Arg->getName() + ".aligned"));
+        Arg->replaceAllUsesWith(Aligned);
+        Aligned->setOperand(0, Arg);
+      }
+    }
+  }
+  return true;
+}
+
+namespace {
+
+// CMKernelVariants : add the kernel variants given by -cm-kernel-variant
+class CMKernelVariants : public ModulePass {
+public:
+  static char ID;
+  CMKernelVariants() : ModulePass(ID) {
+    initializeCMKernelVariantsPass(*PassRegistry::getPassRegistry());
+  }
+  StringRef getPassName() const override { return "CM kernel variants"; }
+  bool runOnModule(Module &M) override;
+};
+
+} // namespace
+
+char CMKernelVariants::ID = 0;
+INITIALIZE_PASS(CMKernelVariants, "cmkernelvariants",
+                "Add specialized CM kernel variants", false, false)
+
+ModulePass *llvm::createCMKernelVariantsPass() {
+  return new CMKernelVariants();
+}
+
+// parseVariant : parse <kernel>:<pred>[,<pred>...]
+static bool parseVariant(StringRef Opt, CMKernelVariant &V) {
+  auto Split = Opt.split(':');
+  V.Kernel = Split.first.str();
+  StringRef Preds = Split.second;
+  if (V.Kernel.empty() || Preds.empty())
+    return false;
+  SmallVector<StringRef, 4> Parts;
+  Preds.split(Parts, ',');
+  for (StringRef Part : Parts) {
+    CMArgPredicate P;
+    size_t Pos = Part.find_first_of("=%");
+    if (Pos == StringRef::npos)
+      return false;
+    P.Kind = Part[Pos] == '=' ? CMArgPredicate::Value : CMArgPredicate::Align;
+    if (Part.substr(0, Pos).getAsInteger(10, P.ArgIndex))
+      return false;
+    StringRef Val = Part.substr(Pos + 1);
+    int64_t SVal;
+    if (Val.getAsInteger(0, P.Val)) {
+      if (Val.getAsInteger(0, SVal))
+        return false;
+      P.Val = SVal;
+    }
+    V.Predicates.push_back(P);
+  }
+  return true;
+}
+
+/***********************************************************************
+ * runOnModule : add the variants given on the command line
+ */
+bool CMKernelVariants::runOnModule(Module &M) {
+  if (CMKernelVariantOpts.empty())
+    return false;
+  SmallVector<CMKernelVariant, 4> Variants;
+  for (auto &Opt : CMKernelVariantOpts) {
+    Variants.emplace_back();
+    if (!parseVariant(Opt, Variants.back()))
+      report_fatal_error("malformed -cm-kernel-variant: " + Opt);
+  }
+  SmallVector<Function *, 4> Clones;
+  if (!cloneCMKernelVariants(M, Variants, Clones))
+    report_fatal_error("-cm-kernel-variant does not match a kernel and its "
+                       "arguments");
+  return true;
+}
@@ -0,0 +1,975 @@
+/*
+ * Copyright (c) 2020, Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+//===----------------------------------------------------------------------===//
+//
+/// CMLoopVectorize
+/// ---------------
+///
+/// CM source ported from C models often processes a vector one element per
+/// loop iteration:
+///
+///   for (int i = 0; i < 16; i++)
+///     b(i) = a(i) * 3 + 1;
+///
+/// Clang codegen turns each element access into a single element rdregion or
+/// wrregion with a variable start index, and the loop is later fully unrolled
+/// into sixteen scalar operations. GenXPacketize only widens whole SIMT
+/// kernels, so nothing turns such a loop back into vector code.
+///
+/// This pass runs on innermost loops with a constant trip count, before the
+/// loop unroller. A loop is vectorized when:
+///
+/// * its body is a single block;
+///
+/// * every value carried round the loop is the induction variable, a vector
+///   the loop writes one element of per iteration (a header phi fed by a
+///   wrregion, or a vload/wrregion/vstore of a local vector), or a scalar
+///   reduction with add, mul, and, or, xor (fadd and fmul only under
+///   fast-math);
+///
+/// * every element read or written is at an index that steps by a positive
+///   constant per iteration, so the elements touched by the whole loop form a
+///   1D region;
+///
+/// * the values written are computed from those elements, loop invariants and
+///   the induction variable by element-wise instructions, and nothing else in
+///   the loop has a side effect.
+///
+/// The loop is then replaced by straight-line code in the preheader: the trip
+/// count is cut into chunks of cm-loop-vectorize-width lanes plus a narrower
+/// remainder chunk, each element access becomes a rdregion or wrregion of the
+/// whole chunk with the access's stride, and each reduction is folded by a
+/// tree of half-width regions. Element reads of the vector being written see
+/// the value before the chunk, which is what the scalar loop saw, since each
+/// element is written once.
+///
+/// Each loop that is not vectorized gets a missed-optimization remark
+/// (-Rpass-missed=cmloopvectorize) saying why, and each loop that is gets a
+/// remark (-Rpass=cmloopvectorize) giving the widths used.
+///
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "cmloopvectorize"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/LoopPass.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/IntrinsicsGenX.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Scalar/CMRegion.h"
+#include "llvm/Transforms/Utils/LoopUtils.h"
+
+using namespace llvm;
+
+static cl::opt<bool> EnableCMLoopVectorize("enable-cm-loop-vectorize",
+    cl::init(true), cl::Hidden,
+    cl::desc("Vectorize scalar element loops in CM kernels"));
+
+static cl::opt<unsigned> CMLoopVectorizeWidth("cm-loop-vectorize-width",
+    cl::init(16), cl::Hidden,
+    cl::desc("Number of lanes per chunk of a vectorized CM loop"));
+
+static cl::opt<unsigned> CMLoopVectorizeMaxTripCount(
+    "cm-loop-vectorize-max-trip-count", cl::init(64), cl::Hidden,
+    cl::desc("Largest trip count of a CM loop that is vectorized"));
+
+STATISTIC(NumVectorized, "Number of CM loops vectorized");
+
+namespace {
+
+// A vector the loop writes one element of per iteration.
+struct Accumulator {
+  PHINode *Phi = nullptr;     // header phi, if the vector is an SSA value
+  CallInst *Load = nullptr;   // vload in the loop, if the vector is in memory
+  CallInst *Store = nullptr;  // vstore in the loop, if the vector is in memory
+  CallInst *Write = nullptr;  // single element wrregion
+  const SCEV *Index = nullptr; // start index of the wrregion
+  int64_t Start = 0;          // first element written
+  int64_t Stride = 0;         // elements between consecutive writes
+  Value *Cur = nullptr;       // value so far while vectorizing
+};
+
+// A scalar the loop folds one value into per iteration.
+struct Reduction {
+  PHINode *Phi = nullptr;
+  BinaryOperator *Op = nullptr;
+  Value *Elt = nullptr;       // operand of Op that is not Phi
+  Value *Cur = nullptr;       // value so far while vectorizing
+};
+
+// An element read: first element and stride, both in elements.
+struct ElementAccess {
+  int64_t Start;
+  int64_t Stride;
+};
+
+class CMLoopVectorize : public LoopPass {
+  Loop *L = nullptr;
+  ScalarEvolution *SE = nullptr;
+  const DataLayout *DL = nullptr;
+  DominatorTree *DT = nullptr;
+  unsigned TripCount = 0;
+  SmallVector<Accumulator, 4> Accums;
+  SmallVector<Reduction, 4> Reds;
+  DenseMap<Value *, ElementAccess> Reads;
+  DenseMap<Value *, bool> WidenMemo;
+  DenseMap<Value *, bool> InvariantMemo;
+  DenseMap<Value *, Value *> Hoisted;
+  DenseMap<Value *, Value *> Lanes;
+  Instruction *InsertPt = nullptr;
+  std::string Reason;
+
+public:
+  static char ID;
+  CMLoopVectorize() : LoopPass(ID) {
+    initializeCMLoopVectorizePass(*PassRegistry::getPassRegistry());
+  }
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    getLoopAnalysisUsage(AU);
+  }
+  bool runOnLoop(Loop *L, LPPassManager &LPM) override;
+
+private:
+  bool analyze();
+  bool reject(const Twine &Msg);
+  bool addSSAAccumulator(PHINode *Phi);
+  bool addMemoryAccumulator(CallInst *Store);
+  bool addReduction(PHINode *Phi);
+  bool checkWrite(Accumulator &A);
+  bool getAccess(Value *Idx, unsigned Unit, unsigned NumElements,
+                 ElementAccess &Access);
+  bool canWiden(Value *V);
+  bool checkWiden(Value *V);
+  bool checkRead(CallInst *CI);
+  bool isAffine(Value *V);
+  bool isInvariant(Value *V);
+  bool isLocalVector(Value *Ptr);
+  Accumulator *findAccumulator(Value *V);
+  void vectorize();
+  Value *widen(Value *V, unsigned First, unsigned Width);
+  Value *hoist(Value *V);
+  Constant *getAffineValue(Value *V, unsigned Iter);
+  Value *getAffineLanes(Value *V, unsigned First, unsigned Width);
+  Value *readRegion(Value *Input, int64_t Start, int64_t Stride,
+                    unsigned Width);
+  Value *writeRegion(Value *OldVal, Value *NewVal, int64_t Start,
+                     int64_t Stride);
+  Value *reduce(Value *V, BinaryOperator *Op, unsigned Width);
+  Value *createReductionOp(BinaryOperator *Op, Value *LHS, Value *RHS);
+  void replaceLiveOuts(Instruction *Inst, Value *NewVal);
+};
+
+} // namespace
+
+char CMLoopVectorize::ID = 0;
+INITIALIZE_PASS_BEGIN(CMLoopVectorize, "cmloopvectorize",
+                      "Vectorize scalar CM element loops", false, false)
+INITIALIZE_PASS_DEPENDENCY(LoopPass)
+INITIALIZE_PASS_END(CMLoopVectorize, "cmloopvectorize",
+                    "Vectorize scalar CM element loops", false, false)
+
+Pass *llvm::createCMLoopVectorizePass() { return new CMLoopVectorize(); }
+
+static inline unsigned getIntrinsicID(Value *V) {
+  if (CallInst *CI = dyn_cast_or_null<CallInst>(V))
+    if (Function *Callee = CI->getCalledFunction())
+      return Callee->getIntrinsicID();
+  return Intrinsic::not_intrinsic;
+}
+
+static inline bool isRdRegion(Value *V) {
+  unsigned IID = getIntrinsicID(V);
+  return IID == Intrinsic::genx_rdregioni || IID == Intrinsic::genx_rdregionf;
+}
+
+static inline bool isWrRegion(Value *V) {
+  unsigned IID = getIntrinsicID(V);
+  return IID == Intrinsic::genx_wrregioni || IID == Intrinsic::genx_wrregionf;
+}
+
+static inline bool isVLoad(Value *V) {
+  return getIntrinsicID(V) == Intrinsic::genx_vload;
+}
+
+static inline bool isVStore(Value *V) {
+  return getIntrinsicID(V) == Intrinsic::genx_vstore;
+}
+
+/***********************************************************************
+ * runOnLoop : vectorize one innermost loop, or say why not
+ */
+bool CMLoopVectorize::runOnLoop(Loop *Lp, LPPassManager &LPM) {
+  if (!EnableCMLoopVectorize || skipLoop(Lp) || !Lp->empty())
+    return false;
+
+  L = Lp;
+  SE = &getAnalysis<ScalarEvolutionWrapperPass>().getSE();
+  DT = &getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+  LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+  DL = &L->getHeader()->getModule()->getDataLayout();
+  TripCount = 0;
+  Accums.clear();
+  Reds.clear();
+  Reads.clear();
+  WidenMemo.clear();
+  InvariantMemo.clear();
+  Hoisted.clear();
+  Lanes.clear();
+  Reason.clear();
+
+  OptimizationRemarkEmitter ORE(L->getHeader()->getParent());
+  if (!analyze()) {
+    DEBUG(dbgs() << "CMLoopVectorize: " << Reason << "\n");
+    ORE.emit([&]() {
+      return OptimizationRemarkMissed(DEBUG_TYPE, "NotVectorized",
+                                      L->getStartLoc(), L->getHeader())
+             << "loop not vectorized: " << Reason;
+    });
+    return false;
+  }
+
+  unsigned Width = std::max(1U, (unsigned)CMLoopVectorizeWidth);
+  unsigned Remainder = TripCount > Width ? TripCount % Width : 0;
+  ORE.emit([&]() {
+    OptimizationRemark R(DEBUG_TYPE, "Vectorized", L->getStartLoc(),
+                         L->getHeader());
+    R << "vectorized loop of " << ore::NV("TripCount", TripCount)
+      << " iterations into "
+      << ore::NV("Width", std::min(Width, TripCount)) << "-wide operations";
+    if (Remainder)
+      R << " with a " << ore::NV("Remainder", Remainder)
+        << "-wide remainder";
+    return R;
+  });
+
+  vectorize();
+  deleteDeadLoop(L, DT, SE, &LI);
+  LPM.markLoopAsDeleted(*L);
+  ++NumVectorized;
+  return true;
+}
+
+/***********************************************************************
+ * reject : record why the loop is not vectorized
+ *
+ * Return:  false, so that a check can "return reject(...)"
+ */
+bool CMLoopVectorize::reject(const Twine &Msg) {
+  if (Reason.empty())
+    Reason = Msg.str();
+  return false;
+}
+
+/***********************************************************************
+ * analyze : check the loop can be vectorized, and collect its accumulators,
+ *           reductions and element reads
+ */
+bool CMLoopVectorize::analyze() {
+  BasicBlock *Header = L->getHeader();
+  if (L->getNumBlocks() != 1)
+    return reject("loop body contains control flow");
+  BasicBlock *Preheader = L->getLoopPreheader();
+  if (!Preheader || !L->getUniqueExitBlock() || !L->hasDedicatedExits())
+    return reject("loop is not in simplified form");
+  auto PreBr = dyn_cast<BranchInst>(Preheader->getTerminator());
+  if (!PreBr || !PreBr->isUnconditional())
+    return reject("loop is not in simplified form");
+  InsertPt = PreBr;
+
+  TripCount = SE->getSmallConstantTripCount(L);
+  if (!TripCount)
+    return reject("trip count is not a compile-time constant");
+  if (TripCount > CMLoopVectorizeMaxTripCount)
+    return reject("trip count " + Twine(TripCount) + " exceeds the limit of " +
+                  Twine(CMLoopVectorizeMaxTripCount));
+
+  // Values carried round the loop. Vector stores are gathered first so that
+  // isInvariant knows which vloads read memory the loop writes.
+  for (Instruction &I : *Header)
+    if (isVStore(&I) && !addMemoryAccumulator(cast<CallInst>(&I)))
+      return false;
+  for (PHINode &Phi : Header->phis()) {
+    if (isAffine(&Phi))
+      continue;
+    if (Phi.getType()->isVectorTy()) {
+      if (!addSSAAccumulator(&Phi))
+        return false;
+    } else if (!addReduction(&Phi))
+      return false;
+  }
+  // Anything else that touches memory or has a side effect stays scalar.
+  for (Instruction &I : *Header) {
+    if (isVStore(&I) || isVLoad(&I) || isa<DbgInfoIntrinsic>(&I))
+      continue;
+    unsigned IID = getIntrinsicID(&I);
+    if (IID == Intrinsic::lifetime_start || IID == Intrinsic::lifetime_end)
+      continue;
+    if (!I.mayHaveSideEffects() && !I.mayReadFromMemory())
+      continue;
+    if (auto CI = dyn_cast<CallInst>(&I))
+      if (Function *Callee = CI->getCalledFunction())
+        return reject("call to " + Callee->getName() +
+                      " cannot be vectorized");
+    return reject("loop body accesses memory other than local vectors");
+  }
+  if (Accums.empty() && Reds.empty())
+    return reject("loop does not build a vector or a reduction");
+
+  // The values written and reduced must be element-wise.
+  for (auto &A : Accums)
+    if (!canWiden(A.Write->getOperand(Intrinsic::GenXRegion::NewValueOperandNum)))
+      return false;
+  for (auto &R : Reds)
+    if (!canWiden(R.Elt))
+      return false;
+
+  // Only the results of the loop may be used after it.
+  for (Instruction &I : *Header) {
+    bool IsResult = isAffine(&I);
+    for (auto &A : Accums)
+      IsResult |= A.Phi && A.Write == &I;
+    for (auto &R : Reds)
+      IsResult |= R.Op == &I;
+    if (IsResult)
+      continue;
+    for (User *U : I.users())
+      if (cast<Instruction>(U)->getParent() != Header)
+        return reject("a value computed in the loop is used after it");
+  }
+  return true;
+}
+
+/***********************************************************************
+ * addSSAAccumulator : add a vector header phi that the loop writes one
+ *                     element of per iteration
+ */
+bool CMLoopVectorize::addSSAAccumulator(PHINode *Phi) {
+  BasicBlock *Header = L->getHeader();
+  Accumulator A;
+  A.Phi = Phi;
+  A.Write = dyn_cast<CallInst>(Phi->getIncomingValueForBlock(Header));
+  if (!isWrRegion(A.Write) || A.Write->getParent() != Header ||
+      A.Write->getOperand(Intrinsic::GenXRegion::OldValueOperandNum) != Phi)
+    return reject("vector is not written one element per iteration");
+  for (User *U : Phi->users())
+    if (U != A.Write && !isRdRegion(U))
+      return reject("vector being written is used by a non-region "
+                    "instruction in the loop");
+  for (User *U : A.Write->users())
+    if (U != Phi && cast<Instruction>(U)->getParent() == Header)
+      return reject("vector is read after being written in the same "
+                    "iteration");
+  if (!checkWrite(A))
+    return false;
+  Accums.push_back(A);
+  return true;
+}
+
+/***********************************************************************
+ * addMemoryAccumulator : add a local vector that the loop loads, writes one
+ *                        element of, and stores back per iteration
+ */
+bool CMLoopVectorize::addMemoryAccumulator(CallInst *Store) {
+  BasicBlock *Header = L->getHeader();
+  Value *Ptr = Store->getArgOperand(1);
+  if (!isLocalVector(Ptr))
+    return reject("vector is stored to memory that may be aliased");
+  Accumulator A;
+  A.Store = Store;
+  A.Write = dyn_cast<CallInst>(Store->getArgOperand(0));
+  if (!isWrRegion(A.Write) || A.Write->getParent() != Header ||
+      !A.Write->hasOneUse())
+    return reject("vector is not written one element per iteration");
+  A.Load = dyn_cast<CallInst>(
+      A.Write->getOperand(Intrinsic::GenXRegion::OldValueOperandNum));
+  if (!isVLoad(A.Load) || A.Load->getParent() != Header ||
+      A.Load->getArgOperand(0)->stripPointerCasts() != Ptr ||
+      !DT->dominates(A.Load, Store))
+    return reject("vector is not written one element per iteration");
+  // Exactly one load and one store of the vector in the loop.
+  for (Instruction &I : *Header) {
+    if (&I == A.Load || &I == Store)
+      continue;
+    if ((isVLoad(&I) && I.getOperand(0)->stripPointerCasts() == Ptr) ||
+        (isVStore(&I) && I.getOperand(1)->stripPointerCasts() == Ptr))
+      return reject("vector is loaded or stored more than once per "
+                    "iteration");
+  }
+  for (User *U : A.Load->users())
+    if (U != A.Write && !isRdRegion(U))
+      return reject("vector being written is used by a non-region "
+                    "instruction in the loop");
+  if (!checkWrite(A))
+    return false;
+  Accums.push_back(A);
+  return true;
+}
+
+/***********************************************************************
+ * checkWrite : check the wrregion of an accumulator writes a single element
+ *              at a linear index
+ */
+bool CMLoopVectorize::checkWrite(Accumulator &A) {
+  CMRegion R(A.Write);
+  if (R.NumElements != 1 || R.Mask || !R.ElementBytes)
+    return reject("vector is written under a predicate or more than one "
+                  "element at a time");
+  Value *Idx = A.Write->getOperand(Intrinsic::GenXRegion::WrIndexOperandNum);
+  ElementAccess Access;
+  unsigned NumElements = A.Write->getType()->getVectorNumElements();
+  if (!getAccess(Idx, R.ElementBytes, NumElements, Access))
+    return false;
+  A.Index = SE->getSCEV(Idx);
+  A.Start = Access.Start;
+  A.Stride = Access.Stride;
+  return true;
+}
+
+/***********************************************************************
+ * addReduction : add a scalar header phi that the loop folds a value into
+ */
+bool CMLoopVectorize::addReduction(PHINode *Phi) {
+  BasicBlock *Header = L->getHeader();
+  if (!Phi->getType()->isIntegerTy() && !Phi->getType()->isFloatingPointTy())
+    return reject("loop-carried value is not a vector or a reduction");
+  auto Op = dyn_cast<BinaryOperator>(Phi->getIncomingValueForBlock(Header));
+  if (!Op || Op->getParent() != Header)
+    return reject("loop-carried value is not a vector or a reduction");
+  switch (Op->getOpcode()) {
+  case Instruction::Add:
+  case Instruction::Mul:
+  case Instruction::And:
+  case Instruction::Or:
+  case Instruction::Xor:
+    break;
+  case Instruction::FAdd:
+  case Instruction::FMul:
+    if (!Op->isFast())
+      return reject("floating-point reduction needs fast-math to be "
+                    "reordered");
+    break;
+  default:
+    return reject("loop-carried value is not a vector or a reduction");
+  }
+  Reduction R;
+  R.Phi = Phi;
+  R.Op = Op;
+  if (Op->getOperand(0) == Phi)
+    R.Elt = Op->getOperand(1);
+  else if (Op->getOperand(1) == Phi)
+    R.Elt = Op->getOperand(0);
+  if (!R.Elt || R.Elt == Phi)
+    return reject("loop-carried value is not a vector or a reduction");
+  if (!Phi->hasOneUse())
+    return reject("partial reduction value is used inside the loop");
+  for (User *U : Op->users())
+    if (U != Phi && cast<Instruction>(U)->getParent() == Header)
+      return reject("partial reduction value is used inside the loop");
+  Reds.push_back(R);
+  return true;
+}
+
+/***********************************************************************
+ * getAccess : get the elements touched by an index that steps linearly
+ *
+ * Enter:   Idx = index of the element accessed in an iteration
+ *          Unit = amount Idx changes by from one element to the next
+ *                 (element size for a region start index, 1 for an
+ *                 extractelement index)
+ *          NumElements = number of elements in the vector accessed
+ *          Access = filled in with the first element and the stride
+ */
+bool CMLoopVectorize::getAccess(Value *Idx, unsigned Unit,
+                                unsigned NumElements, ElementAccess &Access) {
+  auto AR = dyn_cast<SCEVAddRecExpr>(SE->getSCEV(Idx));
+  if (!AR || AR->getLoop() != L || !AR->isAffine())
+    return reject("element index is not a linear function of the induction "
+                  "variable");
+  auto Start = dyn_cast<SCEVConstant>(AR->getStart());
+  auto Step = dyn_cast<SCEVConstant>(AR->getStepRecurrence(*SE));
+  if (!Start || !Step || Start->getAPInt().getMinSignedBits() > 32 ||
+      Step->getAPInt().getMinSignedBits() > 32)
+    return reject("element index does not start and step by constants");
+  int64_t StartVal = Start->getAPInt().getSExtValue();
+  int64_t StepVal = Step->getAPInt().getSExtValue();
+  if (StartVal < 0 || StepVal <= 0)
+    return reject("elements are not accessed in increasing order");
+  if (StartVal % Unit || StepVal % Unit)
+    return reject("element index is not aligned to the element size");
+  Access.Start = StartVal / Unit;
+  Access.Stride = StepVal / Unit;
+  if (Access.Start + (int64_t)(TripCount - 1) * Access.Stride >=
+      (int64_t)NumElements)
+    return reject("element index runs past the end of the vector");
+  return true;
+}
+
+/***********************************************************************
+ * canWiden : check a value computed once per iteration can be computed for
+ *            a chunk of iterations at once
+ */
+bool CMLoopVectorize::canWiden(Value *V) {
+  auto It = WidenMemo.find(V);
+  if (It != WidenMemo.end())
+    return It->second;
+  WidenMemo[V] = false;
+  bool Ok = checkWiden(V);
+  WidenMemo[V] = Ok;
+  return Ok;
+}
+
+bool CMLoopVectorize::checkWiden(Value *V) {
+  Type *Ty = V->getType();
+  if (auto VT = dyn_cast<VectorType>(Ty)) {
+    if (VT->getNumElements() != 1)
+      return reject("a whole vector is used where one element is expected");
+    Ty = VT->getElementType();
+  }
+  if (!Ty->isIntegerTy() && !Ty->isFloatingPointTy())
+    return reject("element type cannot be vectorized");
+  if (isInvariant(V) || isAffine(V))
+    return true;
+
+  auto Inst = cast<Instruction>(V);
+  if (auto CI = dyn_cast<CallInst>(Inst)) {
+    if (isRdRegion(CI))
+      return checkRead(CI);
+    if (Function *Callee = CI->getCalledFunction())
+      return reject("call to " + Callee->getName() + " cannot be vectorized");
+    return reject("indirect call cannot be vectorized");
+  }
+  if (auto EE = dyn_cast<ExtractElementInst>(Inst)) {
+    Value *Vec = EE->getVectorOperand();
+    if (Vec->getType()->getVectorNumElements() == 1)
+      return canWiden(Vec);
+    if (!isInvariant(Vec))
+      return reject("element read from a vector that changes in the loop");
+    ElementAccess Access;
+    if (!getAccess(EE->getIndexOperand(), 1,
+                   Vec->getType()->getVectorNumElements(), Access))
+      return false;
+    Reads[EE] = Access;
+    return true;
+  }
+  if (auto IE = dyn_cast<InsertElementInst>(Inst)) {
+    if (IE->getType()->getNumElements() == 1)
+      return canWiden(IE->getOperand(1));
+    return reject("element inserted into a vector other than by wrregion");
+  }
+  if (isa<BinaryOperator>(Inst) || isa<CmpInst>(Inst) || isa<CastInst>(Inst) ||
+      isa<SelectInst>(Inst)) {
+    for (Value *Opnd : Inst->operands())
+      if (!canWiden(Opnd))
+        return false;
+    return true;
+  }
+  if (isa<PHINode>(Inst))
+    return reject("loop-carried value is used as an element");
+  return reject(Twine("instruction ") + Inst->getOpcodeName() +
+                " cannot be vectorized");
+}
+
+/***********************************************************************
+ * checkRead : check a single element rdregion reads at a linear index,
+ *             either from a loop invariant vector or from the vector being
+ *             written at the element being written
+ */
+bool CMLoopVectorize::checkRead(CallInst *CI) {
+  CMRegion R(CI);
+  if (R.NumElements != 1 || !R.ElementBytes)
+    return reject("region read of more than one element per iteration");
+  Value *Input = CI->getOperand(Intrinsic::GenXRegion::OldValueOperandNum);
+  Value *Idx = CI->getOperand(Intrinsic::GenXRegion::RdIndexOperandNum);
+  if (Accumulator *A = findAccumulator(Input)) {
+    if (SE->getSCEV(Idx) != A->Index)
+      return reject("vector being written is read at a different element");
+    Reads[CI] = {A->Start, A->Stride};
+    return true;
+  }
+  if (!isInvariant(Input))
+    return reject("element read from a vector that changes in the loop");
+  ElementAccess Access;
+  if (!getAccess(Idx, R.ElementBytes, Input->getType()->getVectorNumElements(),
+                 Access))
+    return false;
+  Reads[CI] = Access;
+  return true;
+}
+
+/***********************************************************************
+ * isAffine : test whether a value is an integer that steps by a constant
+ *            from a constant start
+ */
+bool CMLoopVectorize::isAffine(Value *V) {
+  if (!V->getType()->isIntegerTy() || !SE->isSCEVable(V->getType()))
+    return false;
+  auto AR = dyn_cast<SCEVAddRecExpr>(SE->getSCEV(V));
+  return AR && AR->getLoop() == L && AR->isAffine() &&
+         isa<SCEVConstant>(AR->getStart()) &&
+         isa<SCEVConstant>(AR->getStepRecurrence(*SE));
+}
+
+/***********************************************************************
+ * isInvariant : test whether a value is the same in every iteration
+ *
+ * Unlike Loop::isLoopInvariant, this looks through instructions in the loop
+ * that LICM has not hoisted, including vloads of memory the loop does not
+ * write.
+ */
+bool CMLoopVectorize::isInvariant(Value *V) {
+  auto Inst = dyn_cast<Instruction>(V);
+  if (!Inst || !L->contains(Inst))
+    return true;
+  auto It = InvariantMemo.find(V);
+  if (It != InvariantMemo.end())
+    return It->second;
+  InvariantMemo[V] = false;
+  bool Invariant = false;
+  if (isVLoad(Inst)) {
+    // A vload is invariant if the loop does not store to the same vector and
+    // it is not a volatile global that may change under the kernel's feet.
+    Value *Ptr = Inst->getOperand(0)->stripPointerCasts();
+    auto GV = dyn_cast<GlobalVariable>(Ptr);
+    Invariant = !(GV && GV->hasAttribute("genx_volatile")) &&
+                llvm::none_of(Accums, [&](const Accumulator &A) {
+                  return A.Store &&
+                         A.Store->getArgOperand(1)->stripPointerCasts() == Ptr;
+                }) &&
+                isInvariant(Inst->getOperand(0));
+  }
+  else if (!isa<PHINode>(Inst) && !Inst->mayHaveSideEffects() &&
+           !Inst->mayReadFromMemory())
+    Invariant = llvm::all_of(Inst->operands(),
+                             [&](Value *Opnd) { return isInvariant(Opnd); });
+  InvariantMemo[V] = Invariant;
+  return Invariant;
+}
+
+/***********************************************************************
+ * isLocalVector : test whether a pointer is an alloca that is only loaded
+ *                 and stored whole, so nothing else can alias it
+ */
+bool CMLoopVectorize::isLocalVector(Value *Ptr) {
+  auto AI = dyn_cast<AllocaInst>(Ptr);
+  if (!AI)
+    return false;
+  SmallVector<Value *, 8> Worklist(1, AI);
+  while (!Worklist.empty()) {
+    Value *V = Worklist.pop_back_val();
+    for (Use &U : V->uses()) {
+      auto User = cast<Instruction>(U.getUser());
+      if (isa<BitCastInst>(User)) {
+        Worklist.push_back(User);
+        continue;
+      }
+      unsigned IID = getIntrinsicID(User);
+      if (IID == Intrinsic::lifetime_start || IID == Intrinsic::lifetime_end ||
+          IID == Intrinsic::genx_vload ||
+          (IID == Intrinsic::genx_vstore && U.getOperandNo() == 1))
+        continue;
+      return false;
+    }
+  }
+  return true;
+}
+
+/***********************************************************************
+ * findAccumulator : find the accumulator whose per-iteration value is V
+ */
+Accumulator *CMLoopVectorize::findAccumulator(Value *V) {
+  for (auto &A : Accums)
+    if (V == A.Phi || V == A.Load)
+      return &A;
+  return nullptr;
+}
+
+/***********************************************************************
+ * vectorize : emit the vector form of the loop in the preheader and point
+ *             the loop's results at it, leaving the loop itself dead
+ */
+void CMLoopVectorize::vectorize() {
+  BasicBlock *Preheader = L->getLoopPreheader();
+  IRBuilder<> Builder(InsertPt);
+
+  for (auto &A : Accums) {
+    if (A.Phi)
+      A.Cur = A.Phi->getIncomingValueForBlock(Preheader);
+    else
+      A.Cur = Builder.CreateCall(A.Load->getCalledFunction(),
+                                 hoist(A.Load->getArgOperand(0)),
+                                 A.Load->getName());
+  }
+  for (auto &R : Reds)
+    R.Cur = R.Phi->getIncomingValueForBlock(Preheader);
+
+  unsigned ChunkWidth = std::max(1U, (unsigned)CMLoopVectorizeWidth);
+  for (unsigned First = 0; First < TripCount; First += ChunkWidth) {
+    unsigned Width = std::min(ChunkWidth, TripCount - First);
+    Lanes.clear();
+    // Widen everything the chunk computes before writing any accumulator, as
+    // the scalar loop reads each element before it is written.
+    SmallVector<Value *, 4> NewVals;
+    for (auto &A : Accums)
+      NewVals.push_back(widen(
+          A.Write->getOperand(Intrinsic::GenXRegion::NewValueOperandNum),
+          First, Width));
+    for (auto &R : Reds)
+      R.Cur = createReductionOp(R.Op, R.Cur,
+                                reduce(widen(R.Elt, First, Width), R.Op, Width));
+    for (unsigned i = 0, e = Accums.size(); i != e; ++i) {
+      Accumulator &A = Accums[i];
+      A.Cur = writeRegion(A.Cur, NewVals[i], A.Start + First * A.Stride,
+                          A.Stride);
+    }
+  }
+
+  for (auto &A : Accums) {
+    if (A.Phi)
+      replaceLiveOuts(A.Write, A.Cur);
+    else
+      Builder.CreateCall(A.Store->getCalledFunction(),
+                         {A.Cur, hoist(A.Store->getArgOperand(1))});
+  }
+  for (auto &R : Reds)
+    replaceLiveOuts(R.Op, R.Cur);
+  for (Instruction &I : *L->getHeader())
+    if (isAffine(&I))
+      replaceLiveOuts(&I, getAffineValue(&I, TripCount - 1));
+}
+
+/***********************************************************************
+ * widen : get the values of V for a chunk of iterations
+ *
+ * Enter:   V = value computed once per iteration, accepted by canWiden
+ *          First = first iteration of the chunk
+ *          Width = number of iterations in the chunk
+ *
+ * Return:  vector of Width elements, one per iteration
+ */
+Value *CMLoopVectorize::widen(Value *V, unsigned First, unsigned Width) {
+  auto It = Lanes.find(V);
+  if (It != Lanes.end())
+    return It->second;
+
+  IRBuilder<> Builder(InsertPt);
+  Type *VecTy = VectorType::get(V->getType()->getScalarType(), Width);
+  Value *Res = nullptr;
+  if (isInvariant(V)) {
+    Value *S = hoist(V);
+    if (S->getType()->isVectorTy())
+      S = Builder.CreateExtractElement(S, Builder.getInt32(0));
+    Res = Builder.CreateVectorSplat(Width, S, V->getName() + ".splat");
+  } else if (isAffine(V)) {
+    Res = getAffineLanes(V, First, Width);
+  } else if (isRdRegion(V)) {
+    auto CI = cast<CallInst>(V);
+    Value *Input = CI->getOperand(Intrinsic::GenXRegion::OldValueOperandNum);
+    if (Accumulator *A = findAccumulator(Input))
+      Input = A->Cur;
+    else
+      Input = hoist(Input);
+    const ElementAccess &Access = Reads[CI];
+    Res = readRegion(Input, Access.Start + First * Access.Stride,
+                     Access.Stride, Width);
+  } else if (auto EE = dyn_cast<ExtractElementInst>(V)) {
+    Value *Vec = EE->getVectorOperand();
+    if (Vec->getType()->getVectorNumElements() == 1)
+      Res = widen(Vec, First, Width);
+    else {
+      const ElementAccess &Access = Reads[EE];
+      Res = readRegion(hoist(Vec), Access.Start + First * Access.Stride,
+                       Access.Stride, Width);
+    }
+  } else if (auto IE = dyn_cast<InsertElementInst>(V)) {
+    Res = widen(IE->getOperand(1), First, Width);
+  } else if (auto BO = dyn_cast<BinaryOperator>(V)) {
+    Res = Builder.CreateBinOp(BO->getOpcode(),
+                              widen(BO->getOperand(0), First, Width),
+                              widen(BO->getOperand(1), First, Width),
+                              BO->getName());
+    if (auto NewBO = dyn_cast<BinaryOperator>(Res))
+      NewBO->copyIRFlags(BO);
+  } else if (auto Cmp = dyn_cast<CmpInst>(V)) {
+    Value *LHS = widen(Cmp->getOperand(0), First, Width);
+    Value *RHS = widen(Cmp->getOperand(1), First, Width);
+    Res = isa<ICmpInst>(Cmp)
+              ? Builder.CreateICmp(Cmp->getPredicate(), LHS, RHS, Cmp->getName())
+              : Builder.CreateFCmp(Cmp->getPredicate(), LHS, RHS,
+                                   Cmp->getName());
+  } else if (auto CI = dyn_cast<CastInst>(V)) {
+    Res = Builder.CreateCast(CI->getOpcode(),
+                             widen(CI->getOperand(0), First, Width), VecTy,
+                             CI->getName());
+  } else {
+    auto Sel = cast<SelectInst>(V);
+    Res = Builder.CreateSelect(widen(Sel->getCondition(), First, Width),
+                               widen(Sel->getTrueValue(), First, Width),
+                               widen(Sel->getFalseValue(), First, Width),
+                               Sel->getName());
+  }
+  assert(Res->getType() == VecTy && "widened value has the wrong type");
+  Lanes[V] = Res;
+  return Res;
+}
+
+/***********************************************************************
+ * hoist : get a loop invariant value in the preheader, copying any
+ *         instructions in the loop that compute it
+ */
+Value *CMLoopVectorize::hoist(Value *V) {
+  auto Inst = dyn_cast<Instruction>(V);
+  if (!Inst || !L->contains(Inst))
+    return V;
+  auto It = Hoisted.find(V);
+  if (It != Hoisted.end())
+    return It->second;
+  Instruction *NewInst = Inst->clone();
+  for (unsigned i = 0, e = NewInst->getNumOperands(); i != e; ++i)
+    NewInst->setOperand(i, hoist(Inst->getOperand(i)));
+  NewInst->insertBefore(InsertPt);
+  NewInst->takeName(Inst);
+  Hoisted[V] = NewInst;
+  return NewInst;
+}
+
+/***********************************************************************
+ * getAffineValue : get the constant value of an affine integer in the given
+ *                  iteration
+ */
+Constant *CMLoopVectorize::getAffineValue(Value *V, unsigned Iter) {
+  auto AR = cast<SCEVAddRecExpr>(SE->getSCEV(V));
+  const APInt &Start = cast<SCEVConstant>(AR->getStart())->getAPInt();
+  const APInt &Step =
+      cast<SCEVConstant>(AR->getStepRecurrence(*SE))->getAPInt();
+  return ConstantInt::get(V->getType(),
+                          Start + Step * APInt(Start.getBitWidth(), Iter));
+}
+
+/***********************************************************************
+ * getAffineLanes : get the constant values of an affine integer for a chunk
+ *                  of iterations
+ */
+Value *CMLoopVectorize::getAffineLanes(Value *V, unsigned First,
+                                       unsigned Width) {
+  SmallVector<Constant *, 16> Elts;
+  for (unsigned i = 0; i != Width; ++i)
+    Elts.push_back(getAffineValue(V, First + i));
+  return ConstantVector::get(Elts);
+}
+
+/***********************************************************************
+ * readRegion : read Width elements at the given start and stride
+ */
+Value *CMLoopVectorize::readRegion(Value *Input, int64_t Start,
+                                   int64_t Stride, unsigned Width) {
+  Type *EltTy = Input->getType()->getVectorElementType();
+  CMRegion R(VectorType::get(EltTy, Width), DL);
+  R.Stride = Width > 1 ? Stride : 1;
+  R.Offset = Start * R.ElementBytes;
+  return R.createRdRegion(Input, Input->getName() + ".vec", InsertPt,
+                          DebugLoc());
+}
+
+/***********************************************************************
+ * writeRegion : write a vector of elements at the given start and stride
+ */
+Value *CMLoopVectorize::writeRegion(Value *OldVal, Value *NewVal,
+                                    int64_t Start, int64_t Stride) {
+  unsigned Width = NewVal->getType()->getVectorNumElements();
+  CMRegion R(NewVal->getType(), DL);
+  R.Stride = Width > 1 ? Stride : 1;
+  R.Offset = Start * R.ElementBytes;
+  return R.createWrRegion(OldVal, NewVal, OldVal->getName(), InsertPt,
+                          DebugLoc());
+}
+
+/***********************************************************************
+ * reduce : fold the elements of a vector with a reduction's operator
+ *
+ * The vector is halved with two rdregions until one element is left. An odd
+ * element left over at each step is folded in separately.
+ */
+Value *CMLoopVectorize::reduce(Value *V, BinaryOperator *Op, unsigned Width) {
+  Value *Peeled = nullptr;
+  while (Width > 1) {
+    unsigned Half = Width / 2;
+    if (Width & 1) {
+      Value *Last = readRegion(V, Width - 1, 1, 1);
+      Peeled = Peeled ? createReductionOp(Op, Peeled, Last) : Last;
+    }
+    Value *Lo = readRegion(V, 0, 1, Half);
+    Value *Hi = readRegion(V, Half, 1, Half);
+    V = createReductionOp(Op, Lo, Hi);
+    Width = Half;
+  }
+  if (Peeled)
+    V = createReductionOp(Op, V, Peeled);
+  IRBuilder<> Builder(InsertPt);
+  return Builder.CreateExtractElement(V, Builder.getInt32(0),
+                                      Op->getName() + ".red");
+}
+
+/***********************************************************************
+ * createReductionOp : apply a reduction's operator, keeping its fast-math
+ *                     flags but not its wrap flags, which do not hold once
+ *                     the operations are reordered
+ */
+Value *CMLoopVectorize::createReductionOp(BinaryOperator *Op, Value *LHS,
+                                          Value *RHS) {
+  IRBuilder<> Builder(InsertPt);
+  Value *Res = Builder.CreateBinOp(Op->getOpcode(), LHS, RHS, Op->getName());
+  if (auto Inst = dyn_cast<Instruction>(Res))
+    if (isa<FPMathOperator>(Inst))
+      Inst->setFastMathFlags(Op->getFastMathFlags());
+  return Res;
+}
+
+/***********************************************************************
+ * replaceLiveOuts : replace uses of a loop value after the loop, which are
+ *                   all LCSSA phis in the exit block
+ */
+void CMLoopVectorize::replaceLiveOuts(Instruction *Inst, Value *NewVal) {
+  SmallVector<Use *, 4> LiveOuts;
+  for (Use &U : Inst->uses())
+    if (!L->contains(cast<Instruction>(U.getUser())))
+      LiveOuts.push_back(&U);
+  for (Use *U : LiveOuts)
+    U->set(NewVal);
+}
@@ -0,0 +1,801 @@
+/*
+ * Copyright (c) 2020, Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+//===----------------------------------------------------------------------===//
+//
+/// CMSLMStaging
+/// ------------
+///
+/// In stencil, convolution and GEMM kernels each thread of a group often
+/// reads a window of a read-only buffer that overlaps the windows of its
+/// neighbours:
+///
+///   uint x = (cm_group_id(0) * cm_local_size(0) + cm_local_id(0)) * 64;
+///   read(in, x - 64, left);
+///   read(in, x, mid);
+///   read(in, x + 64, right);
+///
+/// so the group as a whole fetches each oword from global memory several
+/// times. This pass stages the union of those windows, the group's "tile",
+/// in shared local memory:
+///
+/// * at the start of the kernel, the threads of the group copy the tile
+///   from the surface into SLM between them, 128 bytes at a time;
+///
+/// * an SLM fence and a barrier follow, so the whole tile is visible to
+///   every thread;
+///
+/// * each read of the tile becomes an oword block read of SLM at the same
+///   distance from the start of the tile.
+///
+/// A read is staged when:
+///
+/// * it is an aligned oword block read (oword_ld) of a SurfaceIndex kernel
+///   argument that the kernel only ever reads;
+///
+/// * its offset is an affine function of the local id, with non-negative
+///   coefficients, plus a part that is the same for every thread of the
+///   group (built from kernel arguments, group ids, group counts and local
+///   sizes);
+///
+/// * the tile, for a group of two threads along each dimension the offset
+///   depends on, is smaller than the data those threads read.
+///
+/// Reads of the same surface with the same group part and the same local id
+/// coefficients share a tile. Another SurfaceIndex argument the kernel writes
+/// may be bound to the same buffer, and a thread would then read a stale SLM
+/// copy of what was written, so a kernel that writes any surface argument is
+/// only staged with -cm-slm-staging-assume-no-alias.
+///
+/// The local size is only known at run time, so each tile gets an SLM
+/// allocation sized for a group of MaxGroupThreads threads, within the
+/// -cm-slm-staging-budget limit, after the kernel's own cm_slm_init size. A
+/// group whose tile does not fit takes the original reads instead, as does a
+/// group whose tile would start below offset 0, where an exact division of
+/// the offset is no longer affine. Both checks are uniform across the group,
+/// so the barrier is still reached by every thread.
+///
+/// Each staged tile gets a remark (-Rpass=cmslmstaging), and each read that
+/// depends on the local id but is not staged gets a missed-optimization
+/// remark (-Rpass-missed=cmslmstaging) saying why.
+///
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "cmslmstaging"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/IntrinsicsGenX.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include <algorithm>
+
+using namespace llvm;
+
+static cl::opt<bool> EnableCMSLMStaging("enable-cm-slm-staging",
+    cl::init(true), cl::Hidden,
+    cl::desc("Stage read-only surface tiles shared by a thread group in SLM"));
+
+static cl::opt<bool> CMSLMStagingAssumeNoAlias(
+    "cm-slm-staging-assume-no-alias", cl::init(false), cl::Hidden,
+    cl::desc("Assume the surfaces a kernel writes are not bound to a buffer "
+             "it stages in SLM"));
+
+static cl::opt<unsigned> CMSLMStagingBudget("cm-slm-staging-budget",
+    cl::init(16384), cl::Hidden, cl::value_desc("bytes"),
+    cl::desc("Most SLM a kernel may use for staged tiles"));
+
+STATISTIC(NumStagedTiles, "Number of tiles staged in SLM");
+STATISTIC(NumStagedReads, "Number of surface reads rewritten into SLM reads");
+
+// The SLM surface index, as used by the cm_slm builtins.
+static const unsigned SLMBTI = 254;
+// Each thread copies this many bytes at a time, the largest oword block.
+static const unsigned ChunkBytes = 128;
+// The group size an allocation is sized for. Larger groups still work, if
+// their tile happens to fit.
+static const unsigned MaxGroupThreads = 64;
+// The largest SLM a kernel can have.
+static const unsigned MaxSLMBytes = 64 << 10;
+// vISA fence mask for an SLM fence that commits its writes.
+static const unsigned SLMFenceMask = 0x21;
+
+namespace {
+
+// The offset operand of a read, as
+//
+//   (sum of Terms + sum of Lid[d] * local_id(d) + Const) >> Shift
+//
+// where the Terms are the same for every thread of the group. Divided is set
+// when the offset went through an exact division, which is only affine while
+// the sum does not wrap.
+struct AffineOffset {
+  SmallVector<std::pair<Value *, int64_t>, 4> Terms;
+  int64_t Lid[3] = {0, 0, 0};
+  int64_t Const = 0;
+  unsigned Shift = 0;
+  bool Divided = false;
+
+  void scale(int64_t M) {
+    for (auto &T : Terms)
+      T.second *= M;
+    for (int64_t &K : Lid)
+      K *= M;
+    Const *= M;
+  }
+  void shiftTo(unsigned S) {
+    scale(int64_t(1) << (S - Shift));
+    Shift = S;
+  }
+  void add(AffineOffset Other, int64_t Sign);
+  void normalize();
+  bool sameGroupPart(const AffineOffset &Other) const;
+};
+
+// One read to stage, and its offset.
+struct StagedRead {
+  CallInst *CI;
+  AffineOffset Off;
+};
+
+// The reads that share one tile.
+struct Tile {
+  Argument *Surf = nullptr;
+  SmallVector<StagedRead, 4> Reads;
+  int64_t Unit = 16;         // bytes per unit of the offset operand
+  int64_t MinConst = 0;      // smallest Const of the reads
+  int64_t Span = 0;          // units read by one thread
+  int64_t Step[3] = {0, 0, 0}; // units moved per local id
+  unsigned SLMOffset = 0;    // bytes
+  unsigned AllocBytes = 0;
+};
+
+class CMSLMStaging : public FunctionPass {
+  const DataLayout *DL = nullptr;
+  DenseMap<Value *, bool> UniformMemo;
+  DenseMap<Value *, bool> LocalIdMemo;
+  DenseMap<Argument *, bool> ReadOnlyMemo;
+  bool WritesSurface = false;
+  std::string Reason;
+
+public:
+  static char ID;
+  CMSLMStaging() : FunctionPass(ID) {
+    initializeCMSLMStagingPass(*PassRegistry::getPassRegistry());
+  }
+  StringRef getPassName() const override {
+    return "CM SLM staging of shared read-only tiles";
+  }
+  void getAnalysisUsage(AnalysisUsage &AU) const override {}
+  bool runOnFunction(Function &F) override;
+
+private:
+  bool analyzeRead(CallInst *CI, AffineOffset &Off);
+  bool decompose(Value *V, AffineOffset &Off);
+  bool reject(const Twine &Msg);
+  bool isGroupUniform(Value *V);
+  bool usesLocalId(Value *V);
+  bool isReadOnly(Argument *Surf);
+  void stage(Function &F, MutableArrayRef<Tile> Tiles);
+  Value *materialize(Value *V, IRBuilder<> &B,
+                     DenseMap<Value *, Value *> &Clones);
+};
+
+} // namespace
+
+char CMSLMStaging::ID = 0;
+INITIALIZE_PASS(CMSLMStaging, "cmslmstaging",
+                "Stage shared read-only tiles in SLM", false, false)
+
+Pass *llvm::createCMSLMStagingPass() { return new CMSLMStaging(); }
+
+static inline unsigned getIntrinsicID(Value *V) {
+  if (CallInst *CI = dyn_cast_or_null<CallInst>(V))
+    if (Function *Callee = CI->getCalledFunction())
+      return Callee->getIntrinsicID();
+  return Intrinsic::not_intrinsic;
+}
+
+void AffineOffset::add(AffineOffset Other, int64_t Sign) {
+  if (Other.Shift > Shift)
+    shiftTo(Other.Shift);
+  else if (Other.Shift < Shift)
+    Other.shiftTo(Shift);
+  for (auto &OT : Other.Terms) {
+    auto It = std::find_if(Terms.begin(), Terms.end(),
+                           [&](const std::pair<Value *, int64_t> &T) {
+                             return T.first == OT.first;
+                           });
+    if (It != Terms.end())
+      It->second += Sign * OT.second;
+    else
+      Terms.push_back({OT.first, Sign * OT.second});
+  }
+  for (unsigned D = 0; D != 3; ++D)
+    Lid[D] += Sign * Other.Lid[D];
+  Const += Sign * Other.Const;
+  Divided |= Other.Divided;
+}
+
+// normalize : drop cancelled terms and take out common factors of two
+void AffineOffset::normalize() {
+  Terms.erase(std::remove_if(Terms.begin(), Terms.end(),
+                             [](const std::pair<Value *, int64_t> &T) {
+                               return !T.second;
+                             }),
+              Terms.end());
+  while (Shift) {
+    bool Even = !(Const & 1) && !(Lid[0] & 1) && !(Lid[1] & 1) &&
+                !(Lid[2] & 1);
+    for (auto &T : Terms)
+      Even &= !(T.second & 1);
+    if (!Even)
+      break;
+    for (auto &T : Terms)
+      T.second /= 2;
+    for (int64_t &K : Lid)
+      K /= 2;
+    Const /= 2;
+    --Shift;
+  }
+}
+
+// sameGroupPart : whether two normalized offsets differ only by a constant
+// number of units, and move by the same amount with the local id
+bool AffineOffset::sameGroupPart(const AffineOffset &Other) const {
+  if (Shift != Other.Shift || Divided != Other.Divided ||
+      Terms.size() != Other.Terms.size())
+    return false;
+  for (unsigned D = 0; D != 3; ++D)
+    if (Lid[D] != Other.Lid[D])
+      return false;
+  if ((Const - Other.Const) % (int64_t(1) << Shift))
+    return false;
+  for (auto &T : Terms)
+    if (std::find(Other.Terms.begin(), Other.Terms.end(), T) ==
+        Other.Terms.end())
+      return false;
+  return true;
+}
+
+/***********************************************************************
+ * runOnFunction : stage the shared read-only tiles of a kernel
+ */
+bool CMSLMStaging::runOnFunction(Function &F) {
+  if (!EnableCMSLMStaging || skipFunction(F))
+    return false;
+  genx::KernelMetadata KM(&F);
+  if (!KM.isKernel())
+    return false;
+  DL = &F.getParent()->getDataLayout();
+  UniformMemo.clear();
+  LocalIdMemo.clear();
+  ReadOnlyMemo.clear();
+
+  // Any surface argument the kernel writes may be bound to the buffer of one
+  // it only reads.
+  WritesSurface = false;
+  for (Argument &Arg : F.args())
+    if (Arg.getArgNo() < KM.getNumArgs() &&
+        KM.getArgCategory(Arg.getArgNo()) == genx::RegCategory::SURFACE)
+      WritesSurface |= !isReadOnly(&Arg);
+
+  // Gather the reads of surface arguments whose offset depends on the local
+  // id. Other reads are the same for the whole group, or not shared by it.
+  SmallVector<CallInst *, 8> Candidates;
+  for (BasicBlock &BB : F)
+    for (Instruction &I : BB) {
+      if (getIntrinsicID(&I) != Intrinsic::genx_oword_ld)
+        continue;
+      auto CI = cast<CallInst>(&I);
+      auto Surf = dyn_cast<Argument>(CI->getArgOperand(1));
+      if (!Surf || Surf->getArgNo() >= KM.getNumArgs() ||
+          KM.getArgCategory(Surf->getArgNo()) != genx::RegCategory::SURFACE)
+        continue;
+      if (usesLocalId(CI->getArgOperand(2)))
+        Candidates.push_back(CI);
+    }
+  if (Candidates.empty())
+    return false;
+
+  OptimizationRemarkEmitter ORE(&F);
+  auto Missed = [&](CallInst *CI, const Twine &Why) {
+    std::string Msg = Why.str();
+    DEBUG(dbgs() << "CMSLMStaging: " << Msg << "\n");
+    ORE.emit([&]() {
+      return OptimizationRemarkMissed(DEBUG_TYPE, "NotStaged",
+                                      CI->getDebugLoc(), CI->getParent())
+             << "read not staged in SLM: " << Msg;
+    });
+  };
+
+  // Sort the reads into tiles.
+  SmallVector<Tile, 4> Tiles;
+  for (CallInst *CI : Candidates) {
+    AffineOffset Off;
+    if (!analyzeRead(CI, Off)) {
+      Missed(CI, Reason);
+      continue;
+    }
+    auto Surf = cast<Argument>(CI->getArgOperand(1));
+    auto T = std::find_if(Tiles.begin(), Tiles.end(), [&](const Tile &Other) {
+      return Other.Surf == Surf && Other.Reads.front().Off.sameGroupPart(Off);
+    });
+    if (T == Tiles.end()) {
+      Tiles.emplace_back();
+      T = &Tiles.back();
+      T->Surf = Surf;
+      T->MinConst = Off.Const;
+    }
+    T->MinConst = std::min(T->MinConst, Off.Const);
+    T->Reads.push_back({CI, Off});
+  }
+
+  // Size each tile, and give it SLM within the budget. Staged tiles go after
+  // the kernel's own SLM.
+  unsigned SLMBase = alignTo(KM.getSLMSize(), ChunkBytes);
+  unsigned Limit = SLMBase < MaxSLMBytes
+                       ? std::min(unsigned(CMSLMStagingBudget),
+                                  MaxSLMBytes - SLMBase)
+                       : 0;
+  unsigned Used = 0;
+  SmallVector<Tile, 4> Staged;
+  for (Tile &T : Tiles) {
+    unsigned Shift = T.Reads.front().Off.Shift;
+    for (auto &R : T.Reads) {
+      int64_t Start = (R.Off.Const - T.MinConst) >> Shift;
+      int64_t Size = DL->getTypeStoreSize(R.CI->getType()) / T.Unit;
+      T.Span = std::max(T.Span, Start + Size);
+    }
+    int64_t MinUnits = T.Span, MaxUnits = T.Span;
+    bool Overlaps = true;
+    for (unsigned D = 0; D != 3; ++D) {
+      T.Step[D] = T.Reads.front().Off.Lid[D] >> Shift;
+      Overlaps &= T.Step[D] < T.Span;
+      MinUnits += T.Step[D];
+      MaxUnits += T.Step[D] * (MaxGroupThreads - 1);
+    }
+    unsigned MinBytes = alignTo(MinUnits * T.Unit, ChunkBytes);
+    unsigned Remaining = Limit - Used;
+    T.AllocBytes = std::min(unsigned(alignTo(MaxUnits * T.Unit, ChunkBytes)),
+                            unsigned(alignDown(Remaining, ChunkBytes)));
+    if (!Overlaps || T.AllocBytes < MinBytes) {
+      std::string Why =
+          !Overlaps ? "footprints of neighbouring threads do not overlap"
+                    : "tile does not fit in the SLM budget of " +
+                          std::to_string(Limit) + " bytes";
+      for (auto &R : T.Reads)
+        Missed(R.CI, Why);
+      continue;
+    }
+    T.SLMOffset = SLMBase + Used;
+    Used += T.AllocBytes;
+    Staged.push_back(T);
+  }
+  if (Staged.empty())
+    return false;
+
+  stage(F, Staged);
+
+  // Grow the kernel's SLM to cover the tiles.
+  NamedMDNode *Named = F.getParent()->getNamedMetadata("genx.kernels");
+  for (MDNode *Node : Named->operands()) {
+    if (genx::getValueAsMetadata(Node->getOperand(0)) != &F)
+      continue;
+    Type *I32Ty = Type::getInt32Ty(F.getContext());
+    Node->replaceOperandWith(
+        4, ValueAsMetadata::get(ConstantInt::get(I32Ty, SLMBase + Used)));
+  }
+
+  for (Tile &T : Staged) {
+    CallInst *First = T.Reads.front().CI;
+    ORE.emit([&]() {
+      return OptimizationRemark(DEBUG_TYPE, "Staged", First->getDebugLoc(),
+                                First->getParent())
+             << "staged " << ore::NV("NumReads", unsigned(T.Reads.size()))
+             << (T.Reads.size() == 1 ? " read" : " reads")
+             << " of a read-only surface in a "
+             << ore::NV("TileBytes", T.AllocBytes) << " byte SLM tile";
+    });
+    ++NumStagedTiles;
+    NumStagedReads += T.Reads.size();
+  }
+  return true;
+}
+
+bool CMSLMStaging::reject(const Twine &Msg) {
+  Reason = Msg.str();
+  return false;
+}
+
+/***********************************************************************
+ * analyzeRead : check a read can be staged, and get its offset
+ */
+bool CMSLMStaging::analyzeRead(CallInst *CI, AffineOffset &Off) {
+  Reason.clear();
+  if (!isReadOnly(cast<Argument>(CI->getArgOperand(1))))
+    return reject("the surface may be written by the kernel");
+  if (WritesSurface && !CMSLMStagingAssumeNoAlias)
+    return reject("the surface may be written through another argument");
+  if (!decompose(CI->getArgOperand(2), Off))
+    return false;
+  Off.normalize();
+  for (unsigned D = 0; D != 3; ++D) {
+    if (Off.Lid[D] < 0)
+      return reject("offset decreases as the local id increases");
+    if (Off.Lid[D] % (int64_t(1) << Off.Shift))
+      return reject("offset does not move by whole units with the local id");
+  }
+  return true;
+}
+
+/***********************************************************************
+ * decompose : write an offset as an AffineOffset
+ *
+ * Anything that does not use the local id is a group uniform term, and the
+ * rest must be sums, differences and constant multiples of local ids, with
+ * exact divisions by powers of two.
+ */
+bool CMSLMStaging::decompose(Value *V, AffineOffset &Off) {
+  if (auto C = dyn_cast<ConstantInt>(V)) {
+    Off.Const = C->getSExtValue();
+    return true;
+  }
+  if (!V->getType()->isIntegerTy(32))
+    return reject("offset is not an affine function of the local id");
+  if (!usesLocalId(V)) {
+    if (!isGroupUniform(V))
+      return reject("offset depends on a value that may differ between the "
+                    "threads of a group");
+    Off.Terms.push_back({V, 1});
+    return true;
+  }
+  if (auto EEI = dyn_cast<ExtractElementInst>(V)) {
+    auto Idx = dyn_cast<ConstantInt>(EEI->getIndexOperand());
+    if (getIntrinsicID(EEI->getVectorOperand()) == Intrinsic::genx_local_id &&
+        Idx && Idx->getZExtValue() < 3) {
+      Off.Lid[Idx->getZExtValue()] = 1;
+      return true;
+    }
+  }
+  auto BO = dyn_cast<BinaryOperator>(V);
+  if (!BO)
+    return reject("offset is not an affine function of the local id");
+  Value *LHS = BO->getOperand(0);
+  Value *RHS = BO->getOperand(1);
+  auto C = dyn_cast<ConstantInt>(RHS);
+  switch (BO->getOpcode()) {
+  case Instruction::Or:
+    if (!haveNoCommonBitsSet(LHS, RHS, *DL))
+      break;
+    LLVM_FALLTHROUGH;
+  case Instruction::Add:
+  case Instruction::Sub: {
+    AffineOffset R;
+    if (!decompose(LHS, Off) || !decompose(RHS, R))
+      return false;
+    Off.add(R, BO->getOpcode() == Instruction::Sub ? -1 : 1);
+    return true;
+  }
+  case Instruction::Mul:
+    if (!C) {
+      C = dyn_cast<ConstantInt>(LHS);
+      std::swap(LHS, RHS);
+    }
+    if (!C || !decompose(LHS, Off))
+      break;
+    Off.scale(C->getSExtValue());
+    return true;
+  case Instruction::Shl:
+    if (!C || C->getZExtValue() >= 16 || !decompose(LHS, Off))
+      break;
+    Off.scale(int64_t(1) << C->getZExtValue());
+    return true;
+  case Instruction::UDiv:
+  case Instruction::LShr: {
+    if (!C || !BO->isExact())
+      break;
+    unsigned Shift = BO->getOpcode() == Instruction::LShr
+                         ? C->getZExtValue()
+                         : (C->getValue().isPowerOf2()
+                                ? C->getValue().logBase2()
+                                : 16);
+    if (Shift >= 16 || !decompose(LHS, Off))
+      break;
+    Off.Shift += Shift;
+    Off.Divided = true;
+    return true;
+  }
+  default:
+    break;
+  }
+  return Reason.empty()
+             ? reject("offset is not an affine function of the local id")
+             : false;
+}
+
+/***********************************************************************
+ * isGroupUniform : whether a value is the same for every thread of a group
+ *
+ * It must be computed, without memory accesses, from kernel arguments and
+ * the group ids, group counts and local sizes, so it can also be recomputed
+ * at the start of the kernel.
+ */
+bool CMSLMStaging::isGroupUniform(Value *V) {
+  if (isa<Argument>(V) || isa<Constant>(V))
+    return true;
+  auto I = dyn_cast<Instruction>(V);
+  if (!I)
+    return false;
+  auto It = UniformMemo.find(V);
+  if (It != UniformMemo.end())
+    return It->second;
+  bool Uniform = false;
+  switch (getIntrinsicID(I)) {
+  case Intrinsic::genx_group_id_x:
+  case Intrinsic::genx_group_id_y:
+  case Intrinsic::genx_group_id_z:
+  case Intrinsic::genx_group_count:
+  case Intrinsic::genx_local_size:
+    Uniform = true;
+    break;
+  case Intrinsic::not_intrinsic:
+    // A division that ran under a guard must not be moved to where it runs
+    // on every thread.
+    if ((isa<BinaryOperator>(I) || isa<CastInst>(I) || isa<CmpInst>(I) ||
+         isa<SelectInst>(I) || isa<ExtractElementInst>(I)) &&
+        isSafeToSpeculativelyExecute(I)) {
+      Uniform = true;
+      for (Value *Op : I->operands())
+        Uniform &= isGroupUniform(Op);
+    }
+    break;
+  default:
+    break;
+  }
+  UniformMemo[V] = Uniform;
+  return Uniform;
+}
+
+// usesLocalId : whether a value is computed from the local id
+bool CMSLMStaging::usesLocalId(Value *V) {
+  auto I = dyn_cast<Instruction>(V);
+  if (!I)
+    return false;
+  auto It = LocalIdMemo.find(V);
+  if (It != LocalIdMemo.end())
+    return It->second;
+  // Cut cycles through phi nodes.
+  LocalIdMemo[V] = false;
+  bool Uses = getIntrinsicID(I) == Intrinsic::genx_local_id;
+  for (unsigned Idx = 0, E = I->getNumOperands(); !Uses && Idx != E; ++Idx)
+    Uses = usesLocalId(I->getOperand(Idx));
+  LocalIdMemo[V] = Uses;
+  return Uses;
+}
+
+// isReadOnly : whether every use of a surface argument is a read
+bool CMSLMStaging::isReadOnly(Argument *Surf) {
+  auto It = ReadOnlyMemo.find(Surf);
+  if (It != ReadOnlyMemo.end())
+    return It->second;
+  bool ReadOnly = true;
+  for (User *U : Surf->users()) {
+    switch (getIntrinsicID(U)) {
+    case Intrinsic::genx_oword_ld:
+    case Intrinsic::genx_oword_ld_unaligned:
+    case Intrinsic::genx_media_ld:
+    case Intrinsic::genx_gather_scaled:
+    case Intrinsic::genx_gather4_scaled:
+      break;
+    default:
+      ReadOnly = false;
+      break;
+    }
+  }
+  ReadOnlyMemo[Surf] = ReadOnly;
+  return ReadOnly;
+}
+
+/***********************************************************************
+ * materialize : recompute a group uniform value at the start of the kernel
+ */
+Value *CMSLMStaging::materialize(Value *V, IRBuilder<> &B,
+                                 DenseMap<Value *, Value *> &Clones) {
+  auto I = dyn_cast<Instruction>(V);
+  if (!I)
+    return V;
+  auto It = Clones.find(V);
+  if (It != Clones.end())
+    return It->second;
+  assert(isSafeToSpeculativelyExecute(I) && "cannot hoist a trapping value");
+  Instruction *Clone = I->clone();
+  for (unsigned Idx = 0, E = I->getNumOperands(); Idx != E; ++Idx)
+    Clone->setOperand(Idx, materialize(I->getOperand(Idx), B, Clones));
+  B.Insert(Clone, I->getName());
+  Clones[V] = Clone;
+  return Clone;
+}
+
+/***********************************************************************
+ * stage : copy the tiles into SLM and rewrite their reads
+ *
+ * The start of the kernel becomes, for each tile
+ *
+ *   start = offset of the lowest read for local id 0
+ *   len = bytes in the tile for this group size
+ *   if (len <= allocated && start did not wrap)
+ *     for (i = linear id * 128; i < len; i += group size * 128)
+ *       SLM[tile + i] = surface[start + i], 128 bytes
+ *
+ * then an SLM fence and a barrier. Each read of the tile picks SLM or the
+ * surface on whether its tile was copied.
+ */
+void CMSLMStaging::stage(Function &F, MutableArrayRef<Tile> Tiles) {
+  LLVMContext &Ctx = F.getContext();
+  Module *M = F.getParent();
+  Type *I32Ty = Type::getInt32Ty(Ctx);
+  Type *ChunkTy = VectorType::get(I32Ty, ChunkBytes / 4);
+  Type *V3I32Ty = VectorType::get(I32Ty, 3);
+
+  BasicBlock *Cur = &F.getEntryBlock();
+  BasicBlock::iterator IP = Cur->getFirstInsertionPt();
+  while (isa<AllocaInst>(IP))
+    ++IP;
+  IRBuilder<> B(Cur, IP);
+  B.SetCurrentDebugLocation(Tiles.front().Reads.front().CI->getDebugLoc());
+
+  Value *LocalId = B.CreateCall(
+      Intrinsic::getDeclaration(M, Intrinsic::genx_local_id, V3I32Ty), {},
+      "local.id");
+  Value *LocalSize = B.CreateCall(
+      Intrinsic::getDeclaration(M, Intrinsic::genx_local_size, V3I32Ty), {},
+      "local.size");
+  Value *Ids[3], *Sizes[3];
+  for (unsigned D = 0; D != 3; ++D) {
+    Ids[D] = B.CreateExtractElement(LocalId, D);
+    Sizes[D] = B.CreateExtractElement(LocalSize, D);
+  }
+  Value *LinearId = B.CreateAdd(
+      B.CreateMul(B.CreateAdd(B.CreateMul(Ids[2], Sizes[1]), Ids[1]),
+                  Sizes[0]),
+      Ids[0], "linear.id");
+  Value *NumThreads =
+      B.CreateMul(B.CreateMul(Sizes[0], Sizes[1]), Sizes[2], "group.size");
+
+  Value *FirstPos =
+      B.CreateMul(LinearId, ConstantInt::get(I32Ty, ChunkBytes));
+  Value *Stride =
+      B.CreateMul(NumThreads, ConstantInt::get(I32Ty, ChunkBytes));
+
+  SmallVector<Value *, 4> Flags;
+  DenseMap<Value *, Value *> Clones;
+  for (Tile &T : Tiles) {
+    // Offset, in units, of the lowest read for local id 0.
+    const AffineOffset &Off = T.Reads.front().Off;
+    Value *Start = ConstantInt::get(I32Ty, T.MinConst);
+    for (auto &Term : Off.Terms)
+      Start = B.CreateAdd(
+          Start, B.CreateMul(materialize(Term.first, B, Clones),
+                             ConstantInt::get(I32Ty, Term.second)));
+    Value *NoWrap = nullptr;
+    if (Off.Divided)
+      NoWrap = B.CreateICmpSGE(Start, ConstantInt::get(I32Ty, 0));
+    if (Off.Shift)
+      Start = B.CreateLShr(Start, Off.Shift, "tile.start", /*isExact=*/true);
+
+    Value *Len = ConstantInt::get(I32Ty, T.Span);
+    for (unsigned D = 0; D != 3; ++D)
+      if (T.Step[D])
+        Len = B.CreateAdd(
+            Len, B.CreateMul(B.CreateSub(Sizes[D], ConstantInt::get(I32Ty, 1)),
+                             ConstantInt::get(I32Ty, T.Step[D])));
+    Len = B.CreateMul(Len, ConstantInt::get(I32Ty, T.Unit), "tile.len");
+    Value *Fits = B.CreateICmpULE(Len, ConstantInt::get(I32Ty, T.AllocBytes));
+    if (NoWrap)
+      Fits = B.CreateAnd(Fits, NoWrap);
+    if (isa<Instruction>(Fits))
+      Fits->setName("tile.staged");
+    Flags.push_back(Fits);
+
+    // The cooperative copy.
+    BasicBlock *Next = SplitBlock(Cur, &*B.GetInsertPoint());
+    BasicBlock *Header = BasicBlock::Create(Ctx, "slm.copy", &F, Next);
+    BasicBlock *Body = BasicBlock::Create(Ctx, "slm.copy.body", &F, Next);
+    Cur->getTerminator()->eraseFromParent();
+    B.SetInsertPoint(Cur);
+    B.CreateCondBr(Fits, Header, Next);
+
+    B.SetInsertPoint(Header);
+    PHINode *Pos = B.CreatePHI(I32Ty, 2, "slm.copy.pos");
+    Pos->addIncoming(FirstPos, Cur);
+    B.CreateCondBr(B.CreateICmpULT(Pos, Len), Body, Next);
+
+    B.SetInsertPoint(Body);
+    Value *Src = B.CreateAdd(Start, B.CreateLShr(Pos, 4));
+    Value *Data = B.CreateCall(
+        Intrinsic::getDeclaration(M, Intrinsic::genx_oword_ld, ChunkTy),
+        {ConstantInt::get(I32Ty, 0), T.Surf, Src});
+    Value *Dst = B.CreateLShr(
+        B.CreateAdd(Pos, ConstantInt::get(I32Ty, T.SLMOffset)), 4);
+    B.CreateCall(
+        Intrinsic::getDeclaration(M, Intrinsic::genx_oword_st, ChunkTy),
+        {ConstantInt::get(I32Ty, SLMBTI), Dst, Data});
+    Pos->addIncoming(B.CreateAdd(Pos, Stride), Body);
+    B.CreateBr(Header);
+
+    Cur = Next;
+    B.SetInsertPoint(Cur, Cur->getFirstInsertionPt());
+  }
+
+  // Every thread reaches the barrier, whether or not its group copied.
+  Type *I8Ty = Type::getInt8Ty(Ctx);
+  B.CreateCall(Intrinsic::getDeclaration(M, Intrinsic::genx_fence),
+               ConstantInt::get(I8Ty, SLMFenceMask));
+  B.CreateCall(Intrinsic::getDeclaration(M, Intrinsic::genx_barrier));
+
+  // Rewrite the reads, at their distance from the start of the tile.
+  for (unsigned Idx = 0, E = Tiles.size(); Idx != E; ++Idx) {
+    Tile &T = Tiles[Idx];
+    for (auto &R : T.Reads) {
+      CallInst *CI = R.CI;
+      TerminatorInst *ThenTerm = nullptr, *ElseTerm = nullptr;
+      SplitBlockAndInsertIfThenElse(Flags[Idx], CI, &ThenTerm, &ElseTerm);
+      BasicBlock *Tail = CI->getParent();
+      IRBuilder<> RB(ThenTerm);
+      RB.SetCurrentDebugLocation(CI->getDebugLoc());
+      const AffineOffset &Off = R.Off;
+      Value *Offset = ConstantInt::get(
+          I32Ty, T.SLMOffset / T.Unit +
+                     ((Off.Const - T.MinConst) >> Off.Shift));
+      for (unsigned D = 0; D != 3; ++D)
+        if (T.Step[D])
+          Offset = RB.CreateAdd(
+              Offset,
+              RB.CreateMul(Ids[D], ConstantInt::get(I32Ty, T.Step[D])));
+      CallInst *SLMRead = RB.CreateCall(
+          CI->getCalledFunction(),
+          {CI->getArgOperand(0), ConstantInt::get(I32Ty, SLMBTI), Offset},
+          CI->getName() + ".slm");
+      PHINode *Phi = PHINode::Create(CI->getType(), 2, "", &Tail->front());
+      Phi->setDebugLoc(CI->getDebugLoc());
+      CI->replaceAllUsesWith(Phi);
+      CI->moveBefore(ElseTerm);
+      Phi->takeName(CI);
+      Phi->addIncoming(SLMRead, ThenTerm->getParent());
+      Phi->addIncoming(CI, ElseTerm->getParent());
+    }
+  }
+}
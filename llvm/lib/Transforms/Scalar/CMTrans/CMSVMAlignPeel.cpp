@@ -0,0 +1,838 @@
+/*
+ * Copyright (c) 2020, Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+//===----------------------------------------------------------------------===//
+//
+/// CMSVMAlignPeel
+/// --------------
+///
+/// A CM loop that streams through SVM memory whose alignment is not known at
+/// compile time has to use cm_svm_block_read_unaligned, or scattered reads
+/// and writes, on every iteration:
+///
+///   for (int i = 0; i < n; i++) {
+///     vector<float, 8> v;
+///     cm_svm_block_read_unaligned(in + i * 32, v);
+///     cm_svm_scatter_write(out + i * 32 + offsets, v * 2.0f);
+///   }
+///
+/// An oword aligned block message is much cheaper than either. This pass
+/// shifts such a loop so that its steady state works on oword aligned
+/// addresses:
+///
+/// * a runtime check in the preheader works out how many dwords h (0 to 3)
+///   the first unaligned stream is past an oword boundary, rounded up;
+///
+/// * a prologue runs the loop body once on the first h elements of every
+///   stream, with predicated scattered reads and writes;
+///
+/// * the steady-state loop runs the original body on addresses h dwords on,
+///   with an oword aligned svm_block_ld or svm_block_st for every stream at
+///   the same alignment as the first one;
+///
+/// * an epilogue runs the body once more on the remaining tail, again with
+///   predicated scattered accesses.
+///
+/// When h is 0 the prologue and epilogue are skipped and the steady-state
+/// loop runs every iteration.
+///
+/// This is only valid when the lanes of the body are independent, so a loop
+/// is transformed when:
+///
+/// * it is an innermost loop with a single block and a computable trip count,
+///   and nothing it computes is used after it;
+///
+/// * each memory access is an SVM stream: svm_block_ld_unaligned,
+///   svm_block_ld or svm_block_st, or an svm_gather or svm_scatter of dwords
+///   whose addresses are a splat plus 0, 4, 8, ..., with all the streams
+///   moving on by their own size, 32 or 64 bytes, each iteration;
+///
+/// * the data written is computed from the data read lane by lane, using
+///   element-wise operations, whole vector regions and splats of loop
+///   invariants.
+///
+/// A stream whose start is a constant multiple of 16 bytes from the first
+/// unaligned stream is "co-aligned" with it, and uses an aligned block
+/// message in the steady state. Other unaligned streams keep their message
+/// kind, on shifted addresses. A loop with an svm_block_ld or svm_block_st is
+/// not transformed: if it is co-aligned, the unaligned streams are aligned
+/// already and h is always 0, and otherwise shifting it would break its
+/// alignment.
+///
+/// Changing the order of the accesses is only safe if a write does not
+/// overlap another stream, so each write must be at the same address as
+/// every other stream. With -cm-svm-align-peel-assume-no-alias, streams whose
+/// bases are not a constant distance apart are assumed not to overlap; a
+/// write at a constant non-zero distance from another stream is still not
+/// transformed.
+///
+/// Each transformed loop gets a remark (-Rpass=cmsvmalignpeel) listing the
+/// messages used in the prologue, steady state and epilogue, and each loop
+/// with an unaligned stream that is not transformed gets a missed-optimization
+/// remark (-Rpass-missed=cmsvmalignpeel) saying why.
+///
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "cmsvmalignpeel"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpander.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/VectorUtils.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/IntrinsicsGenX.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Scalar/CMRegion.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+
+using namespace llvm;
+
+static cl::opt<bool> EnableCMSVMAlignPeel("enable-cm-svm-align-peel",
+    cl::init(true), cl::Hidden,
+    cl::desc("Peel CM loops so that their SVM block accesses are aligned"));
+
+static cl::opt<bool> CMSVMAlignPeelAssumeNoAlias(
+    "cm-svm-align-peel-assume-no-alias", cl::init(false), cl::Hidden,
+    cl::desc("Assume SVM streams with different bases do not overlap when "
+             "peeling loops for SVM alignment"));
+
+STATISTIC(NumPeeled, "Number of CM loops peeled for SVM alignment");
+
+namespace {
+
+// The kinds of message a stream can use, in the order the remark lists them.
+enum MessageKind {
+  MK_AlignedRead,
+  MK_UnalignedRead,
+  MK_Gather,
+  MK_AlignedWrite,
+  MK_Scatter,
+  MK_NumKinds
+};
+
+// One memory access in the loop body, moving through memory by the same
+// number of bytes as it accesses in each iteration.
+struct Stream {
+  CallInst *CI = nullptr;
+  bool IsWrite = false;
+  bool IsBlock = false;      // block message, rather than gather/scatter
+  bool WasAligned = false;   // svm_block_ld or svm_block_st
+  Value *Addr = nullptr;     // scalar address, or the splat in the addresses
+  int64_t LaneOffset = 0;    // lane 0 address minus Addr
+  const SCEV *Start = nullptr; // lane 0 address in the first iteration
+  bool CoAligned = false;    // a multiple of 16 bytes from the anchor
+};
+
+class CMSVMAlignPeel : public FunctionPass {
+  Loop *L = nullptr;
+  ScalarEvolution *SE = nullptr;
+  const DataLayout *DL = nullptr;
+  unsigned NumLanes = 0;
+  Type *EltTy = nullptr;
+  SmallVector<Stream, 4> Streams;
+  DenseMap<Value *, bool> LaneWiseMemo;
+  std::string Reason;
+
+public:
+  static char ID;
+  CMSVMAlignPeel() : FunctionPass(ID) {
+    initializeCMSVMAlignPeelPass(*PassRegistry::getPassRegistry());
+  }
+  StringRef getPassName() const override {
+    return "CM SVM alignment loop peeling";
+  }
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequiredID(LoopSimplifyID);
+    AU.addRequired<LoopInfoWrapperPass>();
+    AU.addRequired<ScalarEvolutionWrapperPass>();
+  }
+  bool runOnFunction(Function &F) override;
+
+private:
+  bool analyze();
+  bool reject(const Twine &Msg);
+  bool addStream(CallInst *CI);
+  bool isLaneWise(Value *V);
+  bool checkLaneWise(Value *V);
+  bool isSplat(Value *V);
+  void peel(unsigned Counts[3][MK_NumKinds]);
+  void emitPartial(BasicBlock *BB, ValueToValueMapTy &VMap, Value *Shift,
+                   Value *Count, unsigned *Counts);
+  Value *getLaneAddrs(IRBuilder<> &B, const Stream &S, Value *Addr,
+                      Value *Shift);
+  Value *getLaneOffsets(Type *Ty);
+};
+
+} // namespace
+
+char CMSVMAlignPeel::ID = 0;
+INITIALIZE_PASS_BEGIN(CMSVMAlignPeel, "cmsvmalignpeel",
+                      "Peel CM loops for SVM alignment", false, false)
+INITIALIZE_PASS_DEPENDENCY(LoopSimplify)
+INITIALIZE_PASS_DEPENDENCY(LoopInfoWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(ScalarEvolutionWrapperPass)
+INITIALIZE_PASS_END(CMSVMAlignPeel, "cmsvmalignpeel",
+                    "Peel CM loops for SVM alignment", false, false)
+
+Pass *llvm::createCMSVMAlignPeelPass() { return new CMSVMAlignPeel(); }
+
+static inline unsigned getIntrinsicID(Value *V) {
+  if (CallInst *CI = dyn_cast_or_null<CallInst>(V))
+    if (Function *Callee = CI->getCalledFunction())
+      return Callee->getIntrinsicID();
+  return Intrinsic::not_intrinsic;
+}
+
+static bool isSVMAccess(unsigned IID) {
+  switch (IID) {
+  case Intrinsic::genx_svm_block_ld:
+  case Intrinsic::genx_svm_block_ld_unaligned:
+  case Intrinsic::genx_svm_block_st:
+  case Intrinsic::genx_svm_gather:
+  case Intrinsic::genx_svm_scatter:
+    return true;
+  }
+  return false;
+}
+
+static const char *getKindName(unsigned Kind) {
+  switch (Kind) {
+  case MK_AlignedRead: return "aligned block read";
+  case MK_UnalignedRead: return "unaligned block read";
+  case MK_Gather: return "gather";
+  case MK_AlignedWrite: return "aligned block write";
+  default: return "scatter";
+  }
+}
+
+// describeMessages : the messages of one region, as "1 gather, 1 scatter"
+static std::string describeMessages(const unsigned *Counts) {
+  std::string S;
+  raw_string_ostream OS(S);
+  for (unsigned Kind = 0; Kind != MK_NumKinds; ++Kind) {
+    if (!Counts[Kind])
+      continue;
+    if (!OS.str().empty())
+      OS << ", ";
+    OS << Counts[Kind] << " " << getKindName(Kind);
+  }
+  return OS.str();
+}
+
+/***********************************************************************
+ * runOnFunction : peel each innermost loop with unaligned SVM streams
+ */
+bool CMSVMAlignPeel::runOnFunction(Function &F) {
+  if (!EnableCMSVMAlignPeel || skipFunction(F))
+    return false;
+  LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+  SE = &getAnalysis<ScalarEvolutionWrapperPass>().getSE();
+  DL = &F.getParent()->getDataLayout();
+
+  SmallVector<Loop *, 8> Worklist;
+  SmallVector<Loop *, 8> Innermost;
+  for (Loop *Lp : LI)
+    Worklist.push_back(Lp);
+  while (!Worklist.empty()) {
+    Loop *Lp = Worklist.pop_back_val();
+    if (Lp->empty())
+      Innermost.push_back(Lp);
+    Worklist.append(Lp->begin(), Lp->end());
+  }
+
+  OptimizationRemarkEmitter ORE(&F);
+  bool Modified = false;
+  for (Loop *Lp : Innermost) {
+    L = Lp;
+    NumLanes = 0;
+    EltTy = nullptr;
+    Streams.clear();
+    LaneWiseMemo.clear();
+    Reason.clear();
+    // Only loops with an unaligned stream are of interest, or worth a
+    // remark.
+    bool HasUnaligned = false;
+    for (Instruction &I : *L->getHeader()) {
+      unsigned IID = getIntrinsicID(&I);
+      HasUnaligned |= IID == Intrinsic::genx_svm_block_ld_unaligned ||
+                      IID == Intrinsic::genx_svm_gather ||
+                      IID == Intrinsic::genx_svm_scatter;
+    }
+    if (!HasUnaligned)
+      continue;
+    BasicBlock *Header = L->getHeader();
+    DebugLoc Loc = L->getStartLoc();
+    if (!analyze()) {
+      DEBUG(dbgs() << "CMSVMAlignPeel: " << Reason << "\n");
+      ORE.emit([&]() {
+        return OptimizationRemarkMissed(DEBUG_TYPE, "NotPeeled", Loc, Header)
+               << "loop not peeled for SVM alignment: " << Reason;
+      });
+      continue;
+    }
+    unsigned Counts[3][MK_NumKinds] = {};
+    peel(Counts);
+    SE->forgetLoop(L);
+    ORE.emit([&]() {
+      return OptimizationRemark(DEBUG_TYPE, "Peeled", Loc, Header)
+             << "peeled loop for SVM alignment: prologue {"
+             << describeMessages(Counts[0]) << "}, steady state {"
+             << describeMessages(Counts[1]) << "}, epilogue {"
+             << describeMessages(Counts[2]) << "}";
+    });
+    ++NumPeeled;
+    Modified = true;
+  }
+  return Modified;
+}
+
+/***********************************************************************
+ * reject : record why the loop is not peeled
+ *
+ * Return:  false, so that a check can "return reject(...)"
+ */
+bool CMSVMAlignPeel::reject(const Twine &Msg) {
+  if (Reason.empty())
+    Reason = Msg.str();
+  return false;
+}
+
+/***********************************************************************
+ * analyze : check the loop can be peeled, and collect its streams
+ */
+bool CMSVMAlignPeel::analyze() {
+  BasicBlock *Header = L->getHeader();
+  if (L->getNumBlocks() != 1)
+    return reject("loop body contains control flow");
+  BasicBlock *Preheader = L->getLoopPreheader();
+  BasicBlock *Exit = L->getUniqueExitBlock();
+  if (!Preheader || !Exit || !L->hasDedicatedExits() ||
+      !isa<BranchInst>(Preheader->getTerminator()) ||
+      isa<PHINode>(Exit->front()))
+    return reject("loop is not in simplified form");
+  auto Br = dyn_cast<BranchInst>(Header->getTerminator());
+  if (!Br || !Br->isConditional())
+    return reject("loop is not in simplified form");
+  const SCEV *BTC = SE->getBackedgeTakenCount(L);
+  if (isa<SCEVCouldNotCompute>(BTC) || !SE->isLoopInvariant(BTC, L))
+    return reject("trip count cannot be computed");
+
+  for (PHINode &Phi : Header->phis()) {
+    auto AR = dyn_cast<SCEVAddRecExpr>(SE->getSCEV(&Phi));
+    if (!Phi.getType()->isIntegerTy() || !AR || AR->getLoop() != L ||
+        !AR->isAffine())
+      return reject("loop-carried value is not an induction variable");
+  }
+  for (Instruction &I : *Header) {
+    for (User *U : I.users())
+      if (cast<Instruction>(U)->getParent() != Header)
+        return reject("a value computed in the loop is used after it");
+    if (isa<TerminatorInst>(&I) || isa<DbgInfoIntrinsic>(&I))
+      continue;
+    if (auto CI = dyn_cast<CallInst>(&I)) {
+      if (isSVMAccess(getIntrinsicID(CI))) {
+        if (!addStream(CI))
+          return false;
+        continue;
+      }
+    }
+    if (I.mayHaveSideEffects() || I.mayReadFromMemory())
+      return reject("loop body accesses memory other than SVM streams");
+  }
+
+  // The first unaligned stream is the anchor that the steady state aligns.
+  const Stream *Anchor = nullptr;
+  for (auto &S : Streams)
+    if (!S.WasAligned) {
+      Anchor = &S;
+      break;
+    }
+  if (!Anchor)
+    return reject("loop has no unaligned SVM stream");
+  for (auto &S : Streams) {
+    auto Dist = dyn_cast<SCEVConstant>(SE->getMinusSCEV(S.Start,
+                                                        Anchor->Start));
+    S.CoAligned = Dist && Dist->getAPInt().getSExtValue() % 16 == 0;
+    if (S.WasAligned && S.CoAligned)
+      return reject("unaligned stream is at the same alignment as an aligned "
+                    "block access, so is aligned already");
+    if (S.WasAligned)
+      return reject("aligned block access is not at the same alignment as "
+                    "the unaligned stream");
+  }
+  // A write must not overlap another stream at a different offset, as the
+  // order of the accesses changes.
+  for (auto &W : Streams) {
+    if (!W.IsWrite)
+      continue;
+    for (auto &S : Streams) {
+      if (&S == &W)
+        continue;
+      auto Dist = dyn_cast<SCEVConstant>(SE->getMinusSCEV(S.Start, W.Start));
+      if (!Dist && !CMSVMAlignPeelAssumeNoAlias)
+        return reject("SVM write may overlap a stream with a different base");
+      if (Dist && !Dist->isZero())
+        return reject("SVM write may overlap another stream");
+    }
+  }
+  // The data written must be computed lane by lane.
+  for (auto &S : Streams) {
+    if (!S.IsWrite)
+      continue;
+    Value *Data = S.CI->getArgOperand(S.IsBlock ? 1 : 3);
+    if (!isLaneWise(Data))
+      return false;
+  }
+  return true;
+}
+
+/***********************************************************************
+ * addStream : add an SVM access to the streams, if it is one
+ */
+bool CMSVMAlignPeel::addStream(CallInst *CI) {
+  Stream S;
+  S.CI = CI;
+  unsigned IID = getIntrinsicID(CI);
+  Type *DataTy = CI->getType();
+  switch (IID) {
+  case Intrinsic::genx_svm_block_ld:
+    S.WasAligned = true;
+    LLVM_FALLTHROUGH;
+  case Intrinsic::genx_svm_block_ld_unaligned:
+    S.IsBlock = true;
+    S.Addr = CI->getArgOperand(0);
+    break;
+  case Intrinsic::genx_svm_block_st:
+    S.IsBlock = S.IsWrite = S.WasAligned = true;
+    S.Addr = CI->getArgOperand(0);
+    DataTy = CI->getArgOperand(1)->getType();
+    break;
+  default: {
+    // svm_gather or svm_scatter of one dword per lane, unpredicated, with
+    // addresses splat(X) + <c, c+4, c+8, ...>.
+    S.IsWrite = IID == Intrinsic::genx_svm_scatter;
+    if (S.IsWrite)
+      DataTy = CI->getArgOperand(3)->getType();
+    auto Pred = dyn_cast<Constant>(CI->getArgOperand(0));
+    auto NumBlocks = dyn_cast<ConstantInt>(CI->getArgOperand(1));
+    if (!Pred || !Pred->isAllOnesValue() || !NumBlocks ||
+        !NumBlocks->isZero())
+      return reject("scattered SVM access is predicated or not of dwords");
+    auto Add = dyn_cast<BinaryOperator>(CI->getArgOperand(2));
+    if (!Add || Add->getOpcode() != Instruction::Add)
+      return reject("scattered SVM addresses are not contiguous");
+    for (unsigned Idx = 0; Idx != 2 && !S.Addr; ++Idx) {
+      auto Offsets = dyn_cast<ConstantDataVector>(Add->getOperand(1 - Idx));
+      auto Splat = getSplatValue(Add->getOperand(Idx));
+      if (!Offsets || !Splat)
+        continue;
+      int64_t First = Offsets->getElementAsAPInt(0).getSExtValue();
+      bool Contiguous = true;
+      for (unsigned Lane = 1, E = Offsets->getNumElements(); Lane != E; ++Lane)
+        Contiguous &= Offsets->getElementAsAPInt(Lane).getSExtValue() ==
+                      First + 4 * Lane;
+      if (Contiguous) {
+        S.Addr = const_cast<Value *>(Splat);
+        S.LaneOffset = First;
+      }
+    }
+    if (!S.Addr)
+      return reject("scattered SVM addresses are not contiguous");
+    break;
+  }
+  }
+  auto VT = dyn_cast<VectorType>(DataTy);
+  if (!VT || VT->getScalarSizeInBits() != 32 ||
+      (VT->getNumElements() != 8 && VT->getNumElements() != 16))
+    return reject("SVM stream is not 8 or 16 dwords wide");
+  if (NumLanes && (VT->getNumElements() != NumLanes ||
+                   VT->getElementType() != EltTy))
+    return reject("SVM streams are of different widths or types");
+  NumLanes = VT->getNumElements();
+  EltTy = VT->getElementType();
+
+  const SCEV *Addr = SE->getSCEV(S.Addr);
+  if (!Addr->getType()->isIntegerTy(64))
+    return reject("SVM address is not 64 bit");
+  auto AR = dyn_cast<SCEVAddRecExpr>(
+      SE->getAddExpr(Addr, SE->getConstant(Addr->getType(), S.LaneOffset,
+                                           /*isSigned=*/true)));
+  if (!AR || AR->getLoop() != L || !AR->isAffine())
+    return reject("SVM address is not a linear function of the induction "
+                  "variable");
+  auto Step = dyn_cast<SCEVConstant>(AR->getStepRecurrence(*SE));
+  if (!Step || Step->getAPInt().getSExtValue() != 4 * (int64_t)NumLanes)
+    return reject("SVM stream does not move on by its own size each "
+                  "iteration");
+  S.Start = AR->getStart();
+  Streams.push_back(S);
+  return true;
+}
+
+/***********************************************************************
+ * isLaneWise : check lane i of a value only depends on lane i of the
+ *              streams read in the same iteration
+ */
+bool CMSVMAlignPeel::isLaneWise(Value *V) {
+  auto It = LaneWiseMemo.find(V);
+  if (It != LaneWiseMemo.end())
+    return It->second;
+  LaneWiseMemo[V] = false;
+  bool Ok = checkLaneWise(V);
+  LaneWiseMemo[V] = Ok;
+  return Ok;
+}
+
+bool CMSVMAlignPeel::checkLaneWise(Value *V) {
+  auto VT = dyn_cast<VectorType>(V->getType());
+  if (!VT || VT->getNumElements() != NumLanes)
+    return reject("data written is not a vector of the stream width");
+  if (isa<UndefValue>(V) || isSplat(V))
+    return true;
+  auto Inst = dyn_cast<Instruction>(V);
+  if (!Inst || !L->contains(Inst))
+    return reject("data written uses a loop-invariant vector that is not a "
+                  "splat");
+  for (auto &S : Streams)
+    if (S.CI == Inst && !S.IsWrite)
+      return true;
+  unsigned IID = getIntrinsicID(Inst);
+  if (IID == Intrinsic::genx_rdregioni || IID == Intrinsic::genx_rdregionf) {
+    Value *Input = Inst->getOperand(Intrinsic::GenXRegion::OldValueOperandNum);
+    CMRegion R(Inst);
+    if (R.Indirect || R.Offset || R.Stride != 1 || R.Width != NumLanes ||
+        Input->getType()->getVectorNumElements() != NumLanes)
+      return reject("data written is shuffled between lanes");
+    return isLaneWise(Input);
+  }
+  if (IID == Intrinsic::genx_wrregioni || IID == Intrinsic::genx_wrregionf) {
+    CMRegion R(Inst);
+    if (R.Indirect || R.Mask || R.Offset || R.Stride != 1 ||
+        R.NumElements != NumLanes || R.Width != NumLanes)
+      return reject("data written is shuffled between lanes");
+    return isLaneWise(
+        Inst->getOperand(Intrinsic::GenXRegion::NewValueOperandNum));
+  }
+  if (auto Sel = dyn_cast<SelectInst>(Inst)) {
+    Value *Cond = Sel->getCondition();
+    if (!Cond->getType()->isVectorTy() && !L->isLoopInvariant(Cond))
+      return reject("data written depends on the iteration");
+    if (Cond->getType()->isVectorTy() && !isLaneWise(Cond))
+      return false;
+    return isLaneWise(Sel->getTrueValue()) && isLaneWise(Sel->getFalseValue());
+  }
+  if (isa<BinaryOperator>(Inst) || isa<CmpInst>(Inst) ||
+      (isa<CastInst>(Inst) && Inst->getOperand(0)->getType()->isVectorTy())) {
+    for (Value *Opnd : Inst->operands())
+      if (!isLaneWise(Opnd))
+        return false;
+    return true;
+  }
+  return reject("data written is computed by an instruction that is not "
+                "element-wise");
+}
+
+/***********************************************************************
+ * isSplat : check a value is the same loop-invariant value in every lane
+ */
+bool CMSVMAlignPeel::isSplat(Value *V) {
+  if (auto C = dyn_cast<Constant>(V))
+    return C->getSplatValue();
+  if (auto Splat = getSplatValue(V))
+    return L->isLoopInvariant(Splat);
+  unsigned IID = getIntrinsicID(V);
+  if (IID != Intrinsic::genx_rdregioni && IID != Intrinsic::genx_rdregionf)
+    return false;
+  auto Inst = cast<Instruction>(V);
+  CMRegion R(Inst);
+  return !R.Indirect && R.isScalar() &&
+         L->isLoopInvariant(
+             Inst->getOperand(Intrinsic::GenXRegion::OldValueOperandNum));
+}
+
+/***********************************************************************
+ * getLaneOffsets : get the constant <0, 4, 8, ...> of the given type
+ */
+Value *CMSVMAlignPeel::getLaneOffsets(Type *Ty) {
+  SmallVector<Constant *, 16> Offsets;
+  for (unsigned Lane = 0; Lane != NumLanes; ++Lane)
+    Offsets.push_back(ConstantInt::get(Ty, 4 * Lane));
+  return ConstantVector::get(Offsets);
+}
+
+/***********************************************************************
+ * getLaneAddrs : get the address vector of a stream in a cloned body,
+ *                moved on by Shift bytes
+ *
+ * Enter:   Addr = the cloned scalar address of a block message, or the
+ *                 cloned address vector of a gather or scatter
+ */
+Value *CMSVMAlignPeel::getLaneAddrs(IRBuilder<> &B, const Stream &S,
+                                    Value *Addr, Value *Shift) {
+  if (!S.IsBlock)
+    return B.CreateAdd(Addr, B.CreateVectorSplat(NumLanes, Shift),
+                       "svmpeel.addrs");
+  Value *Base = B.CreateAdd(Addr, Shift, "svmpeel.base");
+  return B.CreateAdd(B.CreateVectorSplat(NumLanes, Base),
+                     getLaneOffsets(Base->getType()), "svmpeel.addrs");
+}
+
+/***********************************************************************
+ * emitPartial : emit one run of the loop body on the first Count lanes
+ *
+ * Enter:   BB = empty block to emit into, ending in its branch
+ *          VMap = map from the header phis to their values in this run
+ *          Shift = bytes to add to each stream address
+ *          Count = i32 number of lanes to access
+ *          Counts = message counts to fill in for the remark
+ *
+ * Every stream becomes a gather or scatter predicated on lane < Count.
+ */
+void CMSVMAlignPeel::emitPartial(BasicBlock *BB, ValueToValueMapTy &VMap,
+                                 Value *Shift, Value *Count,
+                                 unsigned *Counts) {
+  BasicBlock *Header = L->getHeader();
+  Instruction *InsertPt = BB->getTerminator();
+  SmallVector<Instruction *, 32> Cloned;
+  for (Instruction &I : *Header) {
+    if (isa<PHINode>(&I) || isa<TerminatorInst>(&I))
+      continue;
+    Instruction *New = I.clone();
+    if (I.hasName())
+      New->setName(I.getName() + ".svmpeel");
+    New->insertBefore(InsertPt);
+    VMap[&I] = New;
+    Cloned.push_back(New);
+  }
+  for (Instruction *New : Cloned)
+    RemapInstruction(New, VMap,
+                     RF_NoModuleLevelChanges | RF_IgnoreMissingLocals);
+
+  Module *M = Header->getModule();
+  IRBuilder<> B(InsertPt);
+  SmallVector<Constant *, 16> Lanes;
+  for (unsigned Lane = 0; Lane != NumLanes; ++Lane)
+    Lanes.push_back(B.getInt32(Lane));
+  Value *Pred = B.CreateICmpULT(ConstantVector::get(Lanes),
+                                B.CreateVectorSplat(NumLanes, Count),
+                                "svmpeel.pred");
+  Type *DataTy = VectorType::get(EltTy, NumLanes);
+  for (auto &S : Streams) {
+    Value *Mapped = VMap[S.CI];
+    auto CI = cast<CallInst>(Mapped);
+    B.SetInsertPoint(CI);
+    Value *Addrs = getLaneAddrs(B, S, CI->getArgOperand(S.IsBlock ? 0 : 2),
+                                Shift);
+    if (S.IsWrite) {
+      Value *Data = CI->getArgOperand(S.IsBlock ? 1 : 3);
+      Type *Tys[] = {Pred->getType(), Addrs->getType(), DataTy};
+      Function *Decl = Intrinsic::getDeclaration(
+          M, Intrinsic::genx_svm_scatter, Tys);
+      Value *Args[] = {Pred, B.getInt32(0), Addrs, Data};
+      B.CreateCall(Decl, Args)->setDebugLoc(CI->getDebugLoc());
+      ++Counts[MK_Scatter];
+    } else {
+      Type *Tys[] = {DataTy, Pred->getType(), Addrs->getType()};
+      Function *Decl = Intrinsic::getDeclaration(
+          M, Intrinsic::genx_svm_gather, Tys);
+      Value *Args[] = {Pred, B.getInt32(0), Addrs, UndefValue::get(DataTy)};
+      CallInst *Gather = B.CreateCall(Decl, Args, "svmpeel.gather");
+      Gather->setDebugLoc(CI->getDebugLoc());
+      CI->replaceAllUsesWith(Gather);
+      ++Counts[MK_Gather];
+    }
+    CI->eraseFromParent();
+  }
+}
+
+/***********************************************************************
+ * peel : peel the loop into prologue, aligned steady state and epilogue
+ *
+ * Enter:   Counts = message counts to fill in for the remark, for the
+ *                   prologue, steady state and epilogue
+ *
+ * The control flow becomes:
+ *
+ *   preheader:  h = dwords to the next oword boundary of the anchor
+ *               br h != 0, prologue, guard
+ *   prologue:   body on lanes < h; br guard
+ *   guard:      br N - (h != 0) == 0, tailcheck, header
+ *   header:     body h dwords on, with aligned streams; br ..., tailcheck
+ *   tailcheck:  br h != 0, epilogue, exit
+ *   epilogue:   body on lanes < 8 - h (or 16 - h); br exit
+ */
+void CMSVMAlignPeel::peel(unsigned Counts[3][MK_NumKinds]) {
+  BasicBlock *Header = L->getHeader();
+  BasicBlock *Preheader = L->getLoopPreheader();
+  BasicBlock *Exit = L->getUniqueExitBlock();
+  Function *F = Header->getParent();
+  Module *M = F->getParent();
+  LLVMContext &Ctx = M->getContext();
+  auto Br = cast<BranchInst>(Header->getTerminator());
+  bool ExitOnTrue = Br->getSuccessor(0) == Exit;
+  DebugLoc Loc = Br->getDebugLoc();
+
+  // Everything the new blocks need from SCEV is expanded in the preheader
+  // while the loop is still intact.
+  SCEVExpander Expander(*SE, *DL, "svmpeel");
+  Instruction *PreTerm = Preheader->getTerminator();
+  const SCEV *BTC = SE->getBackedgeTakenCount(L);
+  Type *CountTy = BTC->getType();
+  Value *NumIters = Expander.expandCodeFor(
+      SE->getAddExpr(BTC, SE->getOne(CountTy)), CountTy, PreTerm);
+  const Stream *Anchor = nullptr;
+  for (auto &S : Streams)
+    if (!S.WasAligned && !Anchor)
+      Anchor = &S;
+  Type *I64Ty = Type::getInt64Ty(Ctx);
+  Value *AnchorStart = Expander.expandCodeFor(Anchor->Start, I64Ty, PreTerm);
+  DenseMap<PHINode *, Value *> Steps;
+  for (PHINode &Phi : Header->phis()) {
+    auto AR = cast<SCEVAddRecExpr>(SE->getSCEV(&Phi));
+    Steps[&Phi] = Expander.expandCodeFor(AR->getStepRecurrence(*SE),
+                                         Phi.getType(), PreTerm);
+  }
+
+  IRBuilder<> B(PreTerm);
+  // h = ((-start) & 15) >> 2, the dwords up to the next oword boundary.
+  Value *Head = B.CreateLShr(B.CreateAnd(B.CreateNeg(AnchorStart), 15), 2,
+                             "svmpeel.head");
+  Value *Shift = B.CreateShl(Head, 2, "svmpeel.shift");
+  Value *HasHead = B.CreateICmpNE(Head, B.getInt64(0), "svmpeel.hashead");
+  Value *HeadLanes = B.CreateTrunc(Head, B.getInt32Ty());
+  Value *TailLanes = B.CreateSub(B.getInt32(NumLanes), HeadLanes);
+  Value *SteadyIters = B.CreateSub(NumIters,
+                                   B.CreateZExt(HasHead, CountTy),
+                                   "svmpeel.iters");
+
+  // Create the new blocks.
+  BasicBlock *Prologue = BasicBlock::Create(Ctx, "svmpeel.prologue", F,
+                                            Header);
+  BasicBlock *Guard = BasicBlock::Create(Ctx, "svmpeel.guard", F, Header);
+  BasicBlock *TailCheck = BasicBlock::Create(Ctx, "svmpeel.tailcheck", F,
+                                             Exit);
+  BasicBlock *Epilogue = BasicBlock::Create(Ctx, "svmpeel.epilogue", F,
+                                            Exit);
+  BranchInst::Create(Guard, Prologue)->setDebugLoc(Loc);
+  B.SetInsertPoint(Guard);
+  B.CreateCondBr(B.CreateICmpEQ(SteadyIters,
+                                ConstantInt::get(CountTy, 0)),
+                 TailCheck, Header);
+  B.SetInsertPoint(TailCheck);
+  B.CreateCondBr(HasHead, Epilogue, Exit);
+  BranchInst::Create(Exit, Epilogue)->setDebugLoc(Loc);
+  PreTerm->eraseFromParent();
+  B.SetInsertPoint(Preheader);
+  B.CreateCondBr(HasHead, Prologue, Guard);
+
+  // The prologue runs the first iteration on the head lanes.
+  {
+    ValueToValueMapTy VMap;
+    for (PHINode &Phi : Header->phis())
+      VMap[&Phi] = Phi.getIncomingValueForBlock(Preheader);
+    emitPartial(Prologue, VMap, B.getInt64(0), HeadLanes, Counts[0]);
+  }
+  // The epilogue runs the iteration after the last steady-state one on the
+  // tail lanes, h dwords on.
+  {
+    ValueToValueMapTy VMap;
+    IRBuilder<> EB(Epilogue->getTerminator());
+    for (PHINode &Phi : Header->phis()) {
+      Value *Iters = EB.CreateZExtOrTrunc(SteadyIters, Phi.getType());
+      VMap[&Phi] = EB.CreateAdd(Phi.getIncomingValueForBlock(Preheader),
+                                EB.CreateMul(Iters, Steps[&Phi]),
+                                Phi.getName() + ".svmpeel");
+    }
+    emitPartial(Epilogue, VMap, Shift, TailLanes, Counts[2]);
+  }
+
+  // The loop is now entered from the guard, leaves to the tail check, and
+  // runs SteadyIters times.
+  for (PHINode &Phi : Header->phis())
+    Phi.setIncomingBlock(Phi.getBasicBlockIndex(Preheader), Guard);
+  Br->setSuccessor(ExitOnTrue ? 0 : 1, TailCheck);
+  B.SetInsertPoint(&*Header->getFirstInsertionPt());
+  PHINode *Iter = B.CreatePHI(CountTy, 2, "svmpeel.iter");
+  B.SetInsertPoint(Br);
+  Value *NextIter = B.CreateAdd(Iter, ConstantInt::get(CountTy, 1),
+                                "svmpeel.iter.next");
+  Iter->addIncoming(ConstantInt::get(CountTy, 0), Guard);
+  Iter->addIncoming(NextIter, Header);
+  Br->setCondition(ExitOnTrue ? B.CreateICmpEQ(NextIter, SteadyIters)
+                              : B.CreateICmpNE(NextIter, SteadyIters));
+
+  // Move each stream on by the shift, with aligned messages for those
+  // co-aligned with the anchor.
+  for (auto &S : Streams) {
+    CallInst *CI = S.CI;
+    B.SetInsertPoint(CI);
+    if (!S.IsBlock && !S.CoAligned) {
+      // A gather or scatter that stays one, on shifted addresses.
+      CI->setArgOperand(2, B.CreateAdd(CI->getArgOperand(2),
+                                       B.CreateVectorSplat(NumLanes, Shift),
+                                       "svmpeel.addrs"));
+      ++Counts[1][S.IsWrite ? MK_Scatter : MK_Gather];
+      continue;
+    }
+    Value *Addr = S.Addr;
+    if (S.LaneOffset)
+      Addr = B.CreateAdd(Addr, B.getInt64(S.LaneOffset));
+    Addr = B.CreateAdd(Addr, Shift, "svmpeel.base");
+    Value *New = nullptr;
+    if (S.CoAligned && S.IsWrite) {
+      Value *Data = CI->getArgOperand(S.IsBlock ? 1 : 3);
+      Function *Decl = Intrinsic::getDeclaration(
+          M, Intrinsic::genx_svm_block_st, Data->getType());
+      Value *Args[] = {Addr, Data};
+      New = B.CreateCall(Decl, Args);
+      ++Counts[1][MK_AlignedWrite];
+    } else if (S.CoAligned) {
+      Function *Decl = Intrinsic::getDeclaration(
+          M, Intrinsic::genx_svm_block_ld, CI->getType());
+      New = B.CreateCall(Decl, Addr, CI->getName());
+      ++Counts[1][MK_AlignedRead];
+    } else {
+      Function *Decl = Intrinsic::getDeclaration(
+          M, Intrinsic::genx_svm_block_ld_unaligned, CI->getType());
+      New = B.CreateCall(Decl, Addr, CI->getName());
+      ++Counts[1][MK_UnalignedRead];
+    }
+    cast<CallInst>(New)->setDebugLoc(CI->getDebugLoc());
+    if (!S.IsWrite)
+      CI->replaceAllUsesWith(New);
+    CI->eraseFromParent();
+  }
+}
@@ -75,6 +75,14 @@
 /// 1. Find the SIMD branches, ones where Clang codegen has used
 ///    ``llvm.genx.simdcf.any``.
 ///
+///    Before that, a SIMD branch whose predicate is provably the same in every
+///    channel is turned into a scalar branch, so it needs no goto/join and the
+///    code it controls needs no predication. That is a predicate built from
+///    constants and splatted scalars (scalars are uniform across the channels
+///    of a thread), or a comparison that folds to a constant, such as a range
+///    check that cannot fail. A local variable written by a single dominating
+///    store is looked through, as nothing has been promoted to registers yet.
+///
 /// 2. Determine which basic blocks need to be predicated. Any block that is
 ///    *control dependent* on a SIMD branch needs to be predicated. See Muchnick
 ///    section 9.5 *Program-Dependence Graphs*. For each edge m->n in the
@@ -166,11 +174,16 @@
 #define DEBUG_TYPE "cmsimdcflowering"
 
 #include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/Analysis/ConstantFolding.h"
+#include "llvm/Analysis/InstructionSimplify.h"
 #include "llvm/Analysis/PostDominators.h"
+#include "llvm/Analysis/VectorUtils.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DebugInfo.h"
 #include "llvm/IR/DiagnosticInfo.h"
 #include "llvm/IR/DiagnosticPrinter.h"
+#include "llvm/IR/Dominators.h"
 #include "llvm/IR/GlobalVariable.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Intrinsics.h"
@@ -252,7 +265,9 @@ int DiagnosticInfoSimdCF::KindID = 0;
 struct CGNode {
   Function *F;
   std::set<CGNode *> UnvisitedCallers;
-  std::set<CGNode *> Callees;
+  // In call order, so that the visit order does not depend on where the
+  // nodes were allocated.
+  SetVector<CGNode *> Callees;
 };
 
 // The ISPC SIMD CF lowering pass (a module pass)
@@ -472,6 +487,8 @@ void CMSimdCFLower::processFunction(Function *ArgF)
   DEBUG(dbgs() << "CMSimdCFLowering::processFunction:\n" << *F << "\n");
   DEBUG(F->print(dbgs()));
   unsigned CMWidth = PredicatedSubroutines[F];
+  // Turn simd branches with a uniform condition into scalar branches.
+  foldUniformSimdBranches();
   // Find the simd branches.
   bool FoundSIMD = findSimdBranches(CMWidth);
   if (CMWidth > 0 || FoundSIMD) {
@@ -1095,6 +1112,132 @@ static bool isSingleBlockLocalStore(const Instruction *SI)
   return false;
 }
 
+/***********************************************************************
+ * getLocalStoredValue : look through a load of a local variable that is
+ *    written by a single store dominating the load
+ *
+ * Return:  the stored value, else V itself
+ */
+static Value *getLocalStoredValue(Value *V, const DominatorTree &DT)
+{
+  auto LI = dyn_cast<LoadInst>(V);
+  if (!LI || LI->isVolatile())
+    return V;
+  auto AI = dyn_cast<AllocaInst>(LI->getPointerOperand());
+  if (!AI)
+    return V;
+  StoreInst *Store = nullptr;
+  for (auto U : AI->users()) {
+    if (isa<LoadInst>(U) || IsBitCastForLifetimeMark(U))
+      continue;
+    auto SI = dyn_cast<StoreInst>(U);
+    if (!SI || Store || SI->getPointerOperand() != AI)
+      return V;
+    Store = SI;
+  }
+  if (!Store || Store->getValueOperand()->getType() != LI->getType() ||
+      !DT.dominates(Store, LI))
+    return V;
+  return Store->getValueOperand();
+}
+
+/***********************************************************************
+ * getUniformScalar : see if a vector value is the same in every channel
+ *
+ * Enter:   V = the vector value
+ *          DT = dominator tree, for looking through local variables
+ *          Builder = where to create the scalar equivalent, or nullptr to
+ *              just check
+ *          Depth = recursion depth
+ *
+ * Return:  nullptr if V is not provably uniform, else the scalar equivalent
+ *          (or, if Builder is nullptr, any non-null value)
+ */
+static Value *getUniformScalar(Value *V, const DominatorTree &DT,
+    IRBuilder<> *Builder, unsigned Depth = 0)
+{
+  const unsigned MaxDepth = 8;
+  if (Depth > MaxDepth || !V->getType()->isVectorTy())
+    return nullptr;
+  V = getLocalStoredValue(V, DT);
+  Value *Splat = nullptr;
+  if (auto C = dyn_cast<Constant>(V))
+    Splat = C->getSplatValue();
+  else
+    Splat = const_cast<Value *>(getSplatValue(V));
+  if (Splat)
+    return Builder ? Splat : V;
+  auto Inst = dyn_cast<Instruction>(V);
+  if (!Inst)
+    return nullptr;
+  if (auto Cmp = dyn_cast<CmpInst>(Inst)) {
+    // A comparison that gives the same answer in every channel, such as a
+    // range check that cannot fail.
+    SimplifyQuery Q(Inst->getModule()->getDataLayout());
+    Value *LHS = getLocalStoredValue(Cmp->getOperand(0), DT);
+    Value *RHS = getLocalStoredValue(Cmp->getOperand(1), DT);
+    if (auto C = dyn_cast_or_null<Constant>(
+          SimplifyCmpInst(Cmp->getPredicate(), LHS, RHS, Q)))
+      return getUniformScalar(C, DT, Builder, Depth + 1);
+  } else if (!isa<BinaryOperator>(Inst) && !isa<CastInst>(Inst))
+    return nullptr;
+  // A bitcast is elementwise only between vectors of the same length.
+  if (isa<BitCastInst>(Inst) &&
+      (!Inst->getOperand(0)->getType()->isVectorTy() ||
+       Inst->getOperand(0)->getType()->getVectorNumElements() !=
+           V->getType()->getVectorNumElements()))
+    return nullptr;
+  // An elementwise operation on uniform operands is uniform.
+  for (Value *Op : Inst->operands())
+    if (!getUniformScalar(Op, DT, nullptr, Depth + 1))
+      return nullptr;
+  if (!Builder)
+    return V;
+  Instruction *Scalar = Inst->clone();
+  Scalar->mutateType(V->getType()->getScalarType());
+  for (unsigned i = 0, e = Inst->getNumOperands(); i != e; ++i)
+    Scalar->setOperand(i,
+        getUniformScalar(Inst->getOperand(i), DT, Builder, Depth + 1));
+  Builder->Insert(Scalar, Inst->getName() + ".uniform");
+  if (auto C = ConstantFoldInstruction(Scalar,
+        Inst->getModule()->getDataLayout())) {
+    Scalar->eraseFromParent();
+    return C;
+  }
+  return Scalar;
+}
+
+/***********************************************************************
+ * foldUniformSimdBranches : turn each simd branch whose predicate is the
+ *    same in every channel into a scalar branch
+ *
+ * Such a branch goes the same way for every enabled channel, so it does not
+ * need a goto/join and does not cause the code it controls to be predicated.
+ * If the branch is itself inside simd control flow, markPredicatedBranches
+ * turns it back into a simd branch on a splat, as for any other scalar branch.
+ */
+bool CMSimdCFLower::foldUniformSimdBranches()
+{
+  bool Changed = false;
+  DominatorTree DT(*F);
+  for (auto fi = F->begin(), fe = F->end(); fi != fe; ++fi) {
+    BasicBlock *BB = &*fi;
+    auto Br = dyn_cast<BranchInst>(BB->getTerminator());
+    if (!Br || !Br->isConditional())
+      continue;
+    auto Any = isSimdCFAny(Br->getCondition());
+    if (!Any || !getUniformScalar(Any->getArgOperand(0), DT, nullptr))
+      continue;
+    DEBUG(dbgs() << BB->getName() << ": uniform simd branch\n");
+    IRBuilder<> Builder(Br);
+    Br->setCondition(getUniformScalar(Any->getArgOperand(0), DT, &Builder));
+    if (Any->use_empty())
+      Any->eraseFromParent();
+    Changed = true;
+  }
+  return Changed;
+}
+
 /***********************************************************************
  * predicateStore : add predication to a StoreInst
  *
@@ -36,6 +36,10 @@ void llvm::initializeScalarOpts(PassRegistry &Registry) {
   initializeCMImpParamPass(Registry);
   initializeCMKernelArgOffsetPass(Registry);
   initializeCMABIPass(Registry);
+  initializeCMLoopVectorizePass(Registry);
+  initializeCMSVMAlignPeelPass(Registry);
+  initializeCMSLMStagingPass(Registry);
+  initializeCMKernelVariantsPass(Registry);
   initializeADCELegacyPassPass(Registry);
   initializeBDCELegacyPassPass(Registry);
   initializeAlignmentFromAssumptionsPass(Registry);
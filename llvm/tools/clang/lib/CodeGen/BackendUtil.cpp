@@ -233,6 +233,26 @@ static void addCMLowerLoadStorePass(const PassManagerBuilder &Builder,
   PM.add(createCMLowerLoadStorePass());
 }
 
+static void addCMLoopVectorizePass(const PassManagerBuilder &Builder,
+                                   PassManagerBase &PM) {
+  PM.add(createCMLoopVectorizePass());
+}
+
+static void addCMSVMAlignPeelPass(const PassManagerBuilder &Builder,
+                                  PassManagerBase &PM) {
+  PM.add(createCMSVMAlignPeelPass());
+}
+
+static void addCMSLMStagingPass(const PassManagerBuilder &Builder,
+                                PassManagerBase &PM) {
+  PM.add(createCMSLMStagingPass());
+}
+
+static void addCMKernelVariantsPass(const PassManagerBuilder &Builder,
+                                    PassManagerBase &PM) {
+  PM.add(createCMKernelVariantsPass());
+}
+
 static void addCMPacketizePass(const PassManagerBuilder &Builder,
   PassManagerBase &PM) {
   PM.add(createGenXPacketizePass());
@@ -673,6 +693,16 @@ void EmitAssemblyHelper::CreatePasses(legacy::PassManager &MPM,
   if (LangOpts.MdfCM) {
     PMBuilder.addExtension(PassManagerBuilder::EP_EarlyAsPossible,
                            addCMSimdCFLoweringPass);
+    PMBuilder.addExtension(PassManagerBuilder::EP_LateLoopOptimizations,
+                           addCMLoopVectorizePass);
+    PMBuilder.addExtension(PassManagerBuilder::EP_ScalarOptimizerLate,
+                           addCMSVMAlignPeelPass);
+    PMBuilder.addExtension(PassManagerBuilder::EP_ScalarOptimizerLate,
+                           addCMSLMStagingPass);
+    PMBuilder.addExtension(PassManagerBuilder::EP_ModuleOptimizerEarly,
+                           addCMKernelVariantsPass);
+    PMBuilder.addExtension(PassManagerBuilder::EP_EnabledOnOptLevel0,
+                           addCMKernelVariantsPass);
     PMBuilder.addExtension(PassManagerBuilder::EP_ModuleOptimizerEarly,
                            addCMPacketizePass);
     PMBuilder.addExtension(PassManagerBuilder::EP_EnabledOnOptLevel0,
@@ -0,0 +1,63 @@
+#include <cm/cm.h>
+
+// An atomic whose result is never used gets a null destination, as its
+// result allows one.
+
+_GENX_MAIN_ void atomic_no_result(SurfaceIndex S)
+{
+  vector<uint, 8> offs(0);
+  vector<uint, 8> src = 1;
+  write_atomic<ATOMIC_ADD>(S, offs, src);
+}
+
+// A raw send whose response is never used keeps its destination, as the
+// result of a raw send may not be null.
+
+_GENX_MAIN_ void raw_send_no_result(SurfaceIndex S)
+{
+  vector<uint, 8> rsp;
+  matrix<uint, 1, 8> payload = 0;
+  // A dataport untyped read of one register.
+  uint msgDesc = (1 << 25) + (1 << 20) + (1 << 19) + (0x5 << 14) + (0xe << 8);
+  cm_send(rsp, payload, 0xa, msgDesc, 0u);
+}
+
+// RUN: %cmc -Qxcm_jit_target=SKL %w 2>&1 | FileCheck -allow-empty -check-prefix=BUILD %w
+// RUN: FileCheck -input-file=%W_0.visaasm -check-prefix=ATOMIC %w
+// RUN: FileCheck -input-file=%W_1.visaasm -check-prefix=RAWSEND %w
+//
+// BUILD-NOT: error
+//
+// ATOMIC: dword_atomic.add{{.*}} {{V0|%null}}{{(\.0)?}}{{[[:space:]]*$}}
+//
+// RAWSEND-NOT: raw_send{{.*}} {{V0|%null}}{{(\.0)?}}{{[[:space:]]*$}}
+// RAWSEND: raw_send{{.*}} V{{[1-9][0-9]*}}{{(\.0)?}}{{[[:space:]]*$}}
+
+// tidy up the generated files
+// RUN: rm %W.isa %W_0.visaasm %W_0.asm %W_0.dat %W_1.visaasm %W_1.asm %W_1.dat
+
+// The histogram examples add each local histogram to the global one with
+// write_atomic, and never read the returned old values. All of their
+// atomics, 32 for 256 bins and 8 for 64 bins, must be no-return messages.
+// The examples are compiled in scratch directories, as both are called
+// histogram_genx.cpp.
+//
+// RUN: rm -rf %t.256 %t.64 && mkdir %t.256 %t.64
+// RUN: cp %S/../../../../../test/open_examples/histogram_256/histogram_genx.cpp %t.256
+// RUN: cp %S/../../../../../test/open_examples/histogram_64/histogram_genx.cpp %t.64
+// RUN: cd %t.256 && %cmc -Qxcm_jit_target=SKL histogram_genx.cpp 2>&1 | FileCheck -allow-empty -check-prefix=BUILD %w
+// RUN: cd %t.64 && %cmc -Qxcm_jit_target=SKL histogram_genx.cpp 2>&1 | FileCheck -allow-empty -check-prefix=BUILD %w
+//
+// RUN: FileCheck -input-file=%t.256/histogram_genx_0.visaasm -check-prefix=HIST %w
+// RUN: FileCheck -input-file=%t.64/histogram_genx_0.visaasm -check-prefix=HIST %w
+// RUN: grep -c -E 'dword_atomic\.add.* (V0|%null)(\.0)?[[:space:]]*$' %t.256/histogram_genx_0.visaasm | FileCheck -check-prefix=HIST256 %w
+// RUN: grep -c -E 'dword_atomic\.add.* (V0|%null)(\.0)?[[:space:]]*$' %t.64/histogram_genx_0.visaasm | FileCheck -check-prefix=HIST64 %w
+//
+// HIST-NOT: dword_atomic.add{{.*}} V{{[1-9][0-9]*}}{{(\.0)?}}{{[[:space:]]*$}}
+// HIST: dword_atomic.add{{.*}} {{V0|%null}}{{(\.0)?}}{{[[:space:]]*$}}
+// HIST-NOT: dword_atomic.add{{.*}} V{{[1-9][0-9]*}}{{(\.0)?}}{{[[:space:]]*$}}
+//
+// HIST256: {{^}}32{{$}}
+// HIST64: {{^}}8{{$}}
+//
+// RUN: rm -rf %t.256 %t.64
@@ -0,0 +1,48 @@
+#include <cm/cm.h>
+
+// A compile-time benchmark for GenX dead vector element removal: a fully
+// unrolled kernel with many wide vector values, of which only some elements
+// reach the output. The trip count is kept small so the default lit run
+// stays quick; define TRIPS to scale it up, and time the pass with
+//   cmc -Qxcm_jit_target=SKL -DTRIPS=1024 -mllvm -time-passes <this file>
+
+#ifndef TRIPS
+#define TRIPS 32
+#endif
+
+_GENX_MAIN_ void wide(SurfaceIndex S)
+{
+  matrix<int, 16, 16> m;
+  read(S, 0, 0, m.select<8, 1, 16, 1>(0, 0));
+  read(S, 0, 8, m.select<8, 1, 16, 1>(8, 0));
+  vector<int, 256> acc = 0;
+#pragma unroll
+  for (int i = 0; i < TRIPS; i++) {
+    vector<int, 256> t = m.format<int>() * (i + 1);
+    t.select<16, 1>((i % 16) * 16) += acc.select<16, 1>(((i * 7) % 16) * 16);
+    acc.select<128, 2>(i % 2) = t.select<128, 2>((i + 1) % 2);
+  }
+  write(S, 0, 0, acc.format<int, 16, 16>().select<8, 1, 16, 1>(0, 0));
+}
+
+// This only checks that the pass runs and is timed. No -time-passes numbers
+// for it have been taken yet, so any speedup of the pass is unvalidated.
+// RUN: %cmc -Qxcm_jit_target=SKL -mllvm -time-passes %w 2>&1 | FileCheck -implicit-check-not=error: %w
+//
+// CHECK: Pass execution timing report
+// CHECK: GenX dead vector element removal pass
+
+// The live sets are a fixpoint, so the order the work list is seeded in must
+// not change the code. Diff the vISA against a build that seeds it in
+// reverse.
+// RUN: cp %W_0.visaasm %t.ref.visaasm
+// RUN: %cmc -Qxcm_jit_target=SKL -mllvm -genx-dvr-reverse-worklist %w
+// RUN: diff %t.ref.visaasm %W_0.visaasm
+//
+// Check that the pass has work to do in this kernel: the vISA changes
+// without it.
+// RUN: %cmc -Qxcm_jit_target=SKL -mllvm -limit-genx-dead-vector-removal=0 %w
+// RUN: not diff %t.ref.visaasm %W_0.visaasm > /dev/null
+
+// tidy up the generated files
+// RUN: rm %W.isa %W_0.visaasm %W_0.asm %W_0.dat %t.ref.visaasm
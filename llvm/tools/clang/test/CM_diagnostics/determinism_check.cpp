@@ -0,0 +1,53 @@
+#include <cm/cm.h>
+
+// Compile the open examples with -genx-determinism-check, which compiles each
+// of them twice with a perturbed heap and fails if the two vISA files differ.
+// The examples are copied to a scratch directory, with the headers they
+// include, so that the output files do not land in the source tree.
+
+_GENX_MAIN_ void copy(SurfaceIndex In, SurfaceIndex Out)
+{
+  matrix<uchar, 8, 32> m;
+  read(In, 0, 0, m);
+  write(Out, 0, 0, m);
+}
+
+// RUN: %cmc -mllvm -genx-determinism-check %w 2>&1 | FileCheck %w
+// RUN: rm %W.isa
+
+// RUN: rm -rf %t.dir && mkdir %t.dir
+// RUN: cp %S/../../../../../test/open_examples/hello_world/hello_world_genx.cpp %t.dir
+// RUN: cp %S/../../../../../test/open_examples/linear_walker/linear_walker_genx.cpp %t.dir
+// RUN: cp %S/../../../../../test/open_examples/histogram_64/histogram_genx.cpp %t.dir
+// RUN: cp %S/../../../../../test/open_examples/BitonicSortK/BitonicSortK_genx.cpp %t.dir
+// RUN: cp %S/../../../../../test/open_examples/mandelbrot/mandelbrot_genx.cpp %t.dir
+// RUN: cp %S/../../../../../test/open_examples/matrix_transpose/matrix_transpose_genx.cpp %t.dir
+// RUN: cp %S/../../../../../test/open_examples/Sgemm/Sgemm_genx.cpp %S/../../../../../test/open_examples/Sgemm/share.h %t.dir
+// RUN: cp %S/../../../../../test/open_examples/PrefixSum/Prefix_genx.cpp %S/../../../../../test/open_examples/PrefixSum/Prefix.h %t.dir
+//
+// RUN: cd %t.dir && %cmc -mllvm -genx-determinism-check hello_world_genx.cpp 2>&1 | FileCheck %w
+// RUN: cd %t.dir && %cmc -mllvm -genx-determinism-check linear_walker_genx.cpp 2>&1 | FileCheck %w
+// RUN: cd %t.dir && %cmc -mllvm -genx-determinism-check histogram_genx.cpp 2>&1 | FileCheck %w
+// RUN: cd %t.dir && %cmc -mllvm -genx-determinism-check BitonicSortK_genx.cpp 2>&1 | FileCheck %w
+// RUN: cd %t.dir && %cmc -mllvm -genx-determinism-check mandelbrot_genx.cpp 2>&1 | FileCheck %w
+// RUN: cd %t.dir && %cmc -mllvm -genx-determinism-check matrix_transpose_genx.cpp 2>&1 | FileCheck %w
+// RUN: cd %t.dir && %cmc -mllvm -genx-determinism-check Sgemm_genx.cpp 2>&1 | FileCheck %w
+// RUN: cd %t.dir && %cmc -mllvm -genx-determinism-check Prefix_genx.cpp 2>&1 | FileCheck %w
+//
+// CHECK-NOT: determinism check failed
+// CHECK-NOT: error
+
+// Every example must have got as far as writing its vISA.
+// RUN: ls %t.dir | FileCheck -check-prefix=ISA %w
+//
+// ISA-DAG: hello_world_genx.isa
+// ISA-DAG: linear_walker_genx.isa
+// ISA-DAG: histogram_genx.isa
+// ISA-DAG: BitonicSortK_genx.isa
+// ISA-DAG: mandelbrot_genx.isa
+// ISA-DAG: matrix_transpose_genx.isa
+// ISA-DAG: Sgemm_genx.isa
+// ISA-DAG: Prefix_genx.isa
+
+// tidy up the generated files
+// RUN: rm -rf %t.dir
@@ -0,0 +1,58 @@
+#include <cm/cm.h>
+
+// Division and remainder by a loop invariant divisor are rewritten with a
+// reciprocal computed once, before the loop: the loop body multiplies
+// instead of dividing.
+
+_GENX_MAIN_ void invariant(SurfaceIndex S, uint w, uint n)
+{
+  vector<uint, 8> idx, acc = 0;
+  read(S, 0, idx);
+  for (uint i = 0; i < n; i++)
+    acc += (idx + i) / w + (idx + i) % w;
+  write(S, 32, acc);
+}
+
+// Divisions guarded by a test of the divisor share a reciprocal, which is
+// computed inside the guard rather than at the start of the kernel.
+
+_GENX_MAIN_ void guarded(SurfaceIndex S, uint w)
+{
+  vector<uint, 8> a, b;
+  read(S, 0, a);
+  read(S, 32, b);
+  if (w != 0) {
+    a = a / w;
+    b = b % w;
+  }
+  write(S, 64, a);
+  write(S, 96, b);
+}
+
+// RUN: %cmc -Qxcm_jit_target=SKL %w 2>&1 | FileCheck -allow-empty -check-prefix=BUILD %w
+// RUN: FileCheck -input-file=%W_0.visaasm -check-prefix=LOOP %w
+// RUN: FileCheck -input-file=%W_1.visaasm -check-prefix=GUARD %w
+//
+// BUILD-NOT: error
+//
+// The one division left is the reciprocal, ahead of the loop.
+// LOOP: {{[[:space:]]}}div (M1, 1)
+// LOOP-NOT: {{[[:space:]]}}div (
+// LOOP-NOT: {{[[:space:]]}}mod (
+// LOOP: mulh (M1, 8)
+//
+// GUARD: jmp
+// GUARD: {{[[:space:]]}}div (M1, 1)
+// GUARD-NOT: {{[[:space:]]}}div (
+// GUARD-NOT: {{[[:space:]]}}mod (
+// GUARD: mulh (M1, 8)
+
+// RUN: %cmc -Qxcm_jit_target=SKL -mllvm -enable-genx-divrem-reduction=false %w 2>&1 | FileCheck -allow-empty -check-prefix=BUILD %w
+// RUN: FileCheck -input-file=%W_0.visaasm -check-prefix=ORIG %w
+//
+// ORIG-NOT: mulh
+// ORIG: {{[[:space:]]}}div (M1, 8)
+// ORIG: {{[[:space:]]}}mod (M1, 8)
+
+// tidy up the generated files
+// RUN: rm %W.isa %W_0.visaasm %W_0.asm %W_0.dat %W_1.visaasm %W_1.asm %W_1.dat
@@ -0,0 +1,51 @@
+#include <cm/cm.h>
+
+// A kernel with a loop whose trip count is an argument, and a write that
+// only happens for an offset that is not oword aligned. Its variants are
+// specialized on those arguments.
+
+_GENX_MAIN_ void kern(SurfaceIndex S, uint n, uint off)
+{
+  vector<uint, 8> v;
+  read(S, 0, v);
+  for (uint i = 0; i < n; i++)
+    v = v * 3 + i;
+  if (off & 15)
+    write(S, 32, v);
+  write(S, off & ~15u, v);
+}
+
+// kern_v1 has n == 2 and off == 0, kern_v2 has off a multiple of 16.
+// RUN: %cmc -Qxcm_jit_target=SKL -mllvm -cm-kernel-variant=kern:1=2,2=0 -mllvm -cm-kernel-variant=kern:2%16 %w 2>&1 | FileCheck -allow-empty -check-prefix=BUILD %w
+// RUN: FileCheck -input-file=%W_0.visaasm -check-prefix=KERN %w
+// RUN: FileCheck -input-file=%W_1.visaasm -check-prefix=VALUE %w
+// RUN: FileCheck -input-file=%W_2.visaasm -check-prefix=ALIGN %w
+//
+// BUILD-NOT: error
+//
+// The generic kernel keeps its loop and both writes.
+// KERN: .kernel "kern"
+// KERN: jmp
+// KERN: oword_st
+// KERN: oword_st
+//
+// The loop is unrolled and the conditional write folded away.
+// VALUE: .kernel "kern_v1"
+// VALUE-NOT: jmp
+// VALUE: oword_st
+// VALUE-NOT: oword_st
+// VALUE-NOT: jmp
+//
+// The conditional write is folded away, the loop stays.
+// ALIGN: .kernel "kern_v2"
+// ALIGN: jmp
+// ALIGN: oword_st
+// ALIGN-NOT: oword_st
+
+// A variant of an unknown kernel is an error.
+// RUN: %cmc -Qxcm_jit_target=SKL -mllvm -cm-kernel-variant=nokern:1=2 %w 2>&1 | FileCheck -check-prefix=UNKNOWN %w
+//
+// UNKNOWN: -cm-kernel-variant does not match a kernel and its arguments
+
+// tidy up the generated files
+// RUN: rm %W.isa %W_0.visaasm %W_0.asm %W_0.dat %W_1.visaasm %W_1.asm %W_1.dat %W_2.visaasm %W_2.asm %W_2.dat
@@ -0,0 +1,120 @@
+#include <cm/cm.h>
+
+// Operations on odd width vectors are padded to the next power of two width
+// rather than split into power of two pieces, when the extra elements can be
+// read from the sources: a width 3 float add, a width 5 int and, a width 7
+// short or, a width 12 int or and a width 24 short and each become a single
+// instruction. Their results are then used at the original width by
+// operations that write into a larger vector, which are still split.
+//
+// The short operations are written on ints and narrowed back to short by
+// instcombine, as CM promotes short operands.
+
+_GENX_MAIN_ void odd_widths(SurfaceIndex S)
+{
+  vector<float, 8> fa, fb, fout = 0.0f;
+  vector<int, 8> ia, ib, iout = 0;
+  vector<short, 16> ha, hb, hout = 0;
+  vector<int, 16> ja, jb, jout = 0;
+  vector<short, 32> ka, kb, kout = 0;
+  read(S, 0, fa);
+  read(S, 32, fb);
+  read(S, 64, ia);
+  read(S, 96, ib);
+  read(S, 128, ha);
+  read(S, 160, hb);
+  read(S, 192, ja);
+  read(S, 256, jb);
+  read(S, 320, ka);
+  read(S, 384, kb);
+
+  vector<float, 3> f = fa.select<3, 1>(0) + fb.select<3, 1>(0);
+  fout.select<3, 1>(0) = f * fa.select<3, 1>(4);
+
+  vector<int, 5> i = ia.select<5, 1>(0) & ib.select<5, 1>(0);
+  iout.select<5, 1>(0) = i ^ ib.select<5, 1>(3);
+
+  vector<short, 7> h = ha.select<7, 1>(0) | hb.select<7, 1>(0);
+  hout.select<7, 1>(0) = h ^ hb.select<7, 1>(8);
+
+  vector<int, 12> j = ja.select<12, 1>(0) | jb.select<12, 1>(0);
+  jout.select<12, 1>(0) = j ^ jb.select<12, 1>(4);
+
+  vector<short, 24> k = ka.select<24, 1>(0) & kb.select<24, 1>(0);
+  kout.select<24, 1>(0) = k ^ kb.select<24, 1>(8);
+
+  write(S, 448, fout);
+  write(S, 480, iout);
+  write(S, 512, hout);
+  write(S, 544, jout);
+  write(S, 608, kout);
+}
+
+// A padded result read only through selects is not narrowed first: each
+// select reads its elements straight out of the padded width 3 float mul.
+
+_GENX_MAIN_ void odd_width_select(SurfaceIndex S)
+{
+  vector<float, 8> a, b, out = 0.0f;
+  read(S, 0, a);
+  read(S, 32, b);
+
+  vector<float, 3> f = a.select<3, 1>(0) * b.select<3, 1>(0);
+  out.select<2, 1>(0) = f.select<2, 1>(1) + f.select<2, 2>(0);
+
+  write(S, 64, out);
+}
+
+// The widths up to 16 are checked in the Gen asm, where each operand is a
+// GRF region of the operation's type. The width 24 and is checked in the
+// vISA, as the finalizer may split a SIMD32 word operation itself.
+//
+// RUN: %cmc -Qxcm_jit_target=SKL %w 2>&1 | FileCheck -allow-empty -check-prefix=BUILD %w
+// RUN: FileCheck -input-file=%W_0.asm -check-prefix=PAD %w
+// RUN: FileCheck -input-file=%W_0.asm -check-prefix=PAD-ONLY %w
+// RUN: FileCheck -input-file=%W_0.visaasm -check-prefix=PAD-VISA %w
+// RUN: FileCheck -input-file=%W_1.asm -check-prefix=PAD-SEL %w
+//
+// BUILD-NOT: error
+//
+// PAD-DAG: add (4|M0) r{{[0-9.]+}}<{{[0-9]+}}>:f r{{[0-9.]+}}<{{[0-9;,]+}}>:f r{{[0-9.]+}}<{{[0-9;,]+}}>:f
+// PAD-DAG: and (8|M0) r{{[0-9.]+}}<{{[0-9]+}}>:d r{{[0-9.]+}}<{{[0-9;,]+}}>:d r{{[0-9.]+}}<{{[0-9;,]+}}>:d
+// PAD-DAG: or (8|M0) r{{[0-9.]+}}<{{[0-9]+}}>:w r{{[0-9.]+}}<{{[0-9;,]+}}>:w r{{[0-9.]+}}<{{[0-9;,]+}}>:w
+// PAD-DAG: or (16|M0) r{{[0-9.]+}}<{{[0-9]+}}>:d r{{[0-9.]+}}<{{[0-9;,]+}}>:d r{{[0-9.]+}}<{{[0-9;,]+}}>:d
+//
+// PAD-ONLY-NOT: add ({{[12]}}|M0) r{{[0-9.]+}}<{{[0-9]+}}>:f r{{[0-9.]+}}<{{[0-9;,]+}}>:f r{{[0-9.]+}}<{{[0-9;,]+}}>:f
+// PAD-ONLY-NOT: and ({{[14]}}|M0) r{{[0-9.]+}}<{{[0-9]+}}>:d r{{[0-9.]+}}<{{[0-9;,]+}}>:d r{{[0-9.]+}}<{{[0-9;,]+}}>:d
+// PAD-ONLY-NOT: or ({{[124]}}|M0) r{{[0-9.]+}}<{{[0-9]+}}>:w r{{[0-9.]+}}<{{[0-9;,]+}}>:w r{{[0-9.]+}}<{{[0-9;,]+}}>:w
+// PAD-ONLY-NOT: or ({{[48]}}|M0) r{{[0-9.]+}}<{{[0-9]+}}>:d r{{[0-9.]+}}<{{[0-9;,]+}}>:d r{{[0-9.]+}}<{{[0-9;,]+}}>:d
+//
+// PAD-VISA: and (M1, 32) V{{[0-9]+}}(0,0)<1> V{{[0-9]+}}({{[0-9,]+}})<{{[0-9;,]+}}> V{{[0-9]+}}({{[0-9,]+}})<{{[0-9;,]+}}>
+// PAD-VISA-NOT: and (M1, 16) V{{[0-9]+}}(0,0)<1> V{{[0-9]+}}({{[0-9,]+}})<{{[0-9;,]+}}> V{{[0-9]+}}({{[0-9,]+}})<{{[0-9;,]+}}>
+//
+// PAD-SEL-NOT: mul ({{[12]}}|M0)
+// PAD-SEL: mul (4|M0) r{{[0-9.]+}}<{{[0-9]+}}>:f r{{[0-9.]+}}<{{[0-9;,]+}}>:f r{{[0-9.]+}}<{{[0-9;,]+}}>:f
+// PAD-SEL-NOT: mul ({{[12]}}|M0)
+// PAD-SEL: add (2|M0) r{{[0-9.]+}}<{{[0-9]+}}>:f r{{[0-9.]+}}<{{[0-9;,]+}}>:f r{{[0-9.]+}}<{{[0-9;,]+}}>:f
+
+// RUN: %cmc -Qxcm_jit_target=SKL -mllvm -genx-legalize-pad=false %w 2>&1 | FileCheck -allow-empty -check-prefix=BUILD %w
+// RUN: FileCheck -input-file=%W_0.asm -check-prefix=SPLIT %w
+// RUN: FileCheck -input-file=%W_0.visaasm -check-prefix=SPLIT-VISA %w
+// RUN: FileCheck -input-file=%W_1.asm -check-prefix=SPLIT-SEL %w
+//
+// SPLIT-DAG: add (2|M0) r{{[0-9.]+}}<{{[0-9]+}}>:f r{{[0-9.]+}}<{{[0-9;,]+}}>:f r{{[0-9.]+}}<{{[0-9;,]+}}>:f
+// SPLIT-DAG: add (1|M0) r{{[0-9.]+}}<{{[0-9]+}}>:f r{{[0-9.]+}}<{{[0-9;,]+}}>:f r{{[0-9.]+}}<{{[0-9;,]+}}>:f
+// SPLIT-DAG: and (4|M0) r{{[0-9.]+}}<{{[0-9]+}}>:d r{{[0-9.]+}}<{{[0-9;,]+}}>:d r{{[0-9.]+}}<{{[0-9;,]+}}>:d
+// SPLIT-DAG: and (1|M0) r{{[0-9.]+}}<{{[0-9]+}}>:d r{{[0-9.]+}}<{{[0-9;,]+}}>:d r{{[0-9.]+}}<{{[0-9;,]+}}>:d
+// SPLIT-DAG: or (4|M0) r{{[0-9.]+}}<{{[0-9]+}}>:w r{{[0-9.]+}}<{{[0-9;,]+}}>:w r{{[0-9.]+}}<{{[0-9;,]+}}>:w
+// SPLIT-DAG: or (2|M0) r{{[0-9.]+}}<{{[0-9]+}}>:w r{{[0-9.]+}}<{{[0-9;,]+}}>:w r{{[0-9.]+}}<{{[0-9;,]+}}>:w
+// SPLIT-DAG: or (1|M0) r{{[0-9.]+}}<{{[0-9]+}}>:w r{{[0-9.]+}}<{{[0-9;,]+}}>:w r{{[0-9.]+}}<{{[0-9;,]+}}>:w
+// SPLIT-DAG: or (8|M0) r{{[0-9.]+}}<{{[0-9]+}}>:d r{{[0-9.]+}}<{{[0-9;,]+}}>:d r{{[0-9.]+}}<{{[0-9;,]+}}>:d
+// SPLIT-DAG: or (4|M0) r{{[0-9.]+}}<{{[0-9]+}}>:d r{{[0-9.]+}}<{{[0-9;,]+}}>:d r{{[0-9.]+}}<{{[0-9;,]+}}>:d
+//
+// SPLIT-VISA-DAG: and (M1, 16) V{{[0-9]+}}(0,0)<1> V{{[0-9]+}}({{[0-9,]+}})<{{[0-9;,]+}}> V{{[0-9]+}}({{[0-9,]+}})<{{[0-9;,]+}}>
+// SPLIT-VISA-DAG: and (M1, 8) V{{[0-9]+}}({{[0-9,]+}})<1> V{{[0-9]+}}({{[0-9,]+}})<{{[0-9;,]+}}> V{{[0-9]+}}({{[0-9,]+}})<{{[0-9;,]+}}>
+//
+// SPLIT-SEL-DAG: mul (2|M0) r{{[0-9.]+}}<{{[0-9]+}}>:f r{{[0-9.]+}}<{{[0-9;,]+}}>:f r{{[0-9.]+}}<{{[0-9;,]+}}>:f
+// SPLIT-SEL-DAG: mul (1|M0) r{{[0-9.]+}}<{{[0-9]+}}>:f r{{[0-9.]+}}<{{[0-9;,]+}}>:f r{{[0-9.]+}}<{{[0-9;,]+}}>:f
+
+// tidy up the generated files
+// RUN: rm %W.isa %W_0.visaasm %W_0.asm %W_0.dat %W_1.visaasm %W_1.asm %W_1.dat
@@ -0,0 +1,94 @@
+#include <cm/cm.h>
+
+// Loops that process a vector one element at a time are turned into region
+// operations on whole chunks of the vector: an element-wise map, a strided
+// read, a reduction and a map whose trip counts leave a remainder chunk, and
+// a strided write. The last kernel writes a surface on every iteration and
+// stays a scalar loop.
+
+_GENX_MAIN_ void scale(SurfaceIndex S)
+{
+  vector<int, 16> a, b;
+  read(S, 0, a);
+  for (int i = 0; i < 16; i++)
+    b(i) = a(i) * 3 + 1;
+  write(S, 64, b);
+}
+
+_GENX_MAIN_ void strided(SurfaceIndex S)
+{
+  vector<short, 32> a;
+  vector<short, 16> b;
+  read(S, 0, a);
+  for (int i = 0; i < 16; i++)
+    b(i) = a(2 * i + 1) >> 1;
+  write(S, 64, b);
+}
+
+_GENX_MAIN_ void sum_remainder(SurfaceIndex S)
+{
+  vector<int, 32> a;
+  read(S, 0, a);
+  int sum = 0;
+  for (int i = 0; i < 20; i++)
+    sum += a(i);
+  vector<int, 8> out = sum;
+  write(S, 128, out);
+}
+
+_GENX_MAIN_ void scale_remainder(SurfaceIndex S)
+{
+  vector<int, 32> a, b = 0;
+  read(S, 0, a);
+  for (int i = 0; i < 20; i++)
+    b(i) = a(i) * 3 + 1;
+  write(S, 128, b);
+}
+
+_GENX_MAIN_ void strided_write(SurfaceIndex S)
+{
+  vector<int, 8> a;
+  vector<int, 16> b = 0;
+  read(S, 0, a);
+  for (int i = 0; i < 8; i++)
+    b(2 * i + 1) = a(i) + 5;
+  write(S, 64, b);
+}
+
+_GENX_MAIN_ void surface_writes(SurfaceIndex S)
+{
+  vector<int, 8> v;
+  read(S, 0, v);
+  for (int i = 0; i < 4; i++)
+    write(S, 32 + i * 32, v);
+}
+
+// RUN: %cmc -Qxcm_jit_target=SKL -Rpass=cmloopvectorize -Rpass-missed=cmloopvectorize %w 2>&1 | FileCheck %w
+//
+// CHECK-DAG: remark: vectorized loop of 16 iterations into 16-wide operations
+// CHECK-DAG: remark: vectorized loop of 20 iterations into 16-wide operations with a 4-wide remainder
+// CHECK-DAG: remark: vectorized loop of 8 iterations into 8-wide operations
+// CHECK-DAG: remark: loop not vectorized: call to llvm.genx.oword.st{{.*}} cannot be vectorized
+// CHECK-NOT: error
+
+// RUN: FileCheck -input-file=%W_0.asm -check-prefix=SCALE %w
+//
+// SCALE: {{mul|mad}} (16|M0)
+// SCALE-NOT: {{mul|mad}} (1|M0)
+
+// The remainder chunk writes elements 16 to 19 of b, which start the third
+// GRF of the vector, and the strided write puts the odd elements of b in
+// one instruction.
+//
+// RUN: FileCheck -input-file=%W_3.asm -check-prefix=REM %w
+// RUN: FileCheck -input-file=%W_4.asm -check-prefix=STRIDED %w
+//
+// REM-DAG: {{mul|mad}} (16|M0) r{{[0-9]+}}.0<1>:d
+// REM-DAG: {{mul|mad}} (4|M0) r{{[0-9]+}}.0<1>:d
+// REM-NOT: {{mul|mad}} ({{[128]}}|M0)
+//
+// STRIDED: add (8|M0) r{{[0-9]+}}.1<2>:d
+// STRIDED-NOT: add ({{[124]}}|M0)
+
+// tidy up the generated files
+// RUN: rm %W.isa %W_0.visaasm %W_0.asm %W_0.dat %W_1.visaasm %W_1.asm %W_1.dat %W_2.visaasm %W_2.asm %W_2.dat %W_3.visaasm %W_3.asm %W_3.dat %W_4.visaasm %W_4.asm %W_4.dat %W_5.visaasm %W_5.asm %W_5.dat
@@ -0,0 +1,44 @@
+#include <cm/cm.h>
+
+// A fully unrolled kernel large enough to put pressure on the GenX analyses.
+// With a 1 MB budget it still compiles, with the per pass memory report.
+
+_GENX_MAIN_ void stress(SurfaceIndex S)
+{
+  matrix<float, 16, 16> m;
+  read(S, 0, 0, m.select<8, 1, 16, 1>(0, 0));
+  read(S, 0, 8, m.select<8, 1, 16, 1>(8, 0));
+#pragma unroll
+  for (int i = 0; i < 512; i++)
+    m.row(i % 16) = m.row((i * 7) % 16) * m.row((i * 3 + 1) % 16) + (float)i;
+  write(S, 0, 0, m.select<8, 1, 16, 1>(0, 0));
+  write(S, 0, 8, m.select<8, 1, 16, 1>(8, 0));
+}
+
+// RUN: %cmc -Qxcm_jit_target=SKL -mllvm -genx-memory-budget=1 -mllvm -genx-memory-report %w 2>&1 | FileCheck %w
+//
+// CHECK: GenX memory report (budget 1 MB)
+// CHECK: tracked KB    heap KB  pass
+// CHECK-DAG: GenX liveness analysis
+// CHECK-DAG: GenX numbering
+// CHECK-DAG: GenX vISA virtual register allocator
+// CHECK: peak tracked: {{[0-9]+}} KB
+// CHECK: analyses released early: {{[0-9]+}}
+// CHECK-NOT: error
+
+// RUN: %cmc -Qxcm_jit_target=SKL -mllvm -genx-memory-report %w 2>&1 | FileCheck -check-prefix=NOBUDGET %w
+//
+// NOBUDGET: GenX memory report (budget none)
+// NOBUDGET: analyses released early: 0
+// NOBUDGET-NOT: error
+
+// The budget lowers the peak held by the analyses, as those no remaining
+// pass needs are released early.
+// RUN: %cmc -Qxcm_jit_target=SKL -mllvm -genx-memory-report %w 2>&1 | grep "peak tracked" > %t.nobudget
+// RUN: %cmc -Qxcm_jit_target=SKL -mllvm -genx-memory-budget=1 -mllvm -genx-memory-report %w 2>&1 | grep "peak tracked" > %t.budget
+// RUN: cat %t.nobudget %t.budget | awk 'NR == 1 { a = $3 } NR == 2 { b = $3 } END { print (b < a ? "DROPPED" : "NOT DROPPED") }' | FileCheck -check-prefix=PEAK %w
+//
+// PEAK: {{^}}DROPPED
+
+// tidy up the generated files
+// RUN: rm %W.isa %W_0.visaasm %W_0.asm %W_0.dat
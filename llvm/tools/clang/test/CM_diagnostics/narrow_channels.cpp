@@ -0,0 +1,33 @@
+#include <cm/cm.h>
+
+// Typed and untyped reads of all four channels, of which the kernel only
+// uses some. The messages are narrowed to the channels used.
+
+_GENX_MAIN_ void channels(SurfaceIndex T, SurfaceIndex B, SurfaceIndex O)
+{
+  vector<uint, 8> u = cm_local_id(0);
+  matrix<float, 4, 8> m;
+  read_typed(T, CM_ABGR_ENABLE, m, u);
+  matrix<float, 4, 8> n;
+  read_untyped(B, CM_ABGR_ENABLE, n, u);
+  vector<float, 8> r = m.row(0) + m.row(2) + n.row(1);
+  write(O, 0, r);
+}
+
+// RUN: %cmc -Qxcm_jit_target=SKL %w 2>&1 | FileCheck -allow-empty -check-prefix=BUILD %w
+// RUN: FileCheck -input-file=%W_0.visaasm -check-prefix=NARROW %w
+//
+// BUILD-NOT: error
+//
+// NARROW-DAG: gather4_typed.RB (M1, 8)
+// NARROW-DAG: gather4_scaled.G (M1, 8)
+// NARROW-NOT: RGBA
+
+// RUN: %cmc -Qxcm_jit_target=SKL -mllvm -genx-dvr-narrow-channels=false %w 2>&1 | FileCheck -allow-empty -check-prefix=BUILD %w
+// RUN: FileCheck -input-file=%W_0.visaasm -check-prefix=WIDE %w
+//
+// WIDE-DAG: gather4_typed.RGBA (M1, 8)
+// WIDE-DAG: gather4_scaled.RGBA (M1, 8)
+
+// tidy up the generated files
+// RUN: rm %W.isa %W_0.visaasm %W_0.asm %W_0.dat
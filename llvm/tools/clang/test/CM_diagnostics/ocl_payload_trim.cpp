@@ -0,0 +1,57 @@
+#include <cm/cm.h>
+
+// Kernels for the OpenCL runtime in one module each take only the thread
+// payload fields they read: none, the x local id, or the x and z local ids.
+//
+// cmc compiles every kernel of a source for the same runtime; a module that
+// mixes kernels for the OpenCL and CM runtimes, as linking can give, is
+// covered by the CMImpParam unit test.
+
+_GENX_MAIN_ void plain(SurfaceIndex S)
+{
+  vector<uint, 8> v = 1;
+  write(S, 0, v);
+}
+
+_GENX_MAIN_ void lid_x(SurfaceIndex S)
+{
+  vector<uint, 8> v = cm_local_id(0);
+  write(S, 0, v);
+}
+
+_GENX_MAIN_ void lid_xz(SurfaceIndex S)
+{
+  vector<uint, 8> v = cm_local_id(0) + cm_local_id(2);
+  write(S, 0, v);
+}
+
+// RUN: %cmc -Qxcm_jit_target=SKL -fcmocl -mCM_no_input_reorder %w | FileCheck %w
+//
+// CHECK: -platform SKL
+// CHECK-NOT: error
+// CHECK-NOT: warning
+
+// RUN: FileCheck -input-file=%W_0.asm -check-prefix=PLAIN %w
+// RUN: FileCheck -input-file=%W_1.asm -check-prefix=LIDX %w
+// RUN: FileCheck -input-file=%W_2.asm -check-prefix=LIDXZ %w
+//
+// PLAIN: //.kernel_reordering_info_start
+// PLAIN-NEXT: //id
+// PLAIN-NEXT: //.arg_1 {{.*}}
+// PLAIN-NEXT: //.kernel_reordering_info_end
+//
+// LIDX: //.kernel_reordering_info_start
+// LIDX-NEXT: //id
+// LIDX-NEXT: //.arg_1 {{.*}}
+// LIDX-NEXT: //.arg_2{{[[:space:]]+}}32{{[[:space:]]+}}32{{[[:space:]]}}
+// LIDX-NEXT: //.kernel_reordering_info_end
+//
+// LIDXZ: //.kernel_reordering_info_start
+// LIDXZ-NEXT: //id
+// LIDXZ-NEXT: //.arg_1 {{.*}}
+// LIDXZ-NEXT: //.arg_2{{[[:space:]]+}}32{{[[:space:]]+}}32{{[[:space:]]}}
+// LIDXZ-NEXT: //.arg_3{{[[:space:]]+}}96{{[[:space:]]+}}32{{[[:space:]]}}
+// LIDXZ-NEXT: //.kernel_reordering_info_end
+
+// tidy up the generated files
+// RUN: rm %W.isa %W_0.visaasm %W_0.asm %W_0.dat %W_1.visaasm %W_1.asm %W_1.dat %W_2.visaasm %W_2.asm %W_2.dat
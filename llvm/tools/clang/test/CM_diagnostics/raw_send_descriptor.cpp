@@ -0,0 +1,106 @@
+#include <cm/cm.h>
+
+// Raw sends with constant descriptors are decoded by the GenX backend.
+
+// Data cache oword block read of one register, with a header.
+#define READ_DESC ((1 << 25) + (1 << 20) + (1 << 19) + (0x0 << 14) + (0x2 << 8))
+// Data cache oword block write of one register, with a header.
+#define WRITE_DESC ((2 << 25) + (0 << 20) + (1 << 19) + (0x8 << 14) + (0x2 << 8))
+// The same write as a split send: the header in the first payload, and the
+// data in the second, whose length is in exDesc[9:6] on SKL and later.
+#define SPLIT_WRITE_DESC ((1 << 25) + (0 << 20) + (1 << 19) + (0x8 << 14) + (0x2 << 8))
+#define SPLIT_WRITE_EXDESC ((1 << 6) + 0xa)
+
+// Two identical reads are read only, so they are commoned up into one send.
+
+_GENX_MAIN_ void read_cse(SurfaceIndex S)
+{
+  matrix<uint, 1, 8> payload = 0;
+  vector<uint, 8> rsp1;
+  vector<uint, 8> rsp2;
+  cm_send(rsp1, payload, 0xa, READ_DESC, 0u);
+  cm_send(rsp2, payload, 0xa, READ_DESC, 0u);
+  vector<uint, 8> sum = rsp1 + rsp2;
+  write(S, 0, sum);
+}
+
+// A write has no response, so it becomes a noresult send with no
+// destination registers.
+
+_GENX_MAIN_ void write_no_response(SurfaceIndex S)
+{
+  matrix<uint, 2, 8> payload = 0;
+  vector<uint, 8> rsp;
+  cm_send(rsp, payload, 0xa, WRITE_DESC, 0u);
+}
+
+// The response variable is four registers, but the descriptor says the
+// message writes only one, and that is what is passed on to the finalizer.
+
+_GENX_MAIN_ void resp_length(SurfaceIndex S)
+{
+  matrix<uint, 1, 8> payload = 0;
+  vector<uint, 32> rsp = 0;
+  cm_send(rsp, payload, 0xa, READ_DESC, 0u);
+  vector<uint, 8> res = rsp.select<8, 1>(0);
+  write(S, 0, res);
+}
+
+// Split sends, and the extended message length, only exist on SKL and later.
+
+#if CM_GENX >= 900
+
+// The second payload variable is four registers, but the extended descriptor
+// says the message reads only one.
+
+_GENX_MAIN_ void split_ex_length(SurfaceIndex S)
+{
+  matrix<uint, 1, 8> header = 0;
+  matrix<uint, 4, 8> data = 1;
+  cm_sends(0, header, data, SPLIT_WRITE_EXDESC, SPLIT_WRITE_DESC, 0u);
+}
+
+#endif
+
+// The data cache descriptors decode the same on each target. BDW has no
+// split send, so split_ex_length is only built for SKL and CNL.
+//
+// RUN: %cmc -Qxcm_jit_target=BDW %w 2>&1 | FileCheck -allow-empty -check-prefix=BUILD %w
+// RUN: FileCheck -input-file=%W_0.visaasm -check-prefix=CSE %w
+// RUN: FileCheck -input-file=%W_1.visaasm -check-prefix=NORESP %w
+// RUN: FileCheck -input-file=%W_2.visaasm -check-prefix=RLEN %w
+// RUN: rm %W.isa %W_0.visaasm %W_0.asm %W_0.dat %W_1.visaasm %W_1.asm %W_1.dat %W_2.visaasm %W_2.asm %W_2.dat
+//
+// RUN: %cmc -Qxcm_jit_target=SKL %w 2>&1 | FileCheck -allow-empty -check-prefix=BUILD %w
+// RUN: FileCheck -input-file=%W_0.visaasm -check-prefix=CSE %w
+// RUN: FileCheck -input-file=%W_1.visaasm -check-prefix=NORESP %w
+// RUN: FileCheck -input-file=%W_2.visaasm -check-prefix=RLEN %w
+// RUN: FileCheck -input-file=%W_3.visaasm -check-prefix=SPLIT %w
+// RUN: rm %W.isa %W_0.visaasm %W_0.asm %W_0.dat %W_1.visaasm %W_1.asm %W_1.dat %W_2.visaasm %W_2.asm %W_2.dat %W_3.visaasm %W_3.asm %W_3.dat
+//
+// RUN: %cmc -Qxcm_jit_target=CNL %w 2>&1 | FileCheck -allow-empty -check-prefix=BUILD %w
+// RUN: FileCheck -input-file=%W_0.visaasm -check-prefix=CSE %w
+// RUN: FileCheck -input-file=%W_1.visaasm -check-prefix=NORESP %w
+// RUN: FileCheck -input-file=%W_2.visaasm -check-prefix=RLEN %w
+// RUN: FileCheck -input-file=%W_3.visaasm -check-prefix=SPLIT %w
+//
+// BUILD-NOT: error
+//
+// raw_send.<exDesc>.<numsrc>.<numdst>
+//
+// CSE: raw_send{{c?}}.{{[0-9]+}}.1.1 {{.*}}
+// CSE-NOT: raw_send
+//
+// NORESP: raw_send{{c?}}.{{[0-9]+}}.2.0 {{.*}}
+// NORESP-NOT: raw_send
+//
+// RLEN: raw_send{{c?}}.{{[0-9]+}}.1.1 {{.*}}
+// RLEN-NOT: raw_send
+//
+// raw_sends.<sfid>.<numsrc>.<numsrc2>.<numdst>
+//
+// SPLIT: raw_sends{{c?}}.{{[0-9]+}}.1.1.0 {{.*}}
+// SPLIT-NOT: raw_send
+
+// tidy up the generated files
+// RUN: rm %W.isa %W_0.visaasm %W_0.asm %W_0.dat %W_1.visaasm %W_1.asm %W_1.dat %W_2.visaasm %W_2.asm %W_2.dat %W_3.visaasm %W_3.asm %W_3.dat
@@ -0,0 +1,58 @@
+#include <cm/cm.h>
+
+// SIMD control flow on a condition that is the same in every channel is
+// lowered to scalar branches, without goto/join or predicated stores. The
+// last kernel has a genuinely divergent condition and keeps its goto/join.
+
+_GENX_MAIN_ void uniform(SurfaceIndex S, uint n)
+{
+  vector<uint, 16> limit = n;
+  vector<uint, 16> v;
+  read(S, 0, v);
+  SIMD_IF_BEGIN (limit > 4) {
+    v += 1;
+  } SIMD_ELSE {
+    v -= 1;
+  } SIMD_IF_END;
+  write(S, 0, v);
+}
+
+_GENX_MAIN_ void range_check(SurfaceIndex S)
+{
+  vector<uint, 16> v;
+  read(S, 0, v);
+  vector<uint, 16> idx = v & 15;
+  SIMD_IF_BEGIN (idx < 16) {
+    v += idx;
+  } SIMD_IF_END;
+  write(S, 0, v);
+}
+
+_GENX_MAIN_ void divergent(SurfaceIndex S)
+{
+  vector<uint, 16> v;
+  read(S, 0, v);
+  SIMD_IF_BEGIN (v > 4) {
+    v += 1;
+  } SIMD_IF_END;
+  write(S, 0, v);
+}
+
+// RUN: %cmc -Qxcm_jit_target=SKL %w | FileCheck %w
+//
+// CHECK: -platform SKL
+// CHECK-NOT: error
+// CHECK-NOT: warning
+
+// RUN: FileCheck -input-file=%W_0.asm -check-prefix=UNIFORM %w
+// RUN: FileCheck -input-file=%W_1.asm -check-prefix=UNIFORM %w
+// RUN: FileCheck -input-file=%W_2.asm -check-prefix=DIVERGENT %w
+//
+// UNIFORM-NOT: goto
+// UNIFORM-NOT: join
+//
+// DIVERGENT: goto
+// DIVERGENT: join
+
+// tidy up the generated files
+// RUN: rm %W.isa %W_0.visaasm %W_0.asm %W_0.dat %W_1.visaasm %W_1.asm %W_1.dat %W_2.visaasm %W_2.asm %W_2.dat
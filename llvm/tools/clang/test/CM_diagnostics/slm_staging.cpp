@@ -0,0 +1,98 @@
+#include <cm/cm.h>
+
+// Each thread averages 16 floats with the 16 on either side. Neighbouring
+// threads of a group read overlapping windows of the input, so the reads are
+// staged in SLM. The output surface might be bound to the input buffer, so
+// this is only done when that is ruled out.
+
+_GENX_MAIN_ void blur(SurfaceIndex in, SurfaceIndex out)
+{
+  uint x = (cm_group_id(0) * cm_local_size(0) + cm_local_id(0)) * 64;
+  vector<float, 16> l, m, r;
+  read(in, x - 64, l);
+  read(in, x, m);
+  read(in, x + 64, r);
+  write(out, x, (l + m + r) * (1.0f / 3));
+}
+
+// Scaling in place writes the surface that is read.
+
+_GENX_MAIN_ void scale(SurfaceIndex buf)
+{
+  uint x = (cm_group_id(0) * cm_local_size(0) + cm_local_id(0)) * 64;
+  vector<float, 16> v;
+  read(buf, x, v);
+  write(buf, x, v * 2.0f);
+}
+
+// Each thread reads only its own 16 floats, so nothing is shared.
+
+_GENX_MAIN_ void copy(SurfaceIndex in, SurfaceIndex out)
+{
+  uint x = (cm_group_id(0) * cm_local_size(0) + cm_local_id(0)) * 64;
+  vector<float, 16> v;
+  read(in, x, v);
+  write(out, x, v);
+}
+
+// The blur writing its result through SVM writes no surface, so its reads
+// are staged without the option.
+
+_GENX_MAIN_ void blur_svm(SurfaceIndex in, svmptr_t out)
+{
+  uint x = (cm_group_id(0) * cm_local_size(0) + cm_local_id(0)) * 64;
+  vector<float, 16> l, m, r;
+  read(in, x - 64, l);
+  read(in, x, m);
+  read(in, x + 64, r);
+  cm_svm_block_write(out + x, (l + m + r) * (1.0f / 3));
+}
+
+// Dword aligned reads are unaligned oword block reads, which are not staged.
+
+_GENX_MAIN_ void blur_dwaligned(SurfaceIndex in, svmptr_t out)
+{
+  uint x = (cm_group_id(0) * cm_local_size(0) + cm_local_id(0)) * 64;
+  vector<float, 16> l, m, r;
+  read(DWALIGNED(in), x - 4, l);
+  read(DWALIGNED(in), x, m);
+  read(DWALIGNED(in), x + 4, r);
+  cm_svm_block_write(out + x, (l + m + r) * (1.0f / 3));
+}
+
+// RUN: %cmc -Qxcm_jit_target=SKL -Rpass=cmslmstaging -Rpass-missed=cmslmstaging %w 2>&1 | FileCheck %w
+//
+// CHECK-DAG: remark: staged 3 reads of a read-only surface in a 4224 byte SLM tile
+// CHECK-DAG: remark: read not staged in SLM: the surface may be written by the kernel
+// CHECK-DAG: remark: read not staged in SLM: the surface may be written through another argument
+// CHECK-NOT: error
+
+// RUN: FileCheck -input-file=%W_0.visaasm -check-prefix=ORIG %w
+// RUN: FileCheck -input-file=%W_3.visaasm -check-prefix=STAGED %w
+// RUN: FileCheck -input-file=%W_4.visaasm -check-prefix=ORIG %w
+//
+// STAGED: barrier
+
+// RUN: %cmc -Qxcm_jit_target=SKL -Rpass=cmslmstaging -Rpass-missed=cmslmstaging -mllvm -cm-slm-staging-assume-no-alias %w 2>&1 | FileCheck -check-prefix=NOALIAS %w
+// RUN: FileCheck -input-file=%W_0.visaasm -check-prefix=STAGED %w
+//
+// NOALIAS-DAG: remark: staged 3 reads of a read-only surface in a 4224 byte SLM tile
+// NOALIAS-DAG: remark: read not staged in SLM: the surface may be written by the kernel
+// NOALIAS-DAG: remark: read not staged in SLM: footprints of neighbouring threads do not overlap
+// NOALIAS-NOT: written through another argument
+// NOALIAS-NOT: error
+
+// RUN: %cmc -Qxcm_jit_target=SKL -Rpass-missed=cmslmstaging -mllvm -cm-slm-staging-budget=128 %w 2>&1 | FileCheck -check-prefix=BUDGET %w
+//
+// BUDGET: remark: read not staged in SLM: tile does not fit in the SLM budget of 128 bytes
+// BUDGET-NOT: error
+
+// RUN: %cmc -Qxcm_jit_target=SKL -mllvm -enable-cm-slm-staging=false %w 2>&1 | FileCheck -allow-empty -check-prefix=BUILD %w
+// RUN: FileCheck -input-file=%W_3.visaasm -check-prefix=ORIG %w
+//
+// BUILD-NOT: error
+//
+// ORIG-NOT: barrier
+
+// tidy up the generated files
+// RUN: rm %W.isa %W_0.visaasm %W_0.asm %W_0.dat %W_1.visaasm %W_1.asm %W_1.dat %W_2.visaasm %W_2.asm %W_2.dat %W_3.visaasm %W_3.asm %W_3.dat %W_4.visaasm %W_4.asm %W_4.dat
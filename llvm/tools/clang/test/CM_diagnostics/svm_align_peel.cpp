@@ -0,0 +1,78 @@
+#define CM_PTRSIZE 64
+#include <cm/cm.h>
+
+const svmptr_t init_offsets[8] = {0, 4, 8, 12, 16, 20, 24, 28};
+
+// A loop that reads through one SVM buffer of unknown alignment and scatters
+// to another. Once the buffers are known not to overlap, it is peeled so
+// that the steady state reads with aligned block messages, with scattered
+// messages in the prologue and epilogue.
+
+_GENX_MAIN_ void copy(svmptr_t in, svmptr_t out, int n)
+{
+  vector<svmptr_t, 8> offsets(init_offsets);
+  for (int i = 0; i < n; i++) {
+    vector<float, 8> v;
+    cm_svm_block_read_unaligned(in + i * 32, v);
+    cm_svm_scatter_write(out + i * 32 + offsets, v * 2.0f);
+  }
+}
+
+// The same loop scaling by a vector of coefficients, which would be applied
+// to the wrong elements once the loop is shifted.
+
+_GENX_MAIN_ void coeffs(svmptr_t in, svmptr_t out, int n, vector<float, 8> k)
+{
+  vector<svmptr_t, 8> offsets(init_offsets);
+  for (int i = 0; i < n; i++) {
+    vector<float, 8> v;
+    cm_svm_block_read_unaligned(in + i * 32, v);
+    cm_svm_scatter_write(out + i * 32 + offsets, v * k);
+  }
+}
+
+// An unaligned read at the same address as an aligned block write is
+// aligned already, so there is nothing to peel.
+
+_GENX_MAIN_ void inplace(svmptr_t buf, int n)
+{
+  for (int i = 0; i < n; i++) {
+    vector<float, 8> v;
+    cm_svm_block_read_unaligned(buf + i * 32, v);
+    v = v * 2.0f;
+    cm_svm_block_write(buf + i * 32, v);
+  }
+}
+
+// RUN: %cmc -Qxcm_jit_target=SKL -mllvm -cm-svm-align-peel-assume-no-alias -Rpass=cmsvmalignpeel -Rpass-missed=cmsvmalignpeel %w 2>&1 | FileCheck %w
+//
+// CHECK-DAG: remark: peeled loop for SVM alignment: prologue {1 gather, 1 scatter}, steady state {1 aligned block read, 1 scatter}, epilogue {1 gather, 1 scatter}
+// CHECK-DAG: remark: loop not peeled for SVM alignment: data written uses a loop-invariant vector that is not a splat
+// CHECK-DAG: remark: loop not peeled for SVM alignment: unaligned stream is at the same alignment as an aligned block access, so is aligned already
+// CHECK-NOT: error
+
+// RUN: FileCheck -input-file=%W_0.visaasm -check-prefix=PEELED %w
+//
+// PEELED-DAG: svm_gather
+// PEELED-DAG: svm_scatter
+// PEELED-DAG: svm_block_ld
+
+// Without the no-alias assumption, the write to another buffer may overlap
+// the read, so the loop is left alone.
+// RUN: %cmc -Qxcm_jit_target=SKL -Rpass=cmsvmalignpeel -Rpass-missed=cmsvmalignpeel %w 2>&1 | FileCheck -check-prefix=ALIAS %w
+// RUN: FileCheck -input-file=%W_0.visaasm -check-prefix=ORIG %w
+//
+// ALIAS-NOT: remark: peeled loop
+// ALIAS: remark: loop not peeled for SVM alignment: SVM write may overlap a stream with a different base
+// ALIAS-NOT: remark: peeled loop
+// ALIAS-NOT: error
+//
+// ORIG-NOT: svm_gather
+
+// RUN: %cmc -Qxcm_jit_target=SKL -mllvm -cm-svm-align-peel-assume-no-alias -mllvm -enable-cm-svm-align-peel=false %w 2>&1 | FileCheck -allow-empty -check-prefix=BUILD %w
+// RUN: FileCheck -input-file=%W_0.visaasm -check-prefix=ORIG %w
+//
+// BUILD-NOT: error
+
+// tidy up the generated files
+// RUN: rm %W.isa %W_0.visaasm %W_0.asm %W_0.dat %W_1.visaasm %W_1.asm %W_1.dat %W_2.visaasm %W_2.asm %W_2.dat
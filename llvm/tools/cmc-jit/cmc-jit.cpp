@@ -0,0 +1,100 @@
+//===- cmc-jit.cpp - Compile SPIR-V to vISA through libcmc ----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This program compiles a SPIR-V module the way the runtime does when it
+// loads a kernel, through cmc_load_and_compile_spec, and writes the vISA
+// binary. It is for testing libcmc from lit:
+//
+//   cmc-jit x.spv -o x.isa [-spec <id>=<value>]... [-options "<options>"]
+//
+// Each -spec gives the specialization constant with that SpecId the bit
+// pattern <value>, so a float constant takes the integer encoding of its
+// value.
+//
+//===----------------------------------------------------------------------===//
+
+#include "igcmc.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <memory>
+#include <string>
+#include <system_error>
+
+using namespace llvm;
+
+static cl::opt<std::string> InputFilename(cl::Positional, cl::Required,
+                                          cl::desc("<input spir-v>"));
+
+static cl::opt<std::string> OutputFilename("o", cl::Required,
+                                           cl::desc("Output filename"),
+                                           cl::value_desc("filename"));
+
+static cl::list<std::string>
+    SpecConsts("spec", cl::ZeroOrMore,
+               cl::desc("Give a specialization constant a value"),
+               cl::value_desc("id=value"));
+
+static cl::opt<std::string>
+    CompileOptions("options", cl::init(""),
+                   cl::desc("Options passed to libcmc"),
+                   cl::value_desc("options"));
+
+int main(int argc, char **argv) {
+  cl::ParseCommandLineOptions(argc, argv, "libcmc driver");
+
+  SmallVector<uint32_t, 4> SpecIds;
+  SmallVector<uint64_t, 4> SpecValues;
+  for (StringRef Spec : SpecConsts) {
+    std::pair<StringRef, StringRef> IdValue = Spec.split('=');
+    uint32_t Id = 0;
+    uint64_t Value = 0;
+    if (IdValue.first.getAsInteger(0, Id) ||
+        IdValue.second.getAsInteger(0, Value)) {
+      errs() << argv[0] << ": invalid -spec '" << Spec
+             << "', expected <id>=<value>\n";
+      return 1;
+    }
+    SpecIds.push_back(Id);
+    SpecValues.push_back(Value);
+  }
+
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Input =
+      MemoryBuffer::getFile(InputFilename);
+  if (std::error_code EC = Input.getError()) {
+    errs() << argv[0] << ": " << InputFilename << ": " << EC.message() << "\n";
+    return 1;
+  }
+
+  cmc_jit_info *Output = nullptr;
+  cmc_error_t Err = cmc_load_and_compile_spec(
+      (*Input)->getBufferStart(), (*Input)->getBufferSize(),
+      CompileOptions.c_str(), SpecIds.size(), SpecIds.data(),
+      SpecValues.data(), &Output);
+  if (Err != CMC_SUCCESS) {
+    errs() << argv[0] << ": " << cmc_get_error_string(Err) << "\n";
+    return 1;
+  }
+
+  std::error_code EC;
+  raw_fd_ostream OS(OutputFilename, EC, sys::fs::F_None);
+  if (EC) {
+    errs() << argv[0] << ": " << OutputFilename << ": " << EC.message()
+           << "\n";
+    cmc_free_jit_info(Output);
+    return 1;
+  }
+  OS.write(static_cast<const char *>(Output->binary), Output->binary_size);
+  cmc_free_jit_info(Output);
+  return 0;
+}
@@ -0,0 +1,44 @@
+//===- LibcmcTest.cpp - libcmc C interface unit tests ---------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "igcmc.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+// Not a SPIR-V module, so a compile that gets past the options fails in
+// reading the input.
+const char NotSPIRV[] = "not spir-v";
+
+cmc_error_t compile(const char *Options) {
+  cmc_jit_info *Output = nullptr;
+  cmc_error_t Err =
+      cmc_load_and_compile(NotSPIRV, sizeof(NotSPIRV), Options, &Output);
+  cmc_free_jit_info(Output);
+  return Err;
+}
+
+TEST(LibcmcTest, MemoryBudgetOption) {
+  EXPECT_EQ(compile(nullptr), CMC_ERROR_READING_SPIRV);
+  EXPECT_EQ(compile(""), CMC_ERROR_READING_SPIRV);
+  EXPECT_EQ(compile("-memory-budget=256"), CMC_ERROR_READING_SPIRV);
+  EXPECT_EQ(compile("  -foo -memory-budget=64  "), CMC_ERROR_READING_SPIRV);
+  EXPECT_EQ(compile("-memory-budget="), CMC_ERROR_INVALID_OPTION);
+  EXPECT_EQ(compile("-memory-budget=abc"), CMC_ERROR_INVALID_OPTION);
+  EXPECT_EQ(compile("-foo -memory-budget=-1"), CMC_ERROR_INVALID_OPTION);
+}
+
+TEST(LibcmcTest, ErrorStrings) {
+  EXPECT_STREQ(cmc_get_error_string(CMC_ERROR_INVALID_OPTION),
+               "invalid compile option");
+  EXPECT_STREQ(cmc_get_error_string(CMC_ERROR_READING_SPIRV),
+               "error in reading SPIR-V stream");
+}
+
+} // end anonymous namespace
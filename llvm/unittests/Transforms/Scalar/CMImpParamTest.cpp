@@ -0,0 +1,112 @@
+//===- CMImpParamTest.cpp - CMImpParam unit tests -------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Transforms/Scalar.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace {
+
+// cmc marks every kernel of a compile alike, so a module mixing kernels for
+// the OpenCL runtime (oclrt) and the CM runtime only comes from linking, and
+// is written out here. Both kernels read the x local id, and the CM runtime
+// kernel also reaches a helper that reads the y local id.
+const char *MixedModule =
+    "@out = global i32 0\n"
+    "declare <3 x i32> @llvm.genx.local.id.v3i32()\n"
+    "define internal i32 @helper() {\n"
+    "  %lid = call <3 x i32> @llvm.genx.local.id.v3i32()\n"
+    "  %y = extractelement <3 x i32> %lid, i32 1\n"
+    "  ret i32 %y\n"
+    "}\n"
+    "define dllexport void @ocl(i32 %a) #0 {\n"
+    "  %lid = call <3 x i32> @llvm.genx.local.id.v3i32()\n"
+    "  %x = extractelement <3 x i32> %lid, i32 0\n"
+    "  store volatile i32 %x, i32* @out\n"
+    "  ret void\n"
+    "}\n"
+    "define dllexport void @cmrt(i32 %a) {\n"
+    "  %lid = call <3 x i32> @llvm.genx.local.id.v3i32()\n"
+    "  %x = extractelement <3 x i32> %lid, i32 0\n"
+    "  store volatile i32 %x, i32* @out\n"
+    "  %y = call i32 @helper()\n"
+    "  store volatile i32 %y, i32* @out\n"
+    "  ret void\n"
+    "}\n"
+    "attributes #0 = { \"oclrt\"=\"true\" }\n"
+    "!genx.kernels = !{!0, !1}\n"
+    "!0 = !{void (i32)* @ocl, !\"ocl\", !\"\", !2}\n"
+    "!1 = !{void (i32)* @cmrt, !\"cmrt\", !\"\", !2}\n"
+    "!2 = !{i32 0}\n";
+
+// Returns whether F calls a function whose name starts with Prefix.
+bool calls(Function *F, StringRef Prefix) {
+  for (Instruction &I : instructions(F))
+    if (auto CI = dyn_cast<CallInst>(&I))
+      if (Function *Callee = CI->getCalledFunction())
+        if (Callee->getName().startswith(Prefix))
+          return true;
+  return false;
+}
+
+// Returns the number of argument kinds in the kernel metadata of F.
+unsigned getNumArgKinds(Module &M, Function *F) {
+  NamedMDNode *Named = M.getNamedMetadata("genx.kernels");
+  for (MDNode *Node : Named->operands()) {
+    auto VM = dyn_cast<ValueAsMetadata>(Node->getOperand(0));
+    if (VM && VM->getValue() == F)
+      return cast<MDNode>(Node->getOperand(3))->getNumOperands();
+  }
+  return 0;
+}
+
+TEST(CMImpParamTest, MixedOCLAndCMRuntimeKernels) {
+  LLVMContext Context;
+  SMDiagnostic Err;
+  std::unique_ptr<Module> M = parseAssemblyString(MixedModule, Err, Context);
+  ASSERT_TRUE(M) << Err.getMessage().str();
+
+  legacy::PassManager Passes;
+  Passes.add(createCMImpParamPass());
+  Passes.run(*M);
+
+  // The OpenCL kernel reads the x local id from its thread payload, and
+  // takes no implicit argument.
+  Function *OCL = M->getFunction("ocl");
+  ASSERT_TRUE(OCL);
+  EXPECT_EQ(OCL->arg_size(), 1u);
+  EXPECT_EQ(getNumArgKinds(*M, OCL), 1u);
+  EXPECT_TRUE(calls(OCL, "llvm.genx.local.id.x"));
+  EXPECT_FALSE(calls(OCL, "llvm.genx.local.id.y"));
+  EXPECT_FALSE(calls(OCL, "llvm.genx.local.id.z"));
+  EXPECT_FALSE(calls(OCL, "llvm.genx.local.id.v3i32"));
+
+  // The CM runtime kernel takes the local id as an implicit argument, for
+  // itself and for the helper, which is left alone by the OpenCL payload
+  // conversion.
+  Function *CMRT = M->getFunction("cmrt");
+  ASSERT_TRUE(CMRT);
+  EXPECT_EQ(CMRT->arg_size(), 2u);
+  EXPECT_EQ(getNumArgKinds(*M, CMRT), 2u);
+  EXPECT_FALSE(calls(CMRT, "llvm.genx.local.id"));
+  Function *Helper = M->getFunction("helper");
+  ASSERT_TRUE(Helper);
+  EXPECT_FALSE(calls(Helper, "llvm.genx.local.id"));
+  EXPECT_TRUE(M->getNamedGlobal("__imparg_llvm.genx.local.id"));
+}
+
+} // end anonymous namespace
@@ -0,0 +1,159 @@
+//===- WIAnalysisTest.cpp - WIAnalysis unit tests -------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "WIAnalysis.hpp"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Support/SourceMgr.h"
+#include <map>
+#include "gtest/gtest.h"
+
+using namespace llvm;
+using namespace pktz;
+
+namespace {
+
+// Dependency, no-wrap bits and consecutive access facts of one value.
+struct WIFacts {
+  unsigned Depend;
+  unsigned NoWrap;
+  bool Consecutive4;
+  bool Consecutive8;
+};
+
+static std::map<std::string, WIFacts> Facts;
+
+// Records what WIAnalysis says about every named instruction, while the
+// analysis is still alive.
+struct WIAnalysisTest : public FunctionPass {
+  static char ID;
+  WIAnalysisTest() : FunctionPass(ID) {
+    initializeWIAnalysisPass(*PassRegistry::getPassRegistry());
+  }
+  bool runOnFunction(Function &F) override {
+    WIAnalysis &WIA = getAnalysis<WIAnalysis>();
+    for (BasicBlock &BB : F)
+      for (Instruction &I : BB)
+        if (I.hasName())
+          Facts[I.getName()] = {WIA.whichDepend(&I), WIA.whichNoWrap(&I),
+                                WIA.isConsecutiveAccess(&I, 4),
+                                WIA.isConsecutiveAccess(&I, 8)};
+    return false;
+  }
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<WIAnalysis>();
+    AU.setPreservesAll();
+  }
+};
+
+char WIAnalysisTest::ID = 0;
+
+void runWIAnalysis(const char *Body) {
+  std::string ModuleStr =
+      std::string("target datalayout = \"e-p:64:64-i64:64-n8:16:32:64\"\n"
+                  "declare i32 @llvm.genx.lane.id()\n"
+                  "define void @f(i64 %base, i32 %u) #0 {\n"
+                  "entry:\n"
+                  "  %lane = call i32 @llvm.genx.lane.id()\n") +
+      Body +
+      "  ret void\n"
+      "}\n"
+      "attributes #0 = { \"CMGenxSIMT\"=\"8\" }\n";
+  LLVMContext Context;
+  SMDiagnostic Err;
+  std::unique_ptr<Module> M = parseAssemblyString(ModuleStr, Err, Context);
+  ASSERT_TRUE(M) << Err.getMessage().str();
+  Facts.clear();
+  legacy::PassManager Passes;
+  Passes.add(new WIAnalysisTest());
+  Passes.run(*M);
+}
+
+TEST(WIAnalysisTest, ConsecutiveDwords) {
+  runWIAnalysis("  %z = zext i32 %lane to i64\n"
+                "  %off = shl nuw nsw i64 %z, 2\n"
+                "  %addr = add nuw i64 %base, %off\n");
+  EXPECT_EQ(Facts["z"].Depend, 1u);
+  EXPECT_EQ(Facts["z"].NoWrap, (unsigned)WIAnalysis::NW_BOTH);
+  EXPECT_EQ(Facts["off"].Depend, 4u);
+  EXPECT_EQ(Facts["addr"].Depend, 4u);
+  EXPECT_TRUE(Facts["addr"].Consecutive4);
+  EXPECT_FALSE(Facts["addr"].Consecutive8);
+}
+
+TEST(WIAnalysisTest, ConsecutiveQwords) {
+  runWIAnalysis("  %z = zext i32 %lane to i64\n"
+                "  %off = mul nuw i64 %z, 8\n"
+                "  %addr = add nuw i64 %base, %off\n");
+  EXPECT_EQ(Facts["addr"].Depend, 8u);
+  EXPECT_FALSE(Facts["addr"].Consecutive4);
+  EXPECT_TRUE(Facts["addr"].Consecutive8);
+}
+
+// The address add may wrap around the top of memory, so the lanes need not
+// be consecutive.
+TEST(WIAnalysisTest, AddressMayWrap) {
+  runWIAnalysis("  %z = zext i32 %lane to i64\n"
+                "  %off = shl nuw nsw i64 %z, 2\n"
+                "  %addr = add i64 %base, %off\n");
+  EXPECT_EQ(Facts["addr"].Depend, 4u);
+  EXPECT_FALSE(Facts["addr"].NoWrap & WIAnalysis::NW_UNSIGNED);
+  EXPECT_FALSE(Facts["addr"].Consecutive4);
+}
+
+// A 32 bit offset that may overflow before it is extended loses its stride.
+TEST(WIAnalysisTest, OffsetMayOverflowBeforeExtension) {
+  runWIAnalysis("  %lu = add i32 %lane, %u\n"
+                "  %off = shl i32 %lu, 2\n"
+                "  %z = zext i32 %off to i64\n"
+                "  %s = sext i32 %off to i64\n"
+                "  %addr = add nuw i64 %base, %z\n");
+  EXPECT_EQ(Facts["off"].Depend, 4u);
+  EXPECT_EQ(Facts["off"].NoWrap, (unsigned)WIAnalysis::NW_NONE);
+  EXPECT_EQ(Facts["z"].Depend, (unsigned)WIAnalysis::RANDOM);
+  EXPECT_EQ(Facts["s"].Depend, (unsigned)WIAnalysis::RANDOM);
+  EXPECT_FALSE(Facts["addr"].Consecutive4);
+}
+
+// The same offset with no-wrap flags keeps its stride through the
+// extension that matches them.
+TEST(WIAnalysisTest, OffsetNoWrapThroughExtension) {
+  runWIAnalysis("  %lu = add nsw i32 %lane, %u\n"
+                "  %off = shl nsw i32 %lu, 2\n"
+                "  %s = sext i32 %off to i64\n"
+                "  %z = zext i32 %off to i64\n");
+  EXPECT_EQ(Facts["s"].Depend, 4u);
+  EXPECT_EQ(Facts["z"].Depend, (unsigned)WIAnalysis::RANDOM);
+}
+
+// A stride that does not fit below RANDOM is random.
+TEST(WIAnalysisTest, StrideOverflow) {
+  runWIAnalysis("  %z = zext i32 %lane to i64\n"
+                "  %off = mul nuw nsw i64 %z, 1024\n"
+                "  %neg = sub nuw nsw i64 0, %z\n");
+  EXPECT_EQ(Facts["off"].Depend, (unsigned)WIAnalysis::RANDOM);
+  EXPECT_EQ(Facts["neg"].Depend, (unsigned)WIAnalysis::RANDOM);
+  EXPECT_FALSE(Facts["off"].Consecutive4);
+}
+
+// An or with no common bits is an add that cannot carry; an and that only
+// clears known zero bits is a copy.
+TEST(WIAnalysisTest, OrAndAsCopies) {
+  runWIAnalysis("  %z = zext i32 %lane to i64\n"
+                "  %off = shl nuw nsw i64 %z, 4\n"
+                "  %or = or i64 %off, 4\n"
+                "  %and = and i64 %off, -16\n"
+                "  %mask = and i64 %off, 48\n");
+  EXPECT_EQ(Facts["or"].Depend, 16u);
+  EXPECT_TRUE(Facts["or"].NoWrap & WIAnalysis::NW_UNSIGNED);
+  EXPECT_EQ(Facts["and"].Depend, 16u);
+  EXPECT_EQ(Facts["mask"].Depend, (unsigned)WIAnalysis::RANDOM);
+}
+
+} // end anonymous namespace